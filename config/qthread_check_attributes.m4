@@ -147,3 +147,50 @@ AC_CACHE_CHECK([support for __sync_synchronize],
    [if the compiler supports inline assembly, we can prevent reordering])
  AS_IF([test "x$qt_cv_builtin_synchronize" == xyes], [$1], [$2])
 ])
+
+# QTHREAD_X86_SIMD_DISPATCH
+# -------------------------------------------------------------------------
+# Checks whether individual functions can be compiled for AVX2 and AVX-512F
+# (via __attribute__((target))) and selected at runtime with
+# __builtin_cpu_supports(), without raising the baseline for the whole
+# library.
+AC_DEFUN([QTHREAD_X86_SIMD_DISPATCH],[dnl
+AC_CACHE_CHECK(
+ [support for runtime-dispatched AVX2 functions],
+ [qt_cv_avx2_dispatch],
+ [AC_LINK_IFELSE([AC_LANG_PROGRAM([[#include <immintrin.h>
+__attribute__((target("avx2")))
+static long long f(const long long *p)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    v = _mm256_blendv_epi8(v, v, _mm256_cmpgt_epi64(v, v));
+    return _mm256_extract_epi64(v, 0);
+}]],[[
+long long x[4] = { 0, 1, 2, 3 };
+return __builtin_cpu_supports("avx2") ? (int)f(x) : 0;]])],
+ [qt_cv_avx2_dispatch=yes],
+ [qt_cv_avx2_dispatch=no])])
+ AS_IF([test "x$qt_cv_avx2_dispatch" = xyes],
+ 	   [AC_DEFINE([HAVE_X86_AVX2_DISPATCH], [1],
+		   [define if AVX2 functions can be compiled and selected at runtime])])
+AC_CACHE_CHECK(
+ [support for runtime-dispatched AVX-512F functions],
+ [qt_cv_avx512f_dispatch],
+ [AC_LINK_IFELSE([AC_LANG_PROGRAM([[#include <immintrin.h>
+__attribute__((target("avx512f")))
+static double f(const double *p, const long long *q)
+{
+    __m512i v = _mm512_max_epu64(_mm512_loadu_si512((const void *)q), _mm512_set1_epi64(1));
+    double  d[8];
+    _mm512_storeu_pd(d, _mm512_max_pd(_mm512_loadu_pd(p), _mm512_castsi512_pd(v)));
+    return d[0];
+}]],[[
+double x[8] = { 0 };
+long long y[8] = { 0 };
+return __builtin_cpu_supports("avx512f") ? (int)f(x, y) : 0;]])],
+ [qt_cv_avx512f_dispatch=yes],
+ [qt_cv_avx512f_dispatch=no])])
+ AS_IF([test "x$qt_cv_avx512f_dispatch" = xyes],
+ 	   [AC_DEFINE([HAVE_X86_AVX512F_DISPATCH], [1],
+		   [define if AVX-512F functions can be compiled and selected at runtime])])
+])
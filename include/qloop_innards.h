@@ -3,6 +3,7 @@
 
 #include "qthread/qtimer.h"
 
+struct qqloop_adaptive_slot;
 typedef struct qqloop_iteration_queue {
     saligned_t         start;
     saligned_t         stop;
@@ -14,6 +15,7 @@ typedef struct qqloop_iteration_queue {
             qtimer_t   *timers;
             saligned_t *lastblocks;
         } timed;
+        struct qqloop_adaptive_slot *adaptive;
     } type_specific_data;
 } qqloop_iteration_queue_t;
 struct qqloop_static_args;
@@ -48,6 +50,7 @@ struct qqloop_step_wrapper_args {
 };
 struct qqloop_wrapper_range {
     size_t startat, stopat, step;
+    size_t slot;                       /* which worker's piece (ADAPTIVE) */
 };
 struct qqloop_handle_s {
     struct qqloop_wrapper_args *qwa;
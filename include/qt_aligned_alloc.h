@@ -2,10 +2,10 @@
 
 #include "qt_visibility.h"
 
-void INTERNAL *qthread_internal_aligned_alloc(size_t        alloc_size,
-                                              uint_fast16_t alignment);
-void INTERNAL qthread_internal_aligned_free(void         *ptr,
-                                            uint_fast16_t alignment);
+void INTERNAL *qthread_internal_aligned_alloc(size_t alloc_size,
+                                              size_t alignment);
+void INTERNAL qthread_internal_aligned_free(void  *ptr,
+                                            size_t alignment);
 
 void INTERNAL qthread_internal_alignment_init(void);
 
@@ -2,6 +2,7 @@
 #define QT_BARRIER_H
 
 #include "qt_visibility.h"
+#include "qthread/barrier.h"
 
 /* these two calls assume that we're using a/the global barrier */
 void qt_global_barrier(void);
@@ -12,4 +13,29 @@ void qt_global_barrier_resize(size_t size);
 
 void INTERNAL qt_barrier_internal_init(void);
 
+/* DISSEMINATION_BARRIER and TOURNAMENT_BARRIER are implemented in
+ * barrier/hybrid.c; every backend's qt_barrier_t hands them off to it */
+#define QT_BARRIER_IS_HYBRID(type) ((type) == DISSEMINATION_BARRIER || (type) == TOURNAMENT_BARRIER)
+
+typedef struct qt_hybrid_barrier_s qt_hybrid_barrier_t;
+
+qt_hybrid_barrier_t INTERNAL *qt_hybrid_barrier_create(size_t           participants,
+                                                       qt_barrier_btype type);
+void INTERNAL qt_hybrid_barrier_enter(qt_hybrid_barrier_t *b);
+void INTERNAL qt_hybrid_barrier_enter_id(qt_hybrid_barrier_t *b,
+                                         size_t               id);
+void INTERNAL qt_hybrid_barrier_resize(qt_hybrid_barrier_t *b,
+                                       size_t               participants);
+void INTERNAL qt_hybrid_barrier_destroy(qt_hybrid_barrier_t *b);
+void INTERNAL qt_hybrid_barrier_dump(qt_hybrid_barrier_t *b);
+
+/* every backend keeps one of these for qt_barrier_arrive() and friends */
+typedef struct qt_split_barrier_s qt_split_barrier_t;
+
+qt_split_barrier_t INTERNAL *qt_split_barrier_create(size_t participants);
+void INTERNAL                qt_split_barrier_resize(qt_split_barrier_t *b,
+                                                     size_t              participants);
+void INTERNAL qt_split_barrier_destroy(qt_split_barrier_t *b);
+qt_split_barrier_t INTERNAL *qt_barrier_internal_split(qt_barrier_t *b);
+
 #endif
@@ -5,17 +5,46 @@
 
 typedef struct qt_mpool_s *qt_mpool;
 
+/* object hooks: called with the object and the pool's hook argument */
+typedef void (*qt_mpool_hook_f)(void *obj,
+                                void *arg);
+
 void *qt_mpool_alloc(qt_mpool pool);
 
 void qt_mpool_free(qt_mpool pool,
                    void    *mem);
 
+size_t qt_mpool_alloc_bulk(qt_mpool pool,
+                           void   **ptrs,
+                           size_t   n);
+void qt_mpool_free_bulk(qt_mpool     pool,
+                        void *const *ptrs,
+                        size_t       n);
+
 #define qt_mpool_create(item_size) qt_mpool_create_aligned((item_size), 0)
 
 qt_mpool qt_mpool_create_aligned(size_t       item_size,
                                  const size_t alignment);
+qt_mpool qt_mpool_create_hooked(size_t          item_size,
+                                size_t          alignment,
+                                qt_mpool_hook_f ctor,
+                                qt_mpool_hook_f dtor,
+                                void           *hook_arg);
 void qt_mpool_destroy(qt_mpool pool);
 
+/* a label for the pool in usage reports; the string is not copied */
+void qt_mpool_set_name(qt_mpool    pool,
+                       const char *name);
+
+/* usage statistics (see qthread_pool_stats()) */
+struct qthread_pool_stats_s;
+size_t qt_mpool_stats(struct qthread_pool_stats_s *stats,
+                      size_t                       max);
+
+/* release fully-idle blocks back to the system; returns bytes released */
+size_t qt_mpool_trim(qt_mpool pool);
+size_t qt_mpool_trim_all(void);
+
 void qt_mpool_subsystem_init(void);
 
 #endif // ifndef QT_MPOOL_H
@@ -28,7 +28,7 @@
 #define QTHREAD_HAS_ARGCOPY      (1 << 6)
 #define QTHREAD_TEAM_LEADER      (1 << 7)
 #define QTHREAD_TEAM_WATCHER     (1 << 8)
-#define QTHREAD_BIG_STRUCT       (1 << 9)
+#define QTHREAD_RESERVED_FLAG5   (1 << 9)
 #define QTHREAD_AGGREGABLE       (1 << 10)
 #define QTHREAD_AGGREGATED       (1 << 11)
 #define QTHREAD_RESERVED_FLAG4   (1 << 12)
@@ -88,6 +88,7 @@ struct qthread_s {
     enum threadstate           prev_thread_state;      /* save the previous thread state */
 #endif
     unsigned int               thread_id;
+    uint32_t                   argcopy_size;    /* size of the copied arg, needed to free it */
     qthread_shepherd_id_t      target_shepherd; /* the shepherd we'd rather run on; set to NO_SHEPHERD unless the thread either migrated or was spawned to a specific destination (aka the programmer expressed a desire for this thread to be somewhere) */
     uint16_t                   flags;           /* may not need all bits */
     uint8_t                    thread_state : 4;
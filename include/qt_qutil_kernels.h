@@ -0,0 +1,35 @@
+#ifndef QT_QUTIL_KERNELS_H
+#define QT_QUTIL_KERNELS_H
+
+#include <qthread/qthread.h>
+
+#include "qt_visibility.h"
+
+/* Sequential kernels used by the qutil reductions and the qarray kernels. The
+ * reductions each reduce a non-empty array of n elements; dot, axpy (y +=
+ * alpha * x) and fill64 take any n, and run fastest when their first (output)
+ * argument is vector-aligned, as qarray segments are. The best implementation
+ * the CPU supports is chosen the first time the table is requested. */
+typedef struct qt_qutil_kernels_s {
+    const char *name;
+    double      (*double_sum)(const double *restrict a, size_t n);
+    double      (*double_mult)(const double *restrict a, size_t n);
+    double      (*double_max)(const double *restrict a, size_t n);
+    double      (*double_min)(const double *restrict a, size_t n);
+    aligned_t   (*uint_sum)(const aligned_t *restrict a, size_t n);
+    aligned_t   (*uint_mult)(const aligned_t *restrict a, size_t n);
+    aligned_t   (*uint_max)(const aligned_t *restrict a, size_t n);
+    aligned_t   (*uint_min)(const aligned_t *restrict a, size_t n);
+    saligned_t  (*int_sum)(const saligned_t *restrict a, size_t n);
+    saligned_t  (*int_mult)(const saligned_t *restrict a, size_t n);
+    saligned_t  (*int_max)(const saligned_t *restrict a, size_t n);
+    saligned_t  (*int_min)(const saligned_t *restrict a, size_t n);
+    double      (*double_dot)(const double *restrict a, const double *restrict b, size_t n);
+    void        (*double_axpy)(double *restrict y, double alpha, const double *restrict x, size_t n);
+    void        (*fill64)(uint64_t *restrict a, uint64_t v, size_t n);
+} qt_qutil_kernels_t;
+
+const qt_qutil_kernels_t INTERNAL *qt_qutil_kernels(void);
+
+#endif // ifndef QT_QUTIL_KERNELS_H
+/* vim:set expandtab: */
@@ -0,0 +1,19 @@
+#ifndef QT_SLAB_H
+#define QT_SLAB_H
+
+#include <stddef.h>                    /* for size_t (according to C89) */
+
+/* Variable-sized runtime allocations (argument copies, task-local storage)
+ * are served from a set of size classes, each backed by a qt_mpool. Requests
+ * larger than QT_SLAB_MAX fall through to malloc(). The caller must pass the
+ * same size to qt_slab_free() that it passed to qt_slab_alloc(). */
+#define QT_SLAB_MAX 4096
+
+void *qt_slab_alloc(size_t size);
+void  qt_slab_free(void  *ptr,
+                   size_t size);
+
+void qt_slab_subsystem_init(void);
+
+#endif // ifndef QT_SLAB_H
+/* vim:set expandtab: */
@@ -10,7 +10,11 @@ Q_STARTCXX
 /************************************************************/
 typedef enum {
     REGION_BARRIER,
-    LOOP_BARRIER
+    LOOP_BARRIER,
+    /* spin-then-suspend barriers on padded flags, whichever backend
+     * was configured */
+    DISSEMINATION_BARRIER,
+    TOURNAMENT_BARRIER
 } qt_barrier_btype;
 
 typedef enum {
@@ -33,6 +37,16 @@ void qt_barrier_destroy(qt_barrier_t *b);
 void qt_barrier_resize(qt_barrier_t *b,
                        size_t        size);
 
+/* split-phase use: arrive without blocking, do something useful, then wait
+ * for (or test) the phase that arrival returned. Every participant in an
+ * episode must use these, or every one must use qt_barrier_enter(); a
+ * participant must wait for its phase before arriving again. */
+aligned_t qt_barrier_arrive(qt_barrier_t *b);
+void      qt_barrier_wait(qt_barrier_t *b,
+                          aligned_t     phase);
+int qt_barrier_test(qt_barrier_t *b,
+                    aligned_t     phase);
+
 /* debugging... */
 void qt_barrier_dump(qt_barrier_t    *b,
                      qt_barrier_dtype dt);
@@ -88,6 +88,31 @@ void *qt_dictionary_put_if_absent(qt_dictionary *dict,
 void *qt_dictionary_get(qt_dictionary *dict,
                         void          *key);
 
+/*
+ *      Inserts n key, value pairs in the dictionary, as if by qt_dictionary_put
+ *      on each pair in turn (keys[i] gets values[i])
+ *      returns:
+ *                      the number of pairs that were successfully inserted
+ *
+ */
+size_t qt_dictionary_put_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void *const   *values,
+                              size_t         n);
+
+/*
+ *      Gets the values for n keys, as if by qt_dictionary_get on each key in
+ *      turn; values[i] gets the value for keys[i], or NULL if it isn't there
+ *      returns:
+ *                      the number of keys that were found (i.e. the number of
+ *                      non-NULL values)
+ *
+ */
+size_t qt_dictionary_get_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void         **values,
+                              size_t         n);
+
 /*
  *      Removes a key,value pair from the dictionary
  *      returns:
@@ -115,6 +115,82 @@ QINLINE static void *qarray_elem_nomigrate(const qarray *a,
     }
 }
 
+/* the number of elements from index (but not past stopat) that are contiguous
+ * in memory: the rest of index's segment, or all of them in a tight array */
+QINLINE static size_t qarray_contig(const qarray *a,
+                                    const size_t  index,
+                                    const size_t  stopat)
+{
+    size_t end = stopat;
+
+    if (a->segment_bytes != a->segment_size * a->unit_size) {
+        const size_t segment_end = (index / a->segment_size + 1) * a->segment_size;
+
+        if (segment_end < end) { end = segment_end; }
+    }
+    return end - index;
+}
+
+/* Typed kernels over the elements [startat, stopat). The work on each segment
+ * is done by the shepherd that owns it, a contiguous run at a time, with
+ * vector instructions where the CPU has them. The arrays must hold elements
+ * of the named type; the two-array kernels also need matching element sizes,
+ * and are fastest when one array was laid out like the other with
+ * qarray_dist_like(). The reductions return 0 for an empty range. */
+void qarray_double_fill(qarray      *a,
+                        const size_t startat,
+                        const size_t stopat,
+                        double       value);
+void qarray_uint_fill(qarray      *a,
+                      const size_t startat,
+                      const size_t stopat,
+                      aligned_t    value);
+void qarray_int_fill(qarray      *a,
+                     const size_t startat,
+                     const size_t stopat,
+                     saligned_t   value);
+void qarray_copy(qarray       *dst,
+                 const qarray *src,
+                 const size_t  startat,
+                 const size_t  stopat);
+/* y[i] += alpha * x[i] */
+void qarray_double_axpy(qarray       *y,
+                        double        alpha,
+                        const qarray *x,
+                        const size_t  startat,
+                        const size_t  stopat);
+double qarray_double_dot(const qarray *a,
+                         const qarray *b,
+                         const size_t  startat,
+                         const size_t  stopat);
+double qarray_double_sum(const qarray *a,
+                         const size_t  startat,
+                         const size_t  stopat);
+double qarray_double_max(const qarray *a,
+                         const size_t  startat,
+                         const size_t  stopat);
+double qarray_double_min(const qarray *a,
+                         const size_t  startat,
+                         const size_t  stopat);
+aligned_t qarray_uint_sum(const qarray *a,
+                          const size_t  startat,
+                          const size_t  stopat);
+aligned_t qarray_uint_max(const qarray *a,
+                          const size_t  startat,
+                          const size_t  stopat);
+aligned_t qarray_uint_min(const qarray *a,
+                          const size_t  startat,
+                          const size_t  stopat);
+saligned_t qarray_int_sum(const qarray *a,
+                          const size_t  startat,
+                          const size_t  stopat);
+saligned_t qarray_int_max(const qarray *a,
+                          const size_t  startat,
+                          const size_t  stopat);
+saligned_t qarray_int_min(const qarray *a,
+                          const size_t  startat,
+                          const size_t  stopat);
+
 Q_ENDCXX
 #endif // ifndef QTHREAD_QARRAY_H
 /* vim:set expandtab: */
@@ -0,0 +1,89 @@
+#ifndef QARRAY_HPP
+#define QARRAY_HPP
+
+/* Elementwise maps over qarrays:
+ *
+ *     qarray_map<double>(a, 0, a->count, scale(2.0));                 // a[i] = f(a[i])
+ *     qarray_transform<float, double>(b, a, 0, a->count, narrow());   // b[i] = f(a[i])
+ *
+ * The template arguments are the element types (of the destination, then of
+ * the source), and must match the arrays' unit sizes.
+ *
+ * As with the C kernels in qarray.h, each segment is handled by the shepherd
+ * that owns it (of the destination array, for a transform), and the functor
+ * is applied over contiguous runs with a plain indexed loop, so that once it
+ * is inlined, the compiler can vectorize it. The functor is shared by all of
+ * the shepherds, and is called as f(x). */
+
+#include <assert.h>
+#include <qthread/qarray.h>
+
+template <typename F>
+struct qarray_map_args {
+    const qarray *src;
+    F            *f;
+};
+
+template <typename D, typename S, typename F>
+void qarray_map_cpp_wrapper(const size_t startat,
+                            const size_t stopat,
+                            qarray      *array,
+                            void        *_arg)
+{                                       /*{{{ */
+    qarray_map_args<F> *arg = (qarray_map_args<F> *)_arg;
+    F                   f   = *arg->f;
+
+    for (size_t i = startat; i < stopat;) {
+        size_t n = qarray_contig(array, i, stopat);
+
+        if (arg->src != array) {
+            const size_t ns = qarray_contig(arg->src, i, stopat);
+
+            if (ns < n) { n = ns; }
+        }
+        {
+            D *__restrict       d = (D *)qarray_elem_nomigrate(array, i);
+            const S *__restrict s = (const S *)qarray_elem_nomigrate(arg->src, i);
+
+            if (arg->src == array) {
+                /* in place, so D and S are the same */
+                for (size_t j = 0; j < n; j++) {
+                    d[j] = f(d[j]);
+                }
+            } else {
+                for (size_t j = 0; j < n; j++) {
+                    d[j] = f(s[j]);
+                }
+            }
+        }
+        i += n;
+    }
+}                                       /*}}} */
+
+template <typename D, typename S, typename F>
+void qarray_transform(qarray       *dst,
+                      const qarray *src,
+                      const size_t  startat,
+                      const size_t  stopat,
+                      const F      &f)
+{                                       /*{{{ */
+    qarray_map_args<F> arg = { src, &(const_cast<F &>(f)) };
+
+    assert(dst->unit_size == sizeof(D) && src->unit_size == sizeof(S));
+    assert(stopat <= dst->count && stopat <= src->count);
+    if (startat >= stopat) { return; }
+    qarray_iter_loop(dst, startat, stopat, qarray_map_cpp_wrapper<D, S, F>,
+                     &arg);
+}                                       /*}}} */
+
+template <typename T, typename F>
+void qarray_map(qarray      *a,
+                const size_t startat,
+                const size_t stopat,
+                const F     &f)
+{                                       /*{{{ */
+    qarray_transform<T, T>(a, a, startat, stopat, f);
+}                                       /*}}} */
+
+#endif // ifndef QARRAY_HPP
+/* vim:set expandtab: */
@@ -21,9 +21,28 @@ int qdqueue_enqueue_there(qdqueue_t            *q,
                           void                 *elem,
                           qthread_shepherd_id_t there);
 
+/* enqueue n things in the queue, in order, with a single advertisement */
+int qdqueue_enqueue_many(qdqueue_t   *q,
+                         void *const *elems,
+                         size_t       n);
+
+/* enqueue something in the calling worker's private buffer; the buffer is
+ * handed to the shepherd's queue when it fills up or is flushed */
+int qdqueue_enqueue_buffered(qdqueue_t *q,
+                             void      *elem);
+
+/* hand every worker's buffered elements to the shared queues */
+int qdqueue_flush(qdqueue_t *q);
+
 /* dequeue something from the queue (returns NULL for an empty queue) */
 void *qdqueue_dequeue(qdqueue_t *q);
 
+/* dequeue up to n things from the queue; returns how many were dequeued (0
+ * for an empty queue) */
+size_t qdqueue_dequeue_many(qdqueue_t *q,
+                            void     **elems,
+                            size_t     n);
+
 /* returns 1 if the queue is empty, 0 otherwise */
 int qdqueue_empty(qdqueue_t *q);
 
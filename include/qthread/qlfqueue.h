@@ -1,6 +1,7 @@
 #ifndef QTHREAD_QLFQUEUE_H
 #define QTHREAD_QLFQUEUE_H
 
+#include <stddef.h>                    /* for size_t (according to C89) */
 #include <qthread/macros.h>
 
 Q_STARTCXX /* */
@@ -10,6 +11,14 @@ typedef struct qlfqueue_s qlfqueue_t;
 /* Create a new qlfqueue */
 qlfqueue_t *qlfqueue_create(void);
 
+/* Create a new qlfqueue that keeps its elements in linked rings of ring_size
+ * slots (rounded up to a power of two; 0 picks a default) rather than in one
+ * node per element. Enqueuers and dequeuers claim slots with a fetch-and-add
+ * instead of racing to swing one pointer, which holds up much better under
+ * contention. This needs a 128-bit CAS; without one, this is the same as
+ * qlfqueue_create(). */
+qlfqueue_t *qlfqueue_create_ring(size_t ring_size);
+
 /* destroy that queue */
 int qlfqueue_destroy(qlfqueue_t *q);
 
@@ -20,6 +29,17 @@ int qlfqueue_enqueue(qlfqueue_t *q,
 /* dequeue something from the queue (returns NULL for an empty queue) */
 void *qlfqueue_dequeue(qlfqueue_t *q);
 
+/* enqueue n things, in order (none of them may be NULL) */
+int qlfqueue_enqueue_many(qlfqueue_t *q,
+                          void *const *elems,
+                          size_t       n);
+
+/* dequeue up to n things into elems, in order, and return how many there
+ * were (0 for an empty queue) */
+size_t qlfqueue_dequeue_many(qlfqueue_t *q,
+                             void      **elems,
+                             size_t      n);
+
 /* returns 1 if the queue is empty, 0 otherwise */
 int qlfqueue_empty(qlfqueue_t *q);
 
@@ -15,9 +15,24 @@ typedef void (*qt_loopr_f)(const size_t   startat,
                            void *restrict ret);
 typedef void (*qt_accum_f)(void *restrict       a,
                            const void *restrict b);
+typedef int (*qt_pred_f)(const void *elem,
+                         void       *arg);
+typedef void (*qt_loop2d_f)(const size_t xstart,
+                            const size_t xstop,
+                            const size_t ystart,
+                            const size_t ystop,
+                            void        *arg);
+typedef void (*qt_loop3d_f)(const size_t xstart,
+                            const size_t xstop,
+                            const size_t ystart,
+                            const size_t ystop,
+                            const size_t zstart,
+                            const size_t zstop,
+                            void        *arg);
 
 typedef struct qqloop_handle_s qqloop_handle_t;
 typedef struct qqloop_step_handle_s qqloop_step_handle_t;
+typedef struct qt_loop_affinity_s qt_loop_affinity_t;
 
 void qt_loop(size_t    start,
              size_t    stop,
@@ -72,6 +87,28 @@ void qt_loop_balance_sinc(const size_t    start,
                           const size_t    stop,
                           const qt_loop_f func,
                           void           *argptr);
+void qt_loop_balance_lazy(const size_t    start,
+                          const size_t    stop,
+                          const qt_loop_f func,
+                          void           *argptr);
+void qt_loop_balance_lazy_grain(const size_t    start,
+                                const size_t    stop,
+                                size_t          grain,
+                                const qt_loop_f func,
+                                void           *argptr);
+void qt_loop_balance_nested(const size_t    start,
+                            const size_t    stop,
+                            const qt_loop_f func,
+                            void           *argptr);
+qt_loop_affinity_t *qt_loop_affinity_create(const size_t start,
+                                            const size_t stop);
+void qt_loop_affinity_run(qt_loop_affinity_t *h,
+                          const qt_loop_f     func,
+                          void               *argptr);
+qthread_shepherd_id_t qt_loop_affinity_shepof(const qt_loop_affinity_t *h,
+                                              const size_t              index);
+void qt_loop_affinity_reset(qt_loop_affinity_t *h);
+void qt_loop_affinity_destroy(qt_loop_affinity_t *h);
 void qt_loopaccum_balance(const size_t     start,
                           const size_t     stop,
                           const size_t     size,
@@ -101,7 +138,50 @@ void qt_loopaccum_balance_dc(const size_t     start,
                              void *restrict   argptr,
                              const qt_accum_f acc);
 
-typedef enum {CHUNK, GUIDED, FACTORED, TIMED} qt_loop_queue_type;
+typedef enum {QT_LOOP_ROW_MAJOR, QT_LOOP_MORTON, QT_LOOP_HILBERT, QT_LOOP_RECURSIVE} qt_loop_order;
+void qt_loop2d(const size_t        xstart,
+               const size_t        xstop,
+               const size_t        ystart,
+               const size_t        ystop,
+               const size_t        xtile,
+               const size_t        ytile,
+               const qt_loop_order order,
+               const qt_loop2d_f   func,
+               void               *argptr);
+void qt_loop3d(const size_t        xstart,
+               const size_t        xstop,
+               const size_t        ystart,
+               const size_t        ystop,
+               const size_t        zstart,
+               const size_t        zstop,
+               const size_t        xtile,
+               const size_t        ytile,
+               const size_t        ztile,
+               const qt_loop_order order,
+               const qt_loop3d_f   func,
+               void               *argptr);
+
+typedef enum {QT_SCAN_INCLUSIVE, QT_SCAN_EXCLUSIVE} qt_scan_type;
+void   qt_loop_scan(const void        *in,
+                    void              *out,
+                    const size_t       count,
+                    const size_t       size,
+                    const qt_accum_f   op,
+                    const void        *identity,
+                    const qt_scan_type type);
+size_t qt_compact(const void *restrict in,
+                  void *restrict       out,
+                  const size_t         count,
+                  const size_t         size,
+                  const qt_pred_f      pred,
+                  void                *arg);
+size_t qt_partition(void           *base,
+                    const size_t    count,
+                    const size_t    size,
+                    const qt_pred_f pred,
+                    void           *arg);
+
+typedef enum {CHUNK, GUIDED, FACTORED, TIMED, ADAPTIVE} qt_loop_queue_type;
 qqloop_handle_t *qt_loop_queue_create(const qt_loop_queue_type type,
                                       const size_t             start,
                                       const size_t             stop,
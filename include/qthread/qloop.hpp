@@ -55,6 +55,13 @@ void qt_loop_balance_future(size_t   start,
                            &(const_cast<T &>(obj)));
 }                                       /*}}} */
 
+template <typename T>
+void qt_loop_affinity_run(qt_loop_affinity_t *h,
+                          const T            &obj)
+{                                       /*{{{ */
+    qt_loop_affinity_run(h, qloop_cpp_wrapper<T>, &(const_cast<T &>(obj)));
+}                                       /*}}} */
+
 template <typename T>
 void qloop_accum_cpp_wrapper(size_t startat,
                              size_t stopat,
@@ -77,5 +84,196 @@ typename T::acctype qt_loopaccum_balance(size_t   start,
     qt_loopaccum_balance(start, stop, sizeof(typename T::acctype), &accumulate, qloop_accum_cpp_wrapper<T>, &(const_cast<T &>(obj)), (qt_accum_f)(T::accumulate));
     return accumulate;
 }
+
+#if __cplusplus >= 201103L
+# include <vector>
+# include <utility>
+# include <qthread/sinc.h>
+
+/* C++11 loops whose body is a template parameter, so it is inlined into the
+ * per-chunk worker rather than called through a function pointer for every
+ * iteration. With grain == 0 the range is split once, as by qt_loop_balance();
+ * otherwise one task per worker claims grain-sized chunks from a shared
+ * counter until the range is exhausted. */
+namespace qthread {
+namespace detail {
+template <typename Body>
+void parallel_for_chunk(size_t startat,
+                        size_t stopat,
+                        void  *arg)
+{                                       /*{{{ */
+    Body &body = *static_cast<Body *>(arg);
+
+    for (size_t i = startat; i < stopat; i++) {
+        body(i);
+    }
+}                                       /*}}} */
+
+template <typename T>
+struct reduce_slot {
+    explicit reduce_slot(const T &v) : val(v) {}
+    T val;
+};
+
+template <typename Body, typename T, typename Reduce>
+struct loop_job {
+    loop_job(size_t         b,
+             size_t         e,
+             size_t         g,
+             const Body    &bd,
+             const T       &id,
+             const Reduce  &r,
+             size_t         ntasks) :
+        begin(b), end(e), grain(g), next(0),
+        nchunks((e - b + g - 1) / g),
+        body(bd), identity(id), reduce(r),
+        partials(ntasks, reduce_slot<T>(id))
+    {}
+
+    /* claim chunks until none are left */
+    void run(size_t task)
+    {
+        T acc(identity);
+
+        for (aligned_t c = qthread_incr(&next, 1); c < nchunks;
+             c = qthread_incr(&next, 1)) {
+            const size_t first = begin + c * grain;
+            const size_t last  = (end - first > grain) ? first + grain : end;
+
+            for (size_t i = first; i < last; i++) {
+                acc = reduce(std::move(acc), body(i));
+            }
+        }
+        partials[task].val = std::move(acc);
+    }
+
+    const size_t                   begin, end, grain;
+    aligned_t                      next;
+    const aligned_t                nchunks;
+    Body                           body;
+    const T                        identity;
+    Reduce                         reduce;
+    std::vector<reduce_slot<T> >   partials;
+    qt_sinc_t                      sinc;
+};
+
+template <typename Job>
+struct loop_task_arg {
+    Job   *job;
+    size_t task;
+};
+
+template <typename Job>
+aligned_t loop_task(void *arg_)
+{                                       /*{{{ */
+    loop_task_arg<Job> *arg = static_cast<loop_task_arg<Job> *>(arg_);
+
+    arg->job->run(arg->task);
+    qt_sinc_submit(&arg->job->sinc, NULL);
+    return 0;
+}                                       /*}}} */
+
+template <typename Job>
+void loop_spawn(Job   &job,
+                size_t ntasks)
+{                                       /*{{{ */
+    const qthread_shepherd_id_t nsheps = qthread_num_shepherds();
+    loop_task_arg<Job>          arg;
+
+    if (ntasks == 1) {
+        job.run(0);
+        return;
+    }
+    arg.job = &job;
+    qt_sinc_init(&job.sinc, 0, NULL, NULL, ntasks);
+    for (arg.task = 0; arg.task < ntasks; arg.task++) {
+        qthread_spawn(loop_task<Job>, &arg, sizeof(arg), NULL,
+                      0, NULL, arg.task % nsheps, 0);
+    }
+    qt_sinc_wait(&job.sinc, NULL);
+    qt_sinc_fini(&job.sinc);
+}                                       /*}}} */
+
+/* adapts a void body to loop_job, which always reduces */
+template <typename Body>
+struct void_body {
+    explicit void_body(const Body &b) : body(b) {}
+    char operator()(size_t i) { body(i); return 0; }
+    Body body;
+};
+
+struct void_reduce {
+    char operator()(char, char) const { return 0; }
+};
+}
+
+/* calls body(i) for every i in [begin, end) */
+template <typename Body>
+void parallel_for(size_t      begin,
+                  size_t      end,
+                  size_t      grain,
+                  const Body &body)
+{                                       /*{{{ */
+    if (end <= begin) { return; }
+    if (grain == 0) {
+        Body b(body);
+
+        qt_loop_balance(begin, end, detail::parallel_for_chunk<Body>, &b);
+    } else {
+        typedef detail::loop_job<detail::void_body<Body>, char, detail::void_reduce> job_t;
+        const size_t nchunks = (end - begin + grain - 1) / grain;
+        const size_t workers = qthread_num_workers();
+        const size_t ntasks  = (nchunks < workers) ? nchunks : workers;
+        job_t        job(begin, end, grain, detail::void_body<Body>(body), 0,
+                         detail::void_reduce(), ntasks);
+
+        detail::loop_spawn(job, ntasks);
+    }
+}                                       /*}}} */
+
+template <typename Body>
+void parallel_for(size_t      begin,
+                  size_t      end,
+                  const Body &body)
+{                                       /*{{{ */
+    parallel_for(begin, end, 0, body);
+}                                       /*}}} */
+
+/* returns identity combined with body(i) for every i in [begin, end) using
+ * reduce(a, b), which must be associative and commutative: each task folds
+ * the chunks it claims into its own accumulator, and the accumulators are
+ * combined once every task has finished. */
+template <typename T, typename Body, typename Reduce>
+T parallel_reduce(size_t        begin,
+                  size_t        end,
+                  size_t        grain,
+                  const T      &identity,
+                  const Body   &body,
+                  const Reduce &reduce)
+{                                       /*{{{ */
+    typedef detail::loop_job<Body, T, Reduce> job_t;
+
+    if (end <= begin) { return identity; }
+
+    const size_t workers = qthread_num_workers();
+    if (grain == 0) {
+        grain = (end - begin + workers - 1) / workers;
+    }
+
+    const size_t nchunks = (end - begin + grain - 1) / grain;
+    const size_t ntasks  = (nchunks < workers) ? nchunks : workers;
+    job_t        job(begin, end, grain, body, identity, reduce, ntasks);
+
+    detail::loop_spawn(job, ntasks);
+
+    T ret(std::move(job.partials[0].val));
+    for (size_t t = 1; t < ntasks; t++) {
+        ret = reduce(std::move(ret), std::move(job.partials[t].val));
+    }
+    return ret;
+}                                       /*}}} */
+}
+#endif // if __cplusplus >= 201103L
+
 #endif // ifndef QLOOP_HPP
 /* vim:set expandtab: */
@@ -0,0 +1,296 @@
+#ifndef QLOOP_PIPELINE_HPP
+#define QLOOP_PIPELINE_HPP
+
+/* Fused loop pipelines: a source range, any number of map and filter
+ * stages, and one terminal operation, run as a single pass with no
+ * intermediate arrays. For example:
+ *
+ *     double s = qt_pipeline(data, n).map(square()).filter(positive())
+ *                                    .reduce(add(), 0.0);
+ *
+ * The range is split into one chunk per worker, as with qt_loop_balance().
+ * Each task runs every element of its chunk through all of the stages before
+ * moving on to the next element, so nothing is written to memory between
+ * stages; it then stores its partial result, and the tasks are joined with a
+ * qt_sinc. The caller combines the partial results in chunk order, so a
+ * reduction only needs to be associative, not commutative.
+ *
+ * Stage functors are copied into each task, and are called as f(x), p(x),
+ * and op(a, b). Values must be default-constructible and assignable. Before
+ * C++11, a map functor must declare its result_type. */
+
+#include <stddef.h>
+#include <qthread/qthread.h>
+#include <qthread/sinc.h>
+#if __cplusplus >= 201103L
+# include <utility>
+# include <type_traits>
+# define QT_PIPELINE_RESULT(F, A) \
+    typename std::decay<decltype(std::declval<F &>()(std::declval<A>()))>::type
+#else
+# define QT_PIPELINE_RESULT(F, A) typename F::result_type
+#endif
+
+/* sources */
+struct qt_pipeline_range {
+    typedef size_t value_type;
+    bool get(size_t     i,
+             value_type &out)
+    {
+        out = i;
+        return true;
+    }
+};
+
+template <typename T>
+struct qt_pipeline_array {
+    typedef T value_type;
+    explicit qt_pipeline_array(const T *b) : base(b) {}
+    bool get(size_t     i,
+             value_type &out)
+    {
+        out = base[i];
+        return true;
+    }
+
+    const T *base;
+};
+
+/* stages */
+template <typename Prev, typename F>
+struct qt_pipeline_map {
+    typedef QT_PIPELINE_RESULT (F, typename Prev::value_type) value_type;
+    qt_pipeline_map(const Prev &p,
+                    const F    &f_) : prev(p), f(f_) {}
+    bool get(size_t     i,
+             value_type &out)
+    {
+        typename Prev::value_type in;
+
+        if (!prev.get(i, in)) { return false; }
+        out = f(in);
+        return true;
+    }
+
+    Prev prev;
+    F    f;
+};
+
+template <typename Prev, typename P>
+struct qt_pipeline_filter {
+    typedef typename Prev::value_type value_type;
+    qt_pipeline_filter(const Prev &p,
+                       const P    &pred_) : prev(p), pred(pred_) {}
+    bool get(size_t     i,
+             value_type &out)
+    {
+        return prev.get(i, out) && pred(out);
+    }
+
+    Prev prev;
+    P    pred;
+};
+
+/* terminals; each task gets its own copy */
+template <typename T, typename Op>
+struct qt_pipeline_reduce_term {
+    typedef T result_type;
+    qt_pipeline_reduce_term(const Op &o,
+                            const T  &id) : op(o), acc(id) {}
+    void consume(const T &v) { acc = op(acc, v); }
+    result_type result() const { return acc; }
+    void combine(result_type       &a,
+                 const result_type &b) { a = op(a, b); }
+
+    Op op;
+    T  acc;
+};
+
+struct qt_pipeline_count_term {
+    typedef size_t result_type;
+    qt_pipeline_count_term() : n(0) {}
+    template <typename T>
+    void consume(const T &) { n++; }
+    result_type result() const { return n; }
+    void combine(result_type       &a,
+                 const result_type &b) { a += b; }
+
+    size_t n;
+};
+
+template <typename F>
+struct qt_pipeline_for_each_term {
+    typedef int result_type;
+    explicit qt_pipeline_for_each_term(const F &f_) : f(f_) {}
+    template <typename T>
+    void consume(const T &v) { f(v); }
+    result_type result() const { return 0; }
+    void combine(result_type &,
+                 const result_type &) {}
+
+    F f;
+};
+
+/* the fused pass */
+template <typename Stage, typename Term>
+struct qt_pipeline_job {
+    qt_pipeline_job(const Stage &s,
+                    const Term  &t,
+                    size_t       start,
+                    size_t       stop,
+                    size_t       nchunks) :
+        stage(s), term(t), startat(start),
+        each((stop - start) / nchunks),
+        extra((stop - start) % nchunks),
+        partials(new typename Term::result_type[nchunks])
+    {}
+    ~qt_pipeline_job() { delete[] partials; }
+
+    void run(size_t chunk)
+    {
+        const size_t               first = startat + chunk * each + ((chunk < extra) ? chunk : extra);
+        const size_t               last  = first + each + ((chunk < extra) ? 1 : 0);
+        Stage                      s(stage);
+        Term                       t(term);
+        typename Stage::value_type v;
+
+        for (size_t i = first; i < last; i++) {
+            if (s.get(i, v)) { t.consume(v); }
+        }
+        partials[chunk] = t.result();
+    }
+
+    const Stage                       stage;
+    const Term                        term;
+    const size_t                      startat, each, extra;
+    typename Term::result_type *const partials;
+    qt_sinc_t                         sinc;
+
+private:
+    qt_pipeline_job(const qt_pipeline_job &);
+    qt_pipeline_job &operator=(const qt_pipeline_job &);
+};
+
+template <typename Stage, typename Term>
+struct qt_pipeline_task_arg {
+    qt_pipeline_job<Stage, Term> *job;
+    size_t                        chunk;
+};
+
+template <typename Stage, typename Term>
+aligned_t qt_pipeline_task(void *arg_)
+{                                       /*{{{ */
+    qt_pipeline_task_arg<Stage, Term> *arg = (qt_pipeline_task_arg<Stage, Term> *)arg_;
+
+    arg->job->run(arg->chunk);
+    qt_sinc_submit(&arg->job->sinc, NULL);
+    return 0;
+}                                       /*}}} */
+
+template <typename Stage, typename Term>
+typename Term::result_type qt_pipeline_run(const Stage &stage,
+                                           Term         term,
+                                           size_t       start,
+                                           size_t       stop)
+{                                       /*{{{ */
+    const size_t workers = qthread_num_workers();
+
+    if (stop <= start) { return term.result(); }
+
+    const size_t                 nchunks = (stop - start < workers) ? (stop - start) : workers;
+    qt_pipeline_job<Stage, Term> job(stage, term, start, stop, nchunks);
+
+    if (nchunks == 1) {
+        job.run(0);
+    } else {
+        const qthread_shepherd_id_t       nsheps = qthread_num_shepherds();
+        qt_pipeline_task_arg<Stage, Term> arg;
+
+        arg.job = &job;
+        qt_sinc_init(&job.sinc, 0, NULL, NULL, nchunks);
+        for (arg.chunk = 0; arg.chunk < nchunks; arg.chunk++) {
+            qthread_spawn(qt_pipeline_task<Stage, Term>,
+                          &arg, sizeof(arg),
+                          NULL,
+                          0, NULL,
+                          arg.chunk % nsheps,
+                          0);
+        }
+        qt_sinc_wait(&job.sinc, NULL);
+        qt_sinc_fini(&job.sinc);
+    }
+    typename Term::result_type ret = job.partials[0];
+    for (size_t i = 1; i < nchunks; i++) {
+        term.combine(ret, job.partials[i]);
+    }
+    return ret;
+}                                       /*}}} */
+
+template <typename Stage>
+class qt_pipeline_s
+{
+public:
+    typedef typename Stage::value_type value_type;
+
+    qt_pipeline_s(size_t       start,
+                  size_t       stop,
+                  const Stage &s) : start_(start), stop_(stop), stage_(s) {}
+
+    template <typename F>
+    qt_pipeline_s<qt_pipeline_map<Stage, F> > map(const F &f) const
+    {
+        return qt_pipeline_s<qt_pipeline_map<Stage, F> >(start_, stop_,
+                                                         qt_pipeline_map<Stage, F>(stage_, f));
+    }
+
+    template <typename P>
+    qt_pipeline_s<qt_pipeline_filter<Stage, P> > filter(const P &p) const
+    {
+        return qt_pipeline_s<qt_pipeline_filter<Stage, P> >(start_, stop_,
+                                                            qt_pipeline_filter<Stage, P>(stage_, p));
+    }
+
+    /* returns identity if nothing survives the filters */
+    template <typename Op>
+    value_type reduce(const Op         &op,
+                      const value_type &identity) const
+    {
+        return qt_pipeline_run(stage_, qt_pipeline_reduce_term<value_type, Op>(op, identity),
+                               start_, stop_);
+    }
+
+    size_t count() const
+    {
+        return qt_pipeline_run(stage_, qt_pipeline_count_term(), start_, stop_);
+    }
+
+    /* f is called concurrently, in no particular order */
+    template <typename F>
+    void for_each(const F &f) const
+    {
+        qt_pipeline_run(stage_, qt_pipeline_for_each_term<F>(f), start_, stop_);
+    }
+
+private:
+    const size_t start_, stop_;
+    const Stage  stage_;
+};
+
+/* the elements are the indices from start to stop */
+inline qt_pipeline_s<qt_pipeline_range> qt_pipeline(size_t start,
+                                                    size_t stop)
+{                                       /*{{{ */
+    return qt_pipeline_s<qt_pipeline_range>(start, stop, qt_pipeline_range());
+}                                       /*}}} */
+
+/* the elements are base[0] through base[n - 1] */
+template <typename T>
+qt_pipeline_s<qt_pipeline_array<T> > qt_pipeline(const T *base,
+                                                 size_t   n)
+{                                       /*{{{ */
+    return qt_pipeline_s<qt_pipeline_array<T> >(0, n, qt_pipeline_array<T>(base));
+}                                       /*}}} */
+
+#undef QT_PIPELINE_RESULT
+#endif // ifndef QLOOP_PIPELINE_HPP
+/* vim:set expandtab: */
@@ -9,14 +9,29 @@ Q_STARTCXX /* */
 
 typedef struct qt_mpool_s qpool;
 
+typedef void (*qpool_hook_f)(void *obj,
+                             void *arg);
+
 void *qpool_alloc(qpool *pool);
 
 void qpool_free(qpool *restrict pool,
                 void  *restrict mem);
 
+size_t qpool_alloc_bulk(qpool *restrict pool,
+                        void **restrict ptrs,
+                        size_t          n);
+void qpool_free_bulk(qpool *restrict       pool,
+                     void *const *restrict ptrs,
+                     size_t                n);
+
 qpool *qpool_create(const size_t item_size);
 qpool *qpool_create_aligned(const size_t item_size,
                             const size_t alignment);
+qpool *qpool_create_with_hooks(const size_t item_size,
+                               const size_t alignment,
+                               qpool_hook_f constructor,
+                               qpool_hook_f destructor,
+                               void        *arg);
 
 void qpool_destroy(qpool *pool);
 
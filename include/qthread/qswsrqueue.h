@@ -1,13 +1,15 @@
 #ifndef QTHREAD_QSWSRQUEUE_H
 #define QTHREAD_QSWSRQUEUE_H
 
+#include <stddef.h>                    /* for size_t (according to C89) */
 #include <qthread/macros.h>
 
 Q_STARTCXX /* */
 
 typedef struct qswsrqueue_s qswsrqueue_t;
 
-/* Create a new qswsrqueue */
+/* Create a new single-writer, single-reader qswsrqueue with room for at least
+ * the given number of elements (rounded up to a power of two) */
 qswsrqueue_t *qswsrqueue_create(size_t elements);
 
 /* destroy that queue */
@@ -17,16 +19,28 @@ int qswsrqueue_destroy(qswsrqueue_t *q);
 int qswsrqueue_enqueue(qswsrqueue_t *q,
                        void         *elem);
 
-/* enqueue something in the queue */
+/* enqueue something in the queue, suspending while it's full */
 int qswsrqueue_enqueue_blocking(qswsrqueue_t *q,
                                 void         *elem);
 
+/* enqueue as many of the n elements as there is room for, in order, and
+ * return how many that was */
+size_t qswsrqueue_enqueue_many(qswsrqueue_t *q,
+                               void *const  *elems,
+                               size_t        n);
+
 /* dequeue something from the queue (returns NULL for an empty queue) */
 void *qswsrqueue_dequeue(qswsrqueue_t *q);
 
-/* dequeue something from the queue */
+/* dequeue something from the queue, suspending while it's empty */
 void *qswsrqueue_dequeue_blocking(qswsrqueue_t *q);
 
+/* dequeue up to n elements into elems, in order, and return how many there
+ * were */
+size_t qswsrqueue_dequeue_many(qswsrqueue_t *q,
+                               void        **elems,
+                               size_t        n);
+
 /* returns 1 if the queue is empty, 0 otherwise */
 int qswsrqueue_empty(qswsrqueue_t *q);
 
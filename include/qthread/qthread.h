@@ -378,6 +378,30 @@ enum introspective_state {
 };
 size_t qthread_readstate(const enum introspective_state type);
 
+/* gives idle memory held by the runtime's internal pools back to the system;
+ * returns how many bytes were released */
+size_t qthread_trim_memory(void);
+
+/* Usage statistics for the runtime's memory pools (and any qpools). Object
+ * counts, hits and lock counts are only kept when QT_POOL_PROFILE is set;
+ * the rest is always available. */
+typedef struct qthread_pool_stats_s {
+    const char   *name;              /* NULL for pools without one */
+    size_t        item_size;         /* bytes per object */
+    size_t        reserved;          /* bytes obtained from the system */
+    unsigned long live;              /* objects currently handed out */
+    unsigned long peak;              /* the most ever handed out at once */
+    unsigned long allocs;
+    unsigned long cache_hits;        /* allocs served by the caller's own cache */
+    unsigned long lock_acquisitions; /* of the shared (per-node) reuse lists */
+    unsigned long lock_contended;    /* ...that had to wait for someone else */
+} qthread_pool_stats_t;
+
+/* fills in up to nstats entries, one per pool; returns how many it filled
+ * in, or (when stats is NULL) how many pools there are */
+size_t qthread_pool_stats(qthread_pool_stats_t *stats,
+                          size_t                nstats);
+
 /* Task team interface. */
 typedef enum qt_team_critical_section_e {
     BEGIN,
@@ -53,6 +53,20 @@ void qutil_qsort(double *array,
 void qutil_aligned_qsort(aligned_t *array,
                          size_t     length);
 
+/* Parallel sample sort of nmemb elements of the given size, ordered by a
+ * qsort()-style comparison function */
+void qutil_samplesort(void  *base,
+                      size_t nmemb,
+                      size_t size,
+                      int    (*cmp)(const void *, const void *));
+/* Parallel LSD radix sorts */
+void qutil_uint_radixsort(aligned_t *array,
+                          size_t     length);
+void qutil_int_radixsort(saligned_t *array,
+                         size_t      length);
+void qutil_double_radixsort(double *array,
+                            size_t  length);
+
 Q_ENDCXX /* */
 #endif // ifndef QTHREAD_QUTIL_H
 /* vim:set expandtab: */
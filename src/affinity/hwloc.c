@@ -338,6 +338,20 @@ void INTERNAL qt_affinity_mem_tonode(void  *addr,
     hwloc_bitmap_free(nodeset);
 }                                      /*}}} */
 
+void INTERNAL qt_affinity_mem_move(void  *addr,
+                                   size_t bytes,
+                                   int    node)
+{                                      /*{{{ */
+    hwloc_nodeset_t nodeset = hwloc_bitmap_alloc();
+
+    DEBUG_ONLY(hwloc_topology_check(topology));
+    hwloc_bitmap_set(nodeset, node);
+    hwloc_set_area_membind_nodeset(topology, addr, bytes, nodeset,
+                                   HWLOC_MEMBIND_BIND,
+                                   HWLOC_MEMBIND_NOCPUBIND | HWLOC_MEMBIND_MIGRATE);
+    hwloc_bitmap_free(nodeset);
+}                                      /*}}} */
+
 void INTERNAL *qt_affinity_alloc(size_t bytes)
 {                                      /*{{{ */
     DEBUG_ONLY(hwloc_topology_check(topology));
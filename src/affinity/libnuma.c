@@ -3,15 +3,19 @@
 #endif
 
 #include <numa.h>
+#include <numaif.h> /* for move_pages() and MPOL_MF_MOVE */
 
 #include "qt_subsystems.h"
 #include "qt_asserts.h"
 #include "qt_affinity.h"
 #include "qt_debug.h"
+#include "qt_aligned_alloc.h" /* for pagesize */
 
 #include "shepcomp.h"
 #include "shufflesheps.h"
 
+#define MOVE_BATCH 64
+
 static nodemask_t *mccoy_bitmask = NULL;
 
 static qthread_shepherd_id_t guess_num_shepherds(void);
@@ -45,6 +49,33 @@ void INTERNAL qt_affinity_mem_tonode(void  *addr,
     numa_tonode_memory(addr, bytes, node);
 }                                      /*}}} */
 
+void INTERNAL qt_affinity_mem_move(void  *addr,
+                                   size_t bytes,
+                                   int    node)
+{                                      /*{{{ */
+    void        *pages[MOVE_BATCH];
+    int          nodes[MOVE_BATCH];
+    int          status[MOVE_BATCH];
+    char        *p      = addr;
+    const size_t npages = (bytes + pagesize - 1) / pagesize;
+
+    assert(((uintptr_t)addr & (pagesize - 1)) == 0);
+    /* the policy covers pages nobody has touched yet... */
+    numa_tonode_memory(addr, bytes, node);
+    /* ...and the rest have to be moved by hand */
+    for (size_t i = 0; i < npages;) {
+        unsigned long n = 0;
+
+        for (; n < MOVE_BATCH && i < npages; ++n, ++i) {
+            pages[n] = p + i * pagesize;
+            nodes[n] = node;
+        }
+        if (move_pages(0, n, pages, nodes, status, MPOL_MF_MOVE) != 0) {
+            qthread_debug(AFFINITY_DETAILS, "moving %lu pages at %p to node %i failed\n", n, pages[0], node);
+        }
+    }
+}                                      /*}}} */
+
 void INTERNAL *qt_affinity_alloc(size_t bytes)
 {                                      /*{{{ */
     return numa_alloc(bytes);
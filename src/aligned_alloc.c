@@ -33,8 +33,8 @@ void INTERNAL qthread_internal_alignment_init(void)
     _pagesize = getpagesize();
 }
 
-void INTERNAL *qthread_internal_aligned_alloc(size_t        alloc_size,
-                                              uint_fast16_t alignment)
+void INTERNAL *qthread_internal_aligned_alloc(size_t alloc_size,
+                                              size_t alignment)
 {
     void *ret;
 
@@ -82,8 +82,8 @@ void INTERNAL *qthread_internal_aligned_alloc(size_t        alloc_size,
     return ret;
 }
 
-void INTERNAL qthread_internal_aligned_free(void         *ptr,
-                                            uint_fast16_t alignment)
+void INTERNAL qthread_internal_aligned_free(void  *ptr,
+                                            size_t alignment)
 {
     assert(ptr);
     switch (alignment) {
@@ -36,11 +36,13 @@
 
 /* The Datatype */
 struct qt_barrier_s {
-    size_t    maxParticipants;
-    size_t    numParticipants;
-    WTYPE    *up;
-    WTYPE    *down;
-    aligned_t participant;
+    size_t               maxParticipants;
+    size_t               numParticipants;
+    WTYPE               *up;
+    WTYPE               *down;
+    aligned_t            participant;
+    qt_hybrid_barrier_t *hybrid;
+    qt_split_barrier_t  *split;
 };
 
 qt_barrier_t API_FUNC *qt_barrier_create(size_t           max_threads,
@@ -49,7 +51,15 @@ qt_barrier_t API_FUNC *qt_barrier_create(size_t           max_threads,
     qt_barrier_t *b    = MALLOC(sizeof(qt_barrier_t));
     uint64_t      pow2 = max_threads - 1;
 
-    pow2 |= pow2 >> 1;
+    b->split = qt_split_barrier_create(max_threads);
+    if (QT_BARRIER_IS_HYBRID(type)) {
+        b->hybrid          = qt_hybrid_barrier_create(max_threads, type);
+        b->maxParticipants = b->numParticipants = max_threads;
+        b->up              = b->down = NULL;
+        return b;
+    }
+    b->hybrid = NULL;
+    pow2     |= pow2 >> 1;
     pow2 |= pow2 >> 2;
     pow2 |= pow2 >> 4;
     pow2 |= pow2 >> 8;
@@ -70,6 +80,10 @@ qt_barrier_t API_FUNC *qt_barrier_create(size_t           max_threads,
 
 void API_FUNC qt_barrier_enter(qt_barrier_t *b)
 {
+    if (b->hybrid) {
+        qt_hybrid_barrier_enter(b->hybrid);
+        return;
+    }
     qt_barrier_enter_id(b, qthread_incr(&(b->participant), 1) % b->numParticipants);
 }
 
@@ -80,6 +94,10 @@ void API_FUNC qt_barrier_enter_id(qt_barrier_t *b,
     size_t   test;
     uint64_t value;
 
+    if (b->hybrid) {
+        qt_hybrid_barrier_enter_id(b->hybrid, id);
+        return;
+    }
     parent     = ((id + 1) >> 1) - 1;
     leftchild  = ((id + 1) << 1) - 1;
     rightchild = leftchild + 1;
@@ -116,6 +134,12 @@ void API_FUNC qt_barrier_enter_id(qt_barrier_t *b,
 void API_FUNC qt_barrier_destroy(qt_barrier_t *b)
 {
     assert(b);
+    qt_split_barrier_destroy(b->split);
+    if (b->hybrid) {
+        qt_hybrid_barrier_destroy(b->hybrid);
+        FREE(b, sizeof(qt_barrier_t));
+        return;
+    }
     assert(b->up);
     assert(b->down);
     for (uint64_t i = 0; i < b->maxParticipants; i++) {
@@ -131,6 +155,12 @@ void API_FUNC qt_barrier_resize(qt_barrier_t *b,
                                 size_t        size)
 {
     assert(b);
+    qt_split_barrier_resize(b->split, size);
+    if (b->hybrid) {
+        qt_hybrid_barrier_resize(b->hybrid, size);
+        b->maxParticipants = b->numParticipants = size;
+        return;
+    }
     if (size <= b->maxParticipants) {
         b->numParticipants = size;
     } else {
@@ -165,7 +195,14 @@ void API_FUNC qt_barrier_resize(qt_barrier_t *b,
 /* debugging... */
 void API_FUNC qt_barrier_dump(qt_barrier_t    *b,
                               qt_barrier_dtype dt)
-{}
+{
+    if (b->hybrid) { qt_hybrid_barrier_dump(b->hybrid); }
+}
+
+qt_split_barrier_t INTERNAL *qt_barrier_internal_split(qt_barrier_t *b)
+{
+    return b->split;
+}
 
 void INTERNAL qt_barrier_internal_init(void)
 {}
@@ -24,10 +24,12 @@
 #include "qt_subsystems.h"
 
 struct qt_barrier_s {
-    aligned_t in_gate;
-    aligned_t out_gate;
-    aligned_t blockers;
-    size_t    max_blockers;
+    aligned_t            in_gate;
+    aligned_t            out_gate;
+    aligned_t            blockers;
+    size_t               max_blockers;
+    qt_hybrid_barrier_t *hybrid;
+    qt_split_barrier_t  *split;
 };
 
 static union {
@@ -56,7 +58,7 @@ void INTERNAL qt_barrier_internal_init(void)
 }
 
 qt_barrier_t API_FUNC *qt_barrier_create(size_t           max_threads,
-                                         qt_barrier_btype Q_UNUSED(type))
+                                         qt_barrier_btype type)
 {
     qt_barrier_t *b;
 
@@ -74,6 +76,8 @@ qt_barrier_t API_FUNC *qt_barrier_create(size_t           max_threads,
 #else /* ifndef UNPOOLED */
     b = MALLOC(sizeof(struct qt_barrier_s));
 #endif /* ifndef UNPOOLED */
+    b->hybrid       = QT_BARRIER_IS_HYBRID(type) ? qt_hybrid_barrier_create(max_threads, type) : NULL;
+    b->split        = qt_split_barrier_create(max_threads);
     b->blockers     = 0;
     b->max_blockers = max_threads;
     b->in_gate      = 0;
@@ -83,8 +87,12 @@ qt_barrier_t API_FUNC *qt_barrier_create(size_t           max_threads,
 }
 
 void API_FUNC qt_barrier_enter_id(qt_barrier_t *b,
-                                  size_t        Q_UNUSED(shep))
+                                  size_t        id)
 {
+    if (b->hybrid) {
+        qt_hybrid_barrier_enter_id(b->hybrid, id);
+        return;
+    }
     qt_barrier_enter(b);
 }
 
@@ -94,6 +102,10 @@ void API_FUNC qt_barrier_enter(qt_barrier_t *b)
 
     assert(qthread_library_initialized);
     qassert_retvoid(b);
+    if (b->hybrid) {
+        qt_hybrid_barrier_enter(b->hybrid);
+        return;
+    }
     /* pass through the in_gate */
     qthread_readFF(NULL, &b->in_gate);
     /* increment the blocker count */
@@ -121,6 +133,8 @@ void API_FUNC qt_barrier_resize(qt_barrier_t *restrict b,
 {
     assert(b->blockers == 0);
     b->max_blockers = new_size;
+    if (b->hybrid) { qt_hybrid_barrier_resize(b->hybrid, new_size); }
+    qt_split_barrier_resize(b->split, new_size);
 }
 
 void API_FUNC qt_barrier_destroy(qt_barrier_t *b)
@@ -128,6 +142,8 @@ void API_FUNC qt_barrier_destroy(qt_barrier_t *b)
 #ifndef UNPOOLED
     assert(fbp.pool != NULL);
 #endif
+    if (b->hybrid) { qt_hybrid_barrier_destroy(b->hybrid); }
+    qt_split_barrier_destroy(b->split);
     while (b->blockers > 0) qthread_yield();
     qthread_fill(&b->out_gate);
     qthread_fill(&b->in_gate);
@@ -138,6 +154,11 @@ void API_FUNC qt_barrier_destroy(qt_barrier_t *b)
 #endif
 }
 
+qt_split_barrier_t INTERNAL *qt_barrier_internal_split(qt_barrier_t *b)
+{
+    return b->split;
+}
+
 void qt_global_barrier(void)
 {
     assert(global_barrier);
@@ -0,0 +1,419 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdio.h>
+#include <string.h>
+
+/* System Compatibility Header */
+#include "qthread-int.h"
+
+/* Public Headers */
+#include "qthread/qthread.h"
+#include "qthread/barrier.h"
+#include "qthread/qtimer.h"
+
+/* Internal Headers */
+#include "qt_barrier.h"
+#include "qt_atomics.h"
+#include "qt_visibility.h"
+#include "qt_aligned_alloc.h"
+#include "qt_envariables.h"
+#include "qt_debug.h"
+#include "qt_asserts.h"
+
+/* Dissemination and tournament barriers. Unlike the configured barrier
+ * backend, these wait on plain words, each on its own cache line, so an
+ * uncontended episode costs no FEB operations at all. Every flag holds the
+ * number of the last episode it was signaled for, which is always increasing,
+ * so flags never need to be reset between episodes.
+ *
+ * A waiter spins for a calibrated interval (QT_BARRIER_SPIN microseconds),
+ * then queues itself on the flag and blocks on a FEB of its own; a signaler
+ * only takes the flag's lock when it sees a queued sleeper. Each sleeper has
+ * its own FEB because a flag is reused for later episodes: a shared one could
+ * be emptied for the next episode by somebody else before a slow waiter for
+ * this one got around to reading it. Spinning is skipped when there are more
+ * participants than workers, since a spinning participant may then be keeping
+ * a late one from running. */
+
+struct qt_hybrid_sleeper {
+    aligned_t                 feb;
+    struct qt_hybrid_sleeper *next;
+};
+
+struct qt_hybrid_flag {
+    aligned_t                 val;
+    struct qt_hybrid_sleeper *sleepers;
+    QTHREAD_FASTLOCK_TYPE     lock;
+} Q_ALIGNED(CACHELINE_WIDTH);
+
+struct qt_hybrid_barrier_s {
+    qt_barrier_btype       type;
+    size_t                 participants;
+    size_t                 rounds;
+    size_t                 nflags;
+    size_t                 spins;
+    aligned_t              ticket;
+    /* dissemination: rounds flags per participant, for even and then odd
+     * episodes; tournament: one arrival flag per participant, followed by the
+     * release flag */
+    struct qt_hybrid_flag *flags;
+    /* per participant, only touched by whoever holds that id */
+    struct qt_hybrid_flag *epochs;
+};
+
+static size_t calibrated_spins = (size_t)-1;
+
+static size_t qt_hybrid_calibrate(void)
+{                                      /*{{{ */
+    if (calibrated_spins == (size_t)-1) {
+        const unsigned long usecs = qt_internal_get_env_num("BARRIER_SPIN", 20, 0);
+        const size_t        iters = 4096;
+        volatile aligned_t  probe = 0;
+        qtimer_t            timer;
+        double              per;
+
+        if (usecs == 0) {
+            calibrated_spins = 0;
+            return 0;
+        }
+        timer = qtimer_create();
+        qtimer_start(timer);
+        for (size_t i = 0; i < iters && probe == 0; i++) {
+            SPINLOCK_BODY();
+        }
+        qtimer_stop(timer);
+        per = qtimer_secs(timer) / iters;
+        qtimer_destroy(timer);
+        /* racing callers compute about the same thing */
+        calibrated_spins = (per > 0.0) ? (size_t)(usecs * 1e-6 / per) + 1 : iters;
+        qthread_debug(BARRIER_DETAILS, "spinning for %lu iterations\n",
+                      (unsigned long)calibrated_spins);
+    }
+    return calibrated_spins;
+}                                      /*}}} */
+
+/* true until f has been signaled for episode e */
+static QINLINE int qt_hybrid_before(const struct qt_hybrid_flag *f,
+                                    aligned_t                    e)
+{                                      /*{{{ */
+    return (saligned_t)(*(volatile aligned_t *)&f->val - e) < 0;
+}                                      /*}}} */
+
+static QINLINE void qt_hybrid_signal(struct qt_hybrid_flag *f,
+                                     aligned_t              e)
+{                                      /*{{{ */
+    struct qt_hybrid_sleeper *w;
+
+    *(volatile aligned_t *)&f->val = e;
+    MACHINE_FENCE;
+    if (*(struct qt_hybrid_sleeper *volatile *)&f->sleepers == NULL) { return; }
+
+    QTHREAD_FASTLOCK_LOCK(&f->lock);
+    w           = f->sleepers;
+    f->sleepers = NULL;
+    QTHREAD_FASTLOCK_UNLOCK(&f->lock);
+    while (w) {
+        /* w lives on its owner's stack, and may be gone once it's filled */
+        struct qt_hybrid_sleeper *const next = w->next;
+
+        qthread_fill(&w->feb);
+        w = next;
+    }
+}                                      /*}}} */
+
+static void qt_hybrid_wait(struct qt_hybrid_flag *f,
+                           aligned_t              e,
+                           size_t                 spins)
+{                                      /*{{{ */
+    struct qt_hybrid_sleeper me;
+
+    for (size_t i = 0; i < spins; i++) {
+        if (!qt_hybrid_before(f, e)) { return; }
+        SPINLOCK_BODY();
+    }
+    if (!qt_hybrid_before(f, e)) { return; }
+
+    qthread_empty(&me.feb);
+    QTHREAD_FASTLOCK_LOCK(&f->lock);
+    me.next     = f->sleepers;
+    f->sleepers = &me;
+    QTHREAD_FASTLOCK_UNLOCK(&f->lock);
+    /* Either the signaler sees us queued, or we see its value here. */
+    MACHINE_FENCE;
+    if (!qt_hybrid_before(f, e)) {
+        struct qt_hybrid_sleeper **p;
+
+        QTHREAD_FASTLOCK_LOCK(&f->lock);
+        for (p = &f->sleepers; *p && *p != &me; p = &(*p)->next) ;
+        if (*p) {
+            *p = me.next;
+            qthread_fill(&me.feb);
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&f->lock);
+        /* if we weren't found, the signaler has us and is about to fill */
+    }
+    qthread_readFF(NULL, &me.feb);
+}                                      /*}}} */
+
+static void qt_hybrid_flags_init(struct qt_hybrid_flag *f,
+                                 size_t                 n)
+{                                      /*{{{ */
+    memset(f, 0, sizeof(struct qt_hybrid_flag) * n);
+    for (size_t i = 0; i < n; i++) {
+        QTHREAD_FASTLOCK_INIT(f[i].lock);
+    }
+}                                      /*}}} */
+
+static void qt_hybrid_flags_fini(struct qt_hybrid_flag *f,
+                                 size_t                 n)
+{                                      /*{{{ */
+    /* walk a cursor rather than index f, so f stays used when both of these
+     * compile away */
+    for (struct qt_hybrid_flag *flag = f; flag < f + n; flag++) {
+        assert(flag->sleepers == NULL);
+        QTHREAD_FASTLOCK_DESTROY(flag->lock);
+    }
+}                                      /*}}} */
+
+static void qt_hybrid_alloc(qt_hybrid_barrier_t *b,
+                            size_t               participants)
+{                                      /*{{{ */
+    size_t rounds = 0;
+
+    while (((size_t)1 << rounds) < participants) rounds++;
+    b->participants = participants;
+    b->rounds       = rounds;
+    b->nflags       = (b->type == DISSEMINATION_BARRIER) ? 2 * participants * rounds : participants + 1;
+    b->ticket       = 0;
+    b->spins        = (participants <= qthread_num_workers()) ? qt_hybrid_calibrate() : 0;
+    b->flags        = qthread_internal_aligned_alloc(sizeof(struct qt_hybrid_flag) * (b->nflags ? b->nflags : 1),
+                                                     CACHELINE_WIDTH);
+    b->epochs = qthread_internal_aligned_alloc(sizeof(struct qt_hybrid_flag) * (participants ? participants : 1),
+                                               CACHELINE_WIDTH);
+    assert(b->flags && b->epochs);
+    qt_hybrid_flags_init(b->flags, b->nflags);
+    qt_hybrid_flags_init(b->epochs, participants);
+}                                      /*}}} */
+
+static void qt_hybrid_free(qt_hybrid_barrier_t *b)
+{                                      /*{{{ */
+    qt_hybrid_flags_fini(b->flags, b->nflags);
+    qt_hybrid_flags_fini(b->epochs, b->participants);
+    qthread_internal_aligned_free(b->flags, CACHELINE_WIDTH);
+    qthread_internal_aligned_free(b->epochs, CACHELINE_WIDTH);
+}                                      /*}}} */
+
+qt_hybrid_barrier_t INTERNAL *qt_hybrid_barrier_create(size_t           participants,
+                                                       qt_barrier_btype type)
+{                                      /*{{{ */
+    qt_hybrid_barrier_t *b = MALLOC(sizeof(qt_hybrid_barrier_t));
+
+    assert(QT_BARRIER_IS_HYBRID(type));
+    qassert_ret(b, NULL);
+    b->type = type;
+    qt_hybrid_alloc(b, participants);
+    qthread_debug(BARRIER_CALLS, "participants(%lu), type(%i), rounds(%lu)\n",
+                  (unsigned long)participants, (int)type, (unsigned long)b->rounds);
+    return b;
+}                                      /*}}} */
+
+void INTERNAL qt_hybrid_barrier_enter_id(qt_hybrid_barrier_t *b,
+                                         size_t               id)
+{                                      /*{{{ */
+    const size_t    n     = b->participants;
+    const size_t    spins = b->spins;
+    const aligned_t e     = ++b->epochs[id].val;
+
+    assert(id < n);
+    if (b->type == DISSEMINATION_BARRIER) {
+        /* When ids are handed out by ticket, whoever holds an id in the next
+         * episode may signal before whoever holds it in this one has, so
+         * alternate episodes use separate flags. Nobody can get two episodes
+         * ahead, since that takes everyone having finished this one. */
+        struct qt_hybrid_flag *const parity = b->flags + (e & 1) * n * b->rounds;
+        struct qt_hybrid_flag *const mine   = parity + id * b->rounds;
+
+        for (size_t k = 0; k < b->rounds; k++) {
+            const size_t partner = (id + ((size_t)1 << k)) % n;
+
+            qt_hybrid_signal(&parity[partner * b->rounds + k], e);
+            qt_hybrid_wait(&mine[k], e, spins);
+        }
+    } else {
+        struct qt_hybrid_flag *const release = &b->flags[n];
+
+        /* win against each opponent in turn, until losing to the id that
+         * differs in the lowest set bit; id 0 wins every round */
+        for (size_t bit = 1; bit < n; bit <<= 1) {
+            if (id & bit) {
+                qt_hybrid_signal(&b->flags[id], e);
+                qt_hybrid_wait(release, e, spins);
+                return;
+            }
+            if ((id | bit) < n) {
+                qt_hybrid_wait(&b->flags[id | bit], e, spins);
+            }
+        }
+        qt_hybrid_signal(release, e);
+    }
+}                                      /*}}} */
+
+void INTERNAL qt_hybrid_barrier_enter(qt_hybrid_barrier_t *b)
+{                                      /*{{{ */
+    /* nobody can take a ticket for the next episode until every ticket for
+     * this one is taken, so each id is used once per episode */
+    qt_hybrid_barrier_enter_id(b, qthread_incr(&b->ticket, 1) % b->participants);
+}                                      /*}}} */
+
+void INTERNAL qt_hybrid_barrier_resize(qt_hybrid_barrier_t *b,
+                                       size_t               participants)
+{                                      /*{{{ */
+    qt_hybrid_free(b);
+    qt_hybrid_alloc(b, participants);
+}                                      /*}}} */
+
+void INTERNAL qt_hybrid_barrier_destroy(qt_hybrid_barrier_t *b)
+{                                      /*{{{ */
+    qt_hybrid_free(b);
+    FREE(b, sizeof(qt_hybrid_barrier_t));
+}                                      /*}}} */
+
+void INTERNAL qt_hybrid_barrier_dump(qt_hybrid_barrier_t *b)
+{                                      /*{{{ */
+    printf("%s barrier: %lu participants, spin %lu\n",
+           (b->type == DISSEMINATION_BARRIER) ? "dissemination" : "tournament",
+           (unsigned long)b->participants, (unsigned long)b->spins);
+    for (size_t i = 0; i < b->participants; i++) {
+        printf("  %lu: episode %lu\n", (unsigned long)i, (unsigned long)b->epochs[i].val);
+    }
+    for (size_t i = 0; i < b->nflags; i++) {
+        printf("  flag %lu: %lu%s\n", (unsigned long)i, (unsigned long)b->flags[i].val,
+               b->flags[i].sleepers ? " (sleepers)" : "");
+    }
+}                                      /*}}} */
+
+/* Split-phase support, available on every barrier whatever its type: a
+ * combining tree with QT_SPLIT_FANIN arrivals per node, where the last
+ * arrival at a node resets it and moves up, and the last arrival at the root
+ * signals the release flag with the next phase. Arriving never blocks; the
+ * phase it returns is the episode to wait for. */
+#define QT_SPLIT_FANIN 4
+
+struct qt_split_node {
+    aligned_t count;
+    aligned_t expected;
+    size_t    parent;
+} Q_ALIGNED(CACHELINE_WIDTH);
+
+struct qt_split_barrier_s {
+    size_t                participants;
+    size_t                nnodes;
+    size_t                spins;
+    aligned_t             ticket;
+    struct qt_split_node *nodes; /* leaves first, root last */
+    struct qt_hybrid_flag release;
+};
+
+static void qt_split_alloc(qt_split_barrier_t *b,
+                           size_t              participants)
+{                                      /*{{{ */
+    size_t nnodes = 0, first = 0, width, level;
+
+    width = participants ? participants : 1;
+    do {
+        width   = (width + QT_SPLIT_FANIN - 1) / QT_SPLIT_FANIN;
+        nnodes += width;
+    } while (width > 1);
+
+    b->participants = participants;
+    b->nnodes       = nnodes;
+    b->ticket       = 0;
+    b->spins        = (participants <= qthread_num_workers()) ? qt_hybrid_calibrate() : 0;
+    b->nodes        = qthread_internal_aligned_alloc(sizeof(struct qt_split_node) * nnodes,
+                                                     CACHELINE_WIDTH);
+    assert(b->nodes);
+    memset(b->nodes, 0, sizeof(struct qt_split_node) * nnodes);
+    qt_hybrid_flags_init(&b->release, 1);
+
+    /* each node expects one arrival per participant or child node below it */
+    width = participants ? participants : 1;
+    do {
+        level = (width + QT_SPLIT_FANIN - 1) / QT_SPLIT_FANIN;
+        for (size_t i = 0; i < level; i++) {
+            const size_t below = width - i * QT_SPLIT_FANIN;
+
+            b->nodes[first + i].expected = (below < QT_SPLIT_FANIN) ? below : QT_SPLIT_FANIN;
+            b->nodes[first + i].parent   = first + level + i / QT_SPLIT_FANIN;
+        }
+        first += level;
+        width  = level;
+    } while (level > 1);
+    b->nodes[nnodes - 1].parent = nnodes - 1;
+}                                      /*}}} */
+
+static void qt_split_free(qt_split_barrier_t *b)
+{                                      /*{{{ */
+    qt_hybrid_flags_fini(&b->release, 1);
+    qthread_internal_aligned_free(b->nodes, CACHELINE_WIDTH);
+}                                      /*}}} */
+
+qt_split_barrier_t INTERNAL *qt_split_barrier_create(size_t participants)
+{                                      /*{{{ */
+    qt_split_barrier_t *b = MALLOC(sizeof(qt_split_barrier_t));
+
+    qassert_ret(b, NULL);
+    qt_split_alloc(b, participants);
+    return b;
+}                                      /*}}} */
+
+void INTERNAL qt_split_barrier_resize(qt_split_barrier_t *b,
+                                      size_t              participants)
+{                                      /*{{{ */
+    qt_split_free(b);
+    qt_split_alloc(b, participants);
+}                                      /*}}} */
+
+void INTERNAL qt_split_barrier_destroy(qt_split_barrier_t *b)
+{                                      /*{{{ */
+    qt_split_free(b);
+    FREE(b, sizeof(qt_split_barrier_t));
+}                                      /*}}} */
+
+aligned_t API_FUNC qt_barrier_arrive(qt_barrier_t *b)
+{                                      /*{{{ */
+    qt_split_barrier_t *const s     = qt_barrier_internal_split(b);
+    const aligned_t           t     = qthread_incr(&s->ticket, 1);
+    const aligned_t           phase = t / s->participants;
+    size_t                    n     = (t % s->participants) / QT_SPLIT_FANIN;
+
+    while (qthread_incr(&s->nodes[n].count, 1) + 1 == s->nodes[n].expected) {
+        /* every arrival for this phase is in, so nobody else touches this
+         * node until the phase is released */
+        s->nodes[n].count = 0;
+        if (n == s->nnodes - 1) {
+            qt_hybrid_signal(&s->release, phase + 1);
+            break;
+        }
+        n = s->nodes[n].parent;
+    }
+    return phase;
+}                                      /*}}} */
+
+void API_FUNC qt_barrier_wait(qt_barrier_t *b,
+                              aligned_t     phase)
+{                                      /*{{{ */
+    qt_split_barrier_t *const s = qt_barrier_internal_split(b);
+
+    qt_hybrid_wait(&s->release, phase + 1, s->spins);
+}                                      /*}}} */
+
+int API_FUNC qt_barrier_test(qt_barrier_t *b,
+                             aligned_t     phase)
+{                                      /*{{{ */
+    return !qt_hybrid_before(&qt_barrier_internal_split(b)->release, phase + 1);
+}                                      /*}}} */
+
+/* vim:set expandtab: */
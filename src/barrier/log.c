@@ -38,6 +38,9 @@ struct qt_barrier_s {
 
     syncvar_t *downLock;
     //    int64_t *downLock;	// array of counters that allows threads to leave
+
+    qt_hybrid_barrier_t *hybrid; // set for DISSEMINATION_BARRIER and TOURNAMENT_BARRIER
+    qt_split_barrier_t  *split;  // for qt_barrier_arrive() and friends
 } /* qt_barrier_t */;
 
 static void qtb_internal_initialize_variable(qt_barrier_t *b,
@@ -64,6 +67,12 @@ void INTERNAL qt_barrier_internal_init(void)
 void API_FUNC qt_barrier_resize(qt_barrier_t *b, size_t size)
 {                                      /*{{{ */
     assert(qthread_library_initialized);
+    qt_split_barrier_resize(b->split, size);
+    if (b->hybrid) {
+        qt_hybrid_barrier_resize(b->hybrid, size);
+        b->activeSize = b->count = size;
+        return;
+    }
     printf("resize not implemented\n");
     abort();
     /*qt_barrier_destroy(MBar);
@@ -75,6 +84,12 @@ void API_FUNC qt_barrier_destroy(qt_barrier_t *b)
 {                                      /*{{{ */
     assert(qthread_library_initialized);
     assert(b);
+    if (b->hybrid) {
+        qt_hybrid_barrier_destroy(b->hybrid);
+    }
+    if (b->split) {
+        qt_split_barrier_destroy(b->split);
+    }
     if (b->upLock) {
         free((void *)(b->upLock));
     }
@@ -93,6 +108,12 @@ qt_barrier_t API_FUNC *qt_barrier_create(size_t           size,
                   (int)type, debug);
     assert(b);
     if (b) {
+        b->split = qt_split_barrier_create(size);
+    }
+    if (b && QT_BARRIER_IS_HYBRID(type)) {
+        b->hybrid     = qt_hybrid_barrier_create(size, type);
+        b->activeSize = b->count = size;
+    } else if (b) {
         assert(type == REGION_BARRIER);
         switch (type) {
             case REGION_BARRIER:
@@ -159,6 +180,11 @@ void qt_barrier_dump(qt_barrier_t    *b,
     size_t       i, j;
     const size_t activeSize = b->activeSize;
 
+    if (b->hybrid) {
+        qt_hybrid_barrier_dump(b->hybrid);
+        return;
+    }
+
     if ((dt == UPLOCK) || (dt == BOTHLOCKS)) {
         printf("upLock\n");
         for (j = 0; j < activeSize; j += 8) {
@@ -278,10 +304,19 @@ static void qtb_internal_up(qt_barrier_t *b,
     }
 }                                      /*}}} */
 
+qt_split_barrier_t INTERNAL *qt_barrier_internal_split(qt_barrier_t *b)
+{                                      /*{{{ */
+    return b->split;
+}                                      /*}}} */
+
 // actual barrier entry point
 
 void API_FUNC qt_barrier_enter(qt_barrier_t *b)
 {                                      /*{{{ */
+    if (b->hybrid) {
+        qt_hybrid_barrier_enter(b->hybrid);
+        return;
+    }
     qt_barrier_enter_id(b, qthread_worker(NULL));
 }                                      /*}}} */
 
@@ -296,6 +331,10 @@ void API_FUNC qt_barrier_enter_id(qt_barrier_t *b,
 
     //    int64_t val = b->upLock[shep] + 1;
 
+    if (b->hybrid) {
+        qt_hybrid_barrier_enter_id(b->hybrid, id);
+        return;
+    }
     if (b->activeSize <= 1) { return; }
     qtb_internal_up(b, id, val, 0);
 }                                      /*}}} */
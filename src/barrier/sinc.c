@@ -15,6 +15,7 @@
 #include "qthread/sinc.h"
 
 /* Internal Headers */
+#include "qt_barrier.h"
 #include "qt_atomics.h"
 #include "qt_mpool.h"
 #include "qt_visibility.h"
@@ -23,10 +24,12 @@
 
 /* The Datatype */
 struct qt_barrier_s {
-    uint64_t   count;
-    qt_sinc_t *sinc_1;
-    qt_sinc_t *sinc_2;
-    qt_sinc_t *sinc_3;
+    uint64_t             count;
+    qt_sinc_t           *sinc_1;
+    qt_sinc_t           *sinc_2;
+    qt_sinc_t           *sinc_3;
+    qt_hybrid_barrier_t *hybrid;
+    qt_split_barrier_t  *split;
 };
 
 static qt_barrier_t * global_barrier = NULL;
@@ -35,11 +38,18 @@ void INTERNAL qt_barrier_internal_init(void)
 { }
 
 qt_barrier_t API_FUNC *qt_barrier_create(size_t           size,
-                                         qt_barrier_btype Q_UNUSED(type))
+                                         qt_barrier_btype type)
 {
     qt_barrier_t *barrier = MALLOC(sizeof(qt_barrier_t));
 
-    barrier->count  = size;
+    barrier->count = size;
+    barrier->split = qt_split_barrier_create(size);
+    if (QT_BARRIER_IS_HYBRID(type)) {
+        barrier->hybrid = qt_hybrid_barrier_create(size, type);
+        barrier->sinc_1 = barrier->sinc_2 = barrier->sinc_3 = NULL;
+        return barrier;
+    }
+    barrier->hybrid = NULL;
     barrier->sinc_1 = qt_sinc_create(0, NULL, NULL, size);
     barrier->sinc_2 = qt_sinc_create(0, NULL, NULL, size);
     barrier->sinc_3 = qt_sinc_create(0, NULL, NULL, size);
@@ -49,6 +59,10 @@ qt_barrier_t API_FUNC *qt_barrier_create(size_t           size,
 
 void API_FUNC qt_barrier_destroy(qt_barrier_t *restrict barrier)
 {
+    if (barrier->hybrid) { qt_hybrid_barrier_destroy(barrier->hybrid); }
+    barrier->hybrid = NULL;
+    if (barrier->split) { qt_split_barrier_destroy(barrier->split); }
+    barrier->split = NULL;
     if (barrier->sinc_1) { qt_sinc_destroy(barrier->sinc_1); }
     barrier->sinc_1 = NULL;
     if (barrier->sinc_2) { qt_sinc_destroy(barrier->sinc_2); }
@@ -63,6 +77,11 @@ void API_FUNC qt_barrier_resize(qt_barrier_t *restrict barrier,
     int diff = new_size - barrier->count;
 
     barrier->count = new_size;
+    qt_split_barrier_resize(barrier->split, new_size);
+    if (barrier->hybrid) {
+        qt_hybrid_barrier_resize(barrier->hybrid, new_size);
+        return;
+    }
 
     // modify each internal sinc to countdown form new limit
     qt_sinc_reset(barrier->sinc_1, diff);
@@ -73,6 +92,10 @@ void API_FUNC qt_barrier_resize(qt_barrier_t *restrict barrier,
 void API_FUNC qt_barrier_enter_id(qt_barrier_t *barrier,
                                   size_t        id)
 {
+    if (barrier->hybrid) {
+        qt_hybrid_barrier_enter_id(barrier->hybrid, id);
+        return;
+    }
     qt_sinc_submit(barrier->sinc_1, NULL);
     qt_sinc_wait(barrier->sinc_1, NULL);
     if (id == 0) {
@@ -94,6 +117,10 @@ void API_FUNC qt_barrier_enter_id(qt_barrier_t *barrier,
 
 void API_FUNC qt_barrier_enter(qt_barrier_t *barrier)
 {
+    if (barrier->hybrid) {
+        qt_hybrid_barrier_enter(barrier->hybrid);
+        return;
+    }
     qt_sinc_submit(barrier->sinc_1, NULL);
     qt_sinc_wait(barrier->sinc_1, NULL);
     qt_sinc_reset(barrier->sinc_3, barrier->count); // should be only 1 reset not all
@@ -107,7 +134,14 @@ void API_FUNC qt_barrier_enter(qt_barrier_t *barrier)
 
 void API_FUNC qt_barrier_dump(qt_barrier_t    *b,
                               qt_barrier_dtype dt)
-{}
+{
+    if (b->hybrid) { qt_hybrid_barrier_dump(b->hybrid); }
+}
+
+qt_split_barrier_t INTERNAL *qt_barrier_internal_split(qt_barrier_t *b)
+{
+    return b->split;
+}
 
 
 
@@ -365,6 +365,37 @@ void *qt_dictionary_delete(qt_dictionary *dict,
     return to_ret;
 }
 
+size_t qt_dictionary_put_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void *const   *values,
+                              size_t         n)
+{
+    size_t stored = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (qt_dictionary_put(dict, keys[i], values[i]) != NULL) {
+            stored++;
+        }
+    }
+    return stored;
+}
+
+size_t qt_dictionary_get_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void         **values,
+                              size_t         n)
+{
+    size_t found = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        values[i] = qt_dictionary_get(dict, keys[i]);
+        if (values[i] != NULL) {
+            found++;
+        }
+    }
+    return found;
+}
+
 qt_dictionary_iterator *qt_dictionary_iterator_create(qt_dictionary *dict)
 {
     if((dict == NULL) || (dict->content == NULL)) {
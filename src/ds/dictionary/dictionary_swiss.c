@@ -0,0 +1,854 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdlib.h> /* for malloc/free/etc */
+#include <stdio.h>  /* for printf() */
+#include <stdint.h>
+
+/* Installed Headers */
+#include <qthread/qthread.h> /* for qthread_incr() and qthread_cas() */
+#include <qthread/dictionary.h>
+#include <qthread/hash.h>
+
+/* Internal Headers */
+#include "qt_asserts.h"
+#include "qt_debug.h"
+#include "qt_atomics.h"
+#include "qt_aligned_alloc.h"
+#include "qt_hazardptrs.h"
+#include "qt_prefetch.h"
+
+/* An open-addressing table, in the style of Google's "Swiss tables". The table
+ * is an array of groups, each exactly one cache line: a 64-bit control word,
+ * then seven slots pointing at list_entry's. Each control byte is either a
+ * 7-bit tag taken from the key's hash, or one of the states below; byte 7 is
+ * padding. A lookup compares its tag against all seven bytes of a group at once
+ * (SWAR, which is what SIMD buys you at this width) and only dereferences the
+ * slots that match. Groups are probed linearly from the key's home group, and
+ * a probe stops at the first group that has an EMPTY byte: since EMPTY bytes
+ * never come back once used (a delete only writes EMPTY into a group that still
+ * has one), no key can live past such a group.
+ *
+ * Lookups take no locks and write nothing shared. Writers serialize on one of
+ * SWISS_LOCKS striped locks, chosen by hash, so that a key can't be inserted
+ * twice; they claim slots with a CAS on the control word, so writers on
+ * different stripes never wait for each other.
+ *
+ * When a table passes 7/8 full, a bigger one (or, if it's mostly tombstones, a
+ * clean one of the same size) is hung off of its next pointer, and every
+ * writer moves SWISS_HELP groups across before doing its own work. Entries are
+ * moved, not copied, and go into the new table before they leave the old one,
+ * so a lookup that searches the old table and then the new one always finds
+ * them. New keys only go into the newest table. When the last group has been
+ * moved, the new table becomes the current one and the old one is retired.
+ * Tables and entries are freed through hazard pointers: slot 0 protects the
+ * table being searched, slot 1 the entry being examined. */
+
+#define PUT_ALWAYS    0
+#define PUT_IF_ABSENT 1
+
+#define SWISS_SLOTS       7
+#define SWISS_MIN_GROUPS  64
+#define SWISS_LOCKS       128
+#define SWISS_HELP        2
+#define SWISS_BATCH       16
+
+#define SWISS_EMPTY       0x80 /* never used */
+#define SWISS_MOVED_EMPTY 0xfb /* was EMPTY when its group was moved */
+#define SWISS_MOVED       0xfc /* its group has been moved to the next table */
+#define SWISS_DELETED     0xfe
+#define SWISS_PAD         0xff
+
+#define SWISS_BYTES(b)     (0x0101010101010101ULL * (uint8_t)(b))
+#define SWISS_USED_BYTES   0x0080808080808080ULL
+#define SWISS_EMPTY_GROUP  ((SWISS_BYTES(SWISS_EMPTY) & ~(0xffULL << 56)) | ((uint64_t)SWISS_PAD << 56))
+#define SWISS_BYTE(w, i)   ((uint8_t)((w) >> (8 * (i))))
+#define SWISS_SET(w, i, b) (((w) & ~(0xffULL << (8 * (i)))) | ((uint64_t)(uint8_t)(b) << (8 * (i))))
+#define SWISS_TAG(h)       ((uint8_t)((h) & 0x7f))
+#define SWISS_HOME(t, h)   (((h) >> 7) & ((t)->ngroups - 1))
+#define SWISS_IS_TAG(b)    ((b) < 0x80)
+
+typedef struct swiss_group_s {
+    volatile uint64_t  ctrl;
+    list_entry *volatile slot[SWISS_SLOTS];
+} Q_ALIGNED(CACHELINE_WIDTH) swiss_group_t;
+
+typedef struct swiss_table_s {
+    size_t                         ngroups; /* always a power of two */
+    aligned_t                      used;    /* bytes that aren't EMPTY */
+    aligned_t                      dead;    /* DELETED bytes */
+    aligned_t                      claim;   /* groups claimed for moving */
+    aligned_t                      done;    /* groups finished moving */
+    struct swiss_table_s *volatile next;
+    swiss_group_t                  groups[];
+} swiss_table_t;
+
+typedef struct {
+    QTHREAD_FASTLOCK_TYPE lock;
+} Q_ALIGNED(CACHELINE_WIDTH) swiss_lock_t;
+
+struct qt_dictionary {
+    swiss_table_t *volatile table;
+    qt_dict_key_equals_f    op_equals;
+    qt_dict_hash_f          op_hash;
+    qt_dict_cleanup_f       op_cleanup;
+    swiss_lock_t            locks[SWISS_LOCKS];
+};
+
+struct qt_dictionary_iterator {
+    qt_dictionary *dict;
+    swiss_table_t *table; // =NULL once the iterator has reached the end
+    size_t         pos;   // the next slot to look at
+    list_entry    *crt;   // =NULL if iterator is newly created or reached the end; =crt elem otherwise.
+};
+
+#ifndef QTHREAD_NO_ASSERTS
+extern int qthread_library_initialized;
+#endif
+
+static QINLINE uint64_t swiss_hash(qt_dictionary *d,
+                                   void          *key)
+{   /*{{{*/
+    return qt_hash64((uint64_t)(unsigned int)d->op_hash(key));
+} /*}}}*/
+
+/* returns a mask with the high bit set in every byte of w equal to b; bytes
+ * above a match may also be flagged, which callers have to tolerate */
+static QINLINE uint64_t swiss_match(uint64_t w,
+                                    uint8_t  b)
+{   /*{{{*/
+    const uint64_t x = w ^ SWISS_BYTES(b);
+
+    return (x - SWISS_BYTES(1)) & ~x & SWISS_USED_BYTES;
+} /*}}}*/
+
+static QINLINE unsigned int swiss_first(uint64_t m)
+{   /*{{{*/
+    return __builtin_ctzll(m) >> 3;
+} /*}}}*/
+
+/* a group that still has (or, once moved, had) an EMPTY byte ends a probe */
+static QINLINE int swiss_ends_probe(uint64_t w)
+{   /*{{{*/
+    return (swiss_match(w, SWISS_EMPTY) | swiss_match(w, SWISS_MOVED_EMPTY)) != 0;
+} /*}}}*/
+
+/* changes control byte i from old to new; fails only if byte i changes */
+static int swiss_ctrl_cas(swiss_group_t *g,
+                          unsigned int   i,
+                          uint8_t        old,
+                          uint8_t        new)
+{   /*{{{*/
+    uint64_t w = g->ctrl;
+
+    while (SWISS_BYTE(w, i) == old) {
+        const uint64_t prev = qthread_cas64((uint64_t *)&g->ctrl, w, SWISS_SET(w, i, new));
+
+        if (prev == w) { return 1; }
+        w = prev;
+    }
+    return 0;
+} /*}}}*/
+
+static swiss_table_t *swiss_table_alloc(size_t ngroups)
+{   /*{{{*/
+    swiss_table_t *t = qthread_internal_aligned_alloc(sizeof(swiss_table_t) + ngroups * sizeof(swiss_group_t),
+                                                      CACHELINE_WIDTH);
+
+    if (t == NULL) { return NULL; }
+    t->ngroups = ngroups;
+    t->used    = 0;
+    t->dead    = 0;
+    t->claim   = 0;
+    t->done    = 0;
+    t->next    = NULL;
+    for (size_t i = 0; i < ngroups; ++i) {
+        t->groups[i].ctrl = SWISS_EMPTY_GROUP;
+        for (unsigned int j = 0; j < SWISS_SLOTS; ++j) {
+            t->groups[i].slot[j] = NULL;
+        }
+    }
+    return t;
+} /*}}}*/
+
+static void swiss_table_free(void *t)
+{   /*{{{*/
+    qthread_internal_aligned_free(t, CACHELINE_WIDTH);
+} /*}}}*/
+
+static void swiss_entry_free(void *e)
+{   /*{{{*/
+    FREE(e, sizeof(list_entry));
+} /*}}}*/
+
+/* returns the current table, protected by hazard pointer 0 */
+static swiss_table_t *swiss_current(qt_dictionary *d)
+{   /*{{{*/
+    swiss_table_t *t;
+
+    do {
+        t = d->table;
+        hazardous_ptr(0, t);
+        MACHINE_FENCE;
+    } while (t != d->table);
+    return t;
+} /*}}}*/
+
+/* t is protected and has a next table; moves the protection to that table.
+ * Returns NULL if the dictionary has already moved past both, in which case
+ * the caller has to start over from swiss_current(). */
+static swiss_table_t *swiss_next(qt_dictionary *d,
+                                 swiss_table_t *t)
+{   /*{{{*/
+    swiss_table_t *n = t->next;
+    swiss_table_t *cur;
+
+    /* n can't be retired until it has been the current table */
+    hazardous_ptr(1, n);
+    MACHINE_FENCE;
+    cur = d->table;
+    if ((cur != t) && (cur != n)) { return NULL; }
+    hazardous_ptr(0, n);
+    return n;
+} /*}}}*/
+
+/* returns the newest table, protected by hazard pointer 0 */
+static swiss_table_t *swiss_newest(qt_dictionary *d)
+{   /*{{{*/
+    swiss_table_t *t;
+
+    do {
+        t = swiss_current(d);
+        while (t != NULL && t->next != NULL) {
+            t = swiss_next(d, t);
+        }
+    } while (t == NULL);
+    return t;
+} /*}}}*/
+
+static QINLINE void swiss_unprotect(void)
+{   /*{{{*/
+    hazardous_ptr(0, NULL);
+    hazardous_ptr(1, NULL);
+} /*}}}*/
+
+/* Looks for key in t, which must be protected. A found entry is protected by
+ * hazard pointer 1, and its group and slot are stored in *gp and *ip. */
+static list_entry *swiss_find(qt_dictionary  *d,
+                              swiss_table_t  *t,
+                              void           *key,
+                              uint64_t        h,
+                              swiss_group_t **gp,
+                              unsigned int   *ip)
+{   /*{{{*/
+    const size_t  mask = t->ngroups - 1;
+    const uint8_t tag  = SWISS_TAG(h);
+    size_t        gi   = SWISS_HOME(t, h);
+
+    for (size_t probes = 0; probes < t->ngroups; ++probes, gi = (gi + 1) & mask) {
+        swiss_group_t *g = &t->groups[gi];
+        const uint64_t w = g->ctrl;
+
+        for (uint64_t m = swiss_match(w, tag); m != 0; m &= m - 1) {
+            const unsigned int i = swiss_first(m);
+            list_entry        *e = g->slot[i];
+
+            if (e == NULL) { continue; }
+            hazardous_ptr(1, e);
+            MACHINE_FENCE;
+            if (e != g->slot[i]) { continue; } /* deleted or moved meanwhile */
+            if ((e->hashed_key == h) && d->op_equals(e->key, key)) {
+                if (gp) {
+                    *gp = g;
+                    *ip = i;
+                }
+                return e;
+            }
+        }
+        if (swiss_ends_probe(w)) { break; }
+    }
+    return NULL;
+} /*}}}*/
+
+/* Puts e into the first free slot of t, for a caller that holds e's lock.
+ * Returns 0 on success, 1 if t is being moved (so e belongs in t->next), or -1
+ * if t is full. */
+static int swiss_insert(swiss_table_t *t,
+                        list_entry    *e)
+{   /*{{{*/
+    const uint64_t h    = e->hashed_key;
+    const size_t   mask = t->ngroups - 1;
+    size_t         gi   = SWISS_HOME(t, h);
+
+    for (size_t probes = 0; probes < t->ngroups; ++probes, gi = (gi + 1) & mask) {
+        swiss_group_t *g = &t->groups[gi];
+        uint64_t       w;
+        unsigned int   i;
+
+retry:
+        w = g->ctrl;
+        if (swiss_match(w, SWISS_MOVED) | swiss_match(w, SWISS_MOVED_EMPTY)) { return 1; }
+        for (i = 0; i < SWISS_SLOTS; ++i) {
+            const uint8_t c = SWISS_BYTE(w, i);
+
+            if ((c != SWISS_EMPTY) && (c != SWISS_DELETED)) { continue; }
+            /* until the slot is filled in, lookups skip it and moves wait */
+            if (!swiss_ctrl_cas(g, i, c, SWISS_TAG(h))) { goto retry; }
+            g->slot[i] = e;
+            if (c == SWISS_EMPTY) {
+                (void)qthread_incr(&t->used, 1);
+            } else {
+                (void)qthread_incr(&t->dead, -1);
+            }
+            return 0;
+        }
+    }
+    return -1;
+} /*}}}*/
+
+/* Takes the entry in slot i of g out of t, for a caller that holds its lock. */
+static void swiss_remove(swiss_table_t *t,
+                         swiss_group_t *g,
+                         unsigned int   i)
+{   /*{{{*/
+    uint64_t w;
+    uint8_t  c;
+
+    /* the slot has to be empty before anyone can claim it again */
+    g->slot[i] = NULL;
+    MACHINE_FENCE;
+    w = g->ctrl;
+    for (;;) {
+        uint64_t prev;
+
+        /* EMPTY is only safe if the group would still end a probe anyway */
+        c    = swiss_ends_probe(w) ? SWISS_EMPTY : SWISS_DELETED;
+        prev = qthread_cas64((uint64_t *)&g->ctrl, w, SWISS_SET(w, i, c));
+        if (prev == w) { break; }
+        w = prev;
+    }
+    if (c == SWISS_EMPTY) {
+        (void)qthread_incr(&t->used, -1);
+    } else {
+        (void)qthread_incr(&t->dead, 1);
+    }
+} /*}}}*/
+
+static QINLINE QTHREAD_FASTLOCK_TYPE *swiss_lock(qt_dictionary *d,
+                                                 uint64_t       h)
+{   /*{{{*/
+    return &d->locks[(h >> 32) & (SWISS_LOCKS - 1)].lock;
+} /*}}}*/
+
+/* Starts moving t, the current table, into a new one. */
+static void swiss_grow(qt_dictionary *d,
+                       swiss_table_t *t)
+{   /*{{{*/
+    size_t         ngroups = t->ngroups;
+    const size_t   used    = t->used;
+    const size_t   dead    = t->dead;
+    swiss_table_t *n;
+
+    if ((t->next != NULL) || (t != d->table)) { return; }
+    /* if it's mostly tombstones, a clean table of the same size will do */
+    if (((dead > used) ? used : (used - dead)) * 2 >= ngroups * SWISS_SLOTS) {
+        ngroups *= 2;
+    }
+    n = swiss_table_alloc(ngroups);
+    if (n == NULL) { return; }
+    if (qthread_cas_ptr((void **)&t->next, NULL, n) != NULL) {
+        swiss_table_free(n);
+    }
+} /*}}}*/
+
+/* Moves every entry in group gi of t into t->next. */
+static void swiss_move_group(qt_dictionary *d,
+                             swiss_table_t *t,
+                             size_t         gi)
+{   /*{{{*/
+    swiss_group_t *g = &t->groups[gi];
+
+    for (unsigned int i = 0; i < SWISS_SLOTS; ++i) {
+        for (;;) {
+            const uint8_t          c = SWISS_BYTE(g->ctrl, i);
+            list_entry            *e;
+            QTHREAD_FASTLOCK_TYPE *lock;
+
+            if ((c == SWISS_MOVED) || (c == SWISS_MOVED_EMPTY)) { break; }
+            if (c == SWISS_EMPTY) {
+                if (swiss_ctrl_cas(g, i, c, SWISS_MOVED_EMPTY)) { break; }
+                continue;
+            }
+            if (c == SWISS_DELETED) {
+                if (swiss_ctrl_cas(g, i, c, SWISS_MOVED)) { break; }
+                continue;
+            }
+            e = g->slot[i];
+            if (e == NULL) { /* an insert or a remove is halfway done */
+                SPINLOCK_BODY();
+                continue;
+            }
+            hazardous_ptr(1, e);
+            MACHINE_FENCE;
+            if (e != g->slot[i]) { continue; }
+            lock = swiss_lock(d, e->hashed_key);
+            QTHREAD_FASTLOCK_LOCK(lock);
+            if ((SWISS_BYTE(g->ctrl, i) == c) && (g->slot[i] == e)) {
+                int ret = swiss_insert(t->next, e);
+
+                assert(ret == 0);
+                (void)ret;
+                /* it has to be in the new table before it leaves this one */
+                g->slot[i] = NULL;
+                (void)swiss_ctrl_cas(g, i, c, SWISS_MOVED);
+            }
+            QTHREAD_FASTLOCK_UNLOCK(lock);
+        }
+    }
+} /*}}}*/
+
+/* Makes t's next table current, once everything in t has been moved. */
+static void swiss_retire(qt_dictionary *d,
+                         swiss_table_t *t)
+{   /*{{{*/
+    if (qthread_cas_ptr((void **)&d->table, t, t->next) == t) {
+        hazardous_release_node(swiss_table_free, t);
+    }
+} /*}}}*/
+
+/* Moves a few groups of t, which must be protected and have a next table.
+ * Whoever moves the last group makes the next table current. */
+static void swiss_help(qt_dictionary *d,
+                       swiss_table_t *t)
+{   /*{{{*/
+    for (unsigned int k = 0; k < SWISS_HELP; ++k) {
+        const size_t gi = qthread_incr(&t->claim, 1);
+
+        if (gi >= t->ngroups) { return; }
+        swiss_move_group(d, t, gi);
+        if (qthread_incr(&t->done, 1) + 1 == t->ngroups) {
+            swiss_retire(d, t);
+            return;
+        }
+    }
+} /*}}}*/
+
+/* Moves whatever is left of t, without waiting for the helpers that claimed
+ * groups to get around to them (moving a group twice is harmless). Used when
+ * the next table is filling up faster than t is being emptied, e.g. because
+ * a helper got descheduled. */
+static void swiss_finish(qt_dictionary *d,
+                         swiss_table_t *t)
+{   /*{{{*/
+    for (size_t gi = 0; gi < t->ngroups; ++gi) {
+        swiss_move_group(d, t, gi);
+    }
+    swiss_retire(d, t);
+} /*}}}*/
+
+qt_dictionary *qt_dictionary_create(qt_dict_key_equals_f eq,
+                                    qt_dict_hash_f       hash,
+                                    qt_dict_cleanup_f    cleanup)
+{   /*{{{*/
+    assert(qthread_library_initialized && "Need to initialize qthreads before using the dictionary");
+    qt_dictionary *ret = qthread_internal_aligned_alloc(sizeof(qt_dictionary), CACHELINE_WIDTH);
+
+    if (ret == NULL) { return NULL; }
+    ret->table = swiss_table_alloc(SWISS_MIN_GROUPS);
+    if (ret->table == NULL) {
+        qthread_internal_aligned_free(ret, CACHELINE_WIDTH);
+        return NULL;
+    }
+    ret->op_equals  = eq;
+    ret->op_hash    = hash;
+    ret->op_cleanup = cleanup;
+    for (unsigned int i = 0; i < SWISS_LOCKS; ++i) {
+        QTHREAD_FASTLOCK_INIT(ret->locks[i].lock);
+    }
+    return ret;
+} /*}}}*/
+
+void qt_dictionary_destroy(qt_dictionary *d)
+{   /*{{{*/
+    swiss_table_t *t = d->table;
+
+    while (t != NULL) {
+        swiss_table_t *next = t->next;
+
+        for (size_t gi = 0; gi < t->ngroups; ++gi) {
+            swiss_group_t *g = &t->groups[gi];
+
+            for (unsigned int i = 0; i < SWISS_SLOTS; ++i) {
+                list_entry *e = g->slot[i];
+
+                if (!SWISS_IS_TAG(SWISS_BYTE(g->ctrl, i)) || (e == NULL)) { continue; }
+                if (d->op_cleanup) {
+                    d->op_cleanup(e->key, e->value);
+                }
+                FREE(e, sizeof(list_entry));
+            }
+        }
+        swiss_table_free(t);
+        t = next;
+    }
+    for (unsigned int i = 0; i < SWISS_LOCKS; ++i) {
+        QTHREAD_FASTLOCK_DESTROY(d->locks[i].lock);
+    }
+    qthread_internal_aligned_free(d, CACHELINE_WIDTH);
+} /*}}}*/
+
+static void *qt_dictionary_put_helper(qt_dictionary *dict,
+                                      void          *key,
+                                      void          *value,
+                                      uint64_t       h,
+                                      char           put_type)
+{   /*{{{*/
+    QTHREAD_FASTLOCK_TYPE *lock  = swiss_lock(dict, h);
+    list_entry            *fresh = NULL;
+    list_entry            *e;
+    swiss_table_t         *t;
+    void                  *ret;
+    int                    crowded;
+
+again:
+    crowded = 0;
+    ret     = value;
+    t       = swiss_current(dict);
+    if (t->next != NULL) {
+        swiss_help(dict, t);
+    }
+    QTHREAD_FASTLOCK_LOCK(lock);
+restart:
+    t = swiss_current(dict);
+    for (;;) {
+        e = swiss_find(dict, t, key, h, NULL, NULL);
+        if (e != NULL) {
+            /* nobody else can change this key while we hold the lock */
+            if (put_type != PUT_IF_ABSENT) {
+                e->value = value;
+            }
+            ret = e->value;
+            goto done;
+        }
+        if (t->next == NULL) { break; }
+        if ((t = swiss_next(dict, t)) == NULL) { goto restart; }
+    }
+
+    if (fresh == NULL) {
+        fresh = MALLOC(sizeof(list_entry));
+        if (fresh == NULL) {
+            ret = NULL;
+            goto done;
+        }
+        fresh->hashed_key = h;
+        fresh->key        = key;
+        fresh->value      = value;
+        fresh->next       = NULL;
+    }
+    for (;;) {
+        const int r = swiss_insert(t, fresh);
+
+        if (r == 0) { break; }
+        if (r < 0) {
+            if (t != dict->table) {
+                /* t's predecessor is still being moved into it; finish that
+                 * (which may need our lock) and try again */
+                crowded = 1;
+                goto done;
+            }
+            swiss_grow(dict, t);
+            if (t->next == NULL) { /* couldn't allocate */
+                ret = NULL;
+                goto done;
+            }
+        }
+        if ((t = swiss_next(dict, t)) == NULL) {
+            t = swiss_newest(dict);
+        }
+    }
+    fresh = NULL;
+    if (t->used * 8 > t->ngroups * SWISS_SLOTS * 7) {
+        if (t == dict->table) {
+            swiss_grow(dict, t);
+        } else {
+            crowded = 1;
+        }
+    }
+done:
+    QTHREAD_FASTLOCK_UNLOCK(lock);
+    if (crowded) {
+        t = swiss_current(dict);
+        if (t->next != NULL) {
+            swiss_finish(dict, t);
+        }
+        if (fresh != NULL) {
+            swiss_unprotect();
+            goto again;
+        }
+    }
+    swiss_unprotect();
+    if (fresh != NULL) {
+        FREE(fresh, sizeof(list_entry));
+    }
+    return ret;
+} /*}}}*/
+
+void *qt_dictionary_put(qt_dictionary *dict,
+                        void          *key,
+                        void          *value)
+{   /*{{{*/
+    return qt_dictionary_put_helper(dict, key, value, swiss_hash(dict, key), PUT_ALWAYS);
+} /*}}}*/
+
+void *qt_dictionary_put_if_absent(qt_dictionary *dict,
+                                  void          *key,
+                                  void          *value)
+{   /*{{{*/
+    return qt_dictionary_put_helper(dict, key, value, swiss_hash(dict, key), PUT_IF_ABSENT);
+} /*}}}*/
+
+static void *qt_dictionary_get_helper(qt_dictionary *dict,
+                                      void          *key,
+                                      uint64_t       h)
+{   /*{{{*/
+    swiss_table_t *t;
+    list_entry    *e;
+    void          *ret = NULL;
+
+restart:
+    t = swiss_current(dict);
+    for (;;) {
+        e = swiss_find(dict, t, key, h, NULL, NULL);
+        if (e != NULL) {
+            ret = e->value;
+            break;
+        }
+        if (t->next == NULL) { break; }
+        if ((t = swiss_next(dict, t)) == NULL) { goto restart; }
+    }
+    swiss_unprotect();
+    return ret;
+} /*}}}*/
+
+void *qt_dictionary_get(qt_dictionary *dict,
+                        void          *key)
+{   /*{{{*/
+    return qt_dictionary_get_helper(dict, key, swiss_hash(dict, key));
+} /*}}}*/
+
+void *qt_dictionary_delete(qt_dictionary *dict,
+                           void          *key)
+{   /*{{{*/
+    const uint64_t         h    = swiss_hash(dict, key);
+    QTHREAD_FASTLOCK_TYPE *lock = swiss_lock(dict, h);
+    swiss_table_t         *t    = swiss_current(dict);
+    swiss_group_t         *g;
+    unsigned int           i;
+    list_entry            *e;
+    void                  *to_ret = NULL;
+
+    if (t->next != NULL) {
+        swiss_help(dict, t);
+    }
+    QTHREAD_FASTLOCK_LOCK(lock);
+restart:
+    t = swiss_current(dict);
+    for (;;) {
+        e = swiss_find(dict, t, key, h, &g, &i);
+        if (e != NULL) {
+            swiss_remove(t, g, i);
+            to_ret = e->value;
+            if (dict->op_cleanup != NULL) {
+                dict->op_cleanup(e->key, NULL);
+            }
+            break;
+        }
+        if (t->next == NULL) { break; }
+        if ((t = swiss_next(dict, t)) == NULL) { goto restart; }
+    }
+    QTHREAD_FASTLOCK_UNLOCK(lock);
+    swiss_unprotect();
+    if (e != NULL) {
+        hazardous_release_node(swiss_entry_free, e);
+    }
+    return to_ret;
+} /*}}}*/
+
+/* Hashing a whole batch up front lets the home groups be prefetched, so the
+ * cache misses overlap instead of being taken one key at a time. */
+static void swiss_hash_batch(qt_dictionary *dict,
+                             void *const   *keys,
+                             size_t         n,
+                             uint64_t      *h)
+{   /*{{{*/
+    swiss_table_t *t = swiss_current(dict);
+
+    for (size_t j = 0; j < n; ++j) {
+        h[j] = swiss_hash(dict, keys[j]);
+        Q_PREFETCH(&t->groups[SWISS_HOME(t, h[j])]);
+    }
+    hazardous_ptr(0, NULL);
+} /*}}}*/
+
+size_t qt_dictionary_put_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void *const   *values,
+                              size_t         n)
+{   /*{{{*/
+    uint64_t h[SWISS_BATCH];
+    size_t   stored = 0;
+
+    for (size_t base = 0; base < n; base += SWISS_BATCH) {
+        const size_t len = (n - base < SWISS_BATCH) ? (n - base) : SWISS_BATCH;
+
+        swiss_hash_batch(dict, keys + base, len, h);
+        for (size_t j = 0; j < len; ++j) {
+            if (qt_dictionary_put_helper(dict, keys[base + j], values[base + j], h[j], PUT_ALWAYS) != NULL) {
+                stored++;
+            }
+        }
+    }
+    return stored;
+} /*}}}*/
+
+size_t qt_dictionary_get_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void         **values,
+                              size_t         n)
+{   /*{{{*/
+    uint64_t h[SWISS_BATCH];
+    size_t   found = 0;
+
+    for (size_t base = 0; base < n; base += SWISS_BATCH) {
+        const size_t len = (n - base < SWISS_BATCH) ? (n - base) : SWISS_BATCH;
+
+        swiss_hash_batch(dict, keys + base, len, h);
+        for (size_t j = 0; j < len; ++j) {
+            values[base + j] = qt_dictionary_get_helper(dict, keys[base + j], h[j]);
+            if (values[base + j] != NULL) {
+                found++;
+            }
+        }
+    }
+    return found;
+} /*}}}*/
+
+qt_dictionary_iterator *qt_dictionary_iterator_create(qt_dictionary *dict)
+{   /*{{{*/
+    if (dict == NULL) {
+        return ERROR;
+    }
+    qt_dictionary_iterator *it = (qt_dictionary_iterator *)MALLOC(sizeof(qt_dictionary_iterator));
+    if (it == NULL) {
+        return ERROR;
+    }
+    it->dict  = dict;
+    it->table = dict->table;
+    it->pos   = 0;
+    it->crt   = NULL;
+    return it;
+} /*}}}*/
+
+void qt_dictionary_iterator_destroy(qt_dictionary_iterator *it)
+{   /*{{{*/
+    if (it == NULL) { return; }
+    FREE(it, sizeof(qt_dictionary_iterator));
+} /*}}}*/
+
+list_entry *qt_dictionary_iterator_next(qt_dictionary_iterator *it)
+{   /*{{{*/
+    if ((it == NULL) || (it->dict == NULL)) {
+        return ERROR;
+    }
+    /* a table that is being moved still holds what hasn't been moved yet, and
+     * its next table holds the rest */
+    while (it->table != NULL) {
+        while (it->pos < it->table->ngroups * SWISS_SLOTS) {
+            swiss_group_t     *g = &it->table->groups[it->pos / SWISS_SLOTS];
+            const unsigned int i = it->pos % SWISS_SLOTS;
+
+            it->pos++;
+            if (SWISS_IS_TAG(SWISS_BYTE(g->ctrl, i)) && (g->slot[i] != NULL)) {
+                it->crt = g->slot[i];
+                return it->crt;
+            }
+        }
+        it->table = it->table->next;
+        it->pos   = 0;
+    }
+    it->crt = NULL;
+    return NULL;
+} /*}}}*/
+
+list_entry *qt_dictionary_iterator_get(const qt_dictionary_iterator *it)
+{   /*{{{*/
+    if ((it == NULL) || (it->dict == NULL)) {
+        return ERROR;
+    }
+    return it->crt;
+} /*}}}*/
+
+qt_dictionary_iterator *qt_dictionary_end(qt_dictionary *dict)
+{   /*{{{*/
+    qt_dictionary_iterator *ret = qt_dictionary_iterator_create(dict);
+
+    if ((ret == NULL) || (ret == ERROR)) {
+        return NULL;
+    }
+    ret->table = NULL;
+    return ret;
+} /*}}}*/
+
+int qt_dictionary_iterator_equals(qt_dictionary_iterator *a,
+                                  qt_dictionary_iterator *b)
+{   /*{{{*/
+    if ((a == NULL) || (b == NULL)) {
+        return a == b;
+    }
+    return (a->crt == b->crt) && (a->dict == b->dict) && (a->table == b->table) && (a->pos == b->pos);
+} /*}}}*/
+
+qt_dictionary_iterator *qt_dictionary_iterator_copy(qt_dictionary_iterator *b)
+{   /*{{{*/
+    if (b == NULL) {
+        return NULL;
+    }
+    qt_dictionary_iterator *ret = qt_dictionary_iterator_create(b->dict);
+    if ((ret == NULL) || (ret == ERROR)) {
+        return NULL;
+    }
+    ret->table = b->table;
+    ret->pos   = b->pos;
+    ret->crt   = b->crt;
+    return ret;
+} /*}}}*/
+
+void qt_dictionary_printbuckets(qt_dictionary *dict)
+{   /*{{{*/
+    for (swiss_table_t *t = dict->table; t != NULL; t = t->next) {
+        size_t fill[SWISS_SLOTS + 1] = { 0 };
+        size_t total                 = 0;
+
+        for (size_t gi = 0; gi < t->ngroups; ++gi) {
+            const uint64_t w    = t->groups[gi].ctrl;
+            unsigned int   live = 0;
+
+            for (unsigned int i = 0; i < SWISS_SLOTS; ++i) {
+                live += SWISS_IS_TAG(SWISS_BYTE(w, i));
+            }
+            fill[live]++;
+            total += live;
+        }
+        printf("table %p: %lu groups, %lu used, %lu deleted, %lu elements%s\n",
+               (void *)t, (unsigned long)t->ngroups, (unsigned long)t->used,
+               (unsigned long)t->dead, (unsigned long)total,
+               (t->next != NULL) ? " (being moved)" : "");
+        for (unsigned int i = 0; i <= SWISS_SLOTS; ++i) {
+            printf("\t%lu groups hold %u elements\n", (unsigned long)fill[i], i);
+        }
+    }
+} /*}}}*/
+
+/* vim:set expandtab: */
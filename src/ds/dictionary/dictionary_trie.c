@@ -636,6 +636,37 @@ size_t qt_dictionary_count(qt_dictionary *h)
  * }
  */
 
+size_t qt_dictionary_put_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void *const   *values,
+                              size_t         n)
+{
+    size_t stored = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (qt_dictionary_put(dict, keys[i], values[i]) != NULL) {
+            stored++;
+        }
+    }
+    return stored;
+}
+
+size_t qt_dictionary_get_many(qt_dictionary *dict,
+                              void *const   *keys,
+                              void         **values,
+                              size_t         n)
+{
+    size_t found = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        values[i] = qt_dictionary_get(dict, keys[i]);
+        if (values[i] != NULL) {
+            found++;
+        }
+    }
+    return found;
+}
+
 struct qt_dictionary_iterator {
     qt_dictionary *dict;
     list_entry    *crt; // =NULL if iterator is newly created or reached the end; =crt elem otherwise.
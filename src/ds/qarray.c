@@ -6,6 +6,9 @@
 #include <stdlib.h>                    /* for calloc() */
 #include <sys/types.h>
 #include <sys/mman.h>
+#ifdef QTHREAD_HAVE_LIBNUMA
+# include <numa.h>                     /* for numa_error() */
+#endif
 #ifdef QTHREAD_USE_VALGRIND
 # include <valgrind/memcheck.h>
 #else
@@ -20,6 +23,7 @@
 #include "qt_visibility.h"
 #include "qt_asserts.h"
 #include "qt_shepherd_innards.h"           /* for shep_to_node */
+#include "qt_affinity.h"                   /* for QTHREAD_HAVE_MEM_AFFINITY */
 #include "qt_debug.h"
 #include "qt_aligned_alloc.h"
 #include "qt_gcd.h"                    /* for qt_lcm() */
@@ -144,14 +148,41 @@ static void qarray_free_cdt(void)
     }
 }                                      /*}}} */
 
+struct qarray_touch_args {
+    const qarray                *a;
+    const qthread_shepherd_id_t *owner;
+    size_t                       segment_count;
+    qthread_shepherd_id_t        shep;
+};
+
+/* runs on shepherd arg->shep, and faults in every page of the segments it
+ * owns, so that wherever the pages weren't bound to a node, first-touch puts
+ * them on this shepherd's */
+static aligned_t qarray_first_touch(void *arg_)
+{                                      /*{{{ */
+    const struct qarray_touch_args *arg = arg_;
+    const size_t                    len = arg->a->segment_bytes;
+
+    for (size_t segment = 0; segment < arg->segment_count; segment++) {
+        volatile char *seghead;
+
+        if (arg->owner[segment] != arg->shep) { continue; }
+        seghead = arg->a->base_ptr + segment * len;
+        for (size_t off = 0; off < len; off += pagesize) {
+            seghead[off] = 0;
+        }
+    }
+    return 0;
+}                                      /*}}} */
+
 static qarray *qarray_create_internal(const size_t         count,
                                       const size_t         obj_size,
                                       const distribution_t d,
                                       const char           tight,
                                       const int            seg_pages)
 {                               /*{{{ */
-    size_t  segment_count;      /* number of segments allocated */
-    qarray *ret = NULL;
+    size_t  segment_count = 0;  /* number of segments allocated */
+    qarray *ret           = NULL;
 
     qassert_ret((count > 0), NULL);
     qassert_ret((obj_size > 0), NULL);
@@ -367,7 +398,10 @@ static qarray *qarray_create_internal(const size_t         count,
     {
         size_t                      segment, target_shep;
         const qthread_shepherd_id_t max_sheps = qthread_num_shepherds();
+        qthread_shepherd_id_t      *owner     =
+            MALLOC(segment_count * sizeof(qthread_shepherd_id_t));
 
+        qassert_goto((owner != NULL), badret_exit);
         qthread_debug(QARRAY_DETAILS, "qarray_create(): segment_count = %i\n",
                       (int)segment_count);
         for (segment = 0; segment < segment_count; segment++) {
@@ -412,31 +446,62 @@ static qarray *qarray_create_internal(const size_t         count,
                     assert(ret->dist_type == ALL_SAME);
                     target_shep = ret->dist_specific.dist_shep;
             }
-            if (ret->dist_type == DIST) {
-                char *seghead =
-                    qarray_elem_nomigrate(ret, segment * ret->segment_size);
-                qarray_internal_segment_shep_write(ret, seghead, target_shep);
-            }
             assert(target_shep < max_sheps);
             qthread_debug(QARRAY_DETAILS,
                           "qarray_create(): segment %i assigned to shep %i\n",
                           segment, target_shep);
+            owner[segment] = (qthread_shepherd_id_t)target_shep;
 #ifdef QTHREAD_HAVE_MEM_AFFINITY
-            {
-                /* make sure this shep has a node; if it does, put this segment there */
+            if (ret->dist_type != ALL_SAME) { /* that was allocated on its node */
+                /* make sure this shep has a node; if it does, put this segment
+                 * there (before anything touches it) */
                 unsigned int target_node =
                     qthread_internal_shep_to_node(target_shep);
                 if (target_node != QTHREAD_NO_NODE) {
-                    char *seghead = qarray_elem_nomigrate(ret,
-                                                          segment *
-                                                          ret->segment_size);
-                    qt_affinity_mem_tonode(seghead, ret->segment_bytes,
-                                           target_node);
+                    qt_affinity_mem_tonode(ret->base_ptr + segment * ret->segment_bytes,
+                                           ret->segment_bytes, target_node);
                 }
             }
 #endif      /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
             qthread_incr(&chunk_distribution_tracker[target_shep], 1);
         }
+
+        /* fault every segment in from its own shepherd, so that it's really
+         * there even where it couldn't be bound */
+        {
+            struct qarray_touch_args *ta = MALLOC(max_sheps * sizeof(struct qarray_touch_args));
+            aligned_t                *rv = MALLOC(max_sheps * sizeof(aligned_t));
+            qthread_shepherd_id_t     s;
+
+            assert(ta && rv);
+            for (s = 0; s < max_sheps; s++) {
+                ta[s].a             = ret;
+                ta[s].owner         = owner;
+                ta[s].segment_count = segment_count;
+                ta[s].shep          = s;
+                if ((ret->dist_type == ALL_SAME) && (s != ret->dist_specific.dist_shep)) {
+                    continue;
+                }
+                qthread_fork_to(qarray_first_touch, &ta[s], &rv[s], s);
+            }
+            for (s = 0; s < max_sheps; s++) {
+                if ((ret->dist_type == ALL_SAME) && (s != ret->dist_specific.dist_shep)) {
+                    continue;
+                }
+                qthread_readFF(NULL, &rv[s]);
+            }
+            FREE(ta, max_sheps * sizeof(struct qarray_touch_args));
+            FREE(rv, max_sheps * sizeof(aligned_t));
+        }
+
+        if (ret->dist_type == DIST) {
+            for (segment = 0; segment < segment_count; segment++) {
+                char *seghead =
+                    qarray_elem_nomigrate(ret, segment * ret->segment_size);
+                qarray_internal_segment_shep_write(ret, seghead, owner[segment]);
+            }
+        }
+        FREE(owner, segment_count * sizeof(qthread_shepherd_id_t));
     }
 #if defined(HAVE_MADVISE) && HAVE_DECL_MADV_ACCESS_LWP
     madvise(ret->base_ptr, segment_count * ret->segment_bytes, MADV_ACCESS_LWP);
@@ -453,7 +518,11 @@ static qarray *qarray_create_internal(const size_t         count,
     qgoto(badret_exit);
     if (ret) {
         if (ret->base_ptr) {
-            free(ret->base_ptr);
+#ifdef QTHREAD_HAVE_MEM_AFFINITY
+            qt_affinity_free(ret->base_ptr, segment_count * ret->segment_bytes);
+#else
+            qthread_internal_aligned_free(ret->base_ptr, pagesize);
+#endif
         }
         FREE(ret, sizeof(qarray));
     }
@@ -575,10 +644,10 @@ void *qarray_elem_migrate(const qarray *a,
     qthread_shepherd_id_t dest;
 
     qassert_ret((a != NULL), NULL);
-    qassert_ret((index >= a->count), NULL);
+    qassert_ret((index < a->count), NULL);
     {
         const size_t segment_num  = index / a->segment_size;    /* rounded down */
-        char        *segment_head = a->base_ptr + (segment_num + a->segment_bytes);
+        char        *segment_head = a->base_ptr + (segment_num * a->segment_bytes);
 
         ret =
             segment_head +
@@ -622,6 +691,44 @@ struct qarray_constfunc_wrapper_args {
     const size_t  startat, stopat;
 };
 
+/* For FIXED_FIELDS arrays: clips [*count, *max_count) to the field that shep
+ * owns. Returns 0 if shep owns none of the range. */
+static int qarray_internal_field_range(const qarray               *a,
+                                       const qthread_shepherd_id_t shep,
+                                       size_t                     *count,
+                                       size_t                     *max_count)
+{                                      /*{{{ */
+    const size_t                segment_size  = a->segment_size;
+    const size_t                segs_per_shep = a->dist_specific.stripes.segs_per_shep;
+    const size_t                extras        = a->dist_specific.stripes.extras;
+    const qthread_shepherd_id_t start_shep    = qarray_shepof(a, *count);
+    const qthread_shepherd_id_t stop_shep     = qarray_shepof(a, *max_count - 1);
+    size_t                      field_start;
+    size_t                      field_end;
+
+    if ((shep < start_shep) || (shep > stop_shep)) {
+        return 0;
+    }
+    /* this relies on sheps being zero-indexed */
+    if (shep < extras) {
+        field_start = shep * segment_size * (segs_per_shep + 1);
+        field_end   = field_start + segment_size * (segs_per_shep + 1);
+    } else {
+        field_start = (extras * segment_size * (segs_per_shep + 1)) +
+                      ((shep - extras) * segment_size * segs_per_shep);
+        field_end = field_start + segment_size * segs_per_shep;
+    }
+    if (shep != start_shep) {
+        /* count isn't *my* starting point, but I am within the range of
+         * interest, so find my starting point. */
+        *count = field_start;
+    }
+    if (*max_count > field_end) {
+        *max_count = field_end;
+    }
+    return 1;
+}                                      /*}}} */
+
 static aligned_t qarray_strider(const struct qarray_func_wrapper_args *arg)
 {                                      /*{{{ */
     const size_t                segment_size = arg->a->segment_size;
@@ -639,43 +746,10 @@ static aligned_t qarray_strider(const struct qarray_func_wrapper_args *arg)
             }
             break;
         case FIXED_FIELDS:
-        {
-            qthread_shepherd_id_t start_shep = qarray_shepof(arg->a, count);
-            qthread_shepherd_id_t stop_shep  =
-                qarray_shepof(arg->a, max_count - 1);
-            if ((shep < start_shep) || (shep > stop_shep)) {
+            if (!qarray_internal_field_range(arg->a, shep, &count, &max_count)) {
                 goto qarray_strider_exit;
             }
-            if (shep != start_shep) {
-                /* count isn't *my* starting point, but I am within the
-                 * range of interest, so find my starting point. */
-                size_t extras        = arg->a->dist_specific.stripes.extras;
-                size_t segs_per_shep =
-                    arg->a->dist_specific.stripes.segs_per_shep;
-                /* this relies on sheps being zero-indexed */
-                if (shep < extras) {
-                    count = shep * segment_size * (segs_per_shep + 1);
-                } else {
-                    count =
-                        (extras * segment_size * (segs_per_shep + 1)) +
-                        ((shep - extras) * segment_size * segs_per_shep);
-                }
-            }
-            {
-                size_t segs_on_this_shep =
-                    arg->a->dist_specific.stripes.segs_per_shep;
-                size_t last_count_on_this_shep;
-                if (shep < arg->a->dist_specific.stripes.extras) {
-                    segs_on_this_shep++;
-                }
-                last_count_on_this_shep =
-                    count + ((segment_size * segs_on_this_shep) - 1);
-                if (max_count > last_count_on_this_shep) {
-                    max_count = last_count_on_this_shep + 1;
-                }
-            }
             break;
-        }
         default:                       // use this when our starting point is somewhat unpredictable
             if ((count > 0) && (qarray_shepof(arg->a, count) != shep)) {
                 /* jump to the next segment boundary */
@@ -698,9 +772,10 @@ static aligned_t qarray_strider(const struct qarray_func_wrapper_args *arg)
      */
     while (1) {
         size_t       inpage_offset;
+        /* stop at the end of this segment, even if we started mid-way */
+        const size_t seg_left   = segment_size - (count % segment_size);
         const size_t max_offset =
-            ((max_count - count) >
-             segment_size) ? segment_size : (max_count - count);
+            ((max_count - count) > seg_left) ? seg_left : (max_count - count);
 
         for (inpage_offset = 0; inpage_offset < max_offset; inpage_offset++) {
             void *ptr = qarray_elem_nomigrate(arg->a, count + inpage_offset);
@@ -708,6 +783,7 @@ static aligned_t qarray_strider(const struct qarray_func_wrapper_args *arg)
             assert(ptr != NULL);       // aka internal error
             arg->func.qt(ptr);
         }
+        count -= count % segment_size;
         switch (dist_type) {
             case FIXED_FIELDS:
             case ALL_SAME:
@@ -757,32 +833,10 @@ static aligned_t qarray_loop_strider(const struct qarray_func_wrapper_args *arg)
             }
             break;
         case FIXED_FIELDS:
-        {
-            qthread_shepherd_id_t start_shep = qarray_shepof(arg->a, count);
-            qthread_shepherd_id_t stop_shep  =
-                qarray_shepof(arg->a, max_count - 1);
-            if ((shep < start_shep) || (shep > stop_shep)) {
+            if (!qarray_internal_field_range(arg->a, shep, &count, &max_count)) {
                 goto qarray_loop_strider_exit;
             }
-            if (shep != start_shep) {
-                /* count isn't *my* starting point, but I am within the
-                 * range of interest, so find my starting point. */
-                /* this relies on sheps being zero-indexed */
-                count =
-                    shep * segment_size *
-                    arg->a->dist_specific.stripes.segs_per_shep;
-            }
-            {
-                size_t last_count_on_my_shep =
-                    ((shep +
-                      1) * segment_size *
-                     arg->a->dist_specific.stripes.segs_per_shep) - 1;
-                if (max_count > last_count_on_my_shep) {
-                    max_count = last_count_on_my_shep;
-                }
-            }
             break;
-        }
         default:
             if ((count > 0) && (qarray_shepof(arg->a, count) != shep)) {
                 /* jump to the next segment boundary */
@@ -815,11 +869,13 @@ static aligned_t qarray_loop_strider(const struct qarray_func_wrapper_args *arg)
     }
     while (1) {
         {
+            /* stop at the end of this segment, even if we started mid-way */
+            const size_t seg_left   = segment_size - (count % segment_size);
             const size_t max_offset =
-                ((max_count - count) >
-                 segment_size) ? segment_size : (max_count - count);
+                ((max_count - count) > seg_left) ? seg_left : (max_count - count);
             ql(count, count + max_offset, arg->a, arg->arg);
         }
+        count -= count % segment_size;
         switch (dist_type) {
             default:
                 QTHREAD_TRAP();
@@ -869,32 +925,10 @@ static aligned_t qarray_loopaccum_strider(const struct qarray_accumfunc_wrapper_
             }
             break;
         case FIXED_FIELDS:
-        {
-            qthread_shepherd_id_t start_shep = qarray_shepof(arg->a, count);
-            qthread_shepherd_id_t stop_shep  =
-                qarray_shepof(arg->a, max_count - 1);
-            if ((shep < start_shep) || (shep > stop_shep)) {
+            if (!qarray_internal_field_range(arg->a, shep, &count, &max_count)) {
                 goto qarray_loop_strider_exit;
             }
-            if (shep != start_shep) {
-                /* count isn't *my* starting point, but I am within the
-                 * range of interest, so find my starting point. */
-                /* this relies on sheps being zero-indexed */
-                count =
-                    shep * segment_size *
-                    arg->a->dist_specific.stripes.segs_per_shep;
-            }
-            {
-                size_t last_count_on_my_shep =
-                    ((shep +
-                      1) * segment_size *
-                     arg->a->dist_specific.stripes.segs_per_shep) - 1;
-                if (max_count > last_count_on_my_shep) {
-                    max_count = last_count_on_my_shep;
-                }
-            }
             break;
-        }
         default:
             if ((count > 0) && (qarray_shepof(arg->a, count) != shep)) {
                 /* jump to the next segment boundary */
@@ -929,9 +963,10 @@ static aligned_t qarray_loopaccum_strider(const struct qarray_accumfunc_wrapper_
     assert(tmpret);
     while (1) {
         {
+            /* stop at the end of this segment, even if we started mid-way */
+            const size_t seg_left   = segment_size - (count % segment_size);
             const size_t max_offset =
-                ((max_count - count) >
-                 segment_size) ? segment_size : (max_count - count);
+                ((max_count - count) > seg_left) ? seg_left : (max_count - count);
             if (first) {
                 ql(count, count + max_offset, arg->a, arg->arg, myret);
                 first = 0;
@@ -940,6 +975,7 @@ static aligned_t qarray_loopaccum_strider(const struct qarray_accumfunc_wrapper_
                 acc(myret, tmpret);
             }
         }
+        count -= count % segment_size;
         switch (dist_type) {
             default:
                 /* This should never happen, so deliberately cause a seg fault
@@ -1260,7 +1296,7 @@ void qarray_iter_loopaccum(qarray      *a,
             for (i = 0; i < num_spawns; i++) {
                 qthread_readFF(NULL, &(rv[i]));
                 if (i > 0) {
-                    acc(ret, &rets[i - 1]);
+                    acc(ret, rets + ((i - 1) * retsize));
                 }
             }
             FREE(qfwa, sizeof(struct qarray_accumfunc_wrapper_args) * num_spawns);
@@ -1388,13 +1424,14 @@ void qarray_set_shepof(qarray               *a,
                 unsigned int target_node =
                     qthread_internal_shep_to_node(shep);
                 if (target_node != QTHREAD_NO_NODE) {
-                    size_t num_segments = a->count / a->segment_size;
-                    size_t array_size   = a->segment_bytes * num_segments;
-                    qt_affinity_mem_tonode(a->base_ptr, array_size, target_node);
+                    /* the pages are already there, so they have to move */
+                    qt_affinity_mem_move(a->base_ptr,
+                                         a->segment_bytes * segment_count,
+                                         target_node);
                 }
 #elif defined(HAVE_MADVISE) && HAVE_DECL_MADV_ACCESS_LWP
                 madvise(a->base_ptr,
-                        (a->count / a->segment_size) * a->segment_bytes, MADV_ACCESS_LWP);
+                        segment_count * a->segment_bytes, MADV_ACCESS_LWP);
 #endif      /* ifdef QTHREAD_HAVE_MEM_AFFINITY */
                 qthread_incr(&chunk_distribution_tracker[shep],
                              segment_count);
@@ -1418,9 +1455,9 @@ void qarray_set_shepof(qarray               *a,
                 unsigned int target_node =
                     qthread_internal_shep_to_node(shep);
                 if (target_node != QTHREAD_NO_NODE) {
-                    qt_affinity_mem_tonode(a->base_ptr +
-                                           (a->segment_bytes * segment),
-                                           a->segment_bytes, target_node);
+                    qt_affinity_mem_move(a->base_ptr +
+                                         (a->segment_bytes * segment),
+                                         a->segment_bytes, target_node);
                 }
 #elif defined(HAVE_MADVISE) && HAVE_DECL_MADV_ACCESS_LWP
                 madvise(a->base_ptr + (a->segment_bytes * (i / a->segment_size)),
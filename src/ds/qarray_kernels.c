@@ -0,0 +1,372 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdint.h>
+#include <string.h>                    /* for memcpy() */
+
+/* Public Headers */
+#include "qthread/qarray.h"
+
+/* Local Headers */
+#include "qt_visibility.h"
+#include "qt_asserts.h"
+#include "qt_macros.h"
+#include "qt_qutil_kernels.h"
+
+/* Everything here rides on qarray_iter_loop()/qarray_iter_loopaccum(), which
+ * already hand each shepherd the part of the range it owns. Those pieces are
+ * cut into runs that are contiguous in every array involved, and each run
+ * goes to one of the qutil kernels. Runs start on segment boundaries (which
+ * are page-aligned) whenever the range does, so the kernels' aligned loops
+ * cover all but the tail of a run. */
+
+typedef void (*qarray_run_f)(char       *a,
+                             const char *b,
+                             size_t      n,
+                             void       *arg);
+
+static void qarray_runs(const qarray *a,
+                        const qarray *b,
+                        size_t        startat,
+                        const size_t  stopat,
+                        qarray_run_f  f,
+                        void         *arg)
+{                                      /*{{{ */
+    while (startat < stopat) {
+        size_t n = qarray_contig(a, startat, stopat);
+
+        if (b != NULL) {
+            const size_t nb = qarray_contig(b, startat, stopat);
+
+            if (nb < n) { n = nb; }
+        }
+        f(qarray_elem_nomigrate(a, startat),
+          b ? qarray_elem_nomigrate(b, startat) : NULL, n, arg);
+        startat += n;
+    }
+}                                      /*}}} */
+
+/**************
+* Transforms *
+**************/
+struct qarray_kernel_args {
+    const qarray *b;
+    qarray_run_f  run;
+    union {
+        double     d;
+        aligned_t  u;
+        saligned_t s;
+        uint64_t   bits;
+        char       bytes[sizeof(uint64_t)];
+    } value;
+    size_t unit_size;
+};
+
+static void qarray_kernel_loop(const size_t startat,
+                               const size_t stopat,
+                               qarray      *array,
+                               void        *arg)
+{                                      /*{{{ */
+    struct qarray_kernel_args *ka = (struct qarray_kernel_args *)arg;
+
+    qarray_runs(array, ka->b, startat, stopat, ka->run, ka);
+}                                      /*}}} */
+
+static void qarray_fill_run(char       *a,
+                            const char *QUNUSED(b),
+                            size_t      n,
+                            void       *arg)
+{                                      /*{{{ */
+    const struct qarray_kernel_args *ka = (const struct qarray_kernel_args *)arg;
+
+    if (ka->unit_size == sizeof(uint64_t)) {
+        qt_qutil_kernels()->fill64((uint64_t *)a, ka->value.bits, n);
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            memcpy(a + i * ka->unit_size, ka->value.bytes, ka->unit_size);
+        }
+    }
+}                                      /*}}} */
+
+static void qarray_copy_run(char       *a,
+                            const char *b,
+                            size_t      n,
+                            void       *arg)
+{                                      /*{{{ */
+    memcpy(a, b, n * ((const struct qarray_kernel_args *)arg)->unit_size);
+}                                      /*}}} */
+
+static void qarray_axpy_run(char       *a,
+                            const char *b,
+                            size_t      n,
+                            void       *arg)
+{                                      /*{{{ */
+    qt_qutil_kernels()->double_axpy((double *)a,
+                                    ((const struct qarray_kernel_args *)arg)->value.d,
+                                    (const double *)b, n);
+}                                      /*}}} */
+
+static void qarray_fill(qarray                    *a,
+                        const size_t               startat,
+                        const size_t               stopat,
+                        struct qarray_kernel_args *ka)
+{                                      /*{{{ */
+    qassert_retvoid((a != NULL));
+    qassert_retvoid((a->unit_size == ka->unit_size));
+    qassert_retvoid((stopat <= a->count));
+    if (startat >= stopat) { return; }
+    ka->b   = NULL;
+    ka->run = qarray_fill_run;
+    qarray_iter_loop(a, startat, stopat, qarray_kernel_loop, ka);
+}                                      /*}}} */
+
+void API_FUNC qarray_double_fill(qarray      *a,
+                                 const size_t startat,
+                                 const size_t stopat,
+                                 double       value)
+{                                      /*{{{ */
+    struct qarray_kernel_args ka;
+
+    ka.value.d   = value;
+    ka.unit_size = sizeof(double);
+    qarray_fill(a, startat, stopat, &ka);
+}                                      /*}}} */
+
+void API_FUNC qarray_uint_fill(qarray      *a,
+                               const size_t startat,
+                               const size_t stopat,
+                               aligned_t    value)
+{                                      /*{{{ */
+    struct qarray_kernel_args ka;
+
+    ka.value.u   = value;
+    ka.unit_size = sizeof(aligned_t);
+    qarray_fill(a, startat, stopat, &ka);
+}                                      /*}}} */
+
+void API_FUNC qarray_int_fill(qarray      *a,
+                              const size_t startat,
+                              const size_t stopat,
+                              saligned_t   value)
+{                                      /*{{{ */
+    struct qarray_kernel_args ka;
+
+    ka.value.s   = value;
+    ka.unit_size = sizeof(saligned_t);
+    qarray_fill(a, startat, stopat, &ka);
+}                                      /*}}} */
+
+void API_FUNC qarray_copy(qarray       *dst,
+                          const qarray *src,
+                          const size_t  startat,
+                          const size_t  stopat)
+{                                      /*{{{ */
+    struct qarray_kernel_args ka;
+
+    qassert_retvoid((dst != NULL));
+    qassert_retvoid((src != NULL));
+    qassert_retvoid((dst->unit_size == src->unit_size));
+    qassert_retvoid((stopat <= dst->count && stopat <= src->count));
+    if (startat >= stopat) { return; }
+    ka.b         = src;
+    ka.run       = qarray_copy_run;
+    ka.unit_size = dst->unit_size;
+    qarray_iter_loop(dst, startat, stopat, qarray_kernel_loop, &ka);
+}                                      /*}}} */
+
+void API_FUNC qarray_double_axpy(qarray       *y,
+                                 double        alpha,
+                                 const qarray *x,
+                                 const size_t  startat,
+                                 const size_t  stopat)
+{                                      /*{{{ */
+    struct qarray_kernel_args ka;
+
+    qassert_retvoid((y != NULL));
+    qassert_retvoid((x != NULL));
+    qassert_retvoid((y->unit_size == sizeof(double)));
+    qassert_retvoid((x->unit_size == sizeof(double)));
+    qassert_retvoid((stopat <= y->count && stopat <= x->count));
+    if (startat >= stopat) { return; }
+    ka.b         = x;
+    ka.run       = qarray_axpy_run;
+    ka.value.d   = alpha;
+    ka.unit_size = sizeof(double);
+    qarray_iter_loop(y, startat, stopat, qarray_kernel_loop, &ka);
+}                                      /*}}} */
+
+/**************
+* Reductions *
+**************/
+typedef enum {
+    QA_DOUBLE_SUM = 1, QA_DOUBLE_MAX, QA_DOUBLE_MIN, QA_DOUBLE_DOT,
+    QA_UINT_SUM, QA_UINT_MAX, QA_UINT_MIN,
+    QA_INT_SUM, QA_INT_MAX, QA_INT_MIN
+} qarray_reduction_t;
+
+/* Partial results. qarray_iter_loopaccum() hands out zeroed slots to
+ * shepherds that may own none of the range, so a slot with op 0 is empty and
+ * is skipped when combining. */
+struct qarray_partial {
+    union {
+        double     d;
+        aligned_t  u;
+        saligned_t s;
+    } v;
+    qarray_reduction_t op;
+};
+
+struct qarray_reduce_args {
+    const qarray         *b;
+    struct qarray_partial part;
+    int                   seeded;
+};
+
+/* same semantics as the kernels: max/min only replace the current value when
+ * the contender compares greater/less */
+#define QA_COMBINE(_op_, _r_, _x_) do {                                   \
+        switch (_op_) {                                                   \
+            case QA_DOUBLE_SUM: case QA_DOUBLE_DOT:                       \
+                (_r_).d += (_x_).d; break;                                \
+            case QA_DOUBLE_MAX:                                           \
+                if ((_r_).d < (_x_).d) { (_r_).d = (_x_).d; } break;      \
+            case QA_DOUBLE_MIN:                                           \
+                if ((_r_).d > (_x_).d) { (_r_).d = (_x_).d; } break;      \
+            case QA_UINT_SUM:                                             \
+                (_r_).u += (_x_).u; break;                                \
+            case QA_UINT_MAX:                                             \
+                if ((_r_).u < (_x_).u) { (_r_).u = (_x_).u; } break;      \
+            case QA_UINT_MIN:                                             \
+                if ((_r_).u > (_x_).u) { (_r_).u = (_x_).u; } break;      \
+            case QA_INT_SUM:                                              \
+                (_r_).s += (_x_).s; break;                                \
+            case QA_INT_MAX:                                              \
+                if ((_r_).s < (_x_).s) { (_r_).s = (_x_).s; } break;      \
+            case QA_INT_MIN:                                              \
+                if ((_r_).s > (_x_).s) { (_r_).s = (_x_).s; } break;      \
+        }                                                                 \
+} while (0)
+
+static void qarray_reduce_run(char       *a,
+                              const char *b,
+                              size_t      n,
+                              void       *arg)
+{                                      /*{{{ */
+    struct qarray_reduce_args *ra = (struct qarray_reduce_args *)arg;
+    struct qarray_partial     *r  = &ra->part;
+    const qt_qutil_kernels_t  *k  = qt_qutil_kernels();
+    struct qarray_partial      x;
+
+    switch (r->op) {
+        case QA_DOUBLE_SUM: x.v.d = k->double_sum((const double *)a, n); break;
+        case QA_DOUBLE_MAX: x.v.d = k->double_max((const double *)a, n); break;
+        case QA_DOUBLE_MIN: x.v.d = k->double_min((const double *)a, n); break;
+        case QA_DOUBLE_DOT:
+            x.v.d = k->double_dot((const double *)a, (const double *)b, n);
+            break;
+        case QA_UINT_SUM: x.v.u = k->uint_sum((const aligned_t *)a, n); break;
+        case QA_UINT_MAX: x.v.u = k->uint_max((const aligned_t *)a, n); break;
+        case QA_UINT_MIN: x.v.u = k->uint_min((const aligned_t *)a, n); break;
+        case QA_INT_SUM: x.v.s = k->int_sum((const saligned_t *)a, n); break;
+        case QA_INT_MAX: x.v.s = k->int_max((const saligned_t *)a, n); break;
+        case QA_INT_MIN: x.v.s = k->int_min((const saligned_t *)a, n); break;
+        default:
+            /* callers always set the op; an empty slot never gets here */
+            assert(0);
+            return;
+    }
+    if (ra->seeded) {
+        QA_COMBINE(r->op, r->v, x.v);
+    } else {
+        r->v       = x.v;
+        ra->seeded = 1;
+    }
+}                                      /*}}} */
+
+static void qarray_reduce_loop(const size_t startat,
+                               const size_t stopat,
+                               qarray      *array,
+                               void        *arg,
+                               void        *ret)
+{                                      /*{{{ */
+    const struct qarray_reduce_args *ra = (const struct qarray_reduce_args *)arg;
+    struct qarray_reduce_args        mine;
+
+    mine.b      = ra->b;
+    mine.part   = ra->part;
+    mine.seeded = 0;                   /* the first run seeds the value */
+    qarray_runs(array, ra->b, startat, stopat, qarray_reduce_run, &mine);
+    if (!mine.seeded) {
+        mine.part.op = 0;
+    }
+    *(struct qarray_partial *)ret = mine.part;
+}                                      /*}}} */
+
+static void qarray_reduce_acc(void       *a,
+                              const void *b)
+{                                      /*{{{ */
+    struct qarray_partial       *r = (struct qarray_partial *)a;
+    const struct qarray_partial *x = (const struct qarray_partial *)b;
+
+    if (x->op == 0) { return; }
+    if (r->op == 0) {
+        *r = *x;
+        return;
+    }
+    QA_COMBINE(r->op, r->v, x->v);
+}                                      /*}}} */
+
+static struct qarray_partial qarray_reduce(const qarray            *a,
+                                           const qarray            *b,
+                                           const size_t             startat,
+                                           const size_t             stopat,
+                                           const qarray_reduction_t op)
+{                                      /*{{{ */
+    struct qarray_reduce_args ra;
+    struct qarray_partial     ret;
+
+    memset(&ret, 0, sizeof(ret));
+    qassert_ret((a != NULL), ret);
+    qassert_ret((stopat <= a->count), ret);
+    qassert_ret((b == NULL || stopat <= b->count), ret);
+    if (startat >= stopat) { return ret; }
+    ra.b = b;
+    memset(&ra.part, 0, sizeof(ra.part));
+    ra.part.op = op;
+    qarray_iter_loopaccum((qarray *)a, startat, stopat, qarray_reduce_loop,
+                          &ra, &ret, sizeof(ret), qarray_reduce_acc);
+    return ret;
+}                                      /*}}} */
+
+double API_FUNC qarray_double_dot(const qarray *a,
+                                  const qarray *b,
+                                  const size_t  startat,
+                                  const size_t  stopat)
+{                                      /*{{{ */
+    qassert_ret((a != NULL && a->unit_size == sizeof(double)), 0.0);
+    qassert_ret((b != NULL && b->unit_size == sizeof(double)), 0.0);
+    return qarray_reduce(a, b, startat, stopat, QA_DOUBLE_DOT).v.d;
+}                                      /*}}} */
+
+#define QARRAY_REDUCTION(_rtype_, _fname_, _op_, _field_)                     \
+    _rtype_ API_FUNC _fname_(const qarray *a,                                 \
+                             const size_t  startat,                           \
+                             const size_t  stopat)                            \
+    {                                                                         \
+        qassert_ret((a != NULL && a->unit_size == sizeof(_rtype_)), 0);       \
+        return qarray_reduce(a, NULL, startat, stopat, _op_).v._field_;       \
+    }
+
+QARRAY_REDUCTION(double, qarray_double_sum, QA_DOUBLE_SUM, d)
+QARRAY_REDUCTION(double, qarray_double_max, QA_DOUBLE_MAX, d)
+QARRAY_REDUCTION(double, qarray_double_min, QA_DOUBLE_MIN, d)
+QARRAY_REDUCTION(aligned_t, qarray_uint_sum, QA_UINT_SUM, u)
+QARRAY_REDUCTION(aligned_t, qarray_uint_max, QA_UINT_MAX, u)
+QARRAY_REDUCTION(aligned_t, qarray_uint_min, QA_UINT_MIN, u)
+QARRAY_REDUCTION(saligned_t, qarray_int_sum, QA_INT_SUM, s)
+QARRAY_REDUCTION(saligned_t, qarray_int_max, QA_INT_MAX, s)
+QARRAY_REDUCTION(saligned_t, qarray_int_min, QA_INT_MIN, s)
+
+/* vim:set expandtab: */
@@ -6,6 +6,8 @@
 #include <qthread/qlfqueue.h>
 #include <qthread/qdqueue.h>
 #include "qt_asserts.h"
+#include "qt_atomics.h"                /* for QTHREAD_FASTLOCK_* */
+#include "qt_aligned_alloc.h"
 #ifdef HAVE_SYS_LGRP_USER_H
 # include <sys/lgrp_user.h>
 #endif
@@ -14,8 +16,20 @@
 #endif
 #include "qt_debug.h" /* for malloc debug wrappers */
 
+/* how many elements a worker holds back in qdqueue_enqueue_buffered() before
+ * handing them all to its shepherd's subqueue at once */
+#define QDQUEUE_BUFFER_SIZE 32
+/* the most elements one dequeue takes from another shepherd's subqueue */
+#define QDQUEUE_STEAL_BATCH 8
+
 struct qdsubqueue_s;
 
+struct qdqueue_buffer_s {
+    QTHREAD_FASTLOCK_TYPE lock Q_ALIGNED(CACHELINE_WIDTH);
+    size_t                count;
+    void                 *elems[QDQUEUE_BUFFER_SIZE];
+};
+
 typedef struct qdqueue_adstruct_s {
     struct qdsubqueue_s *shep;
     aligned_t            generation;
@@ -45,6 +59,9 @@ struct qdsubqueue_s {
     size_t                  nNeighbors;
     struct qdsubqueue_s   **neighbors;  /* ordered by distance */
     struct qdsubqueue_s   **allsheps;   /* ordered by distance */
+
+    qthread_worker_id_t      nBuffers;
+    struct qdqueue_buffer_s *buffers;   /* one per worker */
 };
 
 struct qdqueue_s {
@@ -340,6 +357,16 @@ qdqueue_t *qdqueue_create(void)
                 ret->Qs[curshep].allsheps[i];
         }
         ret->Qs[curshep].ads.first = NULL;
+        ret->Qs[curshep].nBuffers  = qthread_num_workers_local(curshep);
+        ret->Qs[curshep].buffers   =
+            qthread_internal_aligned_alloc(ret->Qs[curshep].nBuffers *
+                                           sizeof(struct qdqueue_buffer_s),
+                                           CACHELINE_WIDTH);
+        assert(ret->Qs[curshep].buffers);
+        for (qthread_worker_id_t w = 0; w < ret->Qs[curshep].nBuffers; w++) {
+            QTHREAD_FASTLOCK_INIT(ret->Qs[curshep].buffers[w].lock);
+            ret->Qs[curshep].buffers[w].count = 0;
+        }
     }
     for (curshep = 0; curshep < maxsheps; curshep++) {
         FREE(sheparray[curshep], maxsheps * sizeof(int));
@@ -382,44 +409,146 @@ int qdqueue_destroy(qdqueue_t *q)
         if (q->Qs[i].allsheps != NULL) {
             FREE(q->Qs[i].allsheps, (maxsheps - 1) * sizeof(struct qdsubqueue_s *));
         }
+        if (q->Qs[i].buffers != NULL) {
+            for (qthread_worker_id_t w = 0; w < q->Qs[i].nBuffers; w++) {
+                QTHREAD_FASTLOCK_DESTROY(q->Qs[i].buffers[w].lock);
+            }
+            qthread_internal_aligned_free(q->Qs[i].buffers, CACHELINE_WIDTH);
+        }
     }
     FREE(q->Qs, maxsheps * sizeof(struct qdsubqueue_s));
     FREE(q, sizeof(struct qdqueue_s));
     return QTHREAD_SUCCESS;
 }                                      /*}}} */
 
-/* enqueue something in the queue */
-int qdqueue_enqueue(qdqueue_t *q,
-                    void      *elem)
+/* tell our neighbors that we have work to spare */
+static void qdqueue_internal_advertise(struct qdsubqueue_s *myq)
 {                                      /*{{{ */
-    int                  stat;
-    struct qdsubqueue_s *myq;
+    /* only advertise if our existing ads are stale */
+    if (myq->last_ad_issued <= myq->last_ad_consumed) {
+        aligned_t             generation;
+        qthread_shepherd_id_t shep;
 
-    qassert_ret((q != NULL), QTHREAD_BADARGS);
-    qassert_ret((elem != NULL), QTHREAD_BADARGS);
+        generation = qthread_incr(&(myq->last_ad_issued), 1);
+        for (shep = 0; shep < myq->nNeighbors; shep++) {
+            struct qdsubqueue_s *neighbor = myq->neighbors[shep];
 
-    myq = &(q->Qs[qthread_shep()]);
+            qdqueue_adheap_push(&(neighbor->ads), myq, generation);
+        }
+    }
+}                                      /*}}} */
+
+/* put n elements into one subqueue, advertising (at most once) if that left
+ * it with more than one element in it */
+static void qdqueue_internal_push(struct qdsubqueue_s *myq,
+                                  void *const         *elems,
+                                  size_t               n)
+{                                      /*{{{ */
+    int stat;
 
     stat = qlfqueue_empty(myq->theQ);
-    qlfqueue_enqueue(myq->theQ, elem);
-    if (stat) {
+    if (n == 1) {
+        qlfqueue_enqueue(myq->theQ, elems[0]);
+    } else {
+        qlfqueue_enqueue_many(myq->theQ, elems, n);
+    }
+    if (stat && (n == 1)) {
         /* the queue was empty, so we may have to wake up waiters */
         /*qdqueue_adheap_pushcond(myq->ads, myq, 0); */
     } else {
-        aligned_t             generation;
-        qthread_shepherd_id_t shep;
+        /* the queue has stuff to spare, so we advertise */
+        qdqueue_internal_advertise(myq);
+    }
+}                                      /*}}} */
+
+/* hand everything in a (locked) worker buffer to its subqueue */
+static void qdqueue_internal_flush(struct qdsubqueue_s     *myq,
+                                   struct qdqueue_buffer_s *buf)
+{                                      /*{{{ */
+    if (buf->count > 0) {
+        qdqueue_internal_push(myq, buf->elems, buf->count);
+        buf->count = 0;
+    }
+}                                      /*}}} */
 
-        /* the queue had stuff in it already, so we advertise */
-        if (myq->last_ad_issued <= myq->last_ad_consumed) {
-            /* only advertise if our existing ads are stale */
-            generation = qthread_incr(&(myq->last_ad_issued), 1);
-            for (shep = 0; shep < myq->nNeighbors; shep++) {
-                struct qdsubqueue_s *neighbor = myq->neighbors[shep];
+/* take up to n elements (but never more than QDQUEUE_STEAL_BATCH at once)
+ * from a remote subqueue; they come off the front, so whoever takes them still
+ * sees that shepherd's elements in order */
+static size_t qdqueue_internal_steal(struct qdsubqueue_s *myq,
+                                     struct qdsubqueue_s *victim,
+                                     void               **elems,
+                                     size_t               n)
+{                                      /*{{{ */
+    size_t got;
+
+    got = qlfqueue_dequeue_many(victim->theQ, elems,
+                                (n < QDQUEUE_STEAL_BATCH) ? n : QDQUEUE_STEAL_BATCH);
+    if (got > 0) {
+        /* this write MUST be atomic */
+        myq->last_consumed = victim;
+    }
+    return got;
+}                                      /*}}} */
+
+/* push a worker's buffer into its subqueue (behind everything that worker
+ * flushed before) and take from there, rather than from the buffer itself, so
+ * that its elements still come out in order */
+static size_t qdqueue_internal_drain(struct qdsubqueue_s     *myq,
+                                     struct qdsubqueue_s     *owner,
+                                     struct qdqueue_buffer_s *buf,
+                                     void                   **elems,
+                                     size_t                   n)
+{                                      /*{{{ */
+    if (buf->count == 0) {
+        return 0;
+    }
+    QTHREAD_FASTLOCK_LOCK(&buf->lock);
+    qdqueue_internal_flush(owner, buf);
+    QTHREAD_FASTLOCK_UNLOCK(&buf->lock);
+    return qdqueue_internal_steal(myq, owner, elems, n);
+}                                      /*}}} */
+
+/* follow the ads our neighbors have left us */
+static size_t qdqueue_internal_checkads(struct qdsubqueue_s *myq,
+                                        void               **elems,
+                                        size_t               n)
+{                                      /*{{{ */
+    qdqueue_adstruct_t ad;
+    size_t             got;
 
-                qdqueue_adheap_push(&(neighbor->ads), myq, generation);
+    while ((ad = qdqueue_adheap_pop(&myq->ads)).shep != NULL) {
+        struct qdsubqueue_s *lc = (struct qdsubqueue_s *)ad.shep->last_consumed;
+
+        if (lc == ad.shep) {
+            /* it's working on its own queue */
+            aligned_t last_ad = ad.shep->last_ad_consumed;
+
+            while (last_ad < ad.generation) {
+                last_ad =
+                    qthread_cas(&(ad.shep->last_ad_consumed), last_ad,
+                                ad.generation);
             }
+            if ((got = qdqueue_internal_steal(myq, ad.shep, elems, n)) > 0) {
+                return got;
+            }
+        } else if (lc != NULL) {
+            /* it got work from somewhere! */
+            qdqueue_adheap_push(&myq->ads, lc, 0);
+            /* reset the remote host's last_consumed counter, to avoid infinite loops */
+            (void)qthread_cas_ptr(&(ad.shep->last_consumed), (void *)lc, NULL);
         }
     }
+    return 0;
+}                                      /*}}} */
+
+/* enqueue something in the queue */
+int qdqueue_enqueue(qdqueue_t *q,
+                    void      *elem)
+{                                      /*{{{ */
+    qassert_ret((q != NULL), QTHREAD_BADARGS);
+    qassert_ret((elem != NULL), QTHREAD_BADARGS);
+
+    qdqueue_internal_push(&(q->Qs[qthread_shep()]), &elem, 1);
 
     return QTHREAD_SUCCESS;
 }                                      /*}}} */
@@ -429,32 +558,79 @@ int qdqueue_enqueue_there(qdqueue_t            *q,
                           void                 *elem,
                           qthread_shepherd_id_t there)
 {                                      /*{{{ */
-    int                  stat;
-    struct qdsubqueue_s *myq;
-
     qassert_ret((q != NULL), QTHREAD_BADARGS);
     qassert_ret((elem != NULL), QTHREAD_BADARGS);
     qassert_ret((there < qthread_num_shepherds()), QTHREAD_BADARGS);
 
-    myq = &(q->Qs[there]);
+    qdqueue_internal_push(&(q->Qs[there]), &elem, 1);
 
-    stat = qlfqueue_empty(myq->theQ);
-    qlfqueue_enqueue(myq->theQ, elem);
-    if (stat) {
-        /* the queue was empty, so we may have to wake up waiters */
-        /* qdqueue_adheap_pushcond(myq->ads, myq, 0); */
-    } else {
-        aligned_t             generation;
-        qthread_shepherd_id_t shep;
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+/* enqueue n things in the queue, in order, with a single advertisement */
+int qdqueue_enqueue_many(qdqueue_t   *q,
+                         void *const *elems,
+                         size_t       n)
+{                                      /*{{{ */
+    qassert_ret((q != NULL), QTHREAD_BADARGS);
+    qassert_ret((elems != NULL || n == 0), QTHREAD_BADARGS);
+
+    if (n == 0) { return QTHREAD_SUCCESS; }
+
+    for (size_t i = 0; i < n; i++) {
+        qassert_ret((elems[i] != NULL), QTHREAD_BADARGS);
+    }
+    qdqueue_internal_push(&(q->Qs[qthread_shep()]), elems, n);
 
-        /* the queue had stuff in it already, so we advertise */
-        if (myq->last_ad_issued <= myq->last_ad_consumed) {
-            /* only advertise if our existing ads are stale */
-            generation = qthread_incr(&(myq->last_ad_issued), 1);
-            for (shep = 0; shep < myq->nNeighbors; shep++) {
-                struct qdsubqueue_s *neighbor = myq->neighbors[shep];
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+/* enqueue something in the calling worker's private buffer; the buffer is
+ * handed to the shepherd's queue when it fills up or is flushed */
+int qdqueue_enqueue_buffered(qdqueue_t *q,
+                             void      *elem)
+{                                      /*{{{ */
+    qthread_shepherd_id_t    shep = 0;
+    qthread_worker_id_t      wkr;
+    struct qdsubqueue_s     *myq;
+    struct qdqueue_buffer_s *buf;
 
-                qdqueue_adheap_push(&(neighbor->ads), myq, generation);
+    qassert_ret((q != NULL), QTHREAD_BADARGS);
+    qassert_ret((elem != NULL), QTHREAD_BADARGS);
+
+    wkr = qthread_worker_local(&shep);
+    myq = &(q->Qs[shep]);
+    if ((wkr == NO_WORKER) || (wkr >= myq->nBuffers)) {
+        /* no buffer of our own */
+        qdqueue_internal_push(myq, &elem, 1);
+        return QTHREAD_SUCCESS;
+    }
+    buf = &(myq->buffers[wkr]);
+    QTHREAD_FASTLOCK_LOCK(&buf->lock);
+    buf->elems[buf->count++] = elem;
+    if (buf->count == QDQUEUE_BUFFER_SIZE) {
+        qdqueue_internal_flush(myq, buf);
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&buf->lock);
+
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+/* hand every worker's buffered elements to the shared queues */
+int qdqueue_flush(qdqueue_t *q)
+{                                      /*{{{ */
+    qassert_ret((q != NULL), QTHREAD_BADARGS);
+
+    for (qthread_shepherd_id_t shep = 0; shep < maxsheps; shep++) {
+        struct qdsubqueue_s *myq = &(q->Qs[shep]);
+
+        for (qthread_worker_id_t w = 0; w < myq->nBuffers; w++) {
+            struct qdqueue_buffer_s *buf = &(myq->buffers[w]);
+
+            if (buf->count > 0) {
+                QTHREAD_FASTLOCK_LOCK(&buf->lock);
+                qdqueue_internal_flush(myq, buf);
+                QTHREAD_FASTLOCK_UNLOCK(&buf->lock);
             }
         }
     }
@@ -462,74 +638,82 @@ int qdqueue_enqueue_there(qdqueue_t            *q,
     return QTHREAD_SUCCESS;
 }                                      /*}}} */
 
-/* dequeue something from the queue (returns NULL for an empty queue) */
-void *qdqueue_dequeue(qdqueue_t *q)
+/* dequeue up to n things from the queue; returns how many were dequeued (0
+ * for an empty queue) */
+size_t qdqueue_dequeue_many(qdqueue_t *q,
+                            void     **elems,
+                            size_t     n)
 {                                      /*{{{ */
-    struct qdsubqueue_s *myq;
-    void                *ret;
-
-    qassert_ret((q != NULL), NULL);
+    qthread_shepherd_id_t here = 0;
+    qthread_worker_id_t   wkr;
+    struct qdsubqueue_s  *myq;
+    size_t                got;
+
+    qassert_ret((q != NULL), 0);
+    qassert_ret((elems != NULL || n == 0), 0);
+    if (n == 0) {
+        return 0;
+    }
 
-    myq = &(q->Qs[qthread_shep()]);
-    if ((ret = qlfqueue_dequeue(myq->theQ)) != NULL) {
+    wkr = qthread_worker_local(&here);
+    myq = &(q->Qs[here]);
+    if ((got = qlfqueue_dequeue_many(myq->theQ, elems, n)) > 0) {
         /* this write MUST be atomic */
         myq->last_consumed = myq;
-        return ret;
-    } else {
-        /* this write MUST be atomic */
-        myq->last_consumed = NULL;
-checkads:
-        {
-            qdqueue_adstruct_t ad;
-
-            while ((ad = qdqueue_adheap_pop(&myq->ads)).shep != NULL) {
-                struct qdsubqueue_s *lc = (struct qdsubqueue_s *)ad.shep->last_consumed;
-
-                if (lc == ad.shep) {
-                    /* it's working on its own queue */
-                    aligned_t last_ad = ad.shep->last_ad_consumed;
-
-                    while (last_ad < ad.generation) {
-                        last_ad =
-                            qthread_cas(&(ad.shep->last_ad_consumed), last_ad,
-                                        ad.generation);
-                    }
-                    if ((ret = qlfqueue_dequeue(ad.shep->theQ)) != NULL) {
-                        myq->last_consumed = ad.shep;
-                        return ret;
-                    }
-                } else if (lc != NULL) {
-                    /* it got work from somewhere! */
-                    qdqueue_adheap_push(&myq->ads, lc, 0);
-                    /* reset the remote host's last_consumed counter, to avoid infinite loops */
-                    (void)qthread_cas_ptr(&(ad.shep->last_consumed), (void *)lc, NULL);
-                }
+        return got;
+    }
+    /* this write MUST be atomic */
+    myq->last_consumed = NULL;
+    /* then whatever this worker has held back */
+    if ((wkr != NO_WORKER) && (wkr < myq->nBuffers) &&
+        ((got = qdqueue_internal_drain(myq, myq, &(myq->buffers[wkr]), elems, n)) > 0)) {
+        return got;
+    }
+    if ((got = qdqueue_internal_checkads(myq, elems, n)) > 0) {
+        return got;
+    }
+    /* then steal from the other shepherds, nearest (i.e. our neighbors) first,
+     * trying each of them once */
+    for (qthread_shepherd_id_t shep = 0; shep < (maxsheps - 1); shep++) {
+        struct qdsubqueue_s *remoteshep = myq->allsheps[shep];
+        struct qdsubqueue_s *lc         = remoteshep->last_consumed;
+
+        if ((got = qdqueue_internal_steal(myq, remoteshep, elems, n)) > 0) {
+            return got;
+        } else if ((lc != NULL) && (lc != remoteshep) && (lc != myq)) {
+            /* it got work from somewhere! */
+            if ((got = qdqueue_internal_steal(myq, lc, elems, n)) > 0) {
+                return got;
             }
         }
-        {
-            qthread_shepherd_id_t shep;
-
-            for (shep = 0; shep < (maxsheps - 1); shep++) {
-                struct qdsubqueue_s *remoteshep = myq->allsheps[shep];
-                struct qdsubqueue_s *lc         = remoteshep->last_consumed;
-
-                if ((ret = qlfqueue_dequeue(remoteshep->theQ)) != NULL) {
-                    myq->last_consumed = remoteshep;
-                    return ret;
-                } else if ((lc != NULL) && (lc != remoteshep)) {
-                    /* it got work from somewhere! */
-                    if ((ret = qlfqueue_dequeue(lc->theQ)) != NULL) {
-                        myq->last_consumed = lc;
-                        return ret;
-                    }
-                }
-                if (!qdqueue_adheap_empty(&myq->ads)) {
-                    goto checkads;
-                }
+        if (!qdqueue_adheap_empty(&myq->ads) &&
+            ((got = qdqueue_internal_checkads(myq, elems, n)) > 0)) {
+            return got;
+        }
+    }
+    /* last of all, whatever other workers have held back, so that nothing is
+     * stranded in an idle worker's buffer */
+    for (qthread_shepherd_id_t shep = 0; shep < maxsheps; shep++) {
+        struct qdsubqueue_s *remoteshep = (shep == 0) ? myq : myq->allsheps[shep - 1];
+
+        for (qthread_worker_id_t w = 0; w < remoteshep->nBuffers; w++) {
+            if ((got = qdqueue_internal_drain(myq, remoteshep, &(remoteshep->buffers[w]),
+                                              elems, n)) > 0) {
+                return got;
             }
         }
-        return NULL;
     }
+    return 0;
+}                                      /*}}} */
+
+/* dequeue something from the queue (returns NULL for an empty queue) */
+void *qdqueue_dequeue(qdqueue_t *q)
+{                                      /*{{{ */
+    void *ret;
+
+    qassert_ret((q != NULL), NULL);
+
+    return (qdqueue_dequeue_many(q, &ret, 1) == 1) ? ret : NULL;
 }                                      /*}}} */
 
 /* returns 1 if the queue is empty, 0 otherwise */
@@ -539,24 +723,20 @@ int qdqueue_empty(qdqueue_t *q)
 
     qassert_ret(q, 0);
     myq = &(q->Qs[qthread_shep()]);
-    if (!qlfqueue_empty(myq->theQ)) {
-        return 0;
-    } else {
-        qthread_shepherd_id_t shep;
+    for (qthread_shepherd_id_t shep = 0; shep < maxsheps; shep++) {
+        struct qdsubqueue_s *remoteshep = (shep == 0) ? myq : myq->allsheps[shep - 1];
 
-        for (shep = 0; shep < (maxsheps - 1); shep++) {
-            struct qdsubqueue_s *remoteshep = myq->allsheps[shep];
-
-            assert(remoteshep);
-            if (remoteshep->last_consumed == remoteshep) {
-                /* it's working on its own queue */
-                if (!qlfqueue_empty(remoteshep->theQ)) {
-                    return 0;
-                }
+        assert(remoteshep);
+        if (!qlfqueue_empty(remoteshep->theQ)) {
+            return 0;
+        }
+        for (qthread_worker_id_t w = 0; w < remoteshep->nBuffers; w++) {
+            if (remoteshep->buffers[w].count > 0) {
+                return 0;
             }
         }
-        return 1;                      /* we searched everywhere, and every queue was empty */
     }
+    return 1;                          /* we searched everywhere, and every queue was empty */
 }                                      /*}}} */
 
 /* vim:set expandtab: */
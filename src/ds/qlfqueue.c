@@ -8,6 +8,7 @@
 #include <qthread/qpool.h>
 #include "qt_hazardptrs.h"
 #include "qt_atomics.h"
+#include "qt_aligned_alloc.h"
 #include "qt_asserts.h"
 #include "qt_debug.h"                  /* for malloc debug wrappers */
 #include "qt_subsystems.h"             /* for qthread_internal_cleanup_late() */
@@ -18,9 +19,36 @@ typedef struct _qlfqueue_node {
     void *next;
 } qlfqueue_node_t;
 
+/* The ring slots pack a full-width index and a pointer into one 16-byte
+ * cmpxchg16b, which needs a 64-bit aligned_t: a narrower idx leaves padding
+ * in the compared word and puts the flag bits at bit 31. */
+#if defined(QTHREAD_ATOMIC_CAS128) && (QTHREAD_SIZEOF_ALIGNED_T == 8)
+# define QLFQ_RINGS
+#endif
+
+/* A ring slot: the index of the ticket that may use it next, with the top bit
+ * set once the slot is unsafe, and the value (NULL when empty). Both halves
+ * change together, with a 128-bit CAS. */
+typedef struct _qlfqueue_cell {
+    volatile aligned_t idx;
+    void *volatile     value;
+} Q_ALIGNED(16) qlfqueue_cell_t;
+
+typedef struct _qlfqueue_ring {
+    aligned_t              head Q_ALIGNED(CACHELINE_WIDTH);
+    aligned_t              tail Q_ALIGNED(CACHELINE_WIDTH); /* top bit: closed */
+    struct _qlfqueue_ring *next Q_ALIGNED(CACHELINE_WIDTH);
+    qlfqueue_cell_t        cells[] Q_ALIGNED(CACHELINE_WIDTH);
+} qlfqueue_ring_t;
+
 struct qlfqueue_s {             /* typedef'd to qlfqueue_t */
     qlfqueue_node_t *head;
     qlfqueue_node_t *tail;
+    /* ring_size is 0 unless the elements live in rings */
+    size_t           ring_size;
+    size_t           ring_shift;
+    qlfqueue_ring_t *rhead;
+    qlfqueue_ring_t *rtail;
 };
 
 static qpool *qlfqueue_node_pool = NULL;
@@ -67,13 +95,367 @@ qlfqueue_t *qlfqueue_create(void)
         }
         q->tail       = q->head;
         q->tail->next = NULL;
+        q->ring_size  = 0;
+        q->ring_shift = 0;
+        q->rhead      = NULL;
+        q->rtail      = NULL;
     }
     return q;
 }                                      /*}}} */
 
+#ifdef QLFQ_RINGS
+/*
+ * The ring mode is the LCRQ from
+ * http://www.cs.tau.ac.il/~mad/publications/ppopp2013-x86queues.pdf
+ * Each ring is a CRQ: enqueuers and dequeuers take tickets from tail and
+ * head with a fetch-and-add, and each ticket names one slot. A ticket that
+ * can't be used (its slot is still full, or its dequeuer got there first) is
+ * simply skipped. An enqueuer that finds its ring full, or keeps losing,
+ * closes it and starts a new one; once a closed ring is empty, dequeuers move
+ * on to the next one and free it through the hazard pointers.
+ */
+# define QLFQ_UNSAFE   ((aligned_t)1 << (sizeof(aligned_t) * 8 - 1))
+# define QLFQ_CLOSED   QLFQ_UNSAFE
+# define QLFQ_STARVING 16 /* failed tickets before an enqueuer gives up on a ring */
+# define QLFQ_RING_DEFAULT 1024
+/* consecutive tickets are spread across cache lines */
+# define QLFQ_SPREAD   (CACHELINE_WIDTH / sizeof(qlfqueue_cell_t))
+
+static QINLINE int qlfqueue_cas2(qlfqueue_cell_t *cell,
+                                 aligned_t        oidx,
+                                 void            *oval,
+                                 aligned_t        nidx,
+                                 void            *nval)
+{                                      /*{{{ */
+    char ok;
+
+    __asm__ __volatile__ ("lock; cmpxchg16b %1\n\t"
+                          "setz %0"
+                          : "=q" (ok), "+m" (*cell), "+a" (oidx), "+d" (oval)
+                          : "b" (nidx), "c" (nval)
+                          : "cc", "memory");
+    return ok;
+}                                      /*}}} */
+
+static QINLINE qlfqueue_cell_t *qlfqueue_cell(const qlfqueue_t *q,
+                                              qlfqueue_ring_t  *r,
+                                              aligned_t         t)
+{                                      /*{{{ */
+    const size_t i    = t & (q->ring_size - 1);
+    const size_t rows = q->ring_size / QLFQ_SPREAD;
+
+    return &r->cells[(i & (rows - 1)) * QLFQ_SPREAD + (i >> q->ring_shift)];
+}                                      /*}}} */
+
+static void qlfqueue_ring_free(void *r)
+{                                      /*{{{ */
+    qthread_internal_aligned_free(r, CACHELINE_WIDTH);
+}                                      /*}}} */
+
+/* a new ring, holding elem (if there is one) as its first element */
+static qlfqueue_ring_t *qlfqueue_ring_alloc(const qlfqueue_t *q,
+                                            void             *elem)
+{                                      /*{{{ */
+    qlfqueue_ring_t *r = qthread_internal_aligned_alloc(sizeof(qlfqueue_ring_t) +
+                                                        q->ring_size * sizeof(qlfqueue_cell_t),
+                                                        CACHELINE_WIDTH);
+
+    if (r == NULL) { return NULL; }
+    for (aligned_t t = 0; t < q->ring_size; t++) {
+        qlfqueue_cell_t *c = qlfqueue_cell(q, r, t);
+
+        c->idx   = t;
+        c->value = NULL;
+    }
+    r->head = 0;
+    r->tail = 0;
+    r->next = NULL;
+    if (elem) {
+        qlfqueue_cell(q, r, 0)->value = elem;
+        r->tail                       = 1;
+    }
+    return r;
+}                                      /*}}} */
+
+static void qlfqueue_ring_close(qlfqueue_ring_t *r)
+{                                      /*{{{ */
+    aligned_t t;
+
+    do {
+        t = *(volatile aligned_t *)&r->tail;
+    } while (!(t & QLFQ_CLOSED) &&
+             qthread_cas(&r->tail, t, t | QLFQ_CLOSED) != t);
+}                                      /*}}} */
+
+/* after dequeuers overshoot, pull tail up so enqueuers skip their tickets */
+static void qlfqueue_ring_fix(qlfqueue_ring_t *r)
+{                                      /*{{{ */
+    while (1) {
+        const aligned_t t = *(volatile aligned_t *)&r->tail;
+        const aligned_t h = *(volatile aligned_t *)&r->head;
+
+        if (*(volatile aligned_t *)&r->tail != t) { continue; }
+        if (h <= (t & ~QLFQ_CLOSED)) { return; }
+        if (qthread_cas(&r->tail, t, h | (t & QLFQ_CLOSED)) == t) { return; }
+    }
+}                                      /*}}} */
+
+/* try to put elem in ticket t's slot; each ticket gets one try */
+static QINLINE int qlfqueue_ring_put(const qlfqueue_t *q,
+                                     qlfqueue_ring_t  *r,
+                                     aligned_t         t,
+                                     void             *elem)
+{                                      /*{{{ */
+    qlfqueue_cell_t *c   = qlfqueue_cell(q, r, t);
+    const aligned_t  idx = c->idx;
+
+    return c->value == NULL && (idx & ~QLFQ_UNSAFE) <= t &&
+           (!(idx & QLFQ_UNSAFE) || *(volatile aligned_t *)&r->head <= t) &&
+           qlfqueue_cas2(c, idx, NULL, t, elem);
+}                                      /*}}} */
+
+/* take ticket h's element, or spoil the slot so nobody can put it there */
+static QINLINE void *qlfqueue_ring_take(const qlfqueue_t *q,
+                                        qlfqueue_ring_t  *r,
+                                        aligned_t         h)
+{                                      /*{{{ */
+    qlfqueue_cell_t *c = qlfqueue_cell(q, r, h);
+
+    while (1) {
+        const aligned_t idx    = c->idx;
+        void *const     val    = c->value;
+        const aligned_t unsafe = idx & QLFQ_UNSAFE;
+
+        if ((idx & ~QLFQ_UNSAFE) > h) { return NULL; }
+        if (val != NULL) {
+            if ((idx & ~QLFQ_UNSAFE) == h) {
+                if (qlfqueue_cas2(c, idx, val, unsafe | (h + q->ring_size), NULL)) { return val; }
+            } else if (qlfqueue_cas2(c, idx, val, idx | QLFQ_UNSAFE, val)) {
+                /* an older ticket's element is still here; mark the slot so
+                 * that later enqueuers only use it once head has caught up */
+                return NULL;
+            }
+        } else if (qlfqueue_cas2(c, idx, NULL, unsafe | (h + q->ring_size), NULL)) {
+            return NULL;
+        }
+    }
+}                                      /*}}} */
+
+/* returns 0 if the ring is closed */
+static int qlfqueue_ring_enqueue(const qlfqueue_t *q,
+                                 qlfqueue_ring_t  *r,
+                                 void             *elem)
+{                                      /*{{{ */
+    for (int tries = 0;; tries++) {
+        const aligned_t t = qthread_incr(&r->tail, 1);
+
+        if (t & QLFQ_CLOSED) { return 0; }
+        if (qlfqueue_ring_put(q, r, t, elem)) { return 1; }
+        if ((saligned_t)(t - *(volatile aligned_t *)&r->head) >= (saligned_t)q->ring_size ||
+            tries >= QLFQ_STARVING) {
+            qlfqueue_ring_close(r);
+            return 0;
+        }
+    }
+}                                      /*}}} */
+
+static void *qlfqueue_ring_dequeue(const qlfqueue_t *q,
+                                   qlfqueue_ring_t  *r)
+{                                      /*{{{ */
+    while (1) {
+        const aligned_t h = qthread_incr(&r->head, 1);
+        void           *p = qlfqueue_ring_take(q, r, h);
+
+        if (p) { return p; }
+        if ((*(volatile aligned_t *)&r->tail & ~QLFQ_CLOSED) <= h + 1) {
+            qlfqueue_ring_fix(r);
+            return NULL;
+        }
+    }
+}                                      /*}}} */
+
+/* the ring tail points to, with a hazard pointer on it */
+static qlfqueue_ring_t *qlfqueue_ring_last(qlfqueue_t *q)
+{                                      /*{{{ */
+    while (1) {
+        qlfqueue_ring_t *r = q->rtail;
+
+        hazardous_ptr(0, r);
+        if (r != *(qlfqueue_ring_t *volatile *)&q->rtail) { continue; }
+        if (r->next != NULL) {
+            (void)qthread_cas_ptr((void **)&q->rtail, r, r->next);
+            continue;
+        }
+        return r;
+    }
+}                                      /*}}} */
+
+static int qlfqueue_ring_append(qlfqueue_t *q,
+                                void       *elem)
+{                                      /*{{{ */
+    while (1) {
+        qlfqueue_ring_t *r = qlfqueue_ring_last(q);
+        qlfqueue_ring_t *nr;
+
+        if (qlfqueue_ring_enqueue(q, r, elem)) { break; }
+        nr = qlfqueue_ring_alloc(q, elem);
+        if (nr == NULL) {
+            hazardous_ptr(0, NULL);
+            return QTHREAD_MALLOC_ERROR;
+        }
+        if (qthread_cas_ptr((void **)&r->next, NULL, nr) == NULL) {
+            (void)qthread_cas_ptr((void **)&q->rtail, r, nr);
+            break;
+        }
+        qlfqueue_ring_free(nr);
+    }
+    hazardous_ptr(0, NULL);
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+static int qlfqueue_ring_append_many(qlfqueue_t  *q,
+                                     void *const *elems,
+                                     size_t       n)
+{                                      /*{{{ */
+    while (n > 0) {
+        qlfqueue_ring_t *r = qlfqueue_ring_last(q);
+        const size_t     k = (n < q->ring_size) ? n : q->ring_size;
+        const aligned_t  t = qthread_incr(&r->tail, k);
+        size_t           i = 0;
+
+        /* once a ticket fails, the rest of the batch would land ahead of it,
+         * so skip them and go one at a time */
+        if (!(t & QLFQ_CLOSED)) {
+            while (i < k && qlfqueue_ring_put(q, r, t + i, elems[i])) i++;
+        }
+        hazardous_ptr(0, NULL);
+        elems += i;
+        n     -= i;
+        if (i < k && n > 0) {
+            int ret = qlfqueue_ring_append(q, elems[0]);
+
+            if (ret != QTHREAD_SUCCESS) { return ret; }
+            elems++;
+            n--;
+        }
+    }
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+/* the ring head points to, with a hazard pointer on it; NULL if it's empty
+ * and there's no other ring to move on to */
+static void *qlfqueue_ring_remove(qlfqueue_t *q)
+{                                      /*{{{ */
+    void *p;
+
+    while (1) {
+        qlfqueue_ring_t *r = q->rhead;
+        qlfqueue_ring_t *next;
+
+        hazardous_ptr(0, r);
+        if (r != *(qlfqueue_ring_t *volatile *)&q->rhead) { continue; }
+        if ((p = qlfqueue_ring_dequeue(q, r)) != NULL) { break; }
+        if ((next = r->next) == NULL) { break; }
+        /* it's closed; anything still going in went in before we looked */
+        if ((p = qlfqueue_ring_dequeue(q, r)) != NULL) { break; }
+        /* don't leave tail pointing at a ring that's about to be freed */
+        (void)qthread_cas_ptr((void **)&q->rtail, r, next);
+        if (qthread_cas_ptr((void **)&q->rhead, r, next) == r) {
+            hazardous_ptr(0, NULL);
+            hazardous_release_node(qlfqueue_ring_free, r);
+        }
+    }
+    hazardous_ptr(0, NULL);
+    return p;
+}                                      /*}}} */
+
+static size_t qlfqueue_ring_remove_many(qlfqueue_t *q,
+                                        void      **elems,
+                                        size_t      n)
+{                                      /*{{{ */
+    qlfqueue_ring_t *r;
+    size_t           got = 0, k;
+    aligned_t        h, t;
+
+    do {
+        r = q->rhead;
+        hazardous_ptr(0, r);
+    } while (r != *(qlfqueue_ring_t *volatile *)&q->rhead);
+
+    /* only claim as many tickets as there seem to be elements */
+    h = *(volatile aligned_t *)&r->head;
+    t = *(volatile aligned_t *)&r->tail & ~QLFQ_CLOSED;
+    k = (t > h) ? t - h : 0;
+    if (k > n) { k = n; }
+    if (k > 1) {
+        h = qthread_incr(&r->head, k);
+        for (size_t i = 0; i < k; i++) {
+            void *p = qlfqueue_ring_take(q, r, h + i);
+
+            if (p) { elems[got++] = p; }
+        }
+        if (got < k) { qlfqueue_ring_fix(r); }
+    }
+    hazardous_ptr(0, NULL);
+    /* top up one at a time, which also moves on to the next ring */
+    while (got < n) {
+        void *p = qlfqueue_ring_remove(q);
+
+        if (p == NULL) { break; }
+        elems[got++] = p;
+    }
+    return got;
+}                                      /*}}} */
+
+static int qlfqueue_ring_empty(qlfqueue_t *q)
+{                                      /*{{{ */
+    qlfqueue_ring_t *r;
+    int              ret;
+
+    do {
+        r = q->rhead;
+        hazardous_ptr(0, r);
+    } while (r != *(qlfqueue_ring_t *volatile *)&q->rhead);
+    ret = (*(volatile aligned_t *)&r->head >= (*(volatile aligned_t *)&r->tail & ~QLFQ_CLOSED)) &&
+          r->next == NULL;
+    hazardous_ptr(0, NULL);
+    return ret;
+}                                      /*}}} */
+
+#endif /* ifdef QLFQ_RINGS */
+
+qlfqueue_t *qlfqueue_create_ring(size_t ring_size)
+{                                      /*{{{ */
+    qlfqueue_t *q = qlfqueue_create();
+
+#ifdef QLFQ_RINGS
+    if (q == NULL) { return NULL; }
+    if (ring_size == 0) { ring_size = QLFQ_RING_DEFAULT; }
+    if (ring_size < QLFQ_SPREAD) { ring_size = QLFQ_SPREAD; }
+    /* a power of two rows of QLFQ_SPREAD slots */
+    while (((size_t)1 << q->ring_shift) < ring_size / QLFQ_SPREAD) q->ring_shift++;
+    q->ring_size = QLFQ_SPREAD << q->ring_shift;
+    q->rhead     = q->rtail = qlfqueue_ring_alloc(q, NULL);
+    if (q->rhead == NULL) {
+        q->ring_size = 0;
+        qlfqueue_destroy(q);
+        return NULL;
+    }
+#endif /* ifdef QLFQ_RINGS */
+    return q;
+}                                      /*}}} */
+
 int qlfqueue_destroy(qlfqueue_t *q)
 {                                      /*{{{ */
     qassert_ret((q != NULL), QTHREAD_BADARGS);
+#ifdef QLFQ_RINGS
+    while (q->rhead != NULL) {
+        qlfqueue_ring_t *next = q->rhead->next;
+
+        qlfqueue_ring_free(q->rhead);
+        q->rhead = next;
+    }
+#endif
     while (q->head != q->tail) {
         qlfqueue_dequeue(q);
         COMPILER_FENCE;
@@ -93,6 +475,9 @@ int qlfqueue_enqueue(qlfqueue_t *q,
 
     qassert_ret((elem != NULL), QTHREAD_BADARGS);
     qassert_ret((q != NULL), QTHREAD_BADARGS);
+#ifdef QLFQ_RINGS
+    if (q->ring_size) { return qlfqueue_ring_append(q, elem); }
+#endif
 
     node = (qlfqueue_node_t *)qpool_alloc(qlfqueue_node_pool);
     /* these asserts should be redundant */
@@ -135,6 +520,9 @@ void *qlfqueue_dequeue(qlfqueue_t *q)
     qlfqueue_node_t *next_ptr;
 
     qassert_ret((q != NULL), NULL);
+#ifdef QLFQ_RINGS
+    if (q->ring_size) { return qlfqueue_ring_remove(q); }
+#endif
     while (1) {
         head = q->head;
 
@@ -162,6 +550,75 @@ void *qlfqueue_dequeue(qlfqueue_t *q)
     return p;
 }                                      /*}}} */
 
+int qlfqueue_enqueue_many(qlfqueue_t  *q,
+                          void *const *elems,
+                          size_t       n)
+{                                      /*{{{ */
+    qlfqueue_node_t *first = NULL, *last = NULL;
+    qlfqueue_node_t *tail;
+
+    qassert_ret((q != NULL), QTHREAD_BADARGS);
+    qassert_ret((elems != NULL || n == 0), QTHREAD_BADARGS);
+    if (n == 0) { return QTHREAD_SUCCESS; }
+
+    for (size_t i = 0; i < n; i++) {
+        qassert_ret((elems[i] != NULL), QTHREAD_BADARGS);
+    }
+#ifdef QLFQ_RINGS
+    if (q->ring_size) { return qlfqueue_ring_append_many(q, elems, n); }
+#endif
+
+    /* build the chain privately, then link it in with one CAS */
+    for (size_t i = 0; i < n; i++) {
+        qlfqueue_node_t *node = (qlfqueue_node_t *)qpool_alloc(qlfqueue_node_pool);
+
+        qassert_ret((node != NULL), QTHREAD_MALLOC_ERROR);
+        node->value = elems[i];
+        node->next  = NULL;
+        if (last) {
+            last->next = node;
+        } else {
+            first = node;
+        }
+        last = node;
+    }
+    while (1) {
+        qlfqueue_node_t *next;
+
+        tail = q->tail;
+
+        hazardous_ptr(0, tail);
+        if (tail != q->tail) { continue; }
+
+        next = tail->next;
+        if (next != NULL) {
+            (void)qthread_cas_ptr((void **)&(q->tail), (void *)tail, next);
+            continue;
+        }
+        if (qthread_cas_ptr((void **)&(tail->next), NULL, first) == NULL) {
+            break;
+        }
+    }
+    (void)qthread_cas_ptr((void **)&(q->tail), (void *)tail, last);
+    hazardous_ptr(0, NULL);
+    return QTHREAD_SUCCESS;
+}                                      /*}}} */
+
+size_t qlfqueue_dequeue_many(qlfqueue_t *q,
+                             void      **elems,
+                             size_t      n)
+{                                      /*{{{ */
+    size_t got = 0;
+
+    qassert_ret((q != NULL), 0);
+    qassert_ret((elems != NULL || n == 0), 0);
+#ifdef QLFQ_RINGS
+    if (q->ring_size) { return qlfqueue_ring_remove_many(q, elems, n); }
+#endif
+    while (got < n && (elems[got] = qlfqueue_dequeue(q)) != NULL) got++;
+    return got;
+}                                      /*}}} */
+
 int qlfqueue_empty(qlfqueue_t *q)
 {                                      /*{{{ */
     qlfqueue_node_t *head;
@@ -169,6 +626,9 @@ int qlfqueue_empty(qlfqueue_t *q)
     qlfqueue_node_t *next;
 
     qassert_ret((q != NULL), QTHREAD_BADARGS);
+#ifdef QLFQ_RINGS
+    if (q->ring_size) { return qlfqueue_ring_empty(q); }
+#endif
 
     while (1) {
         head = q->head;
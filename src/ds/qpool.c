@@ -14,25 +14,40 @@
 
 #ifdef UNPOOLED
 struct qt_mpool_s {
-    size_t size;
-    size_t alignment;
+    size_t       size;
+    size_t       alignment;
+    qpool_hook_f ctor;
+    qpool_hook_f dtor;
+    void        *arg;
 };
 #endif
 
-qpool *qpool_create_aligned(const size_t isize,
-                            size_t       alignment)
+qpool *qpool_create_with_hooks(const size_t isize,
+                               const size_t alignment,
+                               qpool_hook_f ctor,
+                               qpool_hook_f dtor,
+                               void        *arg)
 {                                      /*{{{ */
 #ifdef UNPOOLED
     qpool *ret = MALLOC(sizeof(struct qt_mpool_s));
     assert(ret);
     ret->size = isize;
     ret->alignment = alignment;
+    ret->ctor = ctor;
+    ret->dtor = dtor;
+    ret->arg = arg;
     return ret;
 #else
-    return qt_mpool_create_aligned(isize, alignment);
+    return qt_mpool_create_hooked(isize, alignment, ctor, dtor, arg);
 #endif
 }                                      /*}}} */
 
+qpool *qpool_create_aligned(const size_t isize,
+                            size_t       alignment)
+{                                      /*{{{ */
+    return qpool_create_with_hooks(isize, alignment, NULL, NULL, NULL);
+}                                      /*}}} */
+
 qpool *qpool_create(const size_t item_size)
 {                                      /*{{{ */
     return qpool_create_aligned(item_size, 0);
@@ -41,7 +56,11 @@ qpool *qpool_create(const size_t item_size)
 void *qpool_alloc(qpool *pool)
 {
 #ifdef UNPOOLED
-    return MALLOC(pool->size);
+    void *ret = MALLOC(pool->size);
+    if (ret && pool->ctor) {
+        pool->ctor(ret, pool->arg);
+    }
+    return ret;
 #else
     return qt_mpool_alloc(pool);
 #endif
@@ -51,12 +70,45 @@ void qpool_free(qpool *restrict pool,
                 void *restrict  mem)
 {
 #ifdef UNPOOLED
+    if (pool->dtor) {
+        pool->dtor(mem, pool->arg);
+    }
     FREE(mem, pool->size);
 #else
     qt_mpool_free(pool, mem);
 #endif
 }
 
+size_t qpool_alloc_bulk(qpool *restrict pool,
+                        void **restrict ptrs,
+                        size_t          n)
+{
+#ifdef UNPOOLED
+    size_t i;
+    for (i = 0; i < n; ++i) {
+        if ((ptrs[i] = qpool_alloc(pool)) == NULL) {
+            break;
+        }
+    }
+    return i;
+#else
+    return qt_mpool_alloc_bulk(pool, ptrs, n);
+#endif
+}
+
+void qpool_free_bulk(qpool *restrict       pool,
+                     void *const *restrict ptrs,
+                     size_t                n)
+{
+#ifdef UNPOOLED
+    for (size_t i = 0; i < n; ++i) {
+        qpool_free(pool, ptrs[i]);
+    }
+#else
+    qt_mpool_free_bulk(pool, ptrs, n);
+#endif
+}
+
 void qpool_destroy(qpool *pool)
 {
 #ifdef UNPOOLED
@@ -8,38 +8,55 @@
 
 /* Internal Headers */
 #include "qt_asserts.h"
+#include "qt_atomics.h"
 #include "qt_aligned_alloc.h"          /* for aligned alloc */
 
-/* queue declarations */
+/* head and tail count up forever, and are masked to find a slot, so a full
+ * ring doesn't waste a slot telling itself apart from an empty one. Each side
+ * keeps its own copy of the other side's index, and only rereads the real one
+ * when that copy says there's no room (or nothing) left, so the two sides
+ * mostly stay off of each other's cache lines. */
 struct qswsrqueue_s {             /* typedef'd to qswsrqueue_t */
-    uint32_t head;
-    uint32_t size;
-    uint8_t  pad[CACHELINE_WIDTH - (2 * sizeof(uint32_t))];
-    uint32_t tail;
-    uint32_t size2;
-    uint8_t  pad2[CACHELINE_WIDTH - (2 * sizeof(uint32_t))];
-    void    *elements[];
+    /* the consumer's */
+    uint32_t  head;
+    uint32_t  tail_cache;
+    uint32_t  mask;
+    uint8_t   pad[CACHELINE_WIDTH - (3 * sizeof(uint32_t))];
+    /* the producer's */
+    uint32_t  tail;
+    uint32_t  head_cache;
+    uint32_t  mask2;
+    uint8_t   pad2[CACHELINE_WIDTH - (3 * sizeof(uint32_t))];
+    /* only written by a side that's about to suspend, or just has */
+    uint32_t  consumer_waiting;
+    uint32_t  producer_waiting;
+    aligned_t consumer_wake;
+    aligned_t producer_wake;
+    uint8_t   pad3[CACHELINE_WIDTH - (2 * sizeof(uint32_t)) - (2 * sizeof(aligned_t))];
+    void     *elements[];
 };
 
+#define READ_INDEX(x) (*(volatile uint32_t *)&(x))
+
 qswsrqueue_t *qswsrqueue_create(size_t elements)
 {                                      /*{{{ */
     qswsrqueue_t *q;
+    size_t        size = CACHELINE_WIDTH / sizeof(void *);
 
-    if ((elements * sizeof(void *)) < CACHELINE_WIDTH) {
-        elements = CACHELINE_WIDTH / sizeof(void *);
-    }
-    if (elements % CACHELINE_WIDTH) {
-        elements += CACHELINE_WIDTH - (elements % CACHELINE_WIDTH);
-    }
-    if (elements > UINT32_MAX) {
+    if (elements > ((size_t)1 << 31)) {
         return NULL;
     }
-    q = qthread_internal_aligned_alloc(sizeof(struct qswsrqueue_s) + (elements * sizeof(void *)), CACHELINE_WIDTH);
+    while (size < elements) size <<= 1;
+    q = qthread_internal_aligned_alloc(sizeof(struct qswsrqueue_s) + (size * sizeof(void *)), CACHELINE_WIDTH);
     if (q != NULL) {
-        q->head  = 0;
-        q->size  = elements;
-        q->tail  = 0;
-        q->size2 = elements;
+        q->head             = 0;
+        q->tail_cache       = 0;
+        q->mask             = size - 1;
+        q->tail             = 0;
+        q->head_cache       = 0;
+        q->mask2            = size - 1;
+        q->consumer_waiting = 0;
+        q->producer_waiting = 0;
     }
     return q;
 }                                      /*}}} */
@@ -47,77 +64,134 @@ qswsrqueue_t *qswsrqueue_create(size_t elements)
 int qswsrqueue_destroy(qswsrqueue_t *q)
 {                                      /*{{{ */
     qassert_ret((q != NULL), QTHREAD_BADARGS);
-    qthread_internal_aligned_free(q, sizeof(struct qswsrqueue_s) + (q->size * sizeof(void *)));
+    /* full words drop their FEB entries before the memory goes away */
+    qthread_fill(&q->consumer_wake);
+    qthread_fill(&q->producer_wake);
+    qthread_internal_aligned_free(q, CACHELINE_WIDTH);
     return QTHREAD_SUCCESS;
 }                                      /*}}} */
 
-int qswsrqueue_enqueue(qswsrqueue_t *q,
-                       void         *elem)
+/* Called after moving an index. The fence pairs with the one in
+ * qswsrqueue_suspend(): either the other side sees the new index before it
+ * sleeps, or we see that it's sleeping. */
+static QINLINE void qswsrqueue_wake(uint32_t  *waiting,
+                                    aligned_t *wake)
+{                                      /*{{{ */
+    MACHINE_FENCE;
+    if (READ_INDEX(*waiting)) {
+        qthread_fill(wake);
+    }
+}                                      /*}}} */
+
+/* Waits until idx moves away from stuck. Whoever moves idx calls
+ * qswsrqueue_wake(). */
+static void qswsrqueue_suspend(uint32_t       *waiting,
+                               aligned_t      *wake,
+                               const uint32_t *idx,
+                               uint32_t        stuck)
 {                                      /*{{{ */
-    uint32_t cur_tail  = q->tail;
-    uint32_t next_tail = (cur_tail + 1) % q->size;
-    COMPILER_FENCE;
-    if (next_tail != q->head) {
-        q->elements[cur_tail] = elem;
-        MACHINE_FENCE;
-        q->tail = next_tail;
-        return QTHREAD_SUCCESS;
+    qthread_empty(wake);
+    *(volatile uint32_t *)waiting = 1;
+    MACHINE_FENCE;
+    if (READ_INDEX(*idx) == stuck) {
+        qthread_readFF(NULL, wake);
     } else {
-        return QTHREAD_OPFAIL;
+        /* didn't sleep; don't leave the word empty behind us */
+        qthread_fill(wake);
     }
+    *(volatile uint32_t *)waiting = 0;
 }                                      /*}}} */
 
-int qswsrqueue_enqueue_blocking(qswsrqueue_t *q,
+size_t qswsrqueue_enqueue_many(qswsrqueue_t *q,
+                               void *const  *elems,
+                               size_t        n)
+{                                      /*{{{ */
+    uint32_t tail, size;
+
+    qassert_ret((q != NULL), 0);
+    tail = q->tail;
+    size = q->mask2 + 1;
+    if (size - (tail - q->head_cache) < n) {
+        q->head_cache = READ_INDEX(q->head);
+    }
+    if (n > size - (tail - q->head_cache)) {
+        n = size - (tail - q->head_cache);
+    }
+    if (n == 0) { return 0; }
+    for (uint32_t i = 0; i < n; i++) {
+        q->elements[(tail + i) & q->mask2] = elems[i];
+    }
+    MACHINE_FENCE;
+    *(volatile uint32_t *)&q->tail = tail + n;
+    qswsrqueue_wake(&q->consumer_waiting, &q->consumer_wake);
+    return n;
+}                                      /*}}} */
+
+size_t qswsrqueue_dequeue_many(qswsrqueue_t *q,
+                               void        **elems,
+                               size_t        n)
+{                                      /*{{{ */
+    uint32_t head;
+
+    qassert_ret((q != NULL), 0);
+    head = q->head;
+    if (q->tail_cache - head < n) {
+        q->tail_cache = READ_INDEX(q->tail);
+    }
+    if (n > q->tail_cache - head) {
+        n = q->tail_cache - head;
+    }
+    if (n == 0) { return 0; }
+    for (uint32_t i = 0; i < n; i++) {
+        elems[i] = q->elements[(head + i) & q->mask];
+    }
+    /* the slots mustn't be reused until we've read them */
+    MACHINE_FENCE;
+    *(volatile uint32_t *)&q->head = head + n;
+    qswsrqueue_wake(&q->producer_waiting, &q->producer_wake);
+    return n;
+}                                      /*}}} */
+
+int qswsrqueue_enqueue(qswsrqueue_t *q,
                        void         *elem)
 {                                      /*{{{ */
-    uint32_t cur_tail  = q->tail;
-    uint32_t next_tail = (cur_tail + 1) % q->size2;
-    do {
-        while (next_tail == q->head) qthread_yield();
-        COMPILER_FENCE;
-        if (next_tail != q->head) {
-            q->elements[cur_tail] = elem;
-            MACHINE_FENCE;
-            q->tail = next_tail;
-            return QTHREAD_SUCCESS;
-        }
-    } while (1);
+    return qswsrqueue_enqueue_many(q, &elem, 1) ? QTHREAD_SUCCESS : QTHREAD_OPFAIL;
+}                                      /*}}} */
+
+int qswsrqueue_enqueue_blocking(qswsrqueue_t *q,
+                                void         *elem)
+{                                      /*{{{ */
+    qassert_ret((q != NULL), QTHREAD_BADARGS);
+    while (qswsrqueue_enqueue_many(q, &elem, 1) == 0) {
+        qswsrqueue_suspend(&q->producer_waiting, &q->producer_wake,
+                           &q->head, q->tail - (q->mask2 + 1));
+    }
+    return QTHREAD_SUCCESS;
 }                                      /*}}} */
 
 void *qswsrqueue_dequeue(qswsrqueue_t *q)
 {                                      /*{{{ */
     void *item;
-    uint32_t cur_head = q->head;
-    COMPILER_FENCE;
-    if (cur_head == q->tail)
-        return NULL;
-    item = q->elements[cur_head];
-    COMPILER_FENCE; // MIGHT need to be a MACHINE_FENCE, but I don't think so
-    q->head = (cur_head + 1) % q->size;
-    return item;
+
+    return qswsrqueue_dequeue_many(q, &item, 1) ? item : NULL;
 }                                      /*}}} */
 
 void *qswsrqueue_dequeue_blocking(qswsrqueue_t *q)
 {                                      /*{{{ */
     void *item;
-    uint32_t cur_head = q->head;
-    uint32_t next_head = (cur_head + 1) % q->size;
-    do {
-        while (next_head == q->tail) qthread_yield();
-        COMPILER_FENCE;
-        if (next_head != q->tail) {
-            item = q->elements[cur_head];
-            COMPILER_FENCE;
-            q->head = next_head;
-            return item;
-        }
-    } while (1);
+
+    qassert_ret((q != NULL), NULL);
+    while (qswsrqueue_dequeue_many(q, &item, 1) == 0) {
+        qswsrqueue_suspend(&q->consumer_waiting, &q->consumer_wake,
+                           &q->tail, q->head);
+    }
+    return item;
 }                                      /*}}} */
 
 /* returns 1 if the queue is empty, 0 otherwise */
 int qswsrqueue_empty(qswsrqueue_t *q)
 {                                      /*{{{ */
-    return (q->head == q->tail);
+    return (READ_INDEX(q->head) == READ_INDEX(q->tail));
 }                                      /*}}} */
 
 /* vim:set expandtab: */
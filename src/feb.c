@@ -140,9 +140,11 @@ void INTERNAL qt_feb_subsystem_init(uint_fast8_t need_sync)
 {
 #if !defined(UNPOOLED_ADDRSTAT) && !defined(UNPOOLED)
     generic_addrstat_pool = qt_mpool_create(sizeof(qthread_addrstat_t));
+    qt_mpool_set_name(generic_addrstat_pool, "addrstats");
 #endif
 #if !defined(UNPOOLED_ADDRRES) && !defined(UNPOOLED)
     generic_addrres_pool = qt_mpool_create(sizeof(qthread_addrres_t));
+    qt_mpool_set_name(generic_addrres_pool, "addrres");
 #endif
     FEBs = MALLOC(sizeof(qt_hash) * QTHREAD_LOCKING_STRIPES);
     assert(FEBs);
@@ -1426,17 +1428,9 @@ static filter_code qt_feb_tf_call_cb(const qt_key_t            addr,
     void             *tls;
 
     if (waiter->rdata->tasklocal_size <= qlib->qthread_tasklocal_size) {
-        if (waiter->flags & QTHREAD_BIG_STRUCT) {
-            tls = &waiter->data[qlib->qthread_argcopy_size];
-        } else {
-            tls = waiter->data;
-        }
+        tls = waiter->data;
     } else {
-        if (waiter->flags & QTHREAD_BIG_STRUCT) {
-            tls = *(void **)&waiter->data[qlib->qthread_argcopy_size];
-        } else {
-            tls = *(void **)&waiter->data[0];
-        }
+        tls = *(void **)&waiter->data[0];
     }
     f((void *)addr, waiter->f, waiter->arg, waiter->ret, waiter->thread_id, tls, f_arg);
     return IGNORE_AND_CONTINUE;
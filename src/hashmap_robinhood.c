@@ -0,0 +1,383 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdlib.h>
+#include <string.h>
+
+/* Internal Headers */
+#include "qt_visibility.h"
+#include "qt_hash.h"
+#include "qt_asserts.h"
+#include "qt_atomics.h"
+#include "qthread/cacheline.h"
+#include "qt_aligned_alloc.h"
+#include "qt_debug.h"
+
+/*
+ * A Robin Hood hash table: open addressing with linear probing, where an
+ * insert that meets an entry closer to its home slot than the one being
+ * inserted swaps them and carries on with the displaced one. That keeps every
+ * probe sequence short and sorted by distance, so a lookup can stop as soon as
+ * it sees an entry that is closer to home than it would be, and a delete can
+ * shift the rest of the run back one slot instead of leaving a tombstone.
+ *
+ * Each slot's distance from home (plus one; zero means empty) lives in a byte
+ * array beside the entries, so most misses are answered from the distances
+ * alone, and only a slot at exactly the right distance has its key compared.
+ * Since emptiness is kept in the distances, every key value, including 0, is
+ * an ordinary key.
+ *
+ * The keys are almost always addresses, so rather than qt_hash64() this uses
+ * Fibonacci hashing (a multiply, keeping the top bits), which is a couple of
+ * instructions and spreads aligned pointers well; Robin Hood probing copes
+ * with what clustering is left.
+ */
+
+typedef struct {
+    qt_key_t key;
+    void    *value;
+} hash_entry;
+
+struct qt_hash_s {
+    QTHREAD_FASTLOCK_TYPE *lock;
+    hash_entry            *entries;
+    uint8_t               *dist;
+    size_t                 mask;
+    unsigned int           shift;
+    size_t                 population;
+    size_t                 grow_size, shrink_size; // cache for speed
+};
+
+static size_t linesize    = 0;
+static size_t min_entries = 0;
+
+#define MAX_DIST    UINT8_MAX
+#define HOME(h, k)  ((size_t)(((uint64_t)(uintptr_t)(k) * 0x9e3779b97f4a7c15ULL) >> (h)->shift))
+#define NEXT(h, i)  (((i) + 1) & (h)->mask)
+
+static void qt_hash_internal_create(qt_hash h,
+                                    size_t  entries)
+{   /*{{{*/
+    size_t       z    = min_entries;
+    unsigned int bits = 0;
+
+    while (z < entries) z <<= 1;
+    while (((size_t)1 << bits) < z) ++bits;
+    /* one allocation: the entries, then their distances */
+    h->entries = qthread_internal_aligned_alloc(z * (sizeof(hash_entry) + 1), linesize);
+    assert(h->entries);
+    h->dist = (uint8_t *)(h->entries + z);
+    memset(h->dist, 0, z);
+    h->mask        = z - 1;
+    h->shift       = 64 - bits;
+    h->population  = 0;
+    h->grow_size   = z - z / 8;
+    h->shrink_size = (z == min_entries) ? 0 : z / 8;
+} /*}}}*/
+
+static inline hash_entry *qt_hash_internal_find(qt_hash  h,
+                                                qt_key_t key,
+                                                size_t  *where)
+{   /*{{{*/
+    const hash_entry *z = h->entries;
+    const uint8_t    *d = h->dist;
+    size_t            i = HOME(h, key);
+
+    for (unsigned int dist = 1;; ++dist, i = NEXT(h, i)) {
+        if (d[i] < dist) {
+            /* empty, or this entry is closer to home than key would be */
+            return NULL;
+        }
+        if ((d[i] == dist) && (z[i].key == key)) {
+            if (where) { *where = i; }
+            return (hash_entry *)&z[i];
+        }
+    }
+} /*}}}*/
+
+/* Puts *e in the table, starting from slot i at distance dist, which has to
+ * be where it belongs. Returns 0 if some probe would get too long to record;
+ * *e is then whichever entry was left without a slot, and the table is
+ * otherwise intact. */
+static int qt_hash_internal_place(qt_hash     h,
+                                  hash_entry *e,
+                                  size_t      i,
+                                  unsigned    dist)
+{   /*{{{*/
+    hash_entry *z = h->entries;
+    uint8_t    *d = h->dist;
+
+    for (;; ++dist, i = NEXT(h, i)) {
+        if (dist == MAX_DIST) { return 0; }
+        if (d[i] == 0) {
+            z[i] = *e;
+            d[i] = dist;
+            return 1;
+        }
+        if (d[i] < dist) {
+            /* take from the rich: the resident is closer to home than we are */
+            hash_entry tmp = z[i];
+            unsigned   td  = d[i];
+
+            z[i] = *e;
+            d[i] = dist;
+            *e   = tmp;
+            dist = td;
+        }
+    }
+} /*}}}*/
+
+static QINLINE int qt_hash_internal_insert(qt_hash     h,
+                                           hash_entry *e)
+{   /*{{{*/
+    return qt_hash_internal_place(h, e, HOME(h, e->key), 1);
+} /*}}}*/
+
+static void qt_hash_internal_resize(qt_hash h,
+                                    size_t  len)
+{   /*{{{*/
+    hash_entry *oz   = h->entries;
+    uint8_t    *od   = h->dist;
+    size_t      olen = h->mask + 1;
+    size_t      pop  = h->population;
+
+    qthread_debug(CORE_DETAILS, "h=%p: %lu entries -> %lu\n", h, (unsigned long)olen, (unsigned long)len);
+    qt_hash_internal_create(h, len);
+    for (size_t i = 0; i < olen; ++i) {
+        hash_entry e = oz[i];
+
+        if (od[i] == 0) { continue; }
+        if (!qt_hash_internal_insert(h, &e)) {
+            /* absurdly clustered hash values; try again bigger */
+            qthread_internal_aligned_free(h->entries, linesize);
+            h->entries    = oz;
+            h->dist       = od;
+            h->mask       = olen - 1;
+            h->population = pop;
+            qt_hash_internal_resize(h, len * 2);
+            return;
+        }
+    }
+    h->population = pop;
+    FREE_SCRIBBLE(oz, olen * (sizeof(hash_entry) + 1));
+    qthread_internal_aligned_free(oz, linesize);
+} /*}}}*/
+
+void INTERNAL qt_hash_initialize_subsystem(void)
+{   /*{{{*/
+    linesize    = qthread_cacheline();
+    min_entries = pagesize / sizeof(hash_entry);
+} /*}}}*/
+
+qt_hash INTERNAL qt_hash_create(int needSync)
+{   /*{{{*/
+    qt_hash ret = calloc(1, sizeof(struct qt_hash_s));
+
+    if (ret) {
+        if (needSync) {
+            ret->lock = MALLOC(sizeof(QTHREAD_FASTLOCK_TYPE));
+            QTHREAD_FASTLOCK_INIT_PTR(ret->lock);
+        } else {
+            ret->lock = NULL;
+        }
+        qt_hash_internal_create(ret, min_entries);
+    }
+    return ret;
+} /*}}}*/
+
+void INTERNAL qt_hash_destroy(qt_hash h)
+{   /*{{{*/
+    assert(h);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_DESTROY_PTR(h->lock);
+        FREE((void *)h->lock, sizeof(QTHREAD_FASTLOCK_TYPE));
+    }
+    assert(h->entries);
+    qthread_internal_aligned_free(h->entries, linesize);
+    FREE(h, sizeof(struct qt_hash_s));
+} /*}}}*/
+
+/* This function destroys the hash and applies the given deallocator function
+ * to each value stored in the hash */
+void INTERNAL qt_hash_destroy_deallocate(qt_hash                h,
+                                         qt_hash_deallocator_fn f)
+{   /*{{{*/
+    assert(h);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_LOCK(h->lock);
+    }
+    for (size_t i = 0; i <= h->mask; ++i) {
+        if (h->dist[i]) {
+            f(h->entries[i].value);
+        }
+    }
+    if (h->lock) {
+        QTHREAD_FASTLOCK_UNLOCK(h->lock);
+    }
+    qt_hash_destroy(h);
+} /*}}}*/
+
+int INTERNAL qt_hash_put(qt_hash  h,
+                         qt_key_t key,
+                         void    *value)
+{   /*{{{*/
+    int ret;
+
+    assert(h);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_LOCK(h->lock);
+    }
+    ret = qt_hash_put_locked(h, key, value);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_UNLOCK(h->lock);
+    }
+    return ret;
+} /*}}}*/
+
+int INTERNAL qt_hash_put_locked(qt_hash  h,
+                                qt_key_t key,
+                                void    *value)
+{   /*{{{*/
+    hash_entry e = { key, value };
+    size_t     i;
+    unsigned   dist;
+
+    assert(h);
+    if (h->population >= h->grow_size) {
+        qt_hash_internal_resize(h, (h->mask + 1) * 2);
+    }
+    /* key can only be ahead of the first slot it would take over */
+    i = HOME(h, key);
+    for (dist = 1; h->dist[i] >= dist; ++dist, i = NEXT(h, i)) {
+        if ((h->dist[i] == dist) && (h->entries[i].key == key)) {
+            return 0;
+        }
+    }
+    if (!qt_hash_internal_place(h, &e, i, dist)) {
+        do {
+            /* e is still homeless, but everything else is in the table */
+            qt_hash_internal_resize(h, (h->mask + 1) * 2);
+        } while (!qt_hash_internal_insert(h, &e));
+    }
+    ++h->population;
+    return 1;
+} /*}}}*/
+
+int INTERNAL qt_hash_remove(qt_hash        h,
+                            const qt_key_t key)
+{   /*{{{*/
+    int ret;
+
+    assert(h);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_LOCK(h->lock);
+    }
+    ret = qt_hash_remove_locked(h, key);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_UNLOCK(h->lock);
+    }
+    return ret;
+} /*}}}*/
+
+int INTERNAL qt_hash_remove_locked(qt_hash        h,
+                                   const qt_key_t key)
+{   /*{{{*/
+    hash_entry *z = h->entries;
+    uint8_t    *d = h->dist;
+    size_t      i, j;
+
+    assert(h);
+    if (qt_hash_internal_find(h, key, &i) == NULL) {
+        return 0;
+    }
+    /* backward shift: pull the rest of the run one slot closer to home */
+    for (j = NEXT(h, i); d[j] > 1; i = j, j = NEXT(h, j)) {
+        z[i] = z[j];
+        d[i] = d[j] - 1;
+    }
+    d[i] = 0;
+    --h->population;
+    if (h->population < h->shrink_size) {
+        qt_hash_internal_resize(h, (h->mask + 1) / 2);
+    }
+    return 1;
+} /*}}}*/
+
+void INTERNAL *qt_hash_get(qt_hash        h,
+                           const qt_key_t key)
+{   /*{{{*/
+    void *ret;
+
+    assert(h);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_LOCK(h->lock);
+    }
+    ret = qt_hash_get_locked(h, key);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_UNLOCK(h->lock);
+    }
+    return ret;
+} /*}}}*/
+
+void INTERNAL *qt_hash_get_locked(qt_hash        h,
+                                  const qt_key_t key)
+{   /*{{{*/
+    hash_entry *e;
+
+    assert(h);
+    e = qt_hash_internal_find(h, key, NULL);
+    return e ? e->value : NULL;
+} /*}}}*/
+
+void INTERNAL qt_hash_callback(qt_hash             h,
+                               qt_hash_callback_fn f,
+                               void               *arg)
+{   /*{{{*/
+    assert(h);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_LOCK(h->lock);
+    }
+    for (size_t i = 0; i <= h->mask; ++i) {
+        if (h->dist[i]) {
+            f(h->entries[i].key, h->entries[i].value, arg);
+        }
+    }
+    if (h->lock) {
+        QTHREAD_FASTLOCK_UNLOCK(h->lock);
+    }
+} /*}}}*/
+
+size_t INTERNAL qt_hash_count(qt_hash h)
+{   /*{{{*/
+    size_t ct;
+
+    assert(h);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_LOCK(h->lock);
+    }
+    ct = h->population;
+    if (h->lock) {
+        QTHREAD_FASTLOCK_UNLOCK(h->lock);
+    }
+    return ct;
+} /*}}}*/
+
+void INTERNAL qt_hash_lock(qt_hash h)
+{   /*{{{*/
+    assert(h);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_LOCK(h->lock);
+    }
+} /*}}}*/
+
+void INTERNAL qt_hash_unlock(qt_hash h)
+{   /*{{{*/
+    assert(h);
+    if (h->lock) {
+        QTHREAD_FASTLOCK_UNLOCK(h->lock);
+    }
+} /*}}}*/
+
+/* vim:set expandtab: */
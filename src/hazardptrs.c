@@ -89,7 +89,11 @@ void INTERNAL hazardous_ptr(unsigned int which,
 static int void_cmp(const void *a,
                     const void *b)
 {/*{{{*/
-    return (*(intptr_t *)a) - (*(intptr_t *)b);
+    const uintptr_t x = *(const uintptr_t *)a;
+    const uintptr_t y = *(const uintptr_t *)b;
+
+    /* the difference doesn't fit in an int */
+    return (x > y) - (x < y);
 }/*}}}*/
 
 static int binary_search(uintptr_t *list,
@@ -107,6 +107,7 @@ void INTERNAL qt_blocking_subsystem_init(void)
 {   /*{{{*/
 #if !defined(UNPOOLED)
     syscall_job_pool = qt_mpool_create(sizeof(qt_blocking_queue_node_t));
+    qt_mpool_set_name(syscall_job_pool, "syscall jobs");
 #endif
     theQueue.head   = NULL;
     theQueue.tail   = NULL;
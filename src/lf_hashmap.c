@@ -220,6 +220,7 @@ void INTERNAL qt_hash_initialize_subsystem(void)
 #ifndef UNPOOLED
     hash_entry_pool = qt_mpool_create(sizeof(hash_entry));
     assert(hash_entry_pool != NULL);
+    qt_mpool_set_name(hash_entry_pool, "hash entries");
     qthread_internal_cleanup_late(qt_hash_subsystem_shutdown);
 #endif
 }
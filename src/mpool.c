@@ -24,6 +24,7 @@
 
 /* Internal Includes */
 #include <qthread/qthread-int.h>       /* for uintptr_t */
+#include "qthread/qthread.h"           /* for qthread_pool_stats_t */
 #include "qt_mpool.h"
 #include "qt_atomics.h"
 #include "qt_expect.h"
@@ -34,6 +35,10 @@
 #include "qt_visibility.h"
 #include "qt_aligned_alloc.h"
 #include "qt_subsystems.h"
+#include "qt_affinity.h"               /* for qt_affinity_mem_tonode() */
+#include "qt_shepherd_innards.h"       /* for qthread_internal_getshep() */
+#include "qt_envariables.h"
+#include "qt_output_macros.h"
 
 /* Seems SLIGHTLY faster without TLS, and a whole lot safer and cleaner */
 #ifdef TLS
@@ -49,11 +54,76 @@ static aligned_t                      pool_cache_global_max = 1;
 static qt_mpool_threadlocal_cache_t **pool_cache_array      = NULL;
 #endif
 
+/* Every block is a power-of-two-sized span, aligned to its own size, so that
+ * the header at the front of it can be found from any item inside it. */
+typedef struct qt_mpool_block_s {
+    struct qt_mpool_block_s *next;
+    struct qt_mpool_block_s *prev;
+    unsigned int             node;     /* the arena that owns this block */
+    size_t                   idle;     /* scratch space for qt_mpool_trim() */
+} qt_mpool_block_t;
+
+#define QT_MPOOL_BLOCK_DOOMED ((size_t)-1)
+
+/* One of these per NUMA node; each on its own cacheline. */
+struct qt_mpool_arena_s {
+    QTHREAD_FASTLOCK_TYPE reuse_lock;
+    void                 *reuse_pool;
+    size_t                reuse_chains; /* each chain is a block's worth of items */
+    size_t                trim_at;      /* how many chains trigger a trim */
+    /* items flushed home in batches too short to be a chain, waiting for
+     * enough company (fewer than items_per_alloc) */
+    void                 *partial;
+    size_t                partial_count;
+    /* only maintained when profiling */
+    aligned_t             interest;     /* threads holding or waiting for the lock */
+    aligned_t             acquisitions;
+    aligned_t             contended;    /* acquisitions that had to wait */
+} Q_ALIGNED(CACHELINE_WIDTH);
+typedef struct qt_mpool_arena_s qt_mpool_arena_t;
+
+/* A batch of items freed by this thread that belong to another node's arena */
+typedef struct qt_mpool_remote_s {
+    struct qt_mpool_cache_entry_s *head;
+    size_t                         count;
+} qt_mpool_remote_t;
+
+/* the number of nodes the shepherds are spread across */
+static unsigned int qt_mpool_nnodes = 1;
+
+/* how many shepherd depots each pool gets (zero when every shepherd has a
+ * node, and thus an arena, to itself) */
+static unsigned int qt_mpool_ndepots = 0;
+
+/* how many chains a depot holds before overflowing into the arena */
+#define QT_MPOOL_DEPOT_CHAINS 2
+
+/* How many bytes of idle blocks a pool may hold per node before it trims
+ * itself (back down to half that); zero means only trim when asked. */
+static size_t qt_mpool_high_water = 0;
+
+/* Whether to keep usage statistics (and report them at exit). Read on every
+ * alloc and free, but it never changes after startup, so the branch is free. */
+static int qt_mpool_profiling = 0;
+
+/* every live pool, so that they can all be trimmed at once */
+static pthread_mutex_t all_pools_lock = PTHREAD_MUTEX_INITIALIZER;
+static qt_mpool        all_pools      = NULL;
+
+typedef struct qt_mpool_depot_s qt_mpool_depot_t;
+
 struct qt_mpool_s {
     size_t item_size;
-    size_t alloc_size;
+    size_t alloc_size;                 /* a power of two; also the block alignment */
     size_t items_per_alloc;
+    size_t item_offset;                /* where the first item sits in a block */
     size_t alignment;
+    size_t obj_offset;                 /* where the caller's object sits in an item */
+    size_t scribble_size;              /* how much of an item is ours to scribble on */
+
+    qt_mpool_hook_f ctor;              /* run on each object when first carved */
+    qt_mpool_hook_f dtor;              /* run on each object when its block is released */
+    void           *hook_arg;
 
 #ifdef TLS
     size_t                        offset;
@@ -62,12 +132,22 @@ struct qt_mpool_s {
 #endif
     qt_mpool_threadlocal_cache_t *caches;  // for cleanup
 
-    QTHREAD_FASTLOCK_TYPE         reuse_lock;
-    void                         *reuse_pool;
+    unsigned int                  narenas;
+    qt_mpool_arena_t             *arenas;
+    size_t                        high_water; /* in chains; 0 means never auto-trim */
+    unsigned int                  ndepots;
+    qt_mpool_depot_t             *depots;
 
     QTHREAD_FASTLOCK_TYPE         pool_lock;
-    void                        **alloc_list;
-    size_t                        alloc_list_pos;
+    qt_mpool_block_t             *blocks;
+    size_t                        nblocks;
+
+    const char                   *name;   /* for reporting */
+    aligned_t                     live;   /* objects handed out (when profiling) */
+    aligned_t                     peak;
+
+    qt_mpool                      next_pool;
+    qt_mpool                      prev_pool;
 };
 
 typedef struct qt_mpool_cache_entry_s {
@@ -76,12 +156,27 @@ typedef struct qt_mpool_cache_entry_s {
     uint8_t                        data[];
 } qt_mpool_cache_t;
 
+/* One per shepherd (when several share a node): a few whole chains that the
+ * shepherd's workers trade among themselves before going to the arena. */
+struct qt_mpool_depot_s {
+    QTHREAD_FASTLOCK_TYPE lock;
+    qt_mpool_cache_t     *chains;      /* linked through block_tail->next */
+    unsigned int          count;
+    unsigned int          node;        /* the arena these chains belong to */
+} Q_ALIGNED(CACHELINE_WIDTH);
+
 struct threadlocal_cache_s {
     qt_mpool_cache_t             *cache;
     uint_fast16_t                 count;
     uint8_t                      *block;
     uint_fast32_t                 i;
+    unsigned int                  node;
+    qt_mpool_remote_t            *remote; // one pending batch per arena
+    QTHREAD_FASTLOCK_TYPE         remote_lock; // so others can flush them
     qt_mpool_threadlocal_cache_t *next;  // for cleanup
+    /* only maintained when profiling */
+    size_t                        allocs;
+    size_t                        hits;   // allocs satisfied without leaving this cache
 };
 
 #ifdef TLS
@@ -99,8 +194,74 @@ static void qt_mpool_subsystem_shutdown(void)
 }
 #endif /* ifdef TLS */
 
+static void qt_mpool_internal_remote_flush_all(qt_mpool pool);
+
+/* Prints one line per pool that was ever used (in creation order) when the
+ * runtime shuts down */
+static void qt_mpool_internal_report(void)
+{
+    const size_t          nalloc = qt_mpool_stats(NULL, 0);
+    size_t                npools;
+    qthread_pool_stats_t *stats;
+
+    if (nalloc == 0) {
+        return;
+    }
+    /* so that nothing is reported as stuck in some thread's remote batch */
+    pthread_mutex_lock(&all_pools_lock);
+    for (qt_mpool pool = all_pools; pool; pool = pool->next_pool) {
+        qt_mpool_internal_remote_flush_all(pool);
+    }
+    pthread_mutex_unlock(&all_pools_lock);
+    stats = MALLOC(sizeof(qthread_pool_stats_t) * nalloc);
+    assert(stats);
+    npools = qt_mpool_stats(stats, nalloc);
+    print_status("%-18s %8s %10s %10s %12s %12s %6s %10s %9s\n",
+                 "pool", "objsize", "live", "peak", "reserved", "allocs", "hit%",
+                 "locks", "contended");
+    while (npools-- > 0) {
+        const qthread_pool_stats_t *st = &stats[npools];
+
+        if ((st->reserved == 0) && (st->allocs == 0)) {
+            continue;
+        }
+        print_status("%-18s %8lu %10lu %10lu %12lu %12lu %5.1f%% %10lu %8.1f%%\n",
+                     st->name ? st->name : "-",
+                     (unsigned long)st->item_size,
+                     (unsigned long)st->live,
+                     (unsigned long)st->peak,
+                     (unsigned long)st->reserved,
+                     (unsigned long)st->allocs,
+                     st->allocs ? 100.0 * st->cache_hits / st->allocs : 0.0,
+                     (unsigned long)st->lock_acquisitions,
+                     st->lock_acquisitions ? 100.0 * st->lock_contended / st->lock_acquisitions : 0.0);
+    }
+    FREE(stats, sizeof(qthread_pool_stats_t) * nalloc);
+}
+
 void INTERNAL qt_mpool_subsystem_init(void)
 {
+    /* This must happen after the shepherds have been assigned to nodes;
+     * pools created before then get only one arena. */
+    qt_mpool_nnodes = 1;
+    for (qthread_shepherd_id_t s = 0; s < qthread_readstate(TOTAL_SHEPHERDS); ++s) {
+        unsigned int node = qthread_internal_shep_to_node(s);
+        if ((node != QTHREAD_NO_NODE) && (node >= qt_mpool_nnodes)) {
+            qt_mpool_nnodes = node + 1;
+        }
+    }
+    qthread_debug(MPOOL_DETAILS, "%u memory node(s)\n", qt_mpool_nnodes);
+    if (qthread_readstate(TOTAL_SHEPHERDS) > qt_mpool_nnodes) {
+        qt_mpool_ndepots = qthread_readstate(TOTAL_SHEPHERDS);
+    } else {
+        qt_mpool_ndepots = 0;
+    }
+    qt_mpool_high_water = qt_internal_get_env_num("POOL_HIGH_WATER", 0, 0);
+    qt_mpool_profiling  = qt_internal_get_env_num("POOL_PROFILE", 0, 0) != 0;
+    if (qt_mpool_profiling) {
+        /* early, while the subsystems' pools still exist */
+        qthread_internal_cleanup_early(qt_mpool_internal_report);
+    }
 #ifdef TLS
     assert(TLS_GET(pool_caches) == NULL);
     assert(TLS_GET(pool_cache_count) == 0);
@@ -125,11 +286,343 @@ static QINLINE void qt_mpool_internal_aligned_free(void  *freeme,
     qthread_internal_aligned_free(freeme, alignment);
 }                                      /*}}} */
 
+static QINLINE qt_mpool_block_t *qt_mpool_internal_block_of(qt_mpool    pool,
+                                                            const void *item)
+{                                      /*{{{ */
+    return (qt_mpool_block_t *)((uintptr_t)item & ~(uintptr_t)(pool->alloc_size - 1));
+}                                      /*}}} */
+
+static QINLINE unsigned int qt_mpool_internal_mynode(qt_mpool pool)
+{                                      /*{{{ */
+    if (pool->narenas > 1) {
+        qthread_shepherd_t *shep = qthread_internal_getshep();
+
+        if (shep && (shep->node < pool->narenas)) {
+            return shep->node;
+        }
+    }
+    return 0;
+}                                      /*}}} */
+
+/* Takes an arena's reuse lock; when profiling, also notes whether anyone else
+ * was holding it (or waiting for it) at the time */
+static QINLINE void qt_mpool_internal_arena_lock(qt_mpool_arena_t *arena)
+{                                      /*{{{ */
+    if (QTHREAD_UNLIKELY(qt_mpool_profiling)) {
+        if (qthread_incr(&arena->interest, 1) != 0) {
+            qthread_incr(&arena->contended, 1);
+        }
+        QTHREAD_FASTLOCK_LOCK(&arena->reuse_lock);
+        arena->acquisitions++;
+    } else {
+        QTHREAD_FASTLOCK_LOCK(&arena->reuse_lock);
+    }
+}                                      /*}}} */
+
+static QINLINE void qt_mpool_internal_arena_unlock(qt_mpool_arena_t *arena)
+{                                      /*{{{ */
+    QTHREAD_FASTLOCK_UNLOCK(&arena->reuse_lock);
+    if (QTHREAD_UNLIKELY(qt_mpool_profiling)) {
+        qthread_incr(&arena->interest, -1);
+    }
+}                                      /*}}} */
+
+/* Records `n` objects leaving the pool, `hits` of which came straight from
+ * the thread's cache. Only called when profiling. */
+static void qt_mpool_internal_profile_alloc(qt_mpool                      pool,
+                                            qt_mpool_threadlocal_cache_t *tc,
+                                            size_t                        n,
+                                            size_t                        hits)
+{                                      /*{{{ */
+    aligned_t live = qthread_incr(&pool->live, n) + n;
+    aligned_t peak = pool->peak;
+
+    tc->allocs += n;
+    tc->hits   += hits;
+    while (live > peak) {
+        aligned_t prev = qthread_cas(&pool->peak, peak, live);
+
+        if (prev == peak) {
+            break;
+        }
+        peak = prev;
+    }
+}                                      /*}}} */
+
+#define QT_MPOOL_PROFILE_ALLOC(pool, tc, n, hits) do {                  \
+        if (QTHREAD_UNLIKELY(qt_mpool_profiling)) {                     \
+            qt_mpool_internal_profile_alloc((pool), (tc), (n), (hits)); \
+        }                                                               \
+} while (0)
+#define QT_MPOOL_PROFILE_FREE(pool, n) do {                  \
+        if (QTHREAD_UNLIKELY(qt_mpool_profiling)) {          \
+            qthread_incr(&(pool)->live, -(saligned_t)(n));   \
+        }                                                    \
+} while (0)
+
+/* The calling thread's shepherd depot, if it may hold chains owned by `node` */
+static QINLINE qt_mpool_depot_t *qt_mpool_internal_mydepot(qt_mpool     pool,
+                                                           unsigned int node)
+{                                      /*{{{ */
+    if (pool->ndepots) {
+        qthread_shepherd_t *shep = qthread_internal_getshep();
+
+        if (shep && (shep->shepherd_id < pool->ndepots) &&
+            (pool->depots[shep->shepherd_id].node == node)) {
+            return &pool->depots[shep->shepherd_id];
+        }
+    }
+    return NULL;
+}                                      /*}}} */
+
+/* Turns an item that has never been handed out into an object */
+static QINLINE void *qt_mpool_internal_fresh(qt_mpool pool,
+                                             void    *item)
+{                                      /*{{{ */
+    void *obj = (uint8_t *)item + pool->obj_offset;
+
+    if (pool->ctor) {
+        pool->ctor(obj, pool->hook_arg);
+    }
+    return obj;
+}                                      /*}}} */
+
+/* Runs the destructor over the first `carved` objects of a block */
+static void qt_mpool_internal_destruct(qt_mpool          pool,
+                                       qt_mpool_block_t *b,
+                                       size_t            carved)
+{                                      /*{{{ */
+    uint8_t *obj = (uint8_t *)b + pool->item_offset + pool->obj_offset;
+
+    for (size_t i = 0; i < carved; ++i, obj += pool->item_size) {
+        pool->dtor(obj, pool->hook_arg);
+    }
+}                                      /*}}} */
+
+/* Returns a pointer to the first item of a new block owned by the given node */
+static uint8_t *qt_mpool_internal_block_alloc(qt_mpool     pool,
+                                              unsigned int node)
+{                                      /*{{{ */
+    qt_mpool_block_t *b = qt_mpool_internal_aligned_alloc(pool->alloc_size,
+                                                          pool->alloc_size);
+
+    qassert_ret((b != NULL), NULL);
+#ifdef QTHREAD_HAVE_MEM_AFFINITY
+    if (pool->narenas > 1) {
+        /* bind before anything touches it; the caller is running on the
+         * node, so first-touch would usually get this right, but stealing
+         * and un-bound threads make that unreliable */
+        qt_affinity_mem_tonode(b, pool->alloc_size, node);
+    }
+#endif
+    VALGRIND_MAKE_MEM_DEFINED(b, sizeof(qt_mpool_block_t));
+    b->node = node;
+    b->idle = 0;
+    b->prev = NULL;
+    QTHREAD_FASTLOCK_LOCK(&pool->pool_lock);
+    b->next = pool->blocks;
+    if (pool->blocks) {
+        pool->blocks->prev = b;
+    }
+    pool->blocks = b;
+    pool->nblocks++;
+    QTHREAD_FASTLOCK_UNLOCK(&pool->pool_lock);
+    return ((uint8_t *)b) + pool->item_offset;
+}                                      /*}}} */
+
+static size_t qt_mpool_internal_trim_arena(qt_mpool     pool,
+                                           unsigned int node,
+                                           size_t       keep);
+
+/* Hands a whole chain (items_per_alloc long) to the given arena */
+static QINLINE void qt_mpool_internal_arena_push(qt_mpool          pool,
+                                                 unsigned int      node,
+                                                 qt_mpool_cache_t *chain)
+{                                      /*{{{ */
+    qt_mpool_arena_t *arena = &pool->arenas[node];
+    int               trim;
+
+    assert(chain);
+    assert(chain->block_tail);
+    qt_mpool_internal_arena_lock(arena);
+    chain->block_tail->next = arena->reuse_pool;
+    arena->reuse_pool       = chain;
+    arena->reuse_chains++;
+    trim = pool->high_water && (arena->reuse_chains > arena->trim_at);
+    qt_mpool_internal_arena_unlock(arena);
+    if (QTHREAD_UNLIKELY(trim)) {
+        qt_mpool_internal_trim_arena(pool, node, pool->high_water / 2);
+    }
+}                                      /*}}} */
+
+/* Hands a whole chain to the caller's depot, or to the arena if the depot is
+ * full (or the chain belongs somewhere else) */
+static QINLINE void qt_mpool_internal_chain_release(qt_mpool          pool,
+                                                    unsigned int      node,
+                                                    qt_mpool_cache_t *chain)
+{                                      /*{{{ */
+    qt_mpool_depot_t *depot = qt_mpool_internal_mydepot(pool, node);
+
+    if (depot) {
+        QTHREAD_FASTLOCK_LOCK(&depot->lock);
+        if (depot->count < QT_MPOOL_DEPOT_CHAINS) {
+            chain->block_tail->next = depot->chains;
+            depot->chains           = chain;
+            depot->count++;
+            QTHREAD_FASTLOCK_UNLOCK(&depot->lock);
+            return;
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&depot->lock);
+    }
+    qt_mpool_internal_arena_push(pool, node, chain);
+}                                      /*}}} */
+
+/* Hands a batch of fewer than items_per_alloc items (linked through next) to
+ * the given arena, which keeps them aside until there are enough to make a
+ * whole chain of */
+static void qt_mpool_internal_arena_push_partial(qt_mpool          pool,
+                                                 unsigned int      node,
+                                                 qt_mpool_cache_t *head,
+                                                 size_t            count)
+{                                      /*{{{ */
+    qt_mpool_arena_t *arena           = &pool->arenas[node];
+    const size_t      items_per_alloc = pool->items_per_alloc;
+    qt_mpool_cache_t *tail            = head;
+    int               trim;
+
+    assert(head);
+    assert(count > 0 && count < items_per_alloc);
+    while (tail->next) {
+        tail = tail->next;
+    }
+    qt_mpool_internal_arena_lock(arena);
+    tail->next            = arena->partial;
+    arena->partial        = head;
+    arena->partial_count += count;
+    while (arena->partial_count >= items_per_alloc) {
+        qt_mpool_cache_t *chain = arena->partial;
+        qt_mpool_cache_t *last  = chain;
+
+        for (size_t i = 1; i < items_per_alloc; ++i) {
+            last = last->next;
+        }
+        arena->partial        = last->next;
+        arena->partial_count -= items_per_alloc;
+        /* every item in a chain must know where the chain ends */
+        for (qt_mpool_cache_t *c = chain; c != last; c = c->next) {
+            c->block_tail = last;
+        }
+        last->block_tail  = last;
+        last->next        = arena->reuse_pool;
+        arena->reuse_pool = chain;
+        arena->reuse_chains++;
+    }
+    trim = pool->high_water && (arena->reuse_chains > arena->trim_at);
+    qt_mpool_internal_arena_unlock(arena);
+    if (QTHREAD_UNLIKELY(trim)) {
+        qt_mpool_internal_trim_arena(pool, node, pool->high_water / 2);
+    }
+}                                      /*}}} */
+
+/* Sends home whatever a thread cache has collected for other nodes' arenas,
+ * however little, so that it isn't stranded there */
+static void qt_mpool_internal_remote_flush(qt_mpool                      pool,
+                                           qt_mpool_threadlocal_cache_t *tc)
+{                                      /*{{{ */
+    if (tc->remote == NULL) {
+        return;
+    }
+    QTHREAD_FASTLOCK_LOCK(&tc->remote_lock);
+    for (unsigned int a = 0; a < pool->narenas; ++a) {
+        qt_mpool_remote_t *r = &tc->remote[a];
+
+        if (r->count) {
+            qt_mpool_internal_arena_push_partial(pool, a, r->head, r->count);
+            r->head  = NULL;
+            r->count = 0;
+        }
+    }
+    QTHREAD_FASTLOCK_UNLOCK(&tc->remote_lock);
+}                                      /*}}} */
+
+static void qt_mpool_internal_remote_flush_all(qt_mpool pool)
+{                                      /*{{{ */
+    for (qt_mpool_threadlocal_cache_t *tc = pool->caches; tc; tc = tc->next) {
+        qt_mpool_internal_remote_flush(pool, tc);
+    }
+}                                      /*}}} */
+
+/* Detaches up to `max` whole chains, first from the caller's depot and then
+ * from the node's arena, taking each lock once. The chains come back linked
+ * one after another (and NULL-terminated) in *out; returns how many. */
+static size_t qt_mpool_internal_chains_acquire(qt_mpool           pool,
+                                               unsigned int       node,
+                                               size_t             max,
+                                               qt_mpool_cache_t **out)
+{                                      /*{{{ */
+    qt_mpool_depot_t *depot = qt_mpool_internal_mydepot(pool, node);
+    qt_mpool_arena_t *arena = &pool->arenas[node];
+    qt_mpool_cache_t *head  = NULL, *tail = NULL, *c;
+    size_t            got   = 0;
+
+    if (depot && depot->chains) {
+        QTHREAD_FASTLOCK_LOCK(&depot->lock);
+        while (got < max && depot->chains) {
+            c             = depot->chains;
+            depot->chains = c->block_tail->next;
+            depot->count--;
+            if (tail) {
+                tail->block_tail->next = c;
+            } else {
+                head = c;
+            }
+            tail = c;
+            ++got;
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&depot->lock);
+    }
+    if ((got < max) && arena->reuse_pool) {
+        qthread_debug(MPOOL_BEHAVIOR, "->...pull from reuse (node %u)\n", node);
+        qt_mpool_internal_arena_lock(arena);
+        while (got < max && arena->reuse_pool) {
+            c                 = arena->reuse_pool;
+            arena->reuse_pool = c->block_tail->next;
+            arena->reuse_chains--;
+            if (tail) {
+                tail->block_tail->next = c;
+            } else {
+                head = c;
+            }
+            tail = c;
+            ++got;
+        }
+        if ((arena->trim_at > pool->high_water) &&
+            (arena->reuse_chains <= pool->high_water / 2)) {
+            arena->trim_at = pool->high_water;
+        }
+        qt_mpool_internal_arena_unlock(arena);
+    }
+    if (tail) {
+        tail->block_tail->next = NULL;
+    }
+    *out = head;
+    return got;
+}                                      /*}}} */
+
 // sync means lock-protected
 // item_size is how many bytes to return
 // ...memory is always allocated in multiples of getpagesize()
 qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
                                           size_t alignment)
+{                                      /*{{{ */
+    return qt_mpool_create_hooked(item_size, alignment, NULL, NULL, NULL);
+}                                      /*}}} */
+
+qt_mpool INTERNAL qt_mpool_create_hooked(size_t          item_size,
+                                         size_t          alignment,
+                                         qt_mpool_hook_f ctor,
+                                         qt_mpool_hook_f dtor,
+                                         void           *hook_arg)
 {                                      /*{{{ */
     qt_mpool pool = (qt_mpool)MALLOC(sizeof(struct qt_mpool_s));
 
@@ -149,11 +642,23 @@ qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
     if (alignment <= 16) {
         alignment = 16;
     }
+    pool->ctor     = ctor;
+    pool->dtor     = dtor;
+    pool->hook_arg = hook_arg;
+    if (ctor || dtor) {
+        /* constructed objects must keep their state while they sit in the
+         * pool, so the free-list links get their own space in front */
+        pool->obj_offset = alignment * ((sizeof(qt_mpool_cache_t) + alignment - 1) / alignment);
+        item_size       += pool->obj_offset;
+    } else {
+        pool->obj_offset = 0;
+    }
     if (item_size % alignment) {
         item_size += alignment - (item_size % alignment);
     }
-    pool->item_size = item_size;
-    pool->alignment = alignment;
+    pool->item_size     = item_size;
+    pool->alignment     = alignment;
+    pool->scribble_size = pool->obj_offset ? pool->obj_offset : item_size;
     /* next, we find the least-common-multiple in sizes between item_size and
      * pagesize. If this is less than ten items (an arbitrary number), we
      * increase the alloc_size until it is at least that big. This guarantees
@@ -174,28 +679,86 @@ qt_mpool INTERNAL qt_mpool_create_aligned(size_t item_size,
             alloc_size *= 2;
         }
     }
+    /* The block header takes up the first item (or items) of each block, so
+     * that every item stays aligned. Then round up to a power of two, so
+     * blocks can be aligned to their size and the header can be found from
+     * any item by masking. */
+    pool->item_offset = item_size * ((sizeof(qt_mpool_block_t) + item_size - 1) / item_size);
+    {
+        size_t span = pagesize;
+
+        while (span < alloc_size || span - pool->item_offset < item_size) {
+            span *= 2;
+        }
+        alloc_size = span;
+    }
     pool->alloc_size      = alloc_size;
-    pool->items_per_alloc = alloc_size / item_size;
-    pool->reuse_pool      = NULL;
-    QTHREAD_FASTLOCK_INIT(pool->reuse_lock);
+    pool->items_per_alloc = (alloc_size - pool->item_offset) / item_size;
+    pool->narenas         = qt_mpool_nnodes;
+    pool->high_water      = 0;
+    if (qt_mpool_high_water) {
+        pool->high_water = qt_mpool_high_water / alloc_size;
+        if (pool->high_water < 2) {
+            pool->high_water = 2;
+        }
+    }
+    pool->arenas          = qthread_internal_aligned_alloc(sizeof(qt_mpool_arena_t) * pool->narenas,
+                                                           CACHELINE_WIDTH);
+    qassert_goto((pool->arenas != NULL), errexit);
+    for (unsigned int a = 0; a < pool->narenas; ++a) {
+        pool->arenas[a].reuse_pool   = NULL;
+        pool->arenas[a].reuse_chains = 0;
+        pool->arenas[a].trim_at      = pool->high_water;
+        pool->arenas[a].partial       = NULL;
+        pool->arenas[a].partial_count = 0;
+        pool->arenas[a].interest     = 0;
+        pool->arenas[a].acquisitions = 0;
+        pool->arenas[a].contended    = 0;
+        QTHREAD_FASTLOCK_INIT(pool->arenas[a].reuse_lock);
+    }
+    pool->ndepots = qt_mpool_ndepots;
+    pool->depots  = NULL;
+    if (pool->ndepots) {
+        pool->depots = qthread_internal_aligned_alloc(sizeof(qt_mpool_depot_t) * pool->ndepots,
+                                                      CACHELINE_WIDTH);
+        qassert_goto((pool->depots != NULL), errexit);
+        for (unsigned int d = 0; d < pool->ndepots; ++d) {
+            unsigned int node = qthread_internal_shep_to_node(d);
+
+            pool->depots[d].chains = NULL;
+            pool->depots[d].count  = 0;
+            pool->depots[d].node   = (node < pool->narenas) ? node : 0;
+            QTHREAD_FASTLOCK_INIT(pool->depots[d].lock);
+        }
+    }
     QTHREAD_FASTLOCK_INIT(pool->pool_lock);
 #ifdef TLS
     pool->offset = qthread_incr(&pool_cache_global_max, 1);
 #else
     pthread_key_create(&pool->threadlocal_cache, NULL);
 #endif
-    /* this assumes that pagesize is a multiple of sizeof(void*) */
-    assert(pagesize % sizeof(void *) == 0);
-    pool->alloc_list = qthread_internal_aligned_alloc(pagesize, pagesize);
-    qassert_goto((pool->alloc_list != NULL), errexit);
-    memset(pool->alloc_list, 0, pagesize);
-    pool->alloc_list_pos = 0;
-
-    pool->caches = NULL;
+    pool->blocks  = NULL;
+    pool->nblocks = 0;
+    pool->caches  = NULL;
+    pool->name    = NULL;
+    pool->live    = 0;
+    pool->peak    = 0;
+
+    pthread_mutex_lock(&all_pools_lock);
+    pool->prev_pool = NULL;
+    pool->next_pool = all_pools;
+    if (all_pools) {
+        all_pools->prev_pool = pool;
+    }
+    all_pools = pool;
+    pthread_mutex_unlock(&all_pools_lock);
     return pool;
 
     qgoto(errexit);
     if (pool) {
+        if (pool->arenas) {
+            qthread_internal_aligned_free(pool->arenas, CACHELINE_WIDTH);
+        }
         FREE(pool, sizeof(struct qt_mpool_s));
     }
     return NULL;
@@ -265,6 +828,12 @@ static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
     }
     assert(tc);
     tc += (pool->offset - 1);
+    if ((pool->narenas > 1) && (tc->remote == NULL)) {
+        tc->node   = qt_mpool_internal_mynode(pool);
+        tc->remote = calloc(pool->narenas, sizeof(qt_mpool_remote_t));
+        assert(tc->remote);
+        QTHREAD_FASTLOCK_INIT(tc->remote_lock);
+    }
 #else /* ifdef TLS */
     tc = pthread_getspecific(pool->threadlocal_cache);
     if (NULL == tc) {
@@ -273,7 +842,17 @@ static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
         tc->cache = NULL;
         tc->count = 0;
         tc->block = NULL;
-        tc->i     = 0;
+        tc->i      = 0;
+        tc->allocs = 0;
+        tc->hits   = 0;
+        tc->node   = qt_mpool_internal_mynode(pool);
+        if (pool->narenas > 1) {
+            tc->remote = calloc(pool->narenas, sizeof(qt_mpool_remote_t));
+            assert(tc->remote);
+            QTHREAD_FASTLOCK_INIT(tc->remote_lock);
+        } else {
+            tc->remote = NULL;
+        }
         do {
             tc->next = pool->caches;
         } while (qthread_cas_ptr(&pool->caches, tc->next, tc) != tc->next);
@@ -284,102 +863,100 @@ static qt_mpool_threadlocal_cache_t *qt_mpool_internal_getcache(qt_mpool pool)
     return tc;
 }
 
-void INTERNAL *qt_mpool_alloc(qt_mpool pool)
+/* Hands out one object, refilling the thread's cache if need be */
+static QINLINE void *qt_mpool_internal_alloc(qt_mpool                      pool,
+                                             qt_mpool_threadlocal_cache_t *tc)
 {   /*{{{*/
-    qt_mpool_threadlocal_cache_t *tc;
-    size_t                        cnt;
-
-    qthread_debug(MPOOL_CALLS, "pool:%p\n", pool);
-    qassert_ret((pool != NULL), NULL);
-
-    tc = qt_mpool_internal_getcache(pool);
     qthread_debug(MPOOL_BEHAVIOR, "->tc:%p cache:%p (bt:%p) cnt:%u\n", tc, tc->cache, tc->cache ? tc->cache->block_tail : NULL, (unsigned int)tc->count);
     if (tc->cache) {
         qt_mpool_cache_t *cache = tc->cache;
         qthread_debug(MPOOL_DETAILS, "->...cached count:%zu\n", (size_t)tc->count - 1);
         tc->cache = cache->next;
         --tc->count;
-        ALLOC_SCRIBBLE(cache, pool->item_size);
-        return cache;
+        ALLOC_SCRIBBLE(cache, pool->scribble_size);
+        QT_MPOOL_PROFILE_ALLOC(pool, tc, 1, 1);
+        return (uint8_t *)cache + pool->obj_offset;
     } else if (tc->block) {
         void *ret = &(tc->block[tc->i * pool->item_size]);
         qthread_debug(MPOOL_DETAILS, "->...block count:%zu\n", (size_t)tc->i);
         if (++tc->i == pool->items_per_alloc) {
             tc->block = NULL;
         }
-        ALLOC_SCRIBBLE(ret, pool->item_size);
-        return ret;
+        ALLOC_SCRIBBLE(ret, pool->scribble_size);
+        QT_MPOOL_PROFILE_ALLOC(pool, tc, 1, 1);
+        return qt_mpool_internal_fresh(pool, ret);
     } else {
-        const size_t      items_per_alloc = pool->items_per_alloc;
-        qt_mpool_cache_t *cache           = NULL;
+        qt_mpool_cache_t *cache = NULL;
 
-        cnt = 0;
+        /* the thread may have moved (or been assigned) since the cache was
+         * made; refill from wherever it is now */
+        tc->node = qt_mpool_internal_mynode(pool);
         /* cache is empty; need to fill it */
-        if (pool->reuse_pool) { // global cache
-            qthread_debug(MPOOL_BEHAVIOR, "->...pull from reuse\n");
-            QTHREAD_FASTLOCK_LOCK(&pool->reuse_lock);
-            if (pool->reuse_pool) {
-                cache                   = pool->reuse_pool;
-                pool->reuse_pool        = cache->block_tail->next;
-                cache->block_tail->next = NULL;
-                cnt                     = items_per_alloc;
-            }
-            QTHREAD_FASTLOCK_UNLOCK(&pool->reuse_lock);
-        }
-        if (NULL == cache) {
+        if (qt_mpool_internal_chains_acquire(pool, tc->node, 1, &cache) == 0) {
             uint8_t *p;
-            // const size_t item_size = pool->item_size;
 
             /* need to allocate a new block and record that I did so in the central pool */
-            qthread_debug(MPOOL_BEHAVIOR, "->...allocating new block\n");
-            p = qt_mpool_internal_aligned_alloc(pool->alloc_size,
-                                                pool->alignment);
+            qthread_debug(MPOOL_BEHAVIOR, "->...allocating new block (node %u)\n", tc->node);
+            p = qt_mpool_internal_block_alloc(pool, tc->node);
             qassert_ret((p != NULL), NULL);
             assert(pool->alignment == 0 ||
                    (((uintptr_t)p) & (pool->alignment - 1)) == 0);
-            QTHREAD_FASTLOCK_LOCK(&pool->pool_lock);
-            if (pool->alloc_list_pos == (pagesize / sizeof(void *) - 1)) {
-                void **tmp = qthread_internal_aligned_alloc(pagesize, pagesize);
-                qassert_ret((tmp != NULL), NULL);
-                memset(tmp, 0, pagesize);
-                tmp[pagesize / sizeof(void *) - 1] = pool->alloc_list;
-                pool->alloc_list                   = tmp;
-                pool->alloc_list_pos               = 0;
-            }
-            pool->alloc_list[pool->alloc_list_pos] = p;
-            pool->alloc_list_pos++;
-            QTHREAD_FASTLOCK_UNLOCK(&pool->pool_lock);
             /* store the block for later allocation */
             tc->block = p;
             tc->i     = 1;
-            ALLOC_SCRIBBLE(p, pool->item_size);
-            return p;
+            ALLOC_SCRIBBLE(p, pool->scribble_size);
+            QT_MPOOL_PROFILE_ALLOC(pool, tc, 1, 0);
+            return qt_mpool_internal_fresh(pool, p);
         } else {
-            qthread_debug(MPOOL_BEHAVIOR, "->...from_global_pool count:%zu\n", (size_t)(cnt - 1));
+            qthread_debug(MPOOL_BEHAVIOR, "->...from_global_pool count:%zu\n", pool->items_per_alloc - 1);
             tc->cache = cache->next;
-            tc->count = cnt - 1;
+            tc->count = pool->items_per_alloc - 1;
             // cache->next       = NULL; // unnecessary
             // cache->block_tail = NULL; // unnecessary
-            ALLOC_SCRIBBLE(cache, pool->item_size);
-            return cache;
+            ALLOC_SCRIBBLE(cache, pool->scribble_size);
+            QT_MPOOL_PROFILE_ALLOC(pool, tc, 1, 0);
+            return (uint8_t *)cache + pool->obj_offset;
         }
     }
 } /*}}}*/
 
-void INTERNAL qt_mpool_free(qt_mpool pool,
-                            void    *mem)
+/* Takes one object back into the thread's cache, spilling a chain to the
+ * depot (or arena) when the cache gets too full */
+static QINLINE void qt_mpool_internal_free(qt_mpool                      pool,
+                                           qt_mpool_threadlocal_cache_t *tc,
+                                           void                         *mem)
 {   /*{{{*/
-    qt_mpool_threadlocal_cache_t *tc;
-    qt_mpool_cache_t             *cache = NULL;
-    qt_mpool_cache_t             *n     = (qt_mpool_cache_t *)mem;
-    size_t                        cnt;
-    const size_t                  items_per_alloc = pool->items_per_alloc;
+    qt_mpool_cache_t *cache = NULL;
+    qt_mpool_cache_t *n     = (qt_mpool_cache_t *)((uint8_t *)mem - pool->obj_offset);
+    size_t            cnt;
+    const size_t      items_per_alloc = pool->items_per_alloc;
 
-    qthread_debug(MPOOL_CALLS, "pool=%p mem=%p\n", pool, mem);
-    qassert_retvoid((mem != NULL));
-    qassert_retvoid((pool != NULL));
-    FREE_SCRIBBLE(mem, pool->item_size);
-    tc    = qt_mpool_internal_getcache(pool);
+    FREE_SCRIBBLE(n, pool->scribble_size);
+    QT_MPOOL_PROFILE_FREE(pool, 1);
+    if (pool->narenas > 1) {
+        const unsigned int owner = qt_mpool_internal_block_of(pool, n)->node;
+
+        if (owner != tc->node) {
+            /* Belongs to another node: collect a chain of them and send it
+             * home in one go, rather than taking the remote lock per item. */
+            qt_mpool_remote_t *r = &tc->remote[owner];
+
+            /* uncontended unless a trim is flushing this cache's batches */
+            QTHREAD_FASTLOCK_LOCK(&tc->remote_lock);
+            n->next       = r->head;
+            n->block_tail = r->head ? r->head->block_tail : n;
+            r->head       = n;
+            if (++r->count == items_per_alloc) {
+                qthread_debug(MPOOL_BEHAVIOR, "->send batch home to node %u\n", owner);
+                qt_mpool_internal_arena_push(pool, owner, n);
+                r->head  = NULL;
+                r->count = 0;
+            }
+            QTHREAD_FASTLOCK_UNLOCK(&tc->remote_lock);
+            VALGRIND_MEMPOOL_FREE(pool, mem);
+            return;
+        }
+    }
     cache = tc->cache;
     cnt   = tc->count;
     qthread_debug(MPOOL_DETAILS, "->cache:%p (bt:%p) cnt:%u\n", cache, cache ? cache->block_tail : NULL, (unsigned int)cnt);
@@ -401,12 +978,7 @@ void INTERNAL qt_mpool_free(qt_mpool pool,
         assert(n->block_tail);
         toglobal            = n->block_tail->next;
         n->block_tail->next = NULL;
-        assert(toglobal);
-        assert(toglobal->block_tail);
-        QTHREAD_FASTLOCK_LOCK(&pool->reuse_lock);
-        toglobal->block_tail->next = pool->reuse_pool;
-        pool->reuse_pool           = toglobal;
-        QTHREAD_FASTLOCK_UNLOCK(&pool->reuse_lock);
+        qt_mpool_internal_chain_release(pool, tc->node, toglobal);
         cnt -= items_per_alloc;
     } else if (cnt == items_per_alloc + 1) {
         qthread_debug(MPOOL_BEHAVIOR, "->chop_block\n");
@@ -418,30 +990,389 @@ void INTERNAL qt_mpool_free(qt_mpool pool,
     VALGRIND_MEMPOOL_FREE(pool, mem);
 } /*}}}*/
 
-void INTERNAL qt_mpool_destroy(qt_mpool pool)
+void INTERNAL *qt_mpool_alloc(qt_mpool pool)
+{   /*{{{*/
+    qthread_debug(MPOOL_CALLS, "pool:%p\n", pool);
+    qassert_ret((pool != NULL), NULL);
+
+    return qt_mpool_internal_alloc(pool, qt_mpool_internal_getcache(pool));
+} /*}}}*/
+
+void INTERNAL qt_mpool_free(qt_mpool pool,
+                            void    *mem)
+{   /*{{{*/
+    qthread_debug(MPOOL_CALLS, "pool=%p mem=%p\n", pool, mem);
+    qassert_retvoid((mem != NULL));
+    qassert_retvoid((pool != NULL));
+    qt_mpool_internal_free(pool, qt_mpool_internal_getcache(pool), mem);
+} /*}}}*/
+
+/* Fills ptrs[0..n) with objects. Whatever the thread has cached goes first,
+ * then whole chains from the depot/arena (one lock acquisition each, however
+ * many chains), then the rest of the thread's current block; only after that
+ * are whole fresh blocks carved straight into the array.
+ * Returns how many objects were allocated, which is only less than n if the
+ * system runs out of memory. */
+size_t INTERNAL qt_mpool_alloc_bulk(qt_mpool pool,
+                                    void   **ptrs,
+                                    size_t   n)
+{   /*{{{*/
+    qt_mpool_threadlocal_cache_t *tc;
+    const size_t                  items_per_alloc = pool->items_per_alloc;
+    size_t                        got             = 0;
+
+    qthread_debug(MPOOL_CALLS, "pool:%p n:%zu\n", pool, n);
+    qassert_ret((pool != NULL), 0);
+    qassert_ret((ptrs != NULL || n == 0), 0);
+
+    tc = qt_mpool_internal_getcache(pool);
+    while (got < n && tc->cache) {
+        ptrs[got++] = qt_mpool_internal_alloc(pool, tc);
+    }
+    /* recycled objects before fresh ones, so constructors only run when the
+     * pool really has to grow */
+    if (n - got >= items_per_alloc) {
+        qt_mpool_cache_t *item;
+        size_t            start = got;
+
+        if (tc->block == NULL) {
+            /* the cache is empty, so this is a refill like any other */
+            tc->node = qt_mpool_internal_mynode(pool);
+        }
+        qt_mpool_internal_chains_acquire(pool, tc->node, (n - got) / items_per_alloc, &item);
+        while (item) {
+            qt_mpool_cache_t *next = item->next;
+
+            ALLOC_SCRIBBLE(item, pool->scribble_size);
+            ptrs[got++] = (uint8_t *)item + pool->obj_offset;
+            item        = next;
+        }
+        QT_MPOOL_PROFILE_ALLOC(pool, tc, got - start, 0);
+    }
+    while (got < n && tc->block) {
+        ptrs[got++] = qt_mpool_internal_alloc(pool, tc);
+    }
+    while (n - got >= items_per_alloc) {
+        uint8_t *p = qt_mpool_internal_block_alloc(pool, tc->node);
+
+        if (p == NULL) {
+            return got;
+        }
+        for (size_t i = 0; i < items_per_alloc; ++i, p += pool->item_size) {
+            ALLOC_SCRIBBLE(p, pool->scribble_size);
+            ptrs[got++] = qt_mpool_internal_fresh(pool, p);
+        }
+        QT_MPOOL_PROFILE_ALLOC(pool, tc, items_per_alloc, 0);
+    }
+    while (got < n) {
+        void *obj = qt_mpool_internal_alloc(pool, tc);
+
+        if (obj == NULL) {
+            break;
+        }
+        ptrs[got++] = obj;
+    }
+    return got;
+} /*}}}*/
+
+void INTERNAL qt_mpool_free_bulk(qt_mpool     pool,
+                                 void *const *ptrs,
+                                 size_t       n)
+{   /*{{{*/
+    qt_mpool_threadlocal_cache_t *tc;
+
+    qthread_debug(MPOOL_CALLS, "pool:%p n:%zu\n", pool, n);
+    qassert_retvoid((pool != NULL));
+    if (n == 0) {
+        return;
+    }
+    qassert_retvoid((ptrs != NULL));
+    tc = qt_mpool_internal_getcache(pool);
+    for (size_t i = 0; i < n; ++i) {
+        assert(ptrs[i] != NULL);
+        qt_mpool_internal_free(pool, tc, ptrs[i]);
+    }
+} /*}}}*/
+
+/* Gives fully-idle blocks back to the system until no more than `keep` chains
+ * are left in the arena. A block is fully idle when every one of its items is
+ * sitting in the arena's reuse list; items in thread-local caches (or still
+ * uncarved) keep their block alive. Occupancy is counted here, while the
+ * arena is locked, rather than on every alloc/free. Returns the number of
+ * bytes released. */
+static size_t qt_mpool_internal_trim_arena(qt_mpool     pool,
+                                           unsigned int node,
+                                           size_t       keep)
+{                                      /*{{{ */
+    qt_mpool_arena_t *arena           = &pool->arenas[node];
+    const size_t      items_per_alloc = pool->items_per_alloc;
+    qt_mpool_cache_t *item, *next;
+    qt_mpool_cache_t *head  = NULL, *chain = NULL, *prev = NULL, *whole = NULL;
+    qt_mpool_block_t *doomed = NULL;
+    size_t            chain_len = 0, nchains = 0, want, released = 0;
+    qt_mpool_cache_t *lists[2];
+
+    /* pool_lock keeps two trims from using the idle counts at once, and
+     * protects the block list */
+    QTHREAD_FASTLOCK_LOCK(&pool->pool_lock);
+    qt_mpool_internal_arena_lock(arena);
+    if (arena->reuse_chains <= keep) {
+        qt_mpool_internal_arena_unlock(arena);
+        QTHREAD_FASTLOCK_UNLOCK(&pool->pool_lock);
+        return 0;
+    }
+    want = arena->reuse_chains - keep;
+    /* the items in partial batches are idle too */
+    lists[0] = arena->reuse_pool;
+    lists[1] = arena->partial;
+    qthread_debug(MPOOL_BEHAVIOR, "pool:%p node:%u chains:%zu keep:%zu\n", pool, node, arena->reuse_chains, keep);
+    /* first pass: count idle items per block */
+    for (int l = 0; l < 2; ++l) {
+        for (item = lists[l]; item; item = item->next) {
+            qt_mpool_internal_block_of(pool, item)->idle++;
+        }
+    }
+    /* second pass: drop the items of the blocks being released, and relink
+     * the rest into fresh chains; whatever is left over (fewer than
+     * items_per_alloc) becomes the new partial list */
+    for (int l = 0; l < 2; ++l) {
+        for (item = lists[l]; item; item = next) {
+            qt_mpool_block_t *b = qt_mpool_internal_block_of(pool, item);
+
+            next = item->next;
+            if (b->idle == items_per_alloc) {
+                if (want > 0) {
+                    --want;
+                    b->idle = QT_MPOOL_BLOCK_DOOMED;
+                    /* pull it out of the pool's block list */
+                    if (b->prev) {
+                        b->prev->next = b->next;
+                    } else {
+                        pool->blocks = b->next;
+                    }
+                    if (b->next) {
+                        b->next->prev = b->prev;
+                    }
+                    b->next = doomed;
+                    doomed  = b;
+                } else {
+                    b->idle = 0;
+                }
+            } else if (b->idle != QT_MPOOL_BLOCK_DOOMED) {
+                b->idle = 0;
+            }
+            if (b->idle == QT_MPOOL_BLOCK_DOOMED) {
+                continue;
+            }
+            if (chain_len == 0) {
+                chain = item;
+                if (prev) {
+                    prev->next = item;
+                } else {
+                    head = item;
+                }
+            } else {
+                prev->next = item;
+            }
+            prev = item;
+            if (++chain_len == items_per_alloc) {
+                /* every item in a chain must know where the chain ends, since
+                 * any of them may end up at the top of a thread's cache */
+                for (qt_mpool_cache_t *c = chain; c != item; c = c->next) {
+                    c->block_tail = item;
+                }
+                item->block_tail = item;
+                chain_len        = 0;
+                whole            = item;
+                nchains++;
+            }
+        }
+    }
+    if (prev) {
+        prev->next = NULL;
+    }
+    if (chain_len) {
+        /* cut the leftovers off the end of the last whole chain */
+        if (whole) {
+            whole->next = NULL;
+        } else {
+            head = NULL;
+        }
+        arena->partial = chain;
+    } else {
+        arena->partial = NULL;
+    }
+    arena->partial_count = chain_len;
+    arena->reuse_pool    = head;
+    arena->reuse_chains  = nchains;
+    while (doomed) {
+        qt_mpool_block_t *b = doomed;
+
+        doomed = b->next;
+        released += pool->alloc_size;
+        pool->nblocks--;
+        if (pool->dtor) {
+            qt_mpool_internal_destruct(pool, b, items_per_alloc);
+        }
+        qt_mpool_internal_aligned_free(b, pool->alloc_size);
+    }
+    /* if what's left is too fragmented to release, don't rescan it on
+     * every push */
+    if (pool->high_water) {
+        arena->trim_at = arena->reuse_chains + (pool->high_water - pool->high_water / 2);
+        if (arena->trim_at < pool->high_water) {
+            arena->trim_at = pool->high_water;
+        }
+    }
+    qt_mpool_internal_arena_unlock(arena);
+    QTHREAD_FASTLOCK_UNLOCK(&pool->pool_lock);
+    qthread_debug(MPOOL_BEHAVIOR, "pool:%p node:%u released %zu bytes\n", pool, node, released);
+    return released;
+}                                      /*}}} */
+
+size_t INTERNAL qt_mpool_trim(qt_mpool pool)
 {                                      /*{{{ */
+    size_t released = 0;
+
     qthread_debug(MPOOL_CALLS, "pool:%p\n", pool);
+    qassert_ret((pool != NULL), 0);
+    /* items freed on the wrong node may still be waiting to go home */
+    qt_mpool_internal_remote_flush_all(pool);
+    /* chains parked in the shepherds' depots can't be released from there */
+    for (unsigned int d = 0; d < pool->ndepots; ++d) {
+        qt_mpool_depot_t *depot = &pool->depots[d];
+        qt_mpool_cache_t *chains;
+
+        QTHREAD_FASTLOCK_LOCK(&depot->lock);
+        chains        = depot->chains;
+        depot->chains = NULL;
+        depot->count  = 0;
+        QTHREAD_FASTLOCK_UNLOCK(&depot->lock);
+        while (chains) {
+            qt_mpool_cache_t *next = chains->block_tail->next;
+
+            qt_mpool_internal_arena_push(pool, depot->node, chains);
+            chains = next;
+        }
+    }
+    for (unsigned int a = 0; a < pool->narenas; ++a) {
+        released += qt_mpool_internal_trim_arena(pool, a, 0);
+    }
+    return released;
+}                                      /*}}} */
+
+size_t INTERNAL qt_mpool_trim_all(void)
+{                                      /*{{{ */
+    size_t released = 0;
+
+    pthread_mutex_lock(&all_pools_lock);
+    for (qt_mpool pool = all_pools; pool; pool = pool->next_pool) {
+        released += qt_mpool_trim(pool);
+    }
+    pthread_mutex_unlock(&all_pools_lock);
+    return released;
+}                                      /*}}} */
+
+void INTERNAL qt_mpool_set_name(qt_mpool    pool,
+                                const char *name)
+{                                      /*{{{ */
     qassert_retvoid((pool != NULL));
-    while (pool->alloc_list) {
-        unsigned int i = 0;
+    pool->name = name;
+}                                      /*}}} */
 
-        void *p = pool->alloc_list[0];
+/* Fills in up to `max` entries of `stats`, one per pool (newest first), and
+ * returns how many were filled in; with a NULL array, just counts the pools.
+ * The per-thread counters are read without stopping anyone, so the numbers
+ * are only a snapshot. */
+size_t INTERNAL qt_mpool_stats(qthread_pool_stats_t *stats,
+                               size_t                max)
+{                                      /*{{{ */
+    size_t count = 0;
+
+    pthread_mutex_lock(&all_pools_lock);
+    for (qt_mpool pool = all_pools; pool; pool = pool->next_pool) {
+        qthread_pool_stats_t *st;
 
-        while (p && i < (pagesize / sizeof(void *) - 1)) {
-            qt_mpool_internal_aligned_free(p,
-                                           pool->alignment);
-            i++;
-            p = pool->alloc_list[i];
+        if (stats == NULL) {
+            ++count;
+            continue;
+        }
+        if (count == max) {
+            break;
+        }
+        st                    = &stats[count++];
+        st->name              = pool->name;
+        st->item_size         = pool->item_size - pool->obj_offset;
+        st->reserved          = pool->nblocks * pool->alloc_size;
+        /* objects handed out before profiling was switched on can make
+         * this dip below zero */
+        st->live              = ((saligned_t)pool->live < 0) ? 0 : pool->live;
+        st->peak              = pool->peak;
+        st->allocs            = 0;
+        st->cache_hits        = 0;
+        st->lock_acquisitions = 0;
+        st->lock_contended    = 0;
+        for (qt_mpool_threadlocal_cache_t *tc = pool->caches; tc; tc = tc->next) {
+            st->allocs     += tc->allocs;
+            st->cache_hits += tc->hits;
+        }
+        for (unsigned int a = 0; a < pool->narenas; ++a) {
+            st->lock_acquisitions += pool->arenas[a].acquisitions;
+            st->lock_contended    += pool->arenas[a].contended;
         }
-        p                = pool->alloc_list;
-        pool->alloc_list = pool->alloc_list[pagesize / sizeof(void *) - 1];
-        FREE_SCRIBBLE(p, pagesize);
-        qthread_internal_aligned_free(p, pagesize);
+    }
+    pthread_mutex_unlock(&all_pools_lock);
+    return count;
+}                                      /*}}} */
+
+void INTERNAL qt_mpool_destroy(qt_mpool pool)
+{                                      /*{{{ */
+    qthread_debug(MPOOL_CALLS, "pool:%p\n", pool);
+    qassert_retvoid((pool != NULL));
+    pthread_mutex_lock(&all_pools_lock);
+    if (pool->prev_pool) {
+        pool->prev_pool->next_pool = pool->next_pool;
+    } else {
+        all_pools = pool->next_pool;
+    }
+    if (pool->next_pool) {
+        pool->next_pool->prev_pool = pool->prev_pool;
+    }
+    pthread_mutex_unlock(&all_pools_lock);
+    /* the thread caches are going away; send their remote batches home
+     * while the arenas and blocks are still there */
+    qt_mpool_internal_remote_flush_all(pool);
+    if (pool->dtor) {
+        qt_mpool_block_t *b;
+
+        /* every item has been carved except the rest of each thread's
+         * current block */
+        for (b = pool->blocks; b; b = b->next) {
+            b->idle = pool->items_per_alloc;
+        }
+        for (qt_mpool_threadlocal_cache_t *tc = pool->caches; tc; tc = tc->next) {
+            if (tc->block) {
+                qt_mpool_internal_block_of(pool, tc->block)->idle = tc->i;
+            }
+        }
+        for (b = pool->blocks; b; b = b->next) {
+            qt_mpool_internal_destruct(pool, b, b->idle);
+        }
+    }
+    while (pool->blocks) {
+        qt_mpool_block_t *b = pool->blocks;
+
+        pool->blocks = b->next;
+        qt_mpool_internal_aligned_free(b, pool->alloc_size);
     }
     qthread_debug(MPOOL_DETAILS, "begin free TLS caches\n");
     while (pool->caches) {
         qt_mpool_threadlocal_cache_t *freeme = pool->caches;
         pool->caches = freeme->next;
+        if (freeme->remote) {
+            QTHREAD_FASTLOCK_DESTROY(freeme->remote_lock);
+            free(freeme->remote);
+        }
         qthread_internal_aligned_free(freeme, CACHELINE_WIDTH);
     }
     qthread_debug(MPOOL_DETAILS, "done freeing TLS caches\n");
@@ -449,7 +1380,16 @@ void INTERNAL qt_mpool_destroy(qt_mpool pool)
     pthread_key_delete(pool->threadlocal_cache);
 #endif
     QTHREAD_FASTLOCK_DESTROY(pool->pool_lock);
-    QTHREAD_FASTLOCK_DESTROY(pool->reuse_lock);
+    for (unsigned int a = 0; a < pool->narenas; ++a) {
+        QTHREAD_FASTLOCK_DESTROY(pool->arenas[a].reuse_lock);
+    }
+    qthread_internal_aligned_free(pool->arenas, CACHELINE_WIDTH);
+    if (pool->depots) {
+        for (unsigned int d = 0; d < pool->ndepots; ++d) {
+            QTHREAD_FASTLOCK_DESTROY(pool->depots[d].lock);
+        }
+        qthread_internal_aligned_free(pool->depots, CACHELINE_WIDTH);
+    }
     VALGRIND_DESTROY_MEMPOOL(pool);
     FREE(pool, sizeof(struct qt_mpool_s));
 }                                      /*}}} */
@@ -4,6 +4,7 @@
 
 /* System Headers */
 #include <stdlib.h>
+#include <string.h> /* for memcpy() */
 
 /* Installed Headers */
 #include <qthread/qthread.h>
@@ -16,15 +17,17 @@
 #include "qt_initialized.h" // for qthread_library_initialized
 #include "qloop_innards.h"
 #include "qt_expect.h"
+#include "qt_macros.h"
 #include "qt_asserts.h"
 #include "qt_debug.h"
 #include "qt_aligned_alloc.h"
 #include "qt_barrier.h"
+#include "qt_threadqueues.h"     // for qt_threadqueue_advisory_queuelen
+#include "qt_shepherd_innards.h" // for qthread_internal_getshep
+#include "qt_atomics.h"          // for QTHREAD_FASTLOCK_*
 
 #ifdef QTHREAD_USE_ROSE_EXTENSIONS
 # include <stdio.h>
-# include "qt_atomics.h"
-# include "qt_threadqueues.h" // for qthread_steal_disable
 #endif
 
 #ifdef QTHREAD_RCRTOOL
@@ -688,6 +691,437 @@ void API_FUNC qt_loop_balance_sinc(const size_t    start,
     qt_loop_balance_inner(start, stop, func, argptr, 0, SINC_T);
 }                                      /*}}} */
 
+/* Lazy binary splitting: each task keeps its whole range private and works
+ * through it grain iterations at a time. Between grains it peeks at its
+ * shepherd's ready queue; if that queue is empty, no other worker has
+ * anything local to steal, so the upper half of the remaining range is
+ * handed out as a new task. Balanced loops therefore split only about as
+ * often as there are idle workers, while irregular loops keep splitting
+ * wherever the leftover work happens to be. */
+struct qt_loop_lazy_s {
+    qt_loop_f  func;
+    void      *arg;
+    size_t     grain;
+    qt_sinc_t  sinc;
+};
+
+struct qt_loop_lazy_range {
+    struct qt_loop_lazy_s *loop;
+    size_t                 startat, stopat;
+};
+
+static aligned_t qt_loop_lazy_wrapper(const struct qt_loop_lazy_range *arg);
+
+static void qt_loop_lazy_run(struct qt_loop_lazy_s *const loop,
+                             size_t                       startat,
+                             size_t                       stopat)
+{                                      /*{{{ */
+    const size_t grain = loop->grain;
+
+    while (startat < stopat) {
+        if (stopat - startat >= 2 * grain) {
+            qthread_shepherd_t *myshep = qthread_internal_getshep();
+
+            if (qt_threadqueue_advisory_queuelen(myshep->ready) == 0) {
+                struct qt_loop_lazy_range half;
+
+                half.loop    = loop;
+                half.stopat  = stopat;
+                half.startat = stopat = startat + (stopat - startat) / 2;
+                qt_sinc_expect(&loop->sinc, 1);
+                /* no target shepherd, so that the half stays stealable; and
+                 * since it then lands in the spawn cache, flush that into the
+                 * shepherd's queue so that thieves can see it immediately */
+                qassert(qthread_spawn((qthread_f)qt_loop_lazy_wrapper,
+                                      &half, sizeof(half),
+                                      NULL,
+                                      0, NULL,
+                                      NO_SHEPHERD,
+                                      0), QTHREAD_SUCCESS);
+#ifdef QTHREAD_USE_SPAWNCACHE
+                qt_spawncache_flush(myshep->ready);
+#endif
+                continue;
+            }
+        }
+        {
+            const size_t chunkend = (stopat - startat > grain) ? (startat + grain) : stopat;
+
+            loop->func(startat, chunkend, loop->arg);
+            startat = chunkend;
+        }
+    }
+}                                      /*}}} */
+
+static aligned_t qt_loop_lazy_wrapper(const struct qt_loop_lazy_range *arg)
+{                                      /*{{{ */
+    struct qt_loop_lazy_s *const loop = arg->loop;
+
+    qt_loop_lazy_run(loop, arg->startat, arg->stopat);
+    qt_sinc_submit(&loop->sinc, NULL);
+    return 0;
+}                                      /*}}} */
+
+void API_FUNC qt_loop_balance_lazy_grain(const size_t    start,
+                                         const size_t    stop,
+                                         size_t          grain,
+                                         const qt_loop_f func,
+                                         void           *argptr)
+{                                      /*{{{ */
+    struct qt_loop_lazy_s loop;
+    const size_t          workers = qthread_num_workers();
+
+    assert(func);
+    assert(qthread_library_initialized);
+
+    if (stop <= start) { return; }
+    if (grain == 0) {
+        /* small enough that the last half-split still leaves everyone some
+         * work, large enough that the queue check is lost in the noise */
+        grain = (stop - start) / (workers * 128);
+        if (grain == 0) { grain = 1; }
+    }
+    if ((workers == 1) || (stop - start < 2 * grain)) {
+        func(start, stop, argptr);
+        return;
+    }
+
+    loop.func  = func;
+    loop.arg   = argptr;
+    loop.grain = grain;
+    qt_sinc_init(&loop.sinc, 0, NULL, NULL, 1);
+    if (qthread_internal_getshep() != NULL) {
+        /* the caller is itself a task: it starts on the whole range */
+        qt_loop_lazy_run(&loop, start, stop);
+        qt_sinc_submit(&loop.sinc, NULL);
+    } else {
+        struct qt_loop_lazy_range whole = { &loop, start, stop };
+
+        qassert(qthread_spawn((qthread_f)qt_loop_lazy_wrapper,
+                              &whole, sizeof(whole),
+                              NULL,
+                              0, NULL,
+                              NO_SHEPHERD,
+                              0), QTHREAD_SUCCESS);
+    }
+    qt_sinc_wait(&loop.sinc, NULL);
+    qt_sinc_fini(&loop.sinc);
+}                                      /*}}} */
+
+void API_FUNC qt_loop_balance_lazy(const size_t    start,
+                                   const size_t    stop,
+                                   const qt_loop_f func,
+                                   void           *argptr)
+{                                      /*{{{ */
+    qt_loop_balance_lazy_grain(start, stop, 0, func, argptr);
+}                                      /*}}} */
+
+/* Nested loops: when a loop body starts a loop of its own, spawning a full
+ * set of tasks and then blocking until they finish (as qt_loop_balance()
+ * does) oversubscribes the machine and pays the spawn cost at every level.
+ * Instead, the range is cut into a few chunks per worker that are claimed
+ * from a shared counter. The caller pushes a handful of helper tasks onto its
+ * own shepherd's queue, where idle workers can steal them, and then claims
+ * chunks itself (help-first). If the outer loop already keeps the queue busy,
+ * no helpers are pushed at all. The caller only blocks once every chunk has
+ * been claimed, and then only for the ones that thieves are still running.
+ * Helpers that start after the work is gone simply exit, so the shared state
+ * is reference counted rather than living on the caller's stack. */
+#ifndef QT_LOOP_NESTED_CHUNKS_PER_WORKER
+# define QT_LOOP_NESTED_CHUNKS_PER_WORKER 4
+#endif
+
+struct qt_loop_nested_s {
+    qt_loop_f func;
+    void     *arg;
+    size_t    start, each, extra, nchunks;
+    aligned_t next;                    /* next unclaimed chunk */
+    aligned_t done;                    /* chunks finished */
+    aligned_t alldone;                 /* full once done == nchunks */
+    aligned_t refs;
+};
+
+static void qt_loop_nested_release(struct qt_loop_nested_s *const loop)
+{                                      /*{{{ */
+    if (qthread_incr(&loop->refs, -1) == 1) {
+        FREE(loop, sizeof(struct qt_loop_nested_s));
+    }
+}                                      /*}}} */
+
+static void qt_loop_nested_help(struct qt_loop_nested_s *const loop)
+{                                      /*{{{ */
+    const size_t nchunks = loop->nchunks;
+    aligned_t    c;
+
+    while ((c = qthread_incr(&loop->next, 1)) < nchunks) {
+        /* the first extra chunks get one more iteration each */
+        const size_t startat = loop->start + c * loop->each + ((c < loop->extra) ? c : loop->extra);
+        const size_t stopat  = startat + loop->each + ((c < loop->extra) ? 1 : 0);
+
+        loop->func(startat, stopat, loop->arg);
+        if (qthread_incr(&loop->done, 1) + 1 == nchunks) {
+            qthread_fill(&loop->alldone);
+        }
+    }
+}                                      /*}}} */
+
+static aligned_t qt_loop_nested_helper(struct qt_loop_nested_s *const *arg)
+{                                      /*{{{ */
+    struct qt_loop_nested_s *const loop = *arg;
+
+    qt_loop_nested_help(loop);
+    qt_loop_nested_release(loop);
+    return 0;
+}                                      /*}}} */
+
+void API_FUNC qt_loop_balance_nested(const size_t    start,
+                                     const size_t    stop,
+                                     const qt_loop_f func,
+                                     void           *argptr)
+{                                      /*{{{ */
+    const size_t             workers = qthread_num_workers();
+    qthread_shepherd_t      *myshep;
+    struct qt_loop_nested_s *loop;
+    size_t                   nchunks, helpers;
+
+    assert(func);
+    assert(qthread_library_initialized);
+
+    if (stop <= start) { return; }
+    myshep = qthread_internal_getshep();
+    if (myshep == NULL) {
+        /* not inside a task, so there is no team to reuse */
+        qt_loop_balance(start, stop, func, argptr);
+        return;
+    }
+    nchunks = workers * QT_LOOP_NESTED_CHUNKS_PER_WORKER;
+    if (nchunks > stop - start) { nchunks = stop - start; }
+    if ((workers == 1) || (nchunks == 1) ||
+        (qt_threadqueue_advisory_queuelen(myshep->ready) > 0)) {
+        /* nobody is idle enough to take any of it */
+        func(start, stop, argptr);
+        return;
+    }
+    helpers = (nchunks - 1 < workers - 1) ? (nchunks - 1) : (workers - 1);
+
+    loop = MALLOC(sizeof(struct qt_loop_nested_s));
+    assert(loop);
+    loop->func    = func;
+    loop->arg     = argptr;
+    loop->start   = start;
+    loop->nchunks = nchunks;
+    loop->each    = (stop - start) / nchunks;
+    loop->extra   = (stop - start) - loop->each * nchunks;
+    loop->next    = 0;
+    loop->done    = 0;
+    loop->refs    = helpers + 1;
+    qthread_empty(&loop->alldone);
+    for (size_t i = 0; i < helpers; i++) {
+        /* no target shepherd, so that the helpers can be stolen */
+        qassert(qthread_spawn((qthread_f)qt_loop_nested_helper,
+                              &loop, sizeof(loop),
+                              NULL,
+                              0, NULL,
+                              NO_SHEPHERD,
+                              0), QTHREAD_SUCCESS);
+    }
+#ifdef QTHREAD_USE_SPAWNCACHE
+    /* they land in the spawn cache; push them into the shepherd's queue so
+     * that thieves can see them right away */
+    qt_spawncache_flush(myshep->ready);
+#endif
+    qt_loop_nested_help(loop);
+    /* every chunk has been claimed; wait for any that were stolen */
+    qthread_readFF(NULL, &loop->alldone);
+    qt_loop_nested_release(loop);
+}                                      /*}}} */
+
+/* Affinity replay: iterative codes run the same loop over the same range
+ * over and over, and with qt_loop_balance() chunk i may run on a different
+ * shepherd every time, which wastes whatever that chunk left in cache (and,
+ * with first-touch placement, puts it on the wrong NUMA node). A handle
+ * remembers which shepherd actually ran each chunk the first time, and every
+ * later run queues that chunk on the same shepherd. Chunks are never pinned:
+ * a small dispatcher on each shepherd spawns that shepherd's chunks into its
+ * own queue, where idle workers can still steal them if it falls behind.
+ * Stealing on the first run changes what is recorded; on later runs it
+ * doesn't. */
+struct qt_loop_affinity_s {
+    size_t                 start, each, extra, nchunks;
+    qthread_shepherd_id_t *shep;       /* NULL until the first run */
+    qt_sinc_t              sinc;
+};
+
+struct qt_loop_affinity_chunk {
+    qt_loop_affinity_t    *h;
+    qt_loop_f              func;
+    void                  *arg;
+    qthread_shepherd_id_t *record;     /* NULL when replaying */
+    qthread_shepherd_id_t *place;      /* NULL on the first run */
+    qthread_shepherd_id_t  shep;       /* whose chunks a dispatcher spawns */
+    qthread_shepherd_id_t  nsheps;     /* for the first run's round-robin */
+    size_t                 id;
+};
+
+static aligned_t qt_loop_affinity_wrapper(const struct qt_loop_affinity_chunk *arg)
+{                                      /*{{{ */
+    qt_loop_affinity_t *const h       = arg->h;
+    const size_t              id      = arg->id;
+    const size_t              startat = h->start + id * h->each + ((id < h->extra) ? id : h->extra);
+    const size_t              stopat  = startat + h->each + ((id < h->extra) ? 1 : 0);
+
+    if (arg->record) {
+        arg->record[id] = qthread_shep();
+    }
+    arg->func(startat, stopat, arg->arg);
+    qt_sinc_submit(&h->sinc, NULL);
+    return 0;
+}                                      /*}}} */
+
+/* the shepherd a chunk is queued on: round-robin on the first run, and where
+ * it ran the first time after that */
+static QINLINE qthread_shepherd_id_t qt_loop_affinity_target(const qthread_shepherd_id_t *place,
+                                                             size_t                       id,
+                                                             qthread_shepherd_id_t        nsheps)
+{                                      /*{{{ */
+    return place ? place[id] : (qthread_shepherd_id_t)(id % nsheps);
+}                                      /*}}} */
+
+static aligned_t qt_loop_affinity_dispatch(const struct qt_loop_affinity_chunk *arg)
+{                                      /*{{{ */
+    struct qt_loop_affinity_chunk c = *arg;
+
+    /* if c.shep has been disabled, this runs (and queues the chunks)
+     * somewhere else */
+    for (c.id = 0; c.id < c.h->nchunks; c.id++) {
+        if (qt_loop_affinity_target(c.place, c.id, c.nsheps) != c.shep) { continue; }
+        /* no target shepherd, so that it lands in this shepherd's queue but
+         * can still be stolen */
+        qassert(qthread_spawn((qthread_f)qt_loop_affinity_wrapper,
+                              &c, sizeof(c),
+                              NULL,
+                              0, NULL,
+                              NO_SHEPHERD,
+                              0), QTHREAD_SUCCESS);
+    }
+#ifdef QTHREAD_USE_SPAWNCACHE
+    qt_spawncache_flush(qthread_internal_getshep()->ready);
+#endif
+    /* the dispatchers are counted too, so that the handle outlives them */
+    qt_sinc_submit(&c.h->sinc, NULL);
+    return 0;
+}                                      /*}}} */
+
+qt_loop_affinity_t API_FUNC *qt_loop_affinity_create(const size_t start,
+                                                     const size_t stop)
+{                                      /*{{{ */
+    qt_loop_affinity_t *h;
+    const size_t        workers = qthread_num_workers();
+
+    assert(qthread_library_initialized);
+
+    h = MALLOC(sizeof(qt_loop_affinity_t));
+    assert(h);
+    h->start   = start;
+    h->nchunks = (stop <= start) ? 0 : ((stop - start > workers) ? workers : (stop - start));
+    h->each    = h->nchunks ? ((stop - start) / h->nchunks) : 0;
+    h->extra   = h->nchunks ? ((stop - start) - h->each * h->nchunks) : 0;
+    h->shep    = NULL;
+    qt_sinc_init(&h->sinc, 0, NULL, NULL, 0);
+    return h;
+}                                      /*}}} */
+
+void API_FUNC qt_loop_affinity_run(qt_loop_affinity_t *h,
+                                   const qt_loop_f     func,
+                                   void               *argptr)
+{                                      /*{{{ */
+    /* recorded shepherds may since have been disabled, so this covers all
+     * of them, not just the active ones */
+    const qthread_shepherd_id_t   nsheps = qthread_readstate(TOTAL_SHEPHERDS);
+    struct qt_loop_affinity_chunk c;
+    uint8_t                      *used;
+    size_t                        dispatchers = 0;
+
+    assert(h);
+    assert(func);
+
+    if (h->nchunks == 0) { return; }
+    c.h      = h;
+    c.func   = func;
+    c.arg    = argptr;
+    c.record = NULL;
+    c.place  = h->shep;
+    c.nsheps = qthread_num_shepherds();
+    if (h->shep == NULL) {
+        /* the first run writes down where the chunks actually run */
+        c.record = MALLOC(h->nchunks * sizeof(qthread_shepherd_id_t));
+        assert(c.record);
+    }
+    used = MALLOC(nsheps * sizeof(uint8_t));
+    assert(used);
+    memset(used, 0, nsheps * sizeof(uint8_t));
+    for (size_t id = 0; id < h->nchunks; id++) {
+        used[qt_loop_affinity_target(c.place, id, c.nsheps)] = 1;
+    }
+    for (qthread_shepherd_id_t shep = 0; shep < nsheps; shep++) {
+        dispatchers += used[shep];
+    }
+    qt_sinc_reset(&h->sinc, h->nchunks + dispatchers);
+    for (c.shep = 0; c.shep < nsheps; c.shep++) {
+        if (!used[c.shep]) { continue; }
+        qassert(qthread_spawn((qthread_f)qt_loop_affinity_dispatch,
+                              &c, sizeof(c),
+                              NULL,
+                              0, NULL,
+                              c.shep,
+                              0), QTHREAD_SUCCESS);
+    }
+    FREE(used, nsheps * sizeof(uint8_t));
+    qt_sinc_wait(&h->sinc, NULL);
+    if (c.record) {
+        h->shep = c.record;
+    }
+}                                      /*}}} */
+
+qthread_shepherd_id_t API_FUNC qt_loop_affinity_shepof(const qt_loop_affinity_t *h,
+                                                       const size_t              index)
+{                                      /*{{{ */
+    size_t id;
+
+    assert(h);
+
+    if ((h->shep == NULL) || (index < h->start) ||
+        (index - h->start >= h->nchunks * h->each + h->extra)) {
+        return NO_SHEPHERD;
+    }
+    /* the first extra chunks are one longer than the rest */
+    if (index - h->start < h->extra * (h->each + 1)) {
+        id = (index - h->start) / (h->each + 1);
+    } else {
+        id = h->extra + (index - h->start - h->extra * (h->each + 1)) / h->each;
+    }
+    return h->shep[id];
+}                                      /*}}} */
+
+void API_FUNC qt_loop_affinity_reset(qt_loop_affinity_t *h)
+{                                      /*{{{ */
+    assert(h);
+
+    if (h->shep) {
+        FREE(h->shep, h->nchunks * sizeof(qthread_shepherd_id_t));
+        h->shep = NULL;
+    }
+}                                      /*}}} */
+
+void API_FUNC qt_loop_affinity_destroy(qt_loop_affinity_t *h)
+{                                      /*{{{ */
+    assert(h);
+
+    qt_loop_affinity_reset(h);
+    qt_sinc_fini(&h->sinc);
+    FREE(h, sizeof(qt_loop_affinity_t));
+}                                      /*}}} */
+
 struct qloopaccum_wrapper_args {
     qt_loopr_f     func;
     size_t         startat, stopat, id, level, spawnthreads;
@@ -947,6 +1381,391 @@ void API_FUNC qt_loopaccum_balance_dc(const size_t     start,
     qt_loopaccum_balance_inner(start, stop, size, out, func, argptr, acc, 0, DONECOUNT);
 }                                      /*}}} */
 
+/* Scans, compaction and partitioning all follow the same pattern: the input
+ * is cut into cache-sized tiles, each tile is reduced to a single value, each
+ * tile needs the combination of every earlier tile's value (its "carry"), and
+ * then the tile is processed again using that carry. Rather than separating
+ * those phases with a barrier, this uses a decoupled look-back: one task per
+ * worker (started with qt_loop_balance()) claims tiles in order from a shared
+ * counter, publishes the tile's aggregate, then walks backwards over its
+ * predecessors, combining aggregates until it finds one that has already
+ * published its inclusive prefix. Since tiles are claimed in order, the
+ * predecessors are always being worked on, and the second pass over a tile
+ * usually finds it still in cache. Waiting for a predecessor's aggregate
+ * uses its FEB, so a waiting task gives its worker up rather than spinning. */
+#ifndef QT_SCAN_TILE_BYTES
+# define QT_SCAN_TILE_BYTES 32768
+#endif
+
+#define QT_SCAN_AGGREGATE 1
+#define QT_SCAN_PREFIX    2
+
+struct qt_scan_engine_s;
+typedef void (*qt_scan_tile_reduce_f)(struct qt_scan_engine_s *e,
+                                      size_t                   first,
+                                      size_t                   last,
+                                      void                    *agg);
+typedef void (*qt_scan_tile_apply_f)(struct qt_scan_engine_s *e,
+                                     size_t                   first,
+                                     size_t                   last,
+                                     const void              *carry,
+                                     uint8_t                 *scratch);
+
+struct qt_scan_engine_s {
+    size_t                count, tile, ntiles;
+    size_t                size;   /* of the carried values */
+    qt_accum_f            op;
+    qt_scan_tile_reduce_f reduce;
+    qt_scan_tile_apply_f  apply;
+    aligned_t             next;   /* next unclaimed tile */
+    aligned_t            *ready;  /* full once a tile's aggregate is published */
+    volatile uint8_t     *state;
+    uint8_t              *agg, *incl;
+
+    /* for the users of the engine */
+    const uint8_t        *in;
+    uint8_t              *out;
+    size_t                elemsize;
+    const void           *identity;
+    qt_pred_f             pred;
+    void                 *arg;
+};
+
+static void qt_scan_engine_worker(const size_t QUNUSED(startat),
+                                  const size_t QUNUSED(stopat),
+                                  void        *arg)
+{                                      /*{{{ */
+    struct qt_scan_engine_s *const e     = arg;
+    const size_t                   size  = e->size;
+    const size_t                   bytes = 2 * size + 2 * e->elemsize;
+    uint8_t *const                 carry = MALLOC(bytes);
+    uint8_t *const                 tmp   = carry + size;
+    uint8_t *const                 work  = tmp + size; /* for apply() */
+    aligned_t                      t;
+
+    assert(carry);
+    while ((t = qthread_incr(&e->next, 1)) < e->ntiles) {
+        const size_t   first = t * e->tile;
+        const size_t   last  = (t + 1 == e->ntiles) ? e->count : first + e->tile;
+        uint8_t *const agg   = e->agg + t * size;
+        uint8_t *const incl  = e->incl + t * size;
+
+        e->reduce(e, first, last, agg);
+        if (t == 0) {
+            memcpy(incl, agg, size);
+            MACHINE_FENCE;
+            e->state[0] = QT_SCAN_PREFIX;
+            qthread_fill(&e->ready[0]);
+            e->apply(e, first, last, NULL, work);
+            continue;
+        }
+        e->state[t] = QT_SCAN_AGGREGATE;
+        qthread_fill(&e->ready[t]);
+
+        /* look back; carry accumulates right to left, so each earlier value
+         * goes on the left of what has been collected so far */
+        for (size_t j = t - 1, have = 0;; j--) {
+            uint8_t state;
+
+            qthread_readFF(NULL, &e->ready[j]);
+            state = e->state[j];
+            MACHINE_FENCE;
+            if (have) {
+                memcpy(tmp, (state == QT_SCAN_PREFIX) ? e->incl + j * size : e->agg + j * size, size);
+                e->op(tmp, carry);
+                memcpy(carry, tmp, size);
+            } else {
+                memcpy(carry, (state == QT_SCAN_PREFIX) ? e->incl + j * size : e->agg + j * size, size);
+                have = 1;
+            }
+            if (state == QT_SCAN_PREFIX) { break; }
+            assert(j > 0);
+        }
+        memcpy(incl, carry, size);
+        e->op(incl, agg);
+        MACHINE_FENCE;
+        e->state[t] = QT_SCAN_PREFIX;
+
+        e->apply(e, first, last, carry, work);
+    }
+    FREE(carry, bytes);
+}                                      /*}}} */
+
+/* Runs the engine; on return, the inclusive prefix of the last tile (i.e. the
+ * reduction of everything) is in e->incl + (e->ntiles - 1) * e->size. */
+static void qt_scan_engine_run(struct qt_scan_engine_s *e)
+{                                      /*{{{ */
+    const size_t workers = qthread_num_workers();
+
+    e->tile = QT_SCAN_TILE_BYTES / e->elemsize;
+    if (e->tile == 0) { e->tile = 1; }
+    e->ntiles = (e->count + e->tile - 1) / e->tile;
+    e->next   = 0;
+    e->ready  = MALLOC(e->ntiles * sizeof(aligned_t));
+    e->state  = MALLOC(e->ntiles);
+    e->agg    = MALLOC(2 * e->ntiles * e->size);
+    assert(e->ready && e->state && e->agg);
+    e->incl = e->agg + e->ntiles * e->size;
+    for (size_t t = 0; t < e->ntiles; t++) {
+        e->state[t] = 0;
+        qthread_empty(&e->ready[t]);
+    }
+
+    if ((workers == 1) || (e->ntiles == 1)) {
+        qt_scan_engine_worker(0, 1, e);
+    } else {
+        qt_loop_balance(0, (e->ntiles < workers) ? e->ntiles : workers,
+                        qt_scan_engine_worker, e);
+    }
+    /* every tile filled its word, so no FEB state is left behind */
+    FREE(e->ready, e->ntiles * sizeof(aligned_t));
+    FREE((void *)e->state, e->ntiles);
+}                                      /*}}} */
+
+static void qt_scan_engine_fini(struct qt_scan_engine_s *e)
+{                                      /*{{{ */
+    FREE(e->agg, 2 * e->ntiles * e->size);
+}                                      /*}}} */
+
+/* qt_loop_scan */
+static void qt_scan_reduce(struct qt_scan_engine_s *e,
+                           size_t                   first,
+                           size_t                   last,
+                           void                    *agg)
+{                                      /*{{{ */
+    const size_t size = e->elemsize;
+
+    memcpy(agg, e->in + first * size, size);
+    for (size_t i = first + 1; i < last; i++) {
+        e->op(agg, e->in + i * size);
+    }
+}                                      /*}}} */
+
+static void qt_scan_apply_inclusive(struct qt_scan_engine_s *e,
+                                    size_t                   first,
+                                    size_t                   last,
+                                    const void              *carry,
+                                    uint8_t                 *run)
+{                                      /*{{{ */
+    const size_t size = e->elemsize;
+    size_t       i    = first;
+
+    if (carry) {
+        memcpy(run, carry, size);
+    } else {
+        memcpy(run, e->in + first * size, size);
+        memmove(e->out + first * size, run, size);
+        i++;
+    }
+    for (; i < last; i++) {
+        e->op(run, e->in + i * size);
+        memcpy(e->out + i * size, run, size);
+    }
+}                                      /*}}} */
+
+static void qt_scan_apply_exclusive(struct qt_scan_engine_s *e,
+                                    size_t                   first,
+                                    size_t                   last,
+                                    const void              *carry,
+                                    uint8_t                 *run)
+{                                      /*{{{ */
+    const size_t   size = e->elemsize;
+    uint8_t *const save = run + size; /* in case in == out */
+
+    memcpy(run, carry ? carry : e->identity, size);
+    for (size_t i = first; i < last; i++) {
+        memcpy(save, e->in + i * size, size);
+        memcpy(e->out + i * size, run, size);
+        e->op(run, save);
+    }
+}                                      /*}}} */
+
+void API_FUNC qt_loop_scan(const void        *in,
+                           void              *out,
+                           const size_t       count,
+                           const size_t       size,
+                           const qt_accum_f   op,
+                           const void        *identity,
+                           const qt_scan_type type)
+{                                      /*{{{ */
+    struct qt_scan_engine_s e;
+
+    assert(qthread_library_initialized);
+    assert(op);
+    assert(size > 0);
+    assert(type == QT_SCAN_INCLUSIVE || identity != NULL);
+
+    if (count == 0) { return; }
+    e.count    = count;
+    e.size     = size;
+    e.elemsize = size;
+    e.op       = op;
+    e.reduce   = qt_scan_reduce;
+    e.apply    = (type == QT_SCAN_INCLUSIVE) ? qt_scan_apply_inclusive : qt_scan_apply_exclusive;
+    e.in       = in;
+    e.out      = out;
+    e.identity = identity;
+    qt_scan_engine_run(&e);
+    qt_scan_engine_fini(&e);
+}                                      /*}}} */
+
+/* qt_compact and qt_partition carry a count of the elements that pass */
+static void qt_scan_count_add(void *restrict       a,
+                              const void *restrict b)
+{                                      /*{{{ */
+    *(size_t *)a += *(const size_t *)b;
+}                                      /*}}} */
+
+static void qt_scan_count_reduce(struct qt_scan_engine_s *e,
+                                 size_t                   first,
+                                 size_t                   last,
+                                 void                    *agg)
+{                                      /*{{{ */
+    const size_t size = e->elemsize;
+    size_t       n    = 0;
+
+    for (size_t i = first; i < last; i++) {
+        n += (e->pred(e->in + i * size, e->arg) != 0);
+    }
+    *(size_t *)agg = n;
+}                                      /*}}} */
+
+static void qt_compact_apply(struct qt_scan_engine_s *e,
+                             size_t                   first,
+                             size_t                   last,
+                             const void              *carry,
+                             uint8_t                 *QUNUSED(work))
+{                                      /*{{{ */
+    const size_t size = e->elemsize;
+    size_t       pos  = carry ? *(const size_t *)carry : 0;
+
+    for (size_t i = first; i < last; i++) {
+        if (e->pred(e->in + i * size, e->arg)) {
+            memcpy(e->out + (pos++) * size, e->in + i * size, size);
+        }
+    }
+}                                      /*}}} */
+
+size_t API_FUNC qt_compact(const void     *restrict in,
+                           void *restrict           out,
+                           const size_t             count,
+                           const size_t             size,
+                           const qt_pred_f          pred,
+                           void                    *arg)
+{                                      /*{{{ */
+    struct qt_scan_engine_s e;
+    size_t                  kept;
+
+    assert(qthread_library_initialized);
+    assert(pred);
+    assert(size > 0);
+
+    if (count == 0) { return 0; }
+    e.count    = count;
+    e.size     = sizeof(size_t);
+    e.elemsize = size;
+    e.op       = qt_scan_count_add;
+    e.reduce   = qt_scan_count_reduce;
+    e.apply    = qt_compact_apply;
+    e.in       = in;
+    e.out      = out;
+    e.pred     = pred;
+    e.arg      = arg;
+    qt_scan_engine_run(&e);
+    kept = *(size_t *)(e.incl + (e.ntiles - 1) * e.size);
+    qt_scan_engine_fini(&e);
+    return kept;
+}                                      /*}}} */
+
+/* Partitioning writes the passing elements to the front of a scratch array
+ * in order, and the failing ones to its back in reverse order (their
+ * position is simply the number of failures before them, counted from the
+ * end), then copies both runs back. */
+static void qt_partition_apply(struct qt_scan_engine_s *e,
+                               size_t                   first,
+                               size_t                   last,
+                               const void              *carry,
+                               uint8_t                 *QUNUSED(work))
+{                                      /*{{{ */
+    const size_t size = e->elemsize;
+    size_t       pos  = carry ? *(const size_t *)carry : 0;
+    size_t       fpos = first - pos;
+
+    for (size_t i = first; i < last; i++) {
+        const uint8_t *const src = e->in + i * size;
+
+        if (e->pred(src, e->arg)) {
+            memcpy(e->out + (pos++) * size, src, size);
+        } else {
+            memcpy(e->out + (e->count - 1 - fpos++) * size, src, size);
+        }
+    }
+}                                      /*}}} */
+
+struct qt_partition_copyback_s {
+    uint8_t       *base;
+    const uint8_t *tmp;
+    size_t         count, size, npass;
+};
+
+static void qt_partition_copyback(const size_t startat,
+                                  const size_t stopat,
+                                  void        *arg)
+{                                      /*{{{ */
+    const struct qt_partition_copyback_s *const c    = arg;
+    const size_t                                size = c->size;
+
+    for (size_t i = startat; i < stopat; i++) {
+        const size_t src = (i < c->npass) ? i : (c->count - 1 - (i - c->npass));
+
+        memcpy(c->base + i * size, c->tmp + src * size, size);
+    }
+}                                      /*}}} */
+
+size_t API_FUNC qt_partition(void           *base,
+                             const size_t    count,
+                             const size_t    size,
+                             const qt_pred_f pred,
+                             void           *arg)
+{                                      /*{{{ */
+    struct qt_scan_engine_s        e;
+    struct qt_partition_copyback_s c;
+    uint8_t                       *tmp;
+
+    assert(qthread_library_initialized);
+    assert(pred);
+    assert(size > 0);
+
+    if (count == 0) { return 0; }
+    tmp = MALLOC(count * size);
+    assert(tmp);
+    e.count    = count;
+    e.size     = sizeof(size_t);
+    e.elemsize = size;
+    e.op       = qt_scan_count_add;
+    e.reduce   = qt_scan_count_reduce;
+    e.apply    = qt_partition_apply;
+    e.in       = base;
+    e.out      = tmp;
+    e.pred     = pred;
+    e.arg      = arg;
+    qt_scan_engine_run(&e);
+    c.npass = *(size_t *)(e.incl + (e.ntiles - 1) * e.size);
+    qt_scan_engine_fini(&e);
+
+    c.base  = base;
+    c.tmp   = tmp;
+    c.count = count;
+    c.size  = size;
+    if ((qthread_num_workers() == 1) || (count * size <= QT_SCAN_TILE_BYTES)) {
+        qt_partition_copyback(0, count, &c);
+    } else {
+        qt_loop_balance(0, count, qt_partition_copyback, &c);
+    }
+    FREE(tmp, count * size);
+    return c.npass;
+}                                      /*}}} */
+
 /* Now, the easy option for qt_loop_balance() is... effective, but has a major
  * drawback: if some iterations take longer than others, we will have a laggard
  * thread holding everyone up. Even worse, imagine if a shepherd is disabled
@@ -1150,6 +1969,103 @@ static QINLINE int qqloop_get_iterations_timed(qqloop_iteration_queue_t *const r
     }
 }                                      /*}}} */
 
+/* ADAPTIVE: rather than every worker hammering one shared counter, each
+ * worker owns a contiguous piece of the iteration space and takes chunks off
+ * the front of it. Chunks are sized to take about QT_LOOP_ADAPTIVE_TARGET
+ * seconds, based on a moving average of what this worker's iterations have
+ * cost so far (the first chunk is a single iteration, to get a measurement).
+ * A worker whose piece runs dry steals the back half of the biggest piece
+ * left, so the only contention is on the lock of whoever is being robbed. */
+#ifndef QT_LOOP_ADAPTIVE_TARGET
+# define QT_LOOP_ADAPTIVE_TARGET 5e-5  /* seconds per chunk */
+#endif
+
+struct qqloop_adaptive_slot {
+    QTHREAD_FASTLOCK_TYPE lock;
+    size_t                start, stop;
+    double                cost;        /* secs/iteration; 0 until measured */
+    qtimer_t              timer;
+} Q_ALIGNED(CACHELINE_WIDTH);
+
+static int qqloop_adaptive_steal(struct qqloop_adaptive_slot *const slots,
+                                 const size_t                       nslots,
+                                 const size_t                       me)
+{                                      /*{{{ */
+    size_t victim = me, most = 0, left, mid, stop;
+
+    /* these unlocked reads are only a hint as to who has the most left */
+    for (size_t i = 1; i < nslots; i++) {
+        const size_t s  = (me + i) % nslots;
+        const size_t st = slots[s].start;
+        const size_t sp = slots[s].stop;
+
+        if ((sp > st) && (sp - st > most)) {
+            most   = sp - st;
+            victim = s;
+        }
+    }
+    if (most == 0) { return 0; }
+
+    /* qt_loop_queue_addworker() can put a second wrapper on my slot, so my
+     * piece may have been refilled since I found it empty: hold both locks
+     * (lowest slot first), and only take the range if mine is still empty */
+    QTHREAD_FASTLOCK_LOCK(&slots[(me < victim) ? me : victim].lock);
+    QTHREAD_FASTLOCK_LOCK(&slots[(me < victim) ? victim : me].lock);
+    left = slots[victim].stop - slots[victim].start;
+    if ((slots[victim].stop > slots[victim].start) &&
+        (slots[me].start >= slots[me].stop)) {
+        stop               = slots[victim].stop;
+        mid                = slots[victim].start + left / 2;
+        slots[victim].stop = mid;
+        slots[me].start    = mid;
+        slots[me].stop     = stop;
+    }
+    /* otherwise someone beat us to it, or refilled my piece; look again */
+    QTHREAD_FASTLOCK_UNLOCK(&slots[victim].lock);
+    QTHREAD_FASTLOCK_UNLOCK(&slots[me].lock);
+    return 1;
+}                                      /*}}} */
+
+static QINLINE int qqloop_get_iterations_adaptive(qqloop_iteration_queue_t *const restrict    iq,
+                                                  struct qqloop_static_args *const restrict   QUNUSED(sa),
+                                                  struct qqloop_wrapper_range *const restrict range)
+{                                      /*{{{ */
+    struct qqloop_adaptive_slot *const slots = iq->type_specific_data.adaptive;
+    const size_t                       nslots = qthread_num_workers();
+    struct qqloop_adaptive_slot *const mine   = &slots[range->slot];
+    size_t                             want   = 1;
+
+    assert(range->slot < nslots);
+    if (range->stopat > range->startat) {
+        /* fold in the chunk that was just run (timed by qqloop_wrapper) */
+        const double per = qtimer_secs(mine->timer) / (range->stopat - range->startat);
+
+        mine->cost = (mine->cost == 0.0) ? per : (0.75 * mine->cost + 0.25 * per);
+    }
+    if (mine->cost > 0.0) {
+        const double iters = QT_LOOP_ADAPTIVE_TARGET / mine->cost;
+
+        want = (iters >= (double)(iq->stop - iq->start)) ? (size_t)(iq->stop - iq->start) : (size_t)iters;
+        if (want == 0) { want = 1; }
+    }
+
+    do {
+        QTHREAD_FASTLOCK_LOCK(&mine->lock);
+        if (mine->start < mine->stop) {
+            range->startat = mine->start;
+            range->stopat  = (mine->stop - mine->start > want) ? (mine->start + want) : mine->stop;
+            range->step    = iq->step;
+            mine->start    = range->stopat;
+            QTHREAD_FASTLOCK_UNLOCK(&mine->lock);
+            return 1;
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&mine->lock);
+    } while (qqloop_adaptive_steal(slots, nslots, range->slot));
+
+    range->startat = range->stopat = range->step = 0;
+    return 0;
+}                                      /*}}} */
+
 static QINLINE qqloop_iteration_queue_t *qqloop_create_iq(const size_t             startat,
                                                           const size_t             stopat,
                                                           const size_t             step,
@@ -1180,6 +2096,30 @@ static QINLINE qqloop_iteration_queue_t *qqloop_create_iq(const size_t
             assert(iq->type_specific_data.timed.lastblocks);
             break;
         }
+        case ADAPTIVE:
+        {
+            const size_t                 max   = qthread_num_workers();
+            const size_t                 each  = (stopat - startat) / max;
+            size_t                       extra = (stopat - startat) - each * max;
+            size_t                       next  = startat;
+            struct qqloop_adaptive_slot *slots = qthread_internal_aligned_alloc(sizeof(struct qqloop_adaptive_slot) * max,
+                                                                                CACHELINE_WIDTH);
+            assert(slots);
+            for (size_t i = 0; i < max; i++) {
+                QTHREAD_FASTLOCK_INIT(slots[i].lock);
+                slots[i].start = next;
+                next          += each;
+                if (extra > 0) {
+                    next++;
+                    extra--;
+                }
+                slots[i].stop  = next;
+                slots[i].cost  = 0.0;
+                slots[i].timer = qtimer_create();
+            }
+            iq->type_specific_data.adaptive = slots;
+            break;
+        }
         default:
             break;
     }
@@ -1205,6 +2145,17 @@ static QINLINE void qqloop_destroy_iq(qqloop_iteration_queue_t *iq)
             }
             break;
         }
+        case ADAPTIVE:
+        {
+            const size_t                       max   = qthread_num_workers();
+            struct qqloop_adaptive_slot *const slots = iq->type_specific_data.adaptive;
+            for (size_t i = 0; i < max; i++) {
+                QTHREAD_FASTLOCK_DESTROY(slots[i].lock);
+                qtimer_destroy(slots[i].timer);
+            }
+            qthread_internal_aligned_free(slots, CACHELINE_WIDTH);
+            break;
+        }
         default:
             break;
     }
@@ -1222,19 +2173,30 @@ static aligned_t qqloop_wrapper(const struct qqloop_wrapper_args *arg)
     const qthread_shepherd_id_t               shep      = arg->shep;
 
     /* non-consts */
-    struct qqloop_wrapper_range range    = { 0, 0, 0 };
+    struct qqloop_wrapper_range range    = { 0, 0, 0, shep };
     int                         safeexit = 1;
+    qtimer_t                    timer    = NULL;
 
+    switch (iq->type) {
+        case TIMED:
+            timer = iq->type_specific_data.timed.timers[shep];
+            break;
+        case ADAPTIVE:
+            timer = iq->type_specific_data.adaptive[shep].timer;
+            break;
+        default:
+            break;
+    }
     assert(get_iters != NULL);
     if (get_iters(iq, stat, &range)) {
         assert(range.startat != range.stopat);
         do {
-            if (iq->type == TIMED) {
-                qtimer_start(iq->type_specific_data.timed.timers[shep]);
+            if (timer) {
+                qtimer_start(timer);
             }
             func(range.startat, range.stopat, a);
-            if (iq->type == TIMED) {
-                qtimer_stop(iq->type_specific_data.timed.timers[shep]);
+            if (timer) {
+                qtimer_stop(timer);
             }
             if (!qthread_shep_ok()) {
                 /* my shepherd has been disabled while I was running */
@@ -1284,6 +2246,8 @@ qqloop_handle_t *qt_loop_queue_create(const qt_loop_queue_type type,
                     h->stat.get = qqloop_get_iterations_guided; break;
                 case CHUNK:
                     h->stat.get = qqloop_get_iterations_chunked; break;
+                case ADAPTIVE:
+                    h->stat.get = qqloop_get_iterations_adaptive; break;
             }
             for (i = 0; i < maxsheps; i++) {
                 h->qwa[i].stat = &(h->stat);
@@ -1329,6 +2293,7 @@ qqloop_step_handle_t API_FUNC *qt_loop_step_queue_create(const qt_loop_queue_typ
                 case TIMED:
                     h->stat.get = qqloop_get_iterations_timed; break;
                 case GUIDED:
+                case ADAPTIVE: /* the step wrapper doesn't time its chunks */
                     h->stat.get = qqloop_get_iterations_guided; break;
                 case CHUNK:
                     h->stat.get = qqloop_get_iterations_chunked; break;
@@ -0,0 +1,368 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdlib.h>
+#include <stdint.h>
+
+/* API Headers */
+#include <qthread/qthread.h>
+#include <qthread/qloop.h>
+#include <qthread/sinc.h>
+
+/* Internal Headers */
+#include "qt_asserts.h"
+#include "qt_visibility.h"
+#include "qt_debug.h"
+#include "qt_initialized.h" // for qthread_library_initialized
+
+/* Tiled multi-dimensional loops. The iteration box is cut into tiles, and
+ * the tiles are put in a single sequence according to the requested order:
+ * row-major, Morton (Z-order), Hilbert, or the order of a recursive
+ * bisection of the longest side (cache-oblivious). That sequence is then cut
+ * into a few contiguous runs per worker, and consecutive runs are spawned to
+ * the same shepherd, so that tiles that are close together in the sequence,
+ * and therefore (for every order but row-major) close together in space,
+ * share a shepherd and its caches, along with their halos. */
+#ifndef QT_LOOP_TILED_CHUNKS_PER_WORKER
+# define QT_LOOP_TILED_CHUNKS_PER_WORKER 2
+#endif
+#define QT_LOOP2D_DEFAULT_TILE 64
+#define QT_LOOP3D_DEFAULT_TILE 16
+
+struct qt_loop_tiled_s {
+    size_t        dims;
+    size_t        start[3], stop[3], tile[3], ntiles[3];
+    size_t        count;               /* tiles in all */
+    qt_loop_order order;
+    size_t       *curve;               /* MORTON/HILBERT: tiles in order */
+    qt_loop2d_f   func2;
+    qt_loop3d_f   func3;
+    void         *arg;
+    qt_sinc_t     sinc;
+};
+
+struct qt_loop_tiled_chunk {
+    struct qt_loop_tiled_s *loop;
+    size_t                  first, last; /* positions in the sequence */
+};
+
+static void qt_loop_tiled_run_tile(const struct qt_loop_tiled_s *loop,
+                                   const size_t                 *tc)
+{                                      /*{{{ */
+    size_t lo[3], hi[3];
+
+    for (size_t d = 0; d < 3; d++) {
+        lo[d] = loop->start[d] + tc[d] * loop->tile[d];
+        hi[d] = lo[d] + loop->tile[d];
+        if (hi[d] > loop->stop[d]) { hi[d] = loop->stop[d]; }
+    }
+    if (loop->dims == 2) {
+        loop->func2(lo[0], hi[0], lo[1], hi[1], loop->arg);
+    } else {
+        loop->func3(lo[0], hi[0], lo[1], hi[1], lo[2], hi[2], loop->arg);
+    }
+}                                      /*}}} */
+
+static void qt_loop_tiled_run_number(const struct qt_loop_tiled_s *loop,
+                                     const size_t                  t)
+{                                      /*{{{ */
+    size_t tc[3];
+
+    tc[0] = t % loop->ntiles[0];
+    tc[1] = (t / loop->ntiles[0]) % loop->ntiles[1];
+    tc[2] = t / (loop->ntiles[0] * loop->ntiles[1]);
+    qt_loop_tiled_run_tile(loop, tc);
+}                                      /*}}} */
+
+/* Runs the tiles at positions [first, last) of the bisection order of the
+ * box [lo, hi) (in tiles), which starts at position offset. Subtrees that lie
+ * entirely outside of the range are skipped without being walked, so each
+ * chunk only costs its own tiles plus the depth of the tree. */
+static void qt_loop_tiled_bisect(const struct qt_loop_tiled_s *loop,
+                                 const size_t                 *lo,
+                                 const size_t                 *hi,
+                                 const size_t                  offset,
+                                 const size_t                  first,
+                                 const size_t                  last)
+{                                      /*{{{ */
+    const size_t size = (hi[0] - lo[0]) * (hi[1] - lo[1]) * (hi[2] - lo[2]);
+    size_t       d, longest = 0, mid;
+    size_t       lohi[3], hilo[3];
+
+    if ((offset >= last) || (offset + size <= first)) { return; }
+    if (size == 1) {
+        qt_loop_tiled_run_tile(loop, lo);
+        return;
+    }
+    /* split the longest side; ties go to the slowest-varying dimension, so
+     * that tiles that share rows stay together */
+    d = 0;
+    for (size_t i = 0; i < 3; i++) {
+        if (hi[i] - lo[i] >= longest) {
+            longest = hi[i] - lo[i];
+            d       = i;
+        }
+    }
+    mid = lo[d] + longest / 2;
+    for (size_t i = 0; i < 3; i++) {
+        lohi[i] = hi[i];
+        hilo[i] = lo[i];
+    }
+    lohi[d] = mid;
+    hilo[d] = mid;
+    qt_loop_tiled_bisect(loop, lo, lohi, offset, first, last);
+    qt_loop_tiled_bisect(loop, hilo, hi,
+                         offset + (mid - lo[d]) * (size / longest),
+                         first, last);
+}                                      /*}}} */
+
+static void qt_loop_tiled_run_range(const struct qt_loop_tiled_s *loop,
+                                    const size_t                  first,
+                                    const size_t                  last)
+{                                      /*{{{ */
+    switch (loop->order) {
+        case QT_LOOP_ROW_MAJOR:
+            for (size_t i = first; i < last; i++) {
+                qt_loop_tiled_run_number(loop, i);
+            }
+            break;
+        case QT_LOOP_MORTON:
+        case QT_LOOP_HILBERT:
+            for (size_t i = first; i < last; i++) {
+                qt_loop_tiled_run_number(loop, loop->curve[i]);
+            }
+            break;
+        case QT_LOOP_RECURSIVE:
+        {
+            const size_t lo[3] = { 0, 0, 0 };
+
+            qt_loop_tiled_bisect(loop, lo, loop->ntiles, 0, first, last);
+            break;
+        }
+    }
+}                                      /*}}} */
+
+static aligned_t qt_loop_tiled_wrapper(const struct qt_loop_tiled_chunk *arg)
+{                                      /*{{{ */
+    qt_loop_tiled_run_range(arg->loop, arg->first, arg->last);
+    qt_sinc_submit(&arg->loop->sinc, NULL);
+    return 0;
+}                                      /*}}} */
+
+/* Hilbert keys via Skilling's transpose ("Programming the Hilbert curve",
+ * 2004), which works in any number of dimensions: turn the coordinates into
+ * the transposed Hilbert index in place, then interleave their bits just as
+ * for a Morton key. */
+static uint64_t qt_loop_tiled_key(const qt_loop_order order,
+                                  const size_t        dims,
+                                  const size_t        bits,
+                                  size_t             *X)
+{                                      /*{{{ */
+    uint64_t key = 0;
+
+    if (order == QT_LOOP_HILBERT) {
+        const size_t M = (size_t)1 << (bits - 1);
+        size_t       t;
+
+        for (size_t Q = M; Q > 1; Q >>= 1) {
+            const size_t P = Q - 1;
+
+            for (size_t i = 0; i < dims; i++) {
+                if (X[i] & Q) {
+                    X[0] ^= P;
+                } else {
+                    t     = (X[0] ^ X[i]) & P;
+                    X[0] ^= t;
+                    X[i] ^= t;
+                }
+            }
+        }
+        for (size_t i = 1; i < dims; i++) {
+            X[i] ^= X[i - 1];
+        }
+        t = 0;
+        for (size_t Q = M; Q > 1; Q >>= 1) {
+            if (X[dims - 1] & Q) { t ^= Q - 1; }
+        }
+        for (size_t i = 0; i < dims; i++) {
+            X[i] ^= t;
+        }
+        /* Skilling's X[0] is the most significant axis */
+        for (size_t b = bits; b-- > 0;) {
+            for (size_t i = 0; i < dims; i++) {
+                key = (key << 1) | ((X[i] >> b) & 1);
+            }
+        }
+    } else {
+        for (size_t b = bits; b-- > 0;) {
+            for (size_t i = dims; i-- > 0;) {
+                key = (key << 1) | ((X[i] >> b) & 1);
+            }
+        }
+    }
+    return key;
+}                                      /*}}} */
+
+struct qt_loop_tiled_keyed {
+    uint64_t key;
+    size_t   tile;
+};
+
+static int qt_loop_tiled_keycmp(const void *a,
+                                const void *b)
+{                                      /*{{{ */
+    const uint64_t ka = ((const struct qt_loop_tiled_keyed *)a)->key;
+    const uint64_t kb = ((const struct qt_loop_tiled_keyed *)b)->key;
+
+    return (ka > kb) - (ka < kb);
+}                                      /*}}} */
+
+static void qt_loop_tiled_make_curve(struct qt_loop_tiled_s *loop)
+{                                      /*{{{ */
+    struct qt_loop_tiled_keyed *keyed;
+    size_t                      bits = 1, largest = 0;
+
+    for (size_t d = 0; d < loop->dims; d++) {
+        if (loop->ntiles[d] > largest) { largest = loop->ntiles[d]; }
+    }
+    while (((size_t)1 << bits) < largest) bits++;
+    assert(bits * loop->dims <= 64);
+
+    keyed = MALLOC(loop->count * sizeof(struct qt_loop_tiled_keyed));
+    assert(keyed);
+    for (size_t t = 0; t < loop->count; t++) {
+        size_t X[3];
+
+        X[0]           = t % loop->ntiles[0];
+        X[1]           = (t / loop->ntiles[0]) % loop->ntiles[1];
+        X[2]           = t / (loop->ntiles[0] * loop->ntiles[1]);
+        keyed[t].key   = qt_loop_tiled_key(loop->order, loop->dims, bits, X);
+        keyed[t].tile  = t;
+    }
+    qsort(keyed, loop->count, sizeof(struct qt_loop_tiled_keyed), qt_loop_tiled_keycmp);
+    loop->curve = MALLOC(loop->count * sizeof(size_t));
+    assert(loop->curve);
+    for (size_t i = 0; i < loop->count; i++) {
+        loop->curve[i] = keyed[i].tile;
+    }
+    FREE(keyed, loop->count * sizeof(struct qt_loop_tiled_keyed));
+}                                      /*}}} */
+
+static void qt_loop_tiled(struct qt_loop_tiled_s *loop)
+{                                      /*{{{ */
+    const size_t workers = qthread_num_workers();
+    const size_t nsheps  = qthread_num_shepherds();
+    size_t       nchunks;
+
+    assert(qthread_library_initialized);
+
+    loop->count = 1;
+    for (size_t d = 0; d < 3; d++) {
+        if (loop->stop[d] <= loop->start[d]) { return; }
+        if (loop->tile[d] > loop->stop[d] - loop->start[d]) {
+            loop->tile[d] = loop->stop[d] - loop->start[d];
+        }
+        loop->ntiles[d] = (loop->stop[d] - loop->start[d] + loop->tile[d] - 1) / loop->tile[d];
+        loop->count    *= loop->ntiles[d];
+    }
+    loop->curve = NULL;
+    if ((loop->order == QT_LOOP_MORTON) || (loop->order == QT_LOOP_HILBERT)) {
+        qt_loop_tiled_make_curve(loop);
+    }
+
+    nchunks = workers * QT_LOOP_TILED_CHUNKS_PER_WORKER;
+    if (nchunks > loop->count) { nchunks = loop->count; }
+    if (workers == 1) {
+        qt_loop_tiled_run_range(loop, 0, loop->count);
+    } else {
+        struct qt_loop_tiled_chunk c;
+
+        c.loop = loop;
+        qt_sinc_init(&loop->sinc, 0, NULL, NULL, nchunks);
+        for (size_t i = 0; i < nchunks; i++) {
+            c.first = (loop->count * i) / nchunks;
+            c.last  = (loop->count * (i + 1)) / nchunks;
+            /* consecutive chunks go to the same shepherd */
+            qassert(qthread_spawn((qthread_f)qt_loop_tiled_wrapper,
+                                  &c, sizeof(c),
+                                  NULL,
+                                  0, NULL,
+                                  (i * nsheps) / nchunks,
+                                  0), QTHREAD_SUCCESS);
+        }
+        qt_sinc_wait(&loop->sinc, NULL);
+        qt_sinc_fini(&loop->sinc);
+    }
+    if (loop->curve) {
+        FREE(loop->curve, loop->count * sizeof(size_t));
+    }
+}                                      /*}}} */
+
+void API_FUNC qt_loop2d(const size_t        xstart,
+                        const size_t        xstop,
+                        const size_t        ystart,
+                        const size_t        ystop,
+                        const size_t        xtile,
+                        const size_t        ytile,
+                        const qt_loop_order order,
+                        const qt_loop2d_f   func,
+                        void               *argptr)
+{                                      /*{{{ */
+    struct qt_loop_tiled_s loop;
+
+    assert(func);
+
+    loop.dims     = 2;
+    loop.start[0] = xstart;
+    loop.stop[0]  = xstop;
+    loop.tile[0]  = xtile ? xtile : QT_LOOP2D_DEFAULT_TILE;
+    loop.start[1] = ystart;
+    loop.stop[1]  = ystop;
+    loop.tile[1]  = ytile ? ytile : QT_LOOP2D_DEFAULT_TILE;
+    loop.start[2] = 0;
+    loop.stop[2]  = 1;
+    loop.tile[2]  = 1;
+    loop.order    = order;
+    loop.func2    = func;
+    loop.func3    = NULL;
+    loop.arg      = argptr;
+    qt_loop_tiled(&loop);
+}                                      /*}}} */
+
+void API_FUNC qt_loop3d(const size_t        xstart,
+                        const size_t        xstop,
+                        const size_t        ystart,
+                        const size_t        ystop,
+                        const size_t        zstart,
+                        const size_t        zstop,
+                        const size_t        xtile,
+                        const size_t        ytile,
+                        const size_t        ztile,
+                        const qt_loop_order order,
+                        const qt_loop3d_f   func,
+                        void               *argptr)
+{                                      /*{{{ */
+    struct qt_loop_tiled_s loop;
+
+    assert(func);
+
+    loop.dims     = 3;
+    loop.start[0] = xstart;
+    loop.stop[0]  = xstop;
+    loop.tile[0]  = xtile ? xtile : QT_LOOP3D_DEFAULT_TILE;
+    loop.start[1] = ystart;
+    loop.stop[1]  = ystop;
+    loop.tile[1]  = ytile ? ytile : QT_LOOP3D_DEFAULT_TILE;
+    loop.start[2] = zstart;
+    loop.stop[2]  = zstop;
+    loop.tile[2]  = ztile ? ztile : QT_LOOP3D_DEFAULT_TILE;
+    loop.order    = order;
+    loop.func2    = NULL;
+    loop.func3    = func;
+    loop.arg      = argptr;
+    qt_loop_tiled(&loop);
+}                                      /*}}} */
+
+/* vim:set expandtab: */
@@ -48,6 +48,7 @@
 /* Internal Headers                                   */
 /******************************************************/
 #include "qt_mpool.h"
+#include "qt_slab.h"
 #include "qt_atomics.h"
 #include "qt_expect.h"
 #include "qt_asserts.h"
@@ -168,17 +169,12 @@ extern int adaptiveSetHigh;
 #endif
 
 #if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED)
-# define ALLOC_QTHREAD()     (qthread_t *)MALLOC(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size)
-# define ALLOC_BIG_QTHREAD() (qthread_t *)MALLOC(sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size)
-# define FREE_QTHREAD(t)     FREE(t, sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size)
-# define FREE_BIG_QTHREAD(t) FREE(t, sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size)
+# define ALLOC_QTHREAD() (qthread_t *)MALLOC(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size)
+# define FREE_QTHREAD(t) FREE(t, sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size)
 #else /* if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED) */
-qt_mpool generic_qthread_pool     = NULL;
-qt_mpool generic_big_qthread_pool = NULL;
-# define ALLOC_QTHREAD()     (qthread_t *)qt_mpool_alloc(generic_qthread_pool)
-# define ALLOC_BIG_QTHREAD() (qthread_t *)qt_mpool_alloc(generic_big_qthread_pool)
-# define FREE_QTHREAD(t)     qt_mpool_free(generic_qthread_pool, t)
-# define FREE_BIG_QTHREAD(t) qt_mpool_free(generic_big_qthread_pool, t)
+qt_mpool generic_qthread_pool = NULL;
+# define ALLOC_QTHREAD() (qthread_t *)qt_mpool_alloc(generic_qthread_pool)
+# define FREE_QTHREAD(t) qt_mpool_free(generic_qthread_pool, t)
 #endif /* if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED) */
 
 #if defined(UNPOOLED_STACKS) || defined(UNPOOLED)
@@ -954,8 +950,6 @@ int API_FUNC qthread_initialize(void)
     QTHREAD_FASTLOCK_INIT(qlib->nworkers_active_lock);
 #endif
 
-    qt_mpool_subsystem_init();
-
     qlib->qthread_stack_size = qt_internal_get_env_num("STACK_SIZE",
                                                        QTHREAD_DEFAULT_STACK_SIZE,
                                                        QTHREAD_DEFAULT_STACK_SIZE);
@@ -1032,6 +1026,10 @@ int API_FUNC qthread_initialize(void)
         assert(qlib->shepherds[0].shep_dists);
     }
 
+    /* needs to know which node each shepherd is on */
+    qt_mpool_subsystem_init();
+    qt_slab_subsystem_init();
+
     // Set task argument buffer size
     qlib->qthread_argcopy_size = qt_internal_get_env_num("ARGCOPY_SIZE", ARGCOPY_DEFAULT, 0);
     qthread_debug(CORE_DETAILS, "qthread task argcopy size: %u\n", (unsigned)qlib->qthread_argcopy_size);
@@ -1043,8 +1041,7 @@ int API_FUNC qthread_initialize(void)
     qthread_debug(CORE_DETAILS, "qthread task-local size: %u\n", qlib->qthread_tasklocal_size);
 
 #ifndef UNPOOLED
-    generic_qthread_pool     = qt_mpool_create_aligned(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size, qthread_cacheline());
-    generic_big_qthread_pool = qt_mpool_create(sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size);
+    generic_qthread_pool = qt_mpool_create_aligned(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size, qthread_cacheline());
     if (GUARD_PAGES) {
         generic_stack_pool =
             qt_mpool_create_aligned(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s) +
@@ -1053,6 +1050,9 @@ int API_FUNC qthread_initialize(void)
         generic_stack_pool = qt_mpool_create_aligned(qlib->qthread_stack_size + sizeof(struct qthread_runtime_data_s), QTHREAD_STACK_ALIGNMENT);     // stacks on most platforms must be 16-byte aligned (or less)
     }
     generic_rdata_pool = qt_mpool_create(sizeof(struct qthread_runtime_data_s));
+    qt_mpool_set_name(generic_qthread_pool, "qthread_t");
+    qt_mpool_set_name(generic_stack_pool, "stacks");
+    qt_mpool_set_name(generic_rdata_pool, "runtime data");
 #endif /* ifndef UNPOOLED */
     initialize_hazardptrs();
     qt_internal_teams_init();
@@ -1742,7 +1742,7 @@ void API_FUNC qthread_finalize(void)
 #endif
     assert(qlib->mccoy_thread->rdata->stack == NULL);
     if (qlib->mccoy_thread->rdata->tasklocal_size > 0) {
-        FREE(*(void **)&qlib->mccoy_thread->data[0], qlib->mccoy_thread->rdata->tasklocal_size);
+        qt_slab_free(*(void **)&qlib->mccoy_thread->data[0], qlib->mccoy_thread->rdata->tasklocal_size);
     }
     qthread_debug(CORE_DETAILS, "destroy mccoy thread structure\n");
     FREE(qlib->mccoy_thread->rdata, sizeof(struct qthread_runtime_data_s));
@@ -1774,8 +1774,6 @@ void API_FUNC qthread_finalize(void)
     qthread_debug(CORE_DETAILS, "destroy global memory pools\n");
     qt_mpool_destroy(generic_qthread_pool);
     generic_qthread_pool = NULL;
-    qt_mpool_destroy(generic_big_qthread_pool);
-    generic_big_qthread_pool = NULL;
     qt_mpool_destroy(generic_stack_pool);
     generic_stack_pool = NULL;
     qt_mpool_destroy(generic_rdata_pool);
@@ -1826,21 +1824,12 @@ void API_FUNC *qthread_get_tasklocal(unsigned int size)
         qthread_debug(THREAD_DETAILS, "tasklocal_size=%u, global tasklocal_size=%u\n", tl_sz, qlib->qthread_tasklocal_size);
         if ((0 == tl_sz) && (size <= qlib->qthread_tasklocal_size)) {
             // Use default space
-            if (f->flags & QTHREAD_BIG_STRUCT) {
-                return &f->data[qlib->qthread_argcopy_size];
-            } else {
-                return &f->data;
-            }
+            return &f->data;
         } else {
-            void **data_blob;
-            if (f->flags & QTHREAD_BIG_STRUCT) {
-                data_blob = (void **)&f->data[qlib->qthread_argcopy_size];
-            } else {
-                data_blob = (void **)&f->data[0];
-            }
+            void **data_blob = (void **)&f->data[0];
             if (0 == tl_sz) {
                 qthread_debug(THREAD_DETAILS, "Allocate space and copy old data\n");
-                void *tmp_data = MALLOC(size);
+                void *tmp_data = qt_slab_alloc(size);
                 assert(NULL != tmp_data);
 
                 memcpy(tmp_data, data_blob, qlib->qthread_tasklocal_size);
@@ -1854,8 +1843,12 @@ void API_FUNC *qthread_get_tasklocal(unsigned int size)
                 return *data_blob;
             } else {
                 qthread_debug(THREAD_DETAILS, "Resize alloc'd data blob to %u from %u\n", size, f->rdata->tasklocal_size);
-                *data_blob = realloc(*data_blob, size);
-                assert(NULL != *data_blob);
+                void *tmp_data = qt_slab_alloc(size);
+                assert(NULL != tmp_data);
+
+                memcpy(tmp_data, *data_blob, tl_sz);
+                qt_slab_free(*data_blob, tl_sz);
+                *data_blob = tmp_data;
 
                 qthread_debug(THREAD_DETAILS, "set tlsize = %u\n", size);
                 f->rdata->tasklocal_size = size;
@@ -1902,6 +1895,17 @@ size_t API_FUNC qthread_stackleft(void)
     }
 }                      /*}}} */
 
+size_t API_FUNC qthread_trim_memory(void)
+{                      /*{{{ */
+    return qt_mpool_trim_all();
+}                      /*}}} */
+
+size_t API_FUNC qthread_pool_stats(qthread_pool_stats_t *stats,
+                                   size_t                nstats)
+{                      /*{{{ */
+    return qt_mpool_stats(stats, nstats);
+}                      /*}}} */
+
 size_t API_FUNC qthread_readstate(const enum introspective_state type)
 {                      /*{{{ */
     switch (type) {
@@ -2026,13 +2030,7 @@ static QINLINE qthread_t *qthread_thread_new(const qthread_f f,
                                              qt_team_t      *team,
                                              int             team_leader)
 {                      /*{{{ */
-    qthread_t *t;
-
-    if ((arg_size > 0) && (arg_size <= qlib->qthread_argcopy_size)) {
-        t = ALLOC_BIG_QTHREAD();
-    } else {
-        t = ALLOC_QTHREAD();
-    }
+    qthread_t *t = ALLOC_QTHREAD();
     qthread_debug(THREAD_DETAILS, "t = %p\n", t);
 
     t->f     = f;
@@ -2072,16 +2070,18 @@ static QINLINE qthread_t *qthread_thread_new(const qthread_f f,
 
     t->target_shepherd = NO_SHEPHERD;
 
-    // should I use the builtin block for args?
+    // copy the args into a right-sized chunk, unless they're too big to pool
     if (arg_size > 0) {
+        assert(arg_size <= UINT32_MAX);
         if (arg_size <= qlib->qthread_argcopy_size) {
-            t->arg   = (void *)(&t->data);
-            t->flags = QTHREAD_BIG_STRUCT;
+            t->arg = qt_slab_alloc(arg_size);
         } else {
-            t->arg   = MALLOC(arg_size);
-            t->flags = QTHREAD_HAS_ARGCOPY;
+            t->arg = MALLOC(arg_size);
         }
+        assert(t->arg);
         memcpy(t->arg, arg, arg_size);
+        t->argcopy_size = (uint32_t)arg_size;
+        t->flags        = QTHREAD_HAS_ARGCOPY;
     } else {
         t->flags = 0;
     }
@@ -2106,13 +2106,8 @@ void qthread_thread_free(qthread_t *t)
     if (t->rdata != NULL) {
         if (t->rdata->tasklocal_size > 0) {
             qthread_debug(THREAD_DETAILS, "t(%p,%i): destroying %u bytes of task-local storage\n", t, t->thread_id, t->rdata->tasklocal_size);
-            if (t->flags & QTHREAD_BIG_STRUCT) {
-                FREE(*(void **)&t->data[qlib->qthread_argcopy_size], t->rdata->tasklocal_size);
-                *(void **)&t->data[qlib->qthread_argcopy_size] = NULL;
-            } else {
-                FREE(*(void **)&t->data[0], t->rdata->tasklocal_size);
-                *(void **)&t->data[0] = NULL;
-            }
+            qt_slab_free(*(void **)&t->data[0], t->rdata->tasklocal_size);
+            *(void **)&t->data[0] = NULL;
         }
 #ifdef QTHREAD_USE_VALGRIND
         VALGRIND_STACK_DEREGISTER(t->rdata->valgrind_stack_id);
@@ -2130,15 +2125,15 @@ void qthread_thread_free(qthread_t *t)
     }
     if (t->flags & QTHREAD_HAS_ARGCOPY) {
         assert(&t->data != t->arg);
-        free(t->arg); // I don't record the size of this anywhere, so I can't scribble it
+        if (t->argcopy_size <= qlib->qthread_argcopy_size) {
+            qt_slab_free(t->arg, t->argcopy_size);
+        } else {
+            FREE(t->arg, t->argcopy_size);
+        }
         t->arg = NULL;
     }
     qthread_debug(THREAD_DETAILS, "t(%p): releasing thread handle %p\n", t, t);
-    if (t->flags & QTHREAD_BIG_STRUCT) {
-        FREE_BIG_QTHREAD(t);
-    } else {
-        FREE_QTHREAD(t);
-    }
+    FREE_QTHREAD(t);
 }                      /*}}} */
 
 #ifdef QTHREAD_ALLOW_HPCTOOLKIT_STACK_UNWINDING
@@ -3097,7 +3092,7 @@ qt_barrier_t *qt_thread_barrier()            // get barrier active for this thre
 qt_barrier_t *qt_thread_barrier_resize(size_t size)  // resize barrier for current parallel region
 {                      /*{{{ */
     qt_barrier_destroy(qt_parallel_region()->barrier);
-    qt_parallel_region()->barrier = qt_barrier_create(size, REGION_BARRIER);
+    qt_parallel_region()->barrier = qt_barrier_create(size, DISSEMINATION_BARRIER);
     return qt_parallel_region()->barrier;
 }                      /*}}} */
 # endif /* ifdef QTHREAD_USE_ROSE_EXTENSIONS */
@@ -3136,7 +3131,9 @@ int qt_omp_parallel_region_create()
 
     workers = qthread_num_workers();
 
-    qt_barrier_t *gb = qt_barrier_create(workers, REGION_BARRIER); // allocate barrier for region (shepherds)
+    /* one participant per worker, entering every step: spinning on padded
+     * flags beats a trip through the FEB hash */
+    qt_barrier_t *gb = qt_barrier_create(workers, DISSEMINATION_BARRIER); // allocate barrier for region (shepherds)
 
     qthread_t *t = qthread_internal_self();
     if (t->currentParallelRegion != NULL) { // we have nested parallelism
@@ -35,6 +35,7 @@ static void qthread_queue_subsystem_shutdown(void)
 void INTERNAL qthread_queue_subsystem_init(void)
 {
     node_pool = qt_mpool_create(sizeof(qthread_queue_node_t));
+    qt_mpool_set_name(node_pool, "wait queue nodes");
     qthread_internal_cleanup(qthread_queue_subsystem_shutdown);
 }
 
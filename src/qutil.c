@@ -11,12 +11,14 @@
 #include <qthread/qutil.h>
 #include <qthread/qthread.h>
 #include <qthread/cacheline.h>
+#include <qthread/sinc.h>
 
 /* Internal Headers */
 #include "qt_asserts.h"           /* for assert() toggling */
 #include "qt_visibility.h"
 #include "qt_debug.h"
 #include "qt_int_log.h"
+#include "qt_qutil_kernels.h"
 
 #ifndef MT_LOOP_CHUNK
 # define MT_LOOP_CHUNK 10000
@@ -24,98 +26,85 @@
 
 extern int qthread_library_initialized;
 
+/* Each reduction is split into MT_LOOP_CHUNK-sized segments. Every segment
+ * but the last is reduced by its own task, which hands its partial result to
+ * a sinc; the sinc folds the partials into per-worker slots as they arrive,
+ * so the caller only waits for the slowest segment instead of a chain of
+ * them. */
 #define STRUCT(_structname_, _rtype_)                   struct _structname_ \
     {                                                                       \
-        const _rtype_       *array;                                         \
-        syncvar_t            ret_sentinel;                                  \
-        _rtype_              ret;                                           \
-        size_t               start, stop;                                   \
-        const _rtype_       *addlast;                                       \
-        syncvar_t           *addlast_sentinel;                              \
-        struct _structname_ *backptr;                                       \
+        const _rtype_ *array;                                               \
+        size_t         start, stop;                                         \
+        qt_sinc_t     *sinc;                                                \
     }
-#define INNER_LOOP(_fname_, _structtype_, _opmacro_)    static aligned_t _fname_(struct _structtype_ *args) \
-    {                                                                                                       \
-        size_t i;                                                                                           \
-        args->ret = args->array[args->start];                                                               \
-        for (i = args->start + 1; i < args->stop; i++) {                                                    \
-            _opmacro_(args->ret, args->array[i]);                                                           \
-        }                                                                                                   \
-        if (args->addlast) {                                                                                \
-            qthread_syncvar_readFF(NULL, args->addlast_sentinel);                                           \
-            _opmacro_(args->ret, *(args->addlast));                                                         \
-            FREE(args->backptr, sizeof(struct _structtype_));                                               \
-        }                                                                                                   \
-        qthread_syncvar_fill(&(args->ret_sentinel));                                                        \
-        return 0;                                                                                           \
+#define COMBINE(_fname_, _rtype_, _opmacro_)            static void _fname_(void *restrict       tgt, \
+                                                                            const void *restrict src) \
+    {                                                                                                 \
+        _opmacro_(*(_rtype_ *)tgt, *(const _rtype_ *)src);                                            \
     }
-#define INNER_LOOP_FF(_fname_, _structtype_, _opmacro_) static aligned_t _fname_(struct _structtype_ *args) \
-    {                                                                                                       \
-        size_t i;                                                                                           \
-        qthread_readFF(NULL, (aligned_t *)(args->array + args->start));                                     \
-        args->ret = args->array[args->start];                                                               \
-        for (i = args->start + 1; i < args->stop; i++) {                                                    \
-            qthread_readFF(NULL, (aligned_t *)(args->array + i));                                           \
-            _opmacro_(args->ret, args->array[i]);                                                           \
-        }                                                                                                   \
-        if (args->addlast) {                                                                                \
-            qthread_syncvar_readFF(NULL, args->addlast_sentinel);                                           \
-            _opmacro_(args->ret, *(args->addlast));                                                         \
-            FREE(args->backptr, sizeof(struct _structtype_));                                               \
-        }                                                                                                   \
-        qthread_syncvar_fill(&(args->ret_sentinel));                                                        \
-        return 0;                                                                                           \
+#define INNER_LOOP(_fname_, _structtype_, _rtype_, _kernel_) static aligned_t _fname_(const struct _structtype_ *args) \
+    {                                                                                                                  \
+        const _rtype_ ret = qt_qutil_kernels()->_kernel_(args->array + args->start,                                    \
+                                                         args->stop - args->start);                                    \
+        qt_sinc_submit(args->sinc, &ret);                                                                              \
+        return 0;                                                                                                      \
     }
-#define OUTER_LOOP(_fname_, _structtype_, _opmacro_, _rtype_, _innerfunc_, _innerfuncff_) \
-    _rtype_ API_FUNC _fname_(const _rtype_ * array, size_t length, int checkfeb)          \
-    {                                                                                     \
-        size_t               i, start = 0;                                                \
-        syncvar_t           *waitfor_sentinel = NULL;                                     \
-        _rtype_             *waitfor          = NULL, myret;                              \
-        struct _structtype_ *bkptr            = NULL;                                     \
-        /* abort if checkfeb == 1 && aligned_t is too big */                              \
-        assert(checkfeb == 0 || sizeof(aligned_t) == sizeof(_rtype_));                    \
-        while (start + MT_LOOP_CHUNK < length) {                                          \
-            /* spawn off an MT_LOOP_CHUNK-sized segment of the first part of the array */ \
-            struct _structtype_ *left_args =                                              \
-                calloc(1, sizeof(struct _structtype_));                                   \
-                                                                                          \
-            left_args->array            = array;                                          \
-            left_args->start            = start;                                          \
-            left_args->stop             = start + MT_LOOP_CHUNK;                          \
-            start                      += MT_LOOP_CHUNK;                                  \
-            left_args->backptr          = bkptr;                                          \
-            bkptr                       = left_args;                                      \
-            left_args->addlast          = waitfor;                                        \
-            left_args->addlast_sentinel = waitfor_sentinel;                               \
-            waitfor                     = &(left_args->ret);                              \
-            waitfor_sentinel            = &(left_args->ret_sentinel);                     \
-            qthread_syncvar_empty(&(left_args->ret_sentinel));                            \
-            if (checkfeb) {                                                               \
-                qthread_fork((qthread_f)_innerfuncff_, left_args, NULL);                  \
-            } else {                                                                      \
-                qthread_fork((qthread_f)_innerfunc_, left_args, NULL);                    \
-            }                                                                             \
-        }                                                                                 \
-        if (checkfeb) {                                                                   \
-            qthread_readFF(NULL, (aligned_t *)(array + start));                           \
-            myret = array[start];                                                         \
-            for (i = start + 1; i < length; i++) {                                        \
-                qthread_readFF(NULL, (aligned_t *)(array + i));                           \
-                _opmacro_(myret, array[i]);                                               \
-            }                                                                             \
-        } else {                                                                          \
-            myret = array[start];                                                         \
-            for (i = start + 1; i < length; i++) {                                        \
-                _opmacro_(myret, array[i]);                                               \
-            }                                                                             \
-        }                                                                                 \
-        if (waitfor) {                                                                    \
-            qthread_syncvar_readFF(NULL, waitfor_sentinel);                               \
-            _opmacro_(myret, *waitfor);                                                   \
-            FREE(bkptr, sizeof(struct _structtype_));                                     \
-        }                                                                                 \
-        return myret;                                                                     \
+#define INNER_LOOP_FF(_fname_, _structtype_, _rtype_, _opmacro_) static aligned_t _fname_(const struct _structtype_ *args) \
+    {                                                                                                                      \
+        size_t  i;                                                                                                         \
+        _rtype_ ret;                                                                                                       \
+        qthread_readFF(NULL, (aligned_t *)(args->array + args->start));                                                    \
+        ret = args->array[args->start];                                                                                    \
+        for (i = args->start + 1; i < args->stop; i++) {                                                                   \
+            qthread_readFF(NULL, (aligned_t *)(args->array + i));                                                          \
+            _opmacro_(ret, args->array[i]);                                                                                \
+        }                                                                                                                  \
+        qt_sinc_submit(args->sinc, &ret);                                                                                  \
+        return 0;                                                                                                          \
+    }
+#define OUTER_LOOP(_fname_, _structtype_, _opmacro_, _rtype_, _identity_, _combine_, _kernel_, _innerfunc_, _innerfuncff_) \
+    _rtype_ API_FUNC _fname_(const _rtype_ * array, size_t length, int checkfeb)                                          \
+    {                                                                                                                     \
+        size_t              i, start = 0;                                                                                 \
+        _rtype_             myret, identity, theirs;                                                                      \
+        qt_sinc_t           sinc;                                                                                         \
+        struct _structtype_ args;                                                                                         \
+        /* abort if checkfeb == 1 && aligned_t is too big */                                                              \
+        assert(checkfeb == 0 || sizeof(aligned_t) == sizeof(_rtype_));                                                    \
+        if (length > MT_LOOP_CHUNK) {                                                                                     \
+            if (checkfeb) {                                                                                               \
+                qthread_readFF(NULL, (aligned_t *)array);                                                                 \
+            }                                                                                                             \
+            identity = (_identity_);                                                                                      \
+            qt_sinc_init(&sinc, sizeof(_rtype_), &identity, _combine_,                                                    \
+                         (length - 1) / MT_LOOP_CHUNK);                                                                   \
+            args.array = array;                                                                                           \
+            args.sinc  = &sinc;                                                                                           \
+            do {                                                                                                          \
+                /* spawn off an MT_LOOP_CHUNK-sized segment of the first part of the array */                             \
+                args.start = start;                                                                                       \
+                args.stop  = start += MT_LOOP_CHUNK;                                                                      \
+                qassert(qthread_spawn((qthread_f)(checkfeb ? _innerfuncff_ : _innerfunc_),                                \
+                                      &args, sizeof(args), NULL, 0, NULL,                                                 \
+                                      NO_SHEPHERD, 0), QTHREAD_SUCCESS);                                                  \
+            } while (start + MT_LOOP_CHUNK < length);                                                                     \
+        }                                                                                                                 \
+        if (checkfeb) {                                                                                                   \
+            qthread_readFF(NULL, (aligned_t *)(array + start));                                                           \
+            myret = array[start];                                                                                         \
+            for (i = start + 1; i < length; i++) {                                                                        \
+                qthread_readFF(NULL, (aligned_t *)(array + i));                                                           \
+                _opmacro_(myret, array[i]);                                                                               \
+            }                                                                                                             \
+        } else {                                                                                                          \
+            myret = qt_qutil_kernels()->_kernel_(array + start, length - start);                                          \
+        }                                                                                                                 \
+        if (start > 0) {                                                                                                  \
+            qt_sinc_wait(&sinc, &theirs);                                                                                 \
+            qt_sinc_fini(&sinc);                                                                                          \
+            _opmacro_(myret, theirs);                                                                                     \
+        }                                                                                                                 \
+        return myret;                                                                                                     \
     }
 
 #define SUM_MACRO(sum, add)       sum  += (add)
@@ -123,60 +112,33 @@ extern int qthread_library_initialized;
 #define MAX_MACRO(max, contender) if (max < (contender)) max = (contender)
 #define MIN_MACRO(max, contender) if (max > (contender)) max = (contender)
 
+/* Any element of the array serves as the identity for max and min */
+#define REDUCTION(_type_, _op_, _structtype_, _rtype_, _opmacro_, _identity_)                        \
+    COMBINE(qutil_ ## _type_ ## _ ## _op_ ## _combine, _rtype_, _opmacro_)                               \
+    INNER_LOOP(qutil_ ## _type_ ## _ ## _op_ ## _inner, _structtype_, _rtype_, _type_ ## _ ## _op_)      \
+    INNER_LOOP_FF(qutil_ ## _type_ ## _FF_ ## _op_ ## _inner, _structtype_, _rtype_, _opmacro_)          \
+    OUTER_LOOP(qutil_ ## _type_ ## _ ## _op_, _structtype_, _opmacro_, _rtype_, _identity_,              \
+               qutil_ ## _type_ ## _ ## _op_ ## _combine, _type_ ## _ ## _op_,                           \
+               qutil_ ## _type_ ## _ ## _op_ ## _inner, qutil_ ## _type_ ## _FF_ ## _op_ ## _inner)
+
 /* These are the functions for computing things about doubles */
 STRUCT(qutil_ds_args, double);
-INNER_LOOP(qutil_double_sum_inner, qutil_ds_args, SUM_MACRO)
-INNER_LOOP_FF(qutil_double_FF_sum_inner, qutil_ds_args, SUM_MACRO)
-OUTER_LOOP(qutil_double_sum, qutil_ds_args, SUM_MACRO, double,
-           qutil_double_sum_inner, qutil_double_FF_sum_inner)
-INNER_LOOP(qutil_double_mult_inner, qutil_ds_args, MULT_MACRO)
-INNER_LOOP_FF(qutil_double_FF_mult_inner, qutil_ds_args, MULT_MACRO)
-OUTER_LOOP(qutil_double_mult, qutil_ds_args, MULT_MACRO, double,
-           qutil_double_mult_inner, qutil_double_FF_mult_inner)
-INNER_LOOP(qutil_double_max_inner, qutil_ds_args, MAX_MACRO)
-INNER_LOOP_FF(qutil_double_FF_max_inner, qutil_ds_args, MAX_MACRO)
-OUTER_LOOP(qutil_double_max, qutil_ds_args, MAX_MACRO, double,
-           qutil_double_max_inner, qutil_double_FF_max_inner)
-INNER_LOOP(qutil_double_min_inner, qutil_ds_args, MIN_MACRO)
-INNER_LOOP_FF(qutil_double_FF_min_inner, qutil_ds_args, MIN_MACRO)
-OUTER_LOOP(qutil_double_min, qutil_ds_args, MIN_MACRO, double,
-           qutil_double_min_inner, qutil_double_FF_min_inner)
+REDUCTION(double, sum, qutil_ds_args, double, SUM_MACRO, 0.0)
+REDUCTION(double, mult, qutil_ds_args, double, MULT_MACRO, 1.0)
+REDUCTION(double, max, qutil_ds_args, double, MAX_MACRO, array[0])
+REDUCTION(double, min, qutil_ds_args, double, MIN_MACRO, array[0])
 /* These are the functions for computing things about unsigned ints */
 STRUCT(qutil_uis_args, aligned_t);
-INNER_LOOP(qutil_uint_sum_inner, qutil_uis_args, SUM_MACRO)
-INNER_LOOP_FF(qutil_uint_FF_sum_inner, qutil_uis_args, SUM_MACRO)
-OUTER_LOOP(qutil_uint_sum, qutil_uis_args, SUM_MACRO, aligned_t,
-           qutil_uint_sum_inner, qutil_uint_FF_sum_inner)
-INNER_LOOP(qutil_uint_mult_inner, qutil_uis_args, MULT_MACRO)
-INNER_LOOP_FF(qutil_uint_FF_mult_inner, qutil_uis_args, MULT_MACRO)
-OUTER_LOOP(qutil_uint_mult, qutil_uis_args, MULT_MACRO, aligned_t,
-           qutil_uint_mult_inner, qutil_uint_FF_mult_inner)
-INNER_LOOP(qutil_uint_max_inner, qutil_uis_args, MAX_MACRO)
-INNER_LOOP_FF(qutil_uint_FF_max_inner, qutil_uis_args, MAX_MACRO)
-OUTER_LOOP(qutil_uint_max, qutil_uis_args, MAX_MACRO, aligned_t,
-           qutil_uint_max_inner, qutil_uint_FF_max_inner)
-INNER_LOOP(qutil_uint_min_inner, qutil_uis_args, MIN_MACRO)
-INNER_LOOP_FF(qutil_uint_FF_min_inner, qutil_uis_args, MIN_MACRO)
-OUTER_LOOP(qutil_uint_min, qutil_uis_args, MIN_MACRO, aligned_t,
-           qutil_uint_min_inner, qutil_uint_FF_min_inner)
+REDUCTION(uint, sum, qutil_uis_args, aligned_t, SUM_MACRO, 0)
+REDUCTION(uint, mult, qutil_uis_args, aligned_t, MULT_MACRO, 1)
+REDUCTION(uint, max, qutil_uis_args, aligned_t, MAX_MACRO, array[0])
+REDUCTION(uint, min, qutil_uis_args, aligned_t, MIN_MACRO, array[0])
 /* These are the functions for computing things about signed ints */
 STRUCT(qutil_is_args, saligned_t);
-INNER_LOOP(qutil_int_sum_inner, qutil_is_args, SUM_MACRO)
-INNER_LOOP_FF(qutil_int_FF_sum_inner, qutil_is_args, SUM_MACRO)
-OUTER_LOOP(qutil_int_sum, qutil_is_args, SUM_MACRO, saligned_t,
-           qutil_int_sum_inner, qutil_int_FF_sum_inner)
-INNER_LOOP(qutil_int_mult_inner, qutil_is_args, MULT_MACRO)
-INNER_LOOP_FF(qutil_int_FF_mult_inner, qutil_is_args, MULT_MACRO)
-OUTER_LOOP(qutil_int_mult, qutil_is_args, MULT_MACRO, saligned_t,
-           qutil_int_mult_inner, qutil_int_FF_mult_inner)
-INNER_LOOP(qutil_int_max_inner, qutil_is_args, MAX_MACRO)
-INNER_LOOP_FF(qutil_int_FF_max_inner, qutil_is_args, MAX_MACRO)
-OUTER_LOOP(qutil_int_max, qutil_is_args, MAX_MACRO, saligned_t,
-           qutil_int_max_inner, qutil_int_FF_max_inner)
-INNER_LOOP(qutil_int_min_inner, qutil_is_args, MIN_MACRO)
-INNER_LOOP_FF(qutil_int_FF_min_inner, qutil_is_args, MIN_MACRO)
-OUTER_LOOP(qutil_int_min, qutil_is_args, MIN_MACRO, saligned_t,
-           qutil_int_min_inner, qutil_int_FF_min_inner)
+REDUCTION(int, sum, qutil_is_args, saligned_t, SUM_MACRO, 0)
+REDUCTION(int, mult, qutil_is_args, saligned_t, MULT_MACRO, 1)
+REDUCTION(int, max, qutil_is_args, saligned_t, MAX_MACRO, array[0])
+REDUCTION(int, min, qutil_is_args, saligned_t, MIN_MACRO, array[0])
 
 typedef int (*cmp_f)(const void *a, const void *b);
 
@@ -0,0 +1,469 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(HAVE_X86_AVX2_DISPATCH) || defined(HAVE_X86_AVX512F_DISPATCH)
+# include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+# include <arm_neon.h>
+# define QT_QUTIL_NEON 1
+#endif
+
+/* API Headers */
+#include <qthread/qthread.h>
+
+/* Internal Headers */
+#include "qt_qutil_kernels.h"
+#include "qt_expect.h"
+
+/* These must match the macros in qutil.c: in particular, max/min keep the
+ * current value unless the contender compares greater/less, so a NaN in the
+ * array never replaces a number (but a NaN accumulator stays put). */
+#define SUM_MACRO(sum, add)       sum  += (add)
+#define MULT_MACRO(prod, factor)  prod *= (factor)
+#define MAX_MACRO(max, contender) if (max < (contender)) max = (contender)
+#define MIN_MACRO(max, contender) if (max > (contender)) max = (contender)
+
+/* Portable kernels. Four independent accumulators are enough to hide the
+ * latency of the operation, and simple enough for the compiler to vectorize
+ * on its own where it can. */
+#define GENERIC_KERNEL(_fname_, _type_, _opmacro_)                \
+    static _type_ _fname_(const _type_ *restrict a, size_t n)     \
+    {                                                             \
+        _type_ r0 = a[0];                                         \
+        size_t i  = 1;                                            \
+        if (n >= 8) {                                             \
+            _type_ r1 = a[1], r2 = a[2], r3 = a[3];               \
+            for (i = 4; i + 4 <= n; i += 4) {                     \
+                _opmacro_(r0, a[i]);                              \
+                _opmacro_(r1, a[i + 1]);                          \
+                _opmacro_(r2, a[i + 2]);                          \
+                _opmacro_(r3, a[i + 3]);                          \
+            }                                                     \
+            _opmacro_(r0, r1);                                    \
+            _opmacro_(r2, r3);                                    \
+            _opmacro_(r0, r2);                                    \
+        }                                                         \
+        for (; i < n; i++) {                                      \
+            _opmacro_(r0, a[i]);                                  \
+        }                                                         \
+        return r0;                                                \
+    }
+
+GENERIC_KERNEL(generic_double_sum, double, SUM_MACRO)
+GENERIC_KERNEL(generic_double_mult, double, MULT_MACRO)
+GENERIC_KERNEL(generic_double_max, double, MAX_MACRO)
+GENERIC_KERNEL(generic_double_min, double, MIN_MACRO)
+GENERIC_KERNEL(generic_uint_sum, aligned_t, SUM_MACRO)
+GENERIC_KERNEL(generic_uint_mult, aligned_t, MULT_MACRO)
+GENERIC_KERNEL(generic_uint_max, aligned_t, MAX_MACRO)
+GENERIC_KERNEL(generic_uint_min, aligned_t, MIN_MACRO)
+GENERIC_KERNEL(generic_int_sum, saligned_t, SUM_MACRO)
+GENERIC_KERNEL(generic_int_mult, saligned_t, MULT_MACRO)
+GENERIC_KERNEL(generic_int_max, saligned_t, MAX_MACRO)
+GENERIC_KERNEL(generic_int_min, saligned_t, MIN_MACRO)
+
+static double generic_double_dot(const double *restrict a,
+                                 const double *restrict b,
+                                 size_t                 n)
+{
+    double r0 = 0.0, r1 = 0.0, r2 = 0.0, r3 = 0.0;
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        r0 += a[i] * b[i];
+        r1 += a[i + 1] * b[i + 1];
+        r2 += a[i + 2] * b[i + 2];
+        r3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) {
+        r0 += a[i] * b[i];
+    }
+    return (r0 + r1) + (r2 + r3);
+}
+
+static void generic_double_axpy(double *restrict       y,
+                                double                 alpha,
+                                const double *restrict x,
+                                size_t                 n)
+{
+    for (size_t i = 0; i < n; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+static void generic_fill64(uint64_t *restrict a,
+                           uint64_t           v,
+                           size_t             n)
+{
+    for (size_t i = 0; i < n; i++) {
+        a[i] = v;
+    }
+}
+
+static Q_UNUSED const qt_qutil_kernels_t generic_kernels = {
+    "generic",
+    generic_double_sum, generic_double_mult, generic_double_max, generic_double_min,
+    generic_uint_sum,   generic_uint_mult,   generic_uint_max,   generic_uint_min,
+    generic_int_sum,    generic_int_mult,    generic_int_max,    generic_int_min,
+    generic_double_dot, generic_double_axpy, generic_fill64
+};
+
+/* Vector kernels. _vec_ holds _width_ elements; two vectors are kept in
+ * flight, both seeded from the array itself, which is a valid starting point
+ * for every operation. The lanes are folded with the scalar operation at the
+ * end, followed by the leftover tail. Arrays shorter than two vectors go to
+ * the portable kernel. _op_(acc, x) must give the same answer as
+ * _opmacro_(acc, x) on each lane. */
+#define VECTOR_KERNEL(_fname_, _attr_, _type_, _vec_, _width_, _load_, _store_, _op_, _opmacro_, _fallback_) \
+    static _attr_ _type_ _fname_(const _type_ *restrict a, size_t n)                                          \
+    {                                                                                                         \
+        _type_ lanes[_width_];                                                                                \
+        _type_ r;                                                                                             \
+        _vec_  v0, v1;                                                                                        \
+        size_t i;                                                                                             \
+        if (n < 2 * (_width_)) { return _fallback_(a, n); }                                                   \
+        v0 = _load_(a);                                                                                       \
+        v1 = _load_(a + (_width_));                                                                           \
+        for (i = 2 * (_width_); i + 2 * (_width_) <= n; i += 2 * (_width_)) {                                 \
+            v0 = _op_(v0, _load_(a + i));                                                                     \
+            v1 = _op_(v1, _load_(a + i + (_width_)));                                                         \
+        }                                                                                                     \
+        v0 = _op_(v0, v1);                                                                                    \
+        _store_(lanes, v0);                                                                                   \
+        r = lanes[0];                                                                                         \
+        for (size_t l = 1; l < (_width_); l++) {                                                              \
+            _opmacro_(r, lanes[l]);                                                                           \
+        }                                                                                                     \
+        for (; i < n; i++) {                                                                                  \
+            _opmacro_(r, a[i]);                                                                               \
+        }                                                                                                     \
+        return r;                                                                                             \
+    }
+
+/* Streaming kernels. Scalar steps are taken until the first argument (the
+ * output, or for dot the first input) reaches a vector boundary, after which
+ * it is accessed with aligned loads and stores; the other input may have any
+ * alignment. Two vectors are processed per iteration. */
+#define DOT_KERNEL(_fname_, _attr_, _vec_, _width_, _loada_, _load_, _store_, _zero_, _add_, _mul_) \
+    static _attr_ double _fname_(const double *restrict a, const double *restrict b, size_t n)      \
+    {                                                                                              \
+        double lanes[_width_];                                                                     \
+        double r  = 0.0;                                                                           \
+        _vec_  v0 = _zero_(), v1 = _zero_();                                                       \
+        size_t i  = 0;                                                                             \
+        for (; i < n && ((uintptr_t)(a + i) % sizeof(_vec_)); i++) {                               \
+            r += a[i] * b[i];                                                                      \
+        }                                                                                          \
+        for (; i + 2 * (_width_) <= n; i += 2 * (_width_)) {                                       \
+            v0 = _add_(v0, _mul_(_loada_(a + i), _load_(b + i)));                                  \
+            v1 = _add_(v1, _mul_(_loada_(a + i + (_width_)), _load_(b + i + (_width_))));          \
+        }                                                                                          \
+        _store_(lanes, _add_(v0, v1));                                                             \
+        for (size_t l = 0; l < (_width_); l++) {                                                   \
+            r += lanes[l];                                                                         \
+        }                                                                                          \
+        for (; i < n; i++) {                                                                       \
+            r += a[i] * b[i];                                                                      \
+        }                                                                                          \
+        return r;                                                                                  \
+    }
+
+#define AXPY_KERNEL(_fname_, _attr_, _vec_, _width_, _loada_, _load_, _storea_, _set1_, _add_, _mul_)      \
+    static _attr_ void _fname_(double *restrict y, double alpha, const double *restrict x, size_t n)    \
+    {                                                                                                  \
+        const _vec_ va = _set1_(alpha);                                                                \
+        size_t      i  = 0;                                                                            \
+        for (; i < n && ((uintptr_t)(y + i) % sizeof(_vec_)); i++) {                                   \
+            y[i] += alpha * x[i];                                                                      \
+        }                                                                                              \
+        for (; i + 2 * (_width_) <= n; i += 2 * (_width_)) {                                           \
+            _storea_(y + i, _add_(_loada_(y + i), _mul_(va, _load_(x + i))));                          \
+            _storea_(y + i + (_width_), _add_(_loada_(y + i + (_width_)), _mul_(va, _load_(x + i + (_width_))))); \
+        }                                                                                              \
+        for (; i < n; i++) {                                                                           \
+            y[i] += alpha * x[i];                                                                      \
+        }                                                                                              \
+    }
+
+#define FILL_KERNEL(_fname_, _attr_, _vec_, _width_, _set1_, _storea_)    \
+    static _attr_ void _fname_(uint64_t *restrict a, uint64_t v, size_t n) \
+    {                                                                     \
+        const _vec_ vv = _set1_(v);                                       \
+        size_t      i  = 0;                                               \
+        for (; i < n && ((uintptr_t)(a + i) % sizeof(_vec_)); i++) {      \
+            a[i] = v;                                                     \
+        }                                                                 \
+        for (; i + 2 * (_width_) <= n; i += 2 * (_width_)) {              \
+            _storea_(a + i, vv);                                          \
+            _storea_(a + i + (_width_), vv);                              \
+        }                                                                 \
+        for (; i < n; i++) {                                              \
+            a[i] = v;                                                     \
+        }                                                                 \
+    }
+
+/* The integer vector kernels assume 64-bit aligned_t; with a 32-bit aligned_t
+ * the portable kernels are used for the integer types. */
+#if QTHREAD_SIZEOF_ALIGNED_T == 8
+# define QT_QUTIL_INT64 1
+#endif
+
+#ifdef __SSE2__
+/* SSE2 is part of the x86-64 baseline, so these need no runtime check. It has
+ * no 64-bit integer compares or multiplies. Note the operand order of
+ * max/min: the instructions return their second operand when either is a
+ * NaN, which is what keeps a NaN contender from replacing the accumulator. */
+# define SSE2_FN static inline
+SSE2_FN __m128d sse2_ld_pd(const double *p) { return _mm_loadu_pd(p); }
+SSE2_FN void sse2_st_pd(double *p, __m128d v) { _mm_storeu_pd(p, v); }
+SSE2_FN __m128d sse2_max_pd(__m128d acc, __m128d x) { return _mm_max_pd(x, acc); }
+SSE2_FN __m128d sse2_min_pd(__m128d acc, __m128d x) { return _mm_min_pd(x, acc); }
+VECTOR_KERNEL(sse2_double_sum, , double, __m128d, 2, sse2_ld_pd, sse2_st_pd, _mm_add_pd, SUM_MACRO, generic_double_sum)
+VECTOR_KERNEL(sse2_double_mult, , double, __m128d, 2, sse2_ld_pd, sse2_st_pd, _mm_mul_pd, MULT_MACRO, generic_double_mult)
+VECTOR_KERNEL(sse2_double_max, , double, __m128d, 2, sse2_ld_pd, sse2_st_pd, sse2_max_pd, MAX_MACRO, generic_double_max)
+VECTOR_KERNEL(sse2_double_min, , double, __m128d, 2, sse2_ld_pd, sse2_st_pd, sse2_min_pd, MIN_MACRO, generic_double_min)
+# ifdef QT_QUTIL_INT64
+SSE2_FN __m128i sse2_ld_u(const aligned_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+SSE2_FN __m128i sse2_ld_s(const saligned_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+SSE2_FN void sse2_st_u(aligned_t *p, __m128i v) { _mm_storeu_si128((__m128i *)p, v); }
+SSE2_FN void sse2_st_s(saligned_t *p, __m128i v) { _mm_storeu_si128((__m128i *)p, v); }
+VECTOR_KERNEL(sse2_uint_sum, , aligned_t, __m128i, 2, sse2_ld_u, sse2_st_u, _mm_add_epi64, SUM_MACRO, generic_uint_sum)
+VECTOR_KERNEL(sse2_int_sum, , saligned_t, __m128i, 2, sse2_ld_s, sse2_st_s, _mm_add_epi64, SUM_MACRO, generic_int_sum)
+# else
+#  define sse2_uint_sum generic_uint_sum
+#  define sse2_int_sum  generic_int_sum
+# endif
+
+SSE2_FN __m128d sse2_lda_pd(const double *p) { return _mm_load_pd(p); }
+SSE2_FN void sse2_sta_pd(double *p, __m128d v) { _mm_store_pd(p, v); }
+SSE2_FN void sse2_sta_64(uint64_t *p, __m128i v) { _mm_store_si128((__m128i *)p, v); }
+SSE2_FN __m128i sse2_set1_64(uint64_t v) { return _mm_set1_epi64x((long long)v); }
+DOT_KERNEL(sse2_double_dot, , __m128d, 2, sse2_lda_pd, sse2_ld_pd, sse2_st_pd, _mm_setzero_pd, _mm_add_pd, _mm_mul_pd)
+AXPY_KERNEL(sse2_double_axpy, , __m128d, 2, sse2_lda_pd, sse2_ld_pd, sse2_sta_pd, _mm_set1_pd, _mm_add_pd, _mm_mul_pd)
+FILL_KERNEL(sse2_fill64, , __m128i, 2, sse2_set1_64, sse2_sta_64)
+
+static const qt_qutil_kernels_t sse2_kernels = {
+    "sse2",
+    sse2_double_sum, sse2_double_mult, sse2_double_max,  sse2_double_min,
+    sse2_uint_sum,   generic_uint_mult, generic_uint_max, generic_uint_min,
+    sse2_int_sum,    generic_int_mult,  generic_int_max,  generic_int_min,
+    sse2_double_dot, sse2_double_axpy,  sse2_fill64
+};
+#endif /* ifdef __SSE2__ */
+
+#ifdef HAVE_X86_AVX2_DISPATCH
+# define AVX2_ATTR __attribute__((target("avx2")))
+# define AVX2_FN   static inline AVX2_ATTR
+AVX2_FN __m256d avx2_ld_pd(const double *p) { return _mm256_loadu_pd(p); }
+AVX2_FN void avx2_st_pd(double *p, __m256d v) { _mm256_storeu_pd(p, v); }
+AVX2_FN __m256d avx2_add_pd(__m256d acc, __m256d x) { return _mm256_add_pd(acc, x); }
+AVX2_FN __m256d avx2_mul_pd(__m256d acc, __m256d x) { return _mm256_mul_pd(acc, x); }
+AVX2_FN __m256d avx2_max_pd(__m256d acc, __m256d x) { return _mm256_max_pd(x, acc); }
+AVX2_FN __m256d avx2_min_pd(__m256d acc, __m256d x) { return _mm256_min_pd(x, acc); }
+VECTOR_KERNEL(avx2_double_sum, AVX2_ATTR, double, __m256d, 4, avx2_ld_pd, avx2_st_pd, avx2_add_pd, SUM_MACRO, generic_double_sum)
+VECTOR_KERNEL(avx2_double_mult, AVX2_ATTR, double, __m256d, 4, avx2_ld_pd, avx2_st_pd, avx2_mul_pd, MULT_MACRO, generic_double_mult)
+VECTOR_KERNEL(avx2_double_max, AVX2_ATTR, double, __m256d, 4, avx2_ld_pd, avx2_st_pd, avx2_max_pd, MAX_MACRO, generic_double_max)
+VECTOR_KERNEL(avx2_double_min, AVX2_ATTR, double, __m256d, 4, avx2_ld_pd, avx2_st_pd, avx2_min_pd, MIN_MACRO, generic_double_min)
+# ifdef QT_QUTIL_INT64
+AVX2_FN __m256i avx2_ld_u(const aligned_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+AVX2_FN __m256i avx2_ld_s(const saligned_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+AVX2_FN void avx2_st_u(aligned_t *p, __m256i v) { _mm256_storeu_si256((__m256i *)p, v); }
+AVX2_FN void avx2_st_s(saligned_t *p, __m256i v) { _mm256_storeu_si256((__m256i *)p, v); }
+AVX2_FN __m256i avx2_add_i(__m256i acc, __m256i x) { return _mm256_add_epi64(acc, x); }
+/* AVX2 only has a signed 64-bit compare; unsigned values are compared by
+ * flipping their top bits first */
+AVX2_FN __m256i avx2_max_s(__m256i acc, __m256i x) { return _mm256_blendv_epi8(acc, x, _mm256_cmpgt_epi64(x, acc)); }
+AVX2_FN __m256i avx2_min_s(__m256i acc, __m256i x) { return _mm256_blendv_epi8(acc, x, _mm256_cmpgt_epi64(acc, x)); }
+AVX2_FN __m256i avx2_gt_u(__m256i a, __m256i b)
+{
+    const __m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+
+    return _mm256_cmpgt_epi64(_mm256_xor_si256(a, bias), _mm256_xor_si256(b, bias));
+}
+AVX2_FN __m256i avx2_max_u(__m256i acc, __m256i x) { return _mm256_blendv_epi8(acc, x, avx2_gt_u(x, acc)); }
+AVX2_FN __m256i avx2_min_u(__m256i acc, __m256i x) { return _mm256_blendv_epi8(acc, x, avx2_gt_u(acc, x)); }
+VECTOR_KERNEL(avx2_uint_sum, AVX2_ATTR, aligned_t, __m256i, 4, avx2_ld_u, avx2_st_u, avx2_add_i, SUM_MACRO, generic_uint_sum)
+VECTOR_KERNEL(avx2_uint_max, AVX2_ATTR, aligned_t, __m256i, 4, avx2_ld_u, avx2_st_u, avx2_max_u, MAX_MACRO, generic_uint_max)
+VECTOR_KERNEL(avx2_uint_min, AVX2_ATTR, aligned_t, __m256i, 4, avx2_ld_u, avx2_st_u, avx2_min_u, MIN_MACRO, generic_uint_min)
+VECTOR_KERNEL(avx2_int_sum, AVX2_ATTR, saligned_t, __m256i, 4, avx2_ld_s, avx2_st_s, avx2_add_i, SUM_MACRO, generic_int_sum)
+VECTOR_KERNEL(avx2_int_max, AVX2_ATTR, saligned_t, __m256i, 4, avx2_ld_s, avx2_st_s, avx2_max_s, MAX_MACRO, generic_int_max)
+VECTOR_KERNEL(avx2_int_min, AVX2_ATTR, saligned_t, __m256i, 4, avx2_ld_s, avx2_st_s, avx2_min_s, MIN_MACRO, generic_int_min)
+# else
+#  define avx2_uint_sum generic_uint_sum
+#  define avx2_uint_max generic_uint_max
+#  define avx2_uint_min generic_uint_min
+#  define avx2_int_sum  generic_int_sum
+#  define avx2_int_max  generic_int_max
+#  define avx2_int_min  generic_int_min
+# endif
+
+AVX2_FN __m256d avx2_lda_pd(const double *p) { return _mm256_load_pd(p); }
+AVX2_FN void avx2_sta_pd(double *p, __m256d v) { _mm256_store_pd(p, v); }
+AVX2_FN __m256d avx2_zero_pd(void) { return _mm256_setzero_pd(); }
+AVX2_FN __m256d avx2_set1_pd(double v) { return _mm256_set1_pd(v); }
+AVX2_FN __m256d avx2_mul2_pd(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+AVX2_FN void avx2_sta_64(uint64_t *p, __m256i v) { _mm256_store_si256((__m256i *)p, v); }
+AVX2_FN __m256i avx2_set1_64(uint64_t v) { return _mm256_set1_epi64x((long long)v); }
+DOT_KERNEL(avx2_double_dot, AVX2_ATTR, __m256d, 4, avx2_lda_pd, avx2_ld_pd, avx2_st_pd, avx2_zero_pd, avx2_add_pd, avx2_mul2_pd)
+AXPY_KERNEL(avx2_double_axpy, AVX2_ATTR, __m256d, 4, avx2_lda_pd, avx2_ld_pd, avx2_sta_pd, avx2_set1_pd, avx2_add_pd, avx2_mul2_pd)
+FILL_KERNEL(avx2_fill64, AVX2_ATTR, __m256i, 4, avx2_set1_64, avx2_sta_64)
+
+static const qt_qutil_kernels_t avx2_kernels = {
+    "avx2",
+    avx2_double_sum, avx2_double_mult, avx2_double_max, avx2_double_min,
+    avx2_uint_sum,   generic_uint_mult, avx2_uint_max,  avx2_uint_min,
+    avx2_int_sum,    generic_int_mult,  avx2_int_max,   avx2_int_min,
+    avx2_double_dot, avx2_double_axpy,  avx2_fill64
+};
+#endif /* ifdef HAVE_X86_AVX2_DISPATCH */
+
+#ifdef HAVE_X86_AVX512F_DISPATCH
+/* AVX-512F has native 64-bit min/max in both signednesses; the 64-bit
+ * multiply needs AVX-512DQ, so integer products stay scalar */
+# define AVX512_ATTR __attribute__((target("avx512f")))
+# define AVX512_FN   static inline AVX512_ATTR
+AVX512_FN __m512d avx512_ld_pd(const double *p) { return _mm512_loadu_pd(p); }
+AVX512_FN void avx512_st_pd(double *p, __m512d v) { _mm512_storeu_pd(p, v); }
+AVX512_FN __m512d avx512_add_pd(__m512d acc, __m512d x) { return _mm512_add_pd(acc, x); }
+AVX512_FN __m512d avx512_mul_pd(__m512d acc, __m512d x) { return _mm512_mul_pd(acc, x); }
+AVX512_FN __m512d avx512_max_pd(__m512d acc, __m512d x) { return _mm512_max_pd(x, acc); }
+AVX512_FN __m512d avx512_min_pd(__m512d acc, __m512d x) { return _mm512_min_pd(x, acc); }
+VECTOR_KERNEL(avx512_double_sum, AVX512_ATTR, double, __m512d, 8, avx512_ld_pd, avx512_st_pd, avx512_add_pd, SUM_MACRO, generic_double_sum)
+VECTOR_KERNEL(avx512_double_mult, AVX512_ATTR, double, __m512d, 8, avx512_ld_pd, avx512_st_pd, avx512_mul_pd, MULT_MACRO, generic_double_mult)
+VECTOR_KERNEL(avx512_double_max, AVX512_ATTR, double, __m512d, 8, avx512_ld_pd, avx512_st_pd, avx512_max_pd, MAX_MACRO, generic_double_max)
+VECTOR_KERNEL(avx512_double_min, AVX512_ATTR, double, __m512d, 8, avx512_ld_pd, avx512_st_pd, avx512_min_pd, MIN_MACRO, generic_double_min)
+# ifdef QT_QUTIL_INT64
+AVX512_FN __m512i avx512_ld_u(const aligned_t *p) { return _mm512_loadu_si512((const void *)p); }
+AVX512_FN __m512i avx512_ld_s(const saligned_t *p) { return _mm512_loadu_si512((const void *)p); }
+AVX512_FN void avx512_st_u(aligned_t *p, __m512i v) { _mm512_storeu_si512((void *)p, v); }
+AVX512_FN void avx512_st_s(saligned_t *p, __m512i v) { _mm512_storeu_si512((void *)p, v); }
+AVX512_FN __m512i avx512_add_i(__m512i acc, __m512i x) { return _mm512_add_epi64(acc, x); }
+AVX512_FN __m512i avx512_max_u(__m512i acc, __m512i x) { return _mm512_max_epu64(acc, x); }
+AVX512_FN __m512i avx512_min_u(__m512i acc, __m512i x) { return _mm512_min_epu64(acc, x); }
+AVX512_FN __m512i avx512_max_s(__m512i acc, __m512i x) { return _mm512_max_epi64(acc, x); }
+AVX512_FN __m512i avx512_min_s(__m512i acc, __m512i x) { return _mm512_min_epi64(acc, x); }
+VECTOR_KERNEL(avx512_uint_sum, AVX512_ATTR, aligned_t, __m512i, 8, avx512_ld_u, avx512_st_u, avx512_add_i, SUM_MACRO, generic_uint_sum)
+VECTOR_KERNEL(avx512_uint_max, AVX512_ATTR, aligned_t, __m512i, 8, avx512_ld_u, avx512_st_u, avx512_max_u, MAX_MACRO, generic_uint_max)
+VECTOR_KERNEL(avx512_uint_min, AVX512_ATTR, aligned_t, __m512i, 8, avx512_ld_u, avx512_st_u, avx512_min_u, MIN_MACRO, generic_uint_min)
+VECTOR_KERNEL(avx512_int_sum, AVX512_ATTR, saligned_t, __m512i, 8, avx512_ld_s, avx512_st_s, avx512_add_i, SUM_MACRO, generic_int_sum)
+VECTOR_KERNEL(avx512_int_max, AVX512_ATTR, saligned_t, __m512i, 8, avx512_ld_s, avx512_st_s, avx512_max_s, MAX_MACRO, generic_int_max)
+VECTOR_KERNEL(avx512_int_min, AVX512_ATTR, saligned_t, __m512i, 8, avx512_ld_s, avx512_st_s, avx512_min_s, MIN_MACRO, generic_int_min)
+# else
+#  define avx512_uint_sum generic_uint_sum
+#  define avx512_uint_max generic_uint_max
+#  define avx512_uint_min generic_uint_min
+#  define avx512_int_sum  generic_int_sum
+#  define avx512_int_max  generic_int_max
+#  define avx512_int_min  generic_int_min
+# endif
+
+AVX512_FN __m512d avx512_lda_pd(const double *p) { return _mm512_load_pd(p); }
+AVX512_FN void avx512_sta_pd(double *p, __m512d v) { _mm512_store_pd(p, v); }
+AVX512_FN __m512d avx512_zero_pd(void) { return _mm512_setzero_pd(); }
+AVX512_FN __m512d avx512_set1_pd(double v) { return _mm512_set1_pd(v); }
+AVX512_FN __m512d avx512_mul2_pd(__m512d a, __m512d b) { return _mm512_mul_pd(a, b); }
+AVX512_FN void avx512_sta_64(uint64_t *p, __m512i v) { _mm512_store_si512((void *)p, v); }
+AVX512_FN __m512i avx512_set1_64(uint64_t v) { return _mm512_set1_epi64((long long)v); }
+DOT_KERNEL(avx512_double_dot, AVX512_ATTR, __m512d, 8, avx512_lda_pd, avx512_ld_pd, avx512_st_pd, avx512_zero_pd, avx512_add_pd, avx512_mul2_pd)
+AXPY_KERNEL(avx512_double_axpy, AVX512_ATTR, __m512d, 8, avx512_lda_pd, avx512_ld_pd, avx512_sta_pd, avx512_set1_pd, avx512_add_pd, avx512_mul2_pd)
+FILL_KERNEL(avx512_fill64, AVX512_ATTR, __m512i, 8, avx512_set1_64, avx512_sta_64)
+
+static const qt_qutil_kernels_t avx512_kernels = {
+    "avx512f",
+    avx512_double_sum, avx512_double_mult, avx512_double_max, avx512_double_min,
+    avx512_uint_sum,   generic_uint_mult,  avx512_uint_max,   avx512_uint_min,
+    avx512_int_sum,    generic_int_mult,   avx512_int_max,    avx512_int_min,
+    avx512_double_dot, avx512_double_axpy, avx512_fill64
+};
+#endif /* ifdef HAVE_X86_AVX512F_DISPATCH */
+
+#ifdef QT_QUTIL_NEON
+/* Advanced SIMD is mandatory on AArch64. vmaxq_f64/vminq_f64 propagate NaNs,
+ * so max/min are done with a compare and select instead. */
+# define NEON_FN static inline
+NEON_FN float64x2_t neon_max_pd(float64x2_t acc, float64x2_t x) { return vbslq_f64(vcgtq_f64(x, acc), x, acc); }
+NEON_FN float64x2_t neon_min_pd(float64x2_t acc, float64x2_t x) { return vbslq_f64(vcltq_f64(x, acc), x, acc); }
+VECTOR_KERNEL(neon_double_sum, , double, float64x2_t, 2, vld1q_f64, vst1q_f64, vaddq_f64, SUM_MACRO, generic_double_sum)
+VECTOR_KERNEL(neon_double_mult, , double, float64x2_t, 2, vld1q_f64, vst1q_f64, vmulq_f64, MULT_MACRO, generic_double_mult)
+VECTOR_KERNEL(neon_double_max, , double, float64x2_t, 2, vld1q_f64, vst1q_f64, neon_max_pd, MAX_MACRO, generic_double_max)
+VECTOR_KERNEL(neon_double_min, , double, float64x2_t, 2, vld1q_f64, vst1q_f64, neon_min_pd, MIN_MACRO, generic_double_min)
+# ifdef QT_QUTIL_INT64
+NEON_FN uint64x2_t neon_ld_u(const aligned_t *p) { return vld1q_u64((const uint64_t *)p); }
+NEON_FN int64x2_t neon_ld_s(const saligned_t *p) { return vld1q_s64((const int64_t *)p); }
+NEON_FN void neon_st_u(aligned_t *p, uint64x2_t v) { vst1q_u64((uint64_t *)p, v); }
+NEON_FN void neon_st_s(saligned_t *p, int64x2_t v) { vst1q_s64((int64_t *)p, v); }
+NEON_FN uint64x2_t neon_max_u(uint64x2_t acc, uint64x2_t x) { return vbslq_u64(vcgtq_u64(x, acc), x, acc); }
+NEON_FN uint64x2_t neon_min_u(uint64x2_t acc, uint64x2_t x) { return vbslq_u64(vcltq_u64(x, acc), x, acc); }
+NEON_FN int64x2_t neon_max_s(int64x2_t acc, int64x2_t x) { return vbslq_s64(vcgtq_s64(x, acc), x, acc); }
+NEON_FN int64x2_t neon_min_s(int64x2_t acc, int64x2_t x) { return vbslq_s64(vcltq_s64(x, acc), x, acc); }
+VECTOR_KERNEL(neon_uint_sum, , aligned_t, uint64x2_t, 2, neon_ld_u, neon_st_u, vaddq_u64, SUM_MACRO, generic_uint_sum)
+VECTOR_KERNEL(neon_uint_max, , aligned_t, uint64x2_t, 2, neon_ld_u, neon_st_u, neon_max_u, MAX_MACRO, generic_uint_max)
+VECTOR_KERNEL(neon_uint_min, , aligned_t, uint64x2_t, 2, neon_ld_u, neon_st_u, neon_min_u, MIN_MACRO, generic_uint_min)
+VECTOR_KERNEL(neon_int_sum, , saligned_t, int64x2_t, 2, neon_ld_s, neon_st_s, vaddq_s64, SUM_MACRO, generic_int_sum)
+VECTOR_KERNEL(neon_int_max, , saligned_t, int64x2_t, 2, neon_ld_s, neon_st_s, neon_max_s, MAX_MACRO, generic_int_max)
+VECTOR_KERNEL(neon_int_min, , saligned_t, int64x2_t, 2, neon_ld_s, neon_st_s, neon_min_s, MIN_MACRO, generic_int_min)
+# else
+#  define neon_uint_sum generic_uint_sum
+#  define neon_uint_max generic_uint_max
+#  define neon_uint_min generic_uint_min
+#  define neon_int_sum  generic_int_sum
+#  define neon_int_max  generic_int_max
+#  define neon_int_min  generic_int_min
+# endif
+
+NEON_FN float64x2_t neon_zero_pd(void) { return vdupq_n_f64(0.0); }
+NEON_FN void neon_st_64(uint64_t *p, uint64x2_t v) { vst1q_u64(p, v); }
+DOT_KERNEL(neon_double_dot, , float64x2_t, 2, vld1q_f64, vld1q_f64, vst1q_f64, neon_zero_pd, vaddq_f64, vmulq_f64)
+AXPY_KERNEL(neon_double_axpy, , float64x2_t, 2, vld1q_f64, vld1q_f64, vst1q_f64, vdupq_n_f64, vaddq_f64, vmulq_f64)
+FILL_KERNEL(neon_fill64, , uint64x2_t, 2, vdupq_n_u64, neon_st_64)
+
+static const qt_qutil_kernels_t neon_kernels = {
+    "neon",
+    neon_double_sum, neon_double_mult, neon_double_max, neon_double_min,
+    neon_uint_sum,   generic_uint_mult, neon_uint_max,  neon_uint_min,
+    neon_int_sum,    generic_int_mult,  neon_int_max,   neon_int_min,
+    neon_double_dot, neon_double_axpy,  neon_fill64
+};
+#endif /* ifdef QT_QUTIL_NEON */
+
+static const qt_qutil_kernels_t *qt_qutil_kernels_select(void)
+{   /*{{{*/
+#ifdef HAVE_X86_AVX512F_DISPATCH
+    if (__builtin_cpu_supports("avx512f")) {
+        return &avx512_kernels;
+    }
+#endif
+#ifdef HAVE_X86_AVX2_DISPATCH
+    if (__builtin_cpu_supports("avx2")) {
+        return &avx2_kernels;
+    }
+#endif
+#if defined(__SSE2__)
+    return &sse2_kernels;
+
+#elif defined(QT_QUTIL_NEON)
+    return &neon_kernels;
+
+#else
+    return &generic_kernels;
+#endif
+} /*}}}*/
+
+const qt_qutil_kernels_t INTERNAL *qt_qutil_kernels(void)
+{   /*{{{*/
+    /* racing first callers all store the same pointer */
+    static const qt_qutil_kernels_t *selected = NULL;
+
+    if (QTHREAD_UNLIKELY(selected == NULL)) {
+        selected = qt_qutil_kernels_select();
+    }
+    return selected;
+} /*}}}*/
+
+/* vim:set expandtab: */
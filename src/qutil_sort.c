@@ -0,0 +1,450 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/* API Headers */
+#include <qthread/qthread.h>
+#include <qthread/qutil.h>
+#include <qthread/qloop.h>
+#include <qthread/sinc.h>
+
+/* Internal Headers */
+#include "qt_asserts.h"
+#include "qt_visibility.h"
+#include "qt_debug.h"
+#include "qt_initialized.h" // for qthread_library_initialized
+#include "qt_threadqueues.h"     // for qt_spawncache_flush
+#include "qt_shepherd_innards.h" // for qthread_internal_getshep
+
+/* Arrays shorter than this are sorted by a single task */
+#ifndef QUTIL_SORT_SERIAL_CUTOFF
+# define QUTIL_SORT_SERIAL_CUTOFF 16384
+#endif
+
+/* Both sorts cut the input into one block per worker and run their counting
+ * and distribution passes over those blocks with qt_loop_balance(), which
+ * hands block i to shepherd i (mod the number of shepherds). Each block also
+ * first-touches the matching stretch of the scratch buffer, so on NUMA
+ * systems a block's part of the scratch space lives on the node of the
+ * shepherd that fills it. The sample sort's per-bucket sorts are stealable
+ * tasks, so they run wherever there's a free worker. */
+
+static size_t qutil_sort_nblocks(size_t n)
+{   /*{{{*/
+    const size_t workers = qthread_num_workers();
+
+    if ((workers < 2) || (n < QUTIL_SORT_SERIAL_CUTOFF)) {
+        return 1;
+    }
+    return workers;
+} /*}}}*/
+
+static void qutil_sort_touch(char  *buf,
+                             size_t bytes)
+{   /*{{{*/
+    static long pagesize = 0;
+
+    if (pagesize == 0) {
+        pagesize = sysconf(_SC_PAGESIZE);
+        if (pagesize <= 0) { pagesize = 4096; }
+    }
+    for (size_t off = 0; off < bytes; off += pagesize) {
+        buf[off] = 0;
+    }
+} /*}}}*/
+
+/****************************************************************************
+ * Sample sort
+ *
+ * A sorted random sample of the input picks nsplit splitters, which define
+ * 2*nsplit+1 classes: class 2b holds the elements between splitters b-1 and
+ * b, and class 2b-1 holds the elements equal to splitter b-1 when that value
+ * was picked more than once (i.e. it is common enough to deserve a class of
+ * its own, which never needs sorting). Every block classifies and counts
+ * its elements, a prefix sum turns the counts into positions, every block
+ * scatters its elements into the scratch buffer, and finally one task per
+ * class sorts it with qsort() and copies it back.
+ ****************************************************************************/
+typedef int (*qutil_cmp_f)(const void *a, const void *b);
+
+struct qutil_samplesort_s {
+    char        *base, *tmp;
+    size_t       nmemb, size;
+    qutil_cmp_f  cmp;
+    const char  *splitters;
+    uint8_t     *dup;
+    size_t       nsplit, nclass;
+    uint16_t    *cls;
+    size_t       nblocks, blocklen;
+    size_t      *counts;           /* nblocks * nclass */
+    size_t      *cstart;           /* nclass + 1 */
+    qt_sinc_t    sinc;
+};
+
+struct qutil_samplesort_class {
+    struct qutil_samplesort_s *ss;
+    size_t                     class;
+};
+
+static QINLINE size_t qutil_samplesort_classify(const struct qutil_samplesort_s *ss,
+                                                const void                      *x)
+{   /*{{{*/
+    const char *const splitters = ss->splitters;
+    const size_t      size      = ss->size;
+    size_t            lo        = 0, hi = ss->nsplit;
+
+    /* b = number of splitters <= x */
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+
+        if (ss->cmp(splitters + mid * size, x) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if ((lo > 0) && ss->dup[lo - 1] && (ss->cmp(x, splitters + (lo - 1) * size) == 0)) {
+        return 2 * lo - 1;
+    }
+    return 2 * lo;
+} /*}}}*/
+
+static void qutil_samplesort_count(const size_t startat,
+                                   const size_t stopat,
+                                   void        *arg)
+{   /*{{{*/
+    struct qutil_samplesort_s *const ss = arg;
+
+    for (size_t blk = startat; blk < stopat; blk++) {
+        const size_t first  = blk * ss->blocklen;
+        const size_t last   = (blk + 1 == ss->nblocks) ? ss->nmemb : first + ss->blocklen;
+        size_t      *counts = ss->counts + blk * ss->nclass;
+
+        qutil_sort_touch(ss->tmp + first * ss->size, (last - first) * ss->size);
+        memset(counts, 0, ss->nclass * sizeof(size_t));
+        for (size_t i = first; i < last; i++) {
+            const size_t c = qutil_samplesort_classify(ss, ss->base + i * ss->size);
+
+            ss->cls[i] = (uint16_t)c;
+            counts[c]++;
+        }
+    }
+} /*}}}*/
+
+static void qutil_samplesort_scatter(const size_t startat,
+                                     const size_t stopat,
+                                     void        *arg)
+{   /*{{{*/
+    struct qutil_samplesort_s *const ss   = arg;
+    const size_t                     size = ss->size;
+
+    for (size_t blk = startat; blk < stopat; blk++) {
+        const size_t first = blk * ss->blocklen;
+        const size_t last  = (blk + 1 == ss->nblocks) ? ss->nmemb : first + ss->blocklen;
+        size_t      *pos   = ss->counts + blk * ss->nclass;
+
+        /* word-sized elements are moved as words, provided they are aligned */
+        switch (((uintptr_t)ss->base % size == 0) ? size : 0) {
+            case 8:
+                for (size_t i = first; i < last; i++) {
+                    ((uint64_t *)ss->tmp)[pos[ss->cls[i]]++] = ((const uint64_t *)ss->base)[i];
+                }
+                break;
+            case 4:
+                for (size_t i = first; i < last; i++) {
+                    ((uint32_t *)ss->tmp)[pos[ss->cls[i]]++] = ((const uint32_t *)ss->base)[i];
+                }
+                break;
+            default:
+                for (size_t i = first; i < last; i++) {
+                    memcpy(ss->tmp + (pos[ss->cls[i]]++) * size, ss->base + i * size, size);
+                }
+                break;
+        }
+    }
+} /*}}}*/
+
+static aligned_t qutil_samplesort_finish(const struct qutil_samplesort_class *arg)
+{   /*{{{*/
+    struct qutil_samplesort_s *const ss    = arg->ss;
+    const size_t                     first = ss->cstart[arg->class];
+    const size_t                     count = ss->cstart[arg->class + 1] - first;
+
+    /* odd classes are runs of a single value */
+    if (((arg->class & 1) == 0) && (count > 1)) {
+        qsort(ss->tmp + first * ss->size, count, ss->size, ss->cmp);
+    }
+    memcpy(ss->base + first * ss->size, ss->tmp + first * ss->size, count * ss->size);
+    qt_sinc_submit(&ss->sinc, NULL);
+    return 0;
+} /*}}}*/
+
+void API_FUNC qutil_samplesort(void       *base,
+                               size_t      nmemb,
+                               size_t      size,
+                               qutil_cmp_f cmp)
+{   /*{{{*/
+    struct qutil_samplesort_s ss;
+    size_t                    nbuckets, nsamples;
+    char                     *samples;
+    uint64_t                  rng;
+
+    assert(qthread_library_initialized);
+    assert(base || nmemb == 0);
+    assert(cmp);
+
+    ss.nblocks = qutil_sort_nblocks(nmemb);
+    if (ss.nblocks == 1) {
+        qsort(base, nmemb, size, cmp);
+        return;
+    }
+
+    ss.base  = base;
+    ss.nmemb = nmemb;
+    ss.size  = size;
+    ss.cmp   = cmp;
+
+    /* a few buckets per worker gives the stealing room to even things out;
+     * the class numbers have to fit in a uint16_t */
+    nbuckets = ss.nblocks * 8;
+    if (nbuckets > 4096) { nbuckets = 4096; }
+    ss.nsplit = nbuckets - 1;
+    ss.nclass = 2 * ss.nsplit + 1;
+
+    /* pick the splitters from a sorted, oversampled, pseudo-random sample */
+    nsamples = nbuckets * 32;
+    if (nsamples > nmemb) { nsamples = nmemb; }
+    samples = MALLOC(nsamples * size);
+    assert(samples);
+    rng = 0x9e3779b97f4a7c15ULL ^ nmemb;
+    for (size_t i = 0; i < nsamples; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        memcpy(samples + i * size, ss.base + (rng % nmemb) * size, size);
+    }
+    qsort(samples, nsamples, size, cmp);
+    for (size_t i = 0; i < ss.nsplit; i++) {
+        memmove(samples + i * size, samples + ((i + 1) * nsamples / nbuckets) * size, size);
+    }
+    ss.splitters = samples;
+    ss.dup       = MALLOC(ss.nsplit);
+    assert(ss.dup);
+    for (size_t i = 0; i < ss.nsplit; i++) {
+        ss.dup[i] = (i > 0 && cmp(samples + (i - 1) * size, samples + i * size) == 0) ||
+                    (i + 1 < ss.nsplit && cmp(samples + i * size, samples + (i + 1) * size) == 0);
+    }
+
+    ss.blocklen = nmemb / ss.nblocks;
+    ss.tmp      = MALLOC(nmemb * size);
+    ss.cls      = MALLOC(nmemb * sizeof(uint16_t));
+    ss.counts   = MALLOC(ss.nblocks * ss.nclass * sizeof(size_t));
+    ss.cstart   = MALLOC((ss.nclass + 1) * sizeof(size_t));
+    assert(ss.tmp && ss.cls && ss.counts && ss.cstart);
+
+    qt_loop_balance(0, ss.nblocks, qutil_samplesort_count, &ss);
+
+    /* class-major prefix sum: each block's count becomes its write position */
+    {
+        size_t pos = 0;
+
+        for (size_t c = 0; c < ss.nclass; c++) {
+            ss.cstart[c] = pos;
+            for (size_t blk = 0; blk < ss.nblocks; blk++) {
+                const size_t cnt = ss.counts[blk * ss.nclass + c];
+
+                ss.counts[blk * ss.nclass + c] = pos;
+                pos                           += cnt;
+            }
+        }
+        ss.cstart[ss.nclass] = pos;
+        assert(pos == nmemb);
+    }
+
+    qt_loop_balance(0, ss.nblocks, qutil_samplesort_scatter, &ss);
+
+    /* sort each class in its own task, left stealable so idle workers can
+     * take up whatever the uneven class sizes leave behind */
+    qt_sinc_init(&ss.sinc, 0, NULL, NULL, 1);
+    for (size_t c = 0; c < ss.nclass; c++) {
+        struct qutil_samplesort_class arg = { &ss, c };
+
+        if (ss.cstart[c] == ss.cstart[c + 1]) { continue; }
+        qt_sinc_expect(&ss.sinc, 1);
+        qassert(qthread_spawn((qthread_f)qutil_samplesort_finish,
+                              &arg, sizeof(arg), NULL, 0, NULL,
+                              NO_SHEPHERD, 0), QTHREAD_SUCCESS);
+    }
+#ifdef QTHREAD_USE_SPAWNCACHE
+    {
+        qthread_shepherd_t *const myshep = qthread_internal_getshep();
+
+        /* outside a task, the spawns went straight to a shepherd's queue */
+        if (myshep != NULL) { qt_spawncache_flush(myshep->ready); }
+    }
+#endif
+    qt_sinc_submit(&ss.sinc, NULL);
+    qt_sinc_wait(&ss.sinc, NULL);
+    qt_sinc_fini(&ss.sinc);
+
+    FREE(ss.cstart, (ss.nclass + 1) * sizeof(size_t));
+    FREE(ss.counts, ss.nblocks * ss.nclass * sizeof(size_t));
+    FREE(ss.cls, nmemb * sizeof(uint16_t));
+    FREE(ss.tmp, nmemb * size);
+    FREE(ss.dup, ss.nsplit);
+    FREE(samples, nsamples * size);
+} /*}}}*/
+
+/****************************************************************************
+ * LSD radix sort
+ *
+ * Eight-bit digits, least significant first. Each pass counts the digits of
+ * every block, prefix-sums the counts digit-major so that the output is
+ * stable, and scatters each block into the other buffer. A pass whose digit
+ * is the same for every element is skipped, so (for instance) sorting 32-bit
+ * values stored in a 64-bit aligned_t takes four passes rather than eight.
+ * Keys are mapped to unsigned integers that order the same way: signed
+ * values have their sign bit flipped, and doubles have their sign bit
+ * flipped when positive and all bits flipped when negative.
+ ****************************************************************************/
+#define QUTIL_RADIX_BITS    8
+#define QUTIL_RADIX_BUCKETS (1 << QUTIL_RADIX_BITS)
+
+#define QUTIL_UINT_KEY(x)   ((uint64_t)(x))
+#define QUTIL_INT_KEY(x)    ((uint64_t)(x) ^ ((uint64_t)1 << (sizeof(saligned_t) * 8 - 1)))
+static QINLINE uint64_t qutil_double_key(double d)
+{   /*{{{*/
+    union {
+        double   d;
+        uint64_t u;
+    } bits;
+
+    bits.d = d;
+    return (bits.u & ((uint64_t)1 << 63)) ? ~bits.u : (bits.u | ((uint64_t)1 << 63));
+} /*}}}*/
+#define QUTIL_DOUBLE_KEY(x) qutil_double_key(x)
+
+#define RADIXSORT(_fname_, _type_, _keymacro_)                                                          \
+    struct _fname_ ## _s {                                                                              \
+        _type_  *src, *dst;                                                                             \
+        size_t   nmemb, nblocks, blocklen;                                                              \
+        unsigned shift;                                                                                 \
+        int      touch;                                                                                 \
+        size_t  *counts; /* nblocks * QUTIL_RADIX_BUCKETS */                                            \
+    };                                                                                                  \
+    static void _fname_ ## _count(const size_t startat,                                                 \
+                                  const size_t stopat,                                                  \
+                                  void        *arg)                                                     \
+    {                                                                                                   \
+        struct _fname_ ## _s *const rs = arg;                                                           \
+        for (size_t blk = startat; blk < stopat; blk++) {                                               \
+            const size_t first  = blk * rs->blocklen;                                                   \
+            const size_t last   = (blk + 1 == rs->nblocks) ? rs->nmemb : first + rs->blocklen;          \
+            size_t      *counts = rs->counts + blk * QUTIL_RADIX_BUCKETS;                               \
+            if (rs->touch) {                                                                            \
+                qutil_sort_touch((char *)(rs->dst + first), (last - first) * sizeof(_type_));           \
+            }                                                                                           \
+            memset(counts, 0, QUTIL_RADIX_BUCKETS * sizeof(size_t));                                    \
+            for (size_t i = first; i < last; i++) {                                                     \
+                counts[(_keymacro_(rs->src[i]) >> rs->shift) & (QUTIL_RADIX_BUCKETS - 1)]++;            \
+            }                                                                                           \
+        }                                                                                               \
+    }                                                                                                   \
+    static void _fname_ ## _scatter(const size_t startat,                                               \
+                                    const size_t stopat,                                                \
+                                    void        *arg)                                                   \
+    {                                                                                                   \
+        struct _fname_ ## _s *const rs = arg;                                                           \
+        for (size_t blk = startat; blk < stopat; blk++) {                                               \
+            const size_t first = blk * rs->blocklen;                                                    \
+            const size_t last  = (blk + 1 == rs->nblocks) ? rs->nmemb : first + rs->blocklen;           \
+            size_t      *pos   = rs->counts + blk * QUTIL_RADIX_BUCKETS;                                \
+            for (size_t i = first; i < last; i++) {                                                     \
+                const _type_ x = rs->src[i];                                                            \
+                rs->dst[pos[(_keymacro_(x) >> rs->shift) & (QUTIL_RADIX_BUCKETS - 1)]++] = x;           \
+            }                                                                                           \
+        }                                                                                               \
+    }                                                                                                   \
+    static void _fname_ ## _copy(const size_t startat,                                                  \
+                                 const size_t stopat,                                                   \
+                                 void        *arg)                                                      \
+    {                                                                                                   \
+        struct _fname_ ## _s *const rs    = arg;                                                        \
+        const size_t                first = startat * rs->blocklen;                                     \
+        const size_t                last  = (stopat == rs->nblocks) ? rs->nmemb : stopat * rs->blocklen; \
+        memcpy(rs->dst + first, rs->src + first, (last - first) * sizeof(_type_));                      \
+    }                                                                                                   \
+    void API_FUNC _fname_(_type_ *array,                                                                \
+                          size_t  length)                                                               \
+    {                                                                                                   \
+        struct _fname_ ## _s rs;                                                                        \
+        _type_              *tmp;                                                                       \
+        assert(qthread_library_initialized);                                                            \
+        if (length < 2) { return; }                                                                     \
+        tmp         = MALLOC(length * sizeof(_type_));                                                  \
+        assert(tmp);                                                                                    \
+        rs.src      = array;                                                                            \
+        rs.dst      = tmp;                                                                              \
+        rs.nmemb    = length;                                                                           \
+        rs.nblocks  = qutil_sort_nblocks(length);                                                       \
+        rs.blocklen = length / rs.nblocks;                                                              \
+        rs.touch    = 1;                                                                                \
+        rs.counts   = MALLOC(rs.nblocks * QUTIL_RADIX_BUCKETS * sizeof(size_t));                        \
+        assert(rs.counts);                                                                              \
+        for (rs.shift = 0; rs.shift < sizeof(_type_) * 8; rs.shift += QUTIL_RADIX_BITS) {               \
+            size_t pos     = 0;                                                                         \
+            int    trivial = 0;                                                                         \
+            if (rs.nblocks > 1) {                                                                       \
+                qt_loop_balance(0, rs.nblocks, _fname_ ## _count, &rs);                                 \
+            } else {                                                                                    \
+                _fname_ ## _count(0, 1, &rs);                                                           \
+            }                                                                                           \
+            rs.touch = 0;                                                                               \
+            for (size_t d = 0; d < QUTIL_RADIX_BUCKETS; d++) {                                          \
+                size_t total = 0;                                                                       \
+                for (size_t blk = 0; blk < rs.nblocks; blk++) {                                         \
+                    total += rs.counts[blk * QUTIL_RADIX_BUCKETS + d];                                  \
+                }                                                                                       \
+                if (total == length) { trivial = 1; break; }                                            \
+                if (total == 0) { continue; }                                                           \
+                for (size_t blk = 0; blk < rs.nblocks; blk++) {                                         \
+                    const size_t cnt = rs.counts[blk * QUTIL_RADIX_BUCKETS + d];                        \
+                    rs.counts[blk * QUTIL_RADIX_BUCKETS + d] = pos;                                     \
+                    pos                                     += cnt;                                     \
+                }                                                                                       \
+            }                                                                                           \
+            if (trivial) { continue; } /* every element has the same digit */                           \
+            if (rs.nblocks > 1) {                                                                       \
+                qt_loop_balance(0, rs.nblocks, _fname_ ## _scatter, &rs);                               \
+            } else {                                                                                    \
+                _fname_ ## _scatter(0, 1, &rs);                                                         \
+            }                                                                                           \
+            {                                                                                           \
+                _type_ *swap = rs.src;                                                                  \
+                rs.src = rs.dst;                                                                        \
+                rs.dst = swap;                                                                          \
+            }                                                                                           \
+        }                                                                                               \
+        if (rs.src != array) {                                                                          \
+            rs.dst = array;                                                                             \
+            if (rs.nblocks > 1) {                                                                       \
+                qt_loop_balance(0, rs.nblocks, _fname_ ## _copy, &rs);                                  \
+            } else {                                                                                    \
+                _fname_ ## _copy(0, 1, &rs);                                                            \
+            }                                                                                           \
+        }                                                                                               \
+        FREE(rs.counts, rs.nblocks * QUTIL_RADIX_BUCKETS * sizeof(size_t));                             \
+        FREE(tmp, length * sizeof(_type_));                                                             \
+    }
+
+RADIXSORT(qutil_uint_radixsort, aligned_t, QUTIL_UINT_KEY)
+RADIXSORT(qutil_int_radixsort, saligned_t, QUTIL_INT_KEY)
+RADIXSORT(qutil_double_radixsort, double, QUTIL_DOUBLE_KEY)
+
+/* vim:set expandtab: */
@@ -2,428 +2,412 @@
 # include "config.h"
 #endif
 
-#define QTHREAD_NO_ASSERTS 1
-
+/* System Headers */
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
-#if (HAVE_MEMALIGN && HAVE_MALLOC_H)
-# include <malloc.h>                   /* for memalign() */
-#endif
 
+/* The API */
 #include "qthread/qthread.h"
-#include "qthread/cacheline.h"
 #include "qthread/sinc.h"
+#include "qthread/cacheline.h"
+
+/* Internal Headers */
 #include "qt_asserts.h"
+#include "qt_atomics.h"
 #include "qt_shepherd_innards.h"
 #include "qt_expect.h"
 #include "qt_visibility.h"
+#include "qt_aligned_alloc.h"
+#include "qt_debug.h"
 #include "qt_int_ceil.h"
 
-typedef aligned_t qt_sinc_count_t;
-
-typedef struct {
-    aligned_t c;
-    uint8_t   pad[CACHELINE_WIDTH - sizeof(aligned_t)];
-} qt_sinc_cache_count_t;
+/* A SNZI tree shaped like the machine: one leaf per worker, then one node per
+ * shepherd, one per socket (NUMA node), and the root. A node's count is the
+ * number of outstanding submissions below it for a leaf, or the number of
+ * children with a nonzero count for everything else, so only a transition to
+ * or from zero propagates upward. Reductions ride along: a submitted value is
+ * folded into the leaf it is counted against, and a node that drops to zero
+ * folds its value into its parent's, so the root holds the result as soon as
+ * it drops to zero and nothing has to be combined serially at the end.
+ *
+ * Each node is on its own cache line(s), with its partial value, and is
+ * protected by a lock; locks are only ever taken upward (a child's lock is
+ * held while its parent is updated), so a node's count never disagrees with
+ * its parent's idea of it. */
+
+typedef struct qt_sinc_node_s {
+    QTHREAD_FASTLOCK_TYPE lock;
+    aligned_t             count;
+} qt_sinc_node_t;
 
 typedef struct qt_sinc_reduction_ {
-    // Value-related info
-    void *restrict values;
     qt_sinc_op_f   op;
     void *restrict result;
     void *restrict initial_value;
     size_t         sizeof_value;
-    size_t         sizeof_shep_value_part;
 } qt_sinc_reduction_t;
 
-typedef struct qt_sinc_snzi_ {
-    qt_sinc_cache_count_t *restrict counts;
-    aligned_t                       remaining;
-} qt_sinc_snzi_t;
-
 typedef struct qt_sinc_s {
-    qt_sinc_snzi_t      *snzi;
+    uint8_t             *nodes;
     aligned_t            ready;
     qt_sinc_reduction_t *rdata;
 } qt_internal_sinc_t;
 
+/* The tree's shape is the same for every sinc */
 static size_t       num_sheps;
 static size_t       num_workers;
 static size_t       num_wps;
+static size_t       num_sockets;
+static size_t       num_nodes;
+static size_t       root;
 static unsigned int cacheline;
+static size_t      *parent;    /* by node */
+static size_t      *child_off; /* by node; children of n are child_list[child_off[n]..child_off[n+1]] */
+static size_t      *child_list;
+
+#define NODE_STRIDE(rdata)                                                          \
+    (QT_CEIL_RATIO(sizeof(qt_sinc_node_t) + ((rdata) ? (rdata)->sizeof_value : 0), \
+                   cacheline) * cacheline)
+#define NODE(sinc, n)  ((qt_sinc_node_t *)((sinc)->nodes + (n) * NODE_STRIDE((sinc)->rdata)))
+#define VALUE(node)    ((void *)((uint8_t *)(node) + sizeof(qt_sinc_node_t)))
+#define SHEP_NODE(s)   (num_workers + (s))
+
+static void qt_sinc_internal_topology(void)
+{   /*{{{*/
+    size_t       *socket_of = MALLOC(num_sheps * sizeof(size_t));
+    unsigned int *node_ids  = MALLOC(num_sheps * sizeof(unsigned int));
+    size_t        c;
+
+    assert(socket_of && node_ids);
+
+    /* Number the distinct NUMA nodes the shepherds are on; without affinity
+     * information, make up groups of eight shepherds instead. */
+    num_sockets = 0;
+    for (size_t s = 0; s < num_sheps; s++) {
+        unsigned int n = qthread_internal_shep_to_node(s);
+        size_t       k;
 
-#define SNZI_ASSIGN(a, b) do {   \
-        if ((b) == 0) { a = 0; } \
-        else { a = (b) + 1; }    \
-} while (0)
+        if (n == (unsigned int)-1) { n = (unsigned int)(s / 8); }
+        for (k = 0; k < num_sockets; k++) {
+            if (node_ids[k] == n) { break; }
+        }
+        if (k == num_sockets) { node_ids[num_sockets++] = n; }
+        socket_of[s] = k;
+    }
+    FREE(node_ids, num_sheps * sizeof(unsigned int));
+    if (num_sockets == 1) {
+        num_sockets = 0; /* the socket level would only add a hop */
+    }
 
-static void qt_sinc_internal_collate(qt_sinc_t *sinc);
+    num_nodes  = num_workers + num_sheps + num_sockets + 1;
+    root       = num_nodes - 1;
+    parent     = MALLOC(num_nodes * sizeof(size_t));
+    child_off  = MALLOC((num_nodes + 1) * sizeof(size_t));
+    child_list = MALLOC(num_nodes * sizeof(size_t));
+    assert(parent && child_off && child_list);
 
-void qt_sinc_init(qt_sinc_t *restrict  sinc_,
-                  size_t               sizeof_value,
-                  const void *restrict initial_value,
-                  qt_sinc_op_f         op,
-                  size_t               expect)
-{
-    assert(sinc_);
-    qt_internal_sinc_t *sinc = (qt_internal_sinc_t *)sinc_;
+    for (size_t w = 0; w < num_workers; w++) {
+        parent[w] = SHEP_NODE(w / num_wps);
+    }
+    for (size_t s = 0; s < num_sheps; s++) {
+        parent[SHEP_NODE(s)] = num_sockets ? (num_workers + num_sheps + socket_of[s]) : root;
+    }
+    for (size_t k = 0; k < num_sockets; k++) {
+        parent[num_workers + num_sheps + k] = root;
+    }
+    parent[root] = root;
+
+    /* invert parent[] */
+    c = 0;
+    for (size_t n = 0; n < num_nodes; n++) {
+        child_off[n] = c;
+        for (size_t m = 0; m < root; m++) {
+            if (parent[m] == n) { child_list[c++] = m; }
+        }
+    }
+    child_off[num_nodes] = c;
+    FREE(socket_of, num_sheps * sizeof(size_t));
+} /*}}}*/
+
+static size_t qt_sinc_internal_myleaf(void)
+{   /*{{{*/
+    const qthread_shepherd_id_t s = qthread_shep();
+    const qthread_worker_id_t   w = (qthread_worker_id_t)qthread_readstate(CURRENT_WORKER);
+
+    if ((s >= num_sheps) || (w >= num_wps)) { return 0; }
+    return s * num_wps + w;
+} /*}}}*/
+
+/* Spread the expected count over the leaves, round-robin across shepherds,
+ * and set every internal node to match. */
+static void qt_sinc_internal_distribute(qt_internal_sinc_t *sinc,
+                                        size_t              expect)
+{   /*{{{*/
+    qt_sinc_reduction_t *const rdata = sinc->rdata;
+
+    for (size_t n = 0; n < num_nodes; n++) {
+        qt_sinc_node_t *node = NODE(sinc, n);
+
+        QTHREAD_FASTLOCK_INIT(node->lock);
+        node->count = 0;
+        if (rdata) {
+            memcpy(VALUE(node), rdata->initial_value, rdata->sizeof_value);
+        }
+    }
+    for (size_t w = 0; w < num_workers; w++) {
+        /* leaf for shepherd (w % num_sheps), worker (w / num_sheps) */
+        const size_t leaf  = (w % num_sheps) * num_wps + w / num_sheps;
+        const size_t share = expect / num_workers + ((w < expect % num_workers) ? 1 : 0);
+
+        NODE(sinc, leaf)->count = share;
+    }
+    for (size_t n = 0; n < root; n++) {
+        if (NODE(sinc, n)->count > 0) {
+            NODE(sinc, parent[n])->count++;
+        }
+    }
+    if (NODE(sinc, root)->count != 0) {
+        qthread_empty(&sinc->ready);
+    } else {
+        qthread_fill(&sinc->ready);
+    }
+} /*}}}*/
+
+/* Caller holds n's lock and has just taken n from zero to nonzero. */
+static void qt_sinc_internal_arrive(qt_internal_sinc_t *sinc,
+                                    size_t              n)
+{   /*{{{*/
+    if (n == root) {
+        qthread_empty(&sinc->ready);
+    } else {
+        qt_sinc_node_t *p = NODE(sinc, parent[n]);
+
+        QTHREAD_FASTLOCK_LOCK(&p->lock);
+        if (p->count++ == 0) {
+            qt_sinc_internal_arrive(sinc, parent[n]);
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&p->lock);
+    }
+} /*}}}*/
+
+/* Caller holds n's lock and has just taken n to zero; n's partial value goes
+ * up with it. */
+static void qt_sinc_internal_depart(qt_internal_sinc_t *sinc,
+                                    size_t              n)
+{   /*{{{*/
+    qt_sinc_reduction_t *const rdata = sinc->rdata;
+    qt_sinc_node_t *const      node  = NODE(sinc, n);
+
+    if (n == root) {
+        if (rdata) {
+            memcpy(rdata->result, VALUE(node), rdata->sizeof_value);
+            memcpy(VALUE(node), rdata->initial_value, rdata->sizeof_value);
+        }
+        qthread_fill(&sinc->ready);
+    } else {
+        qt_sinc_node_t *p = NODE(sinc, parent[n]);
+
+        QTHREAD_FASTLOCK_LOCK(&p->lock);
+        if (rdata) {
+            rdata->op(VALUE(p), VALUE(node));
+            memcpy(VALUE(node), rdata->initial_value, rdata->sizeof_value);
+        }
+        assert(p->count > 0);
+        if (--p->count == 0) {
+            qt_sinc_internal_depart(sinc, parent[n]);
+        }
+        QTHREAD_FASTLOCK_UNLOCK(&p->lock);
+    }
+} /*}}}*/
+
+/* Find a leaf with something left to submit against: our own, if we can,
+ * otherwise the nearest one, by walking up to the first nonzero ancestor and
+ * back down through nonzero children. The counts read here are only hints. */
+static size_t qt_sinc_internal_find(qt_internal_sinc_t *sinc,
+                                    size_t              leaf)
+{   /*{{{*/
+    size_t n = leaf;
+
+    if (NODE(sinc, leaf)->count > 0) { return leaf; }
+    while (n != root && NODE(sinc, n)->count == 0) {
+        n = parent[n];
+    }
+    while (n >= num_workers) {
+        size_t next = n;
+
+        for (size_t c = child_off[n]; c < child_off[n + 1]; c++) {
+            if (NODE(sinc, child_list[c])->count > 0) {
+                next = child_list[c];
+                break;
+            }
+        }
+        if (next == n) { return leaf; } /* raced; start over */
+        n = next;
+    }
+    return n;
+} /*}}}*/
+
+void API_FUNC qt_sinc_init(qt_sinc_t *restrict  sinc_,
+                           size_t               sizeof_value,
+                           const void *restrict initial_value,
+                           qt_sinc_op_f         op,
+                           size_t               expect)
+{   /*{{{*/
+    assert((0 == sizeof_value && NULL == initial_value) ||
+           (0 != sizeof_value && NULL != initial_value));
+    qt_internal_sinc_t *const restrict sinc = (qt_internal_sinc_t *)sinc_;
+    assert(sinc);
 
     if (QTHREAD_EXPECT((num_sheps == 0), 0)) {
         num_sheps   = qthread_readstate(TOTAL_SHEPHERDS);
         num_workers = qthread_readstate(TOTAL_WORKERS);
         num_wps     = num_workers / num_sheps;
         cacheline   = qthread_cacheline();
+        qt_sinc_internal_topology();
     }
 
     if (sizeof_value == 0) {
         sinc->rdata = NULL;
     } else {
-        const size_t         sizeof_shep_values     = num_wps * sizeof_value;
-        const size_t         num_lines_per_shep     = QT_CEIL_RATIO(sizeof_shep_values, cacheline);
-        const size_t         num_lines              = num_sheps * num_lines_per_shep;
-        const size_t         sizeof_shep_value_part = num_lines_per_shep * cacheline;
-        qt_sinc_reduction_t *rdata                  = sinc->rdata = malloc(sizeof(qt_sinc_reduction_t));
+        qt_sinc_reduction_t *const restrict rdata = sinc->rdata = MALLOC(sizeof(qt_sinc_reduction_t));
         assert(rdata);
         rdata->op            = op;
         rdata->sizeof_value  = sizeof_value;
-        rdata->initial_value = malloc(2 * sizeof_value);
+        rdata->initial_value = MALLOC(2 * sizeof_value);
         assert(rdata->initial_value);
         memcpy(rdata->initial_value, initial_value, sizeof_value);
         rdata->result = ((uint8_t *)rdata->initial_value) + sizeof_value;
-        assert(rdata->result);
-
-        rdata->sizeof_shep_value_part = sizeof_shep_value_part;
-
-        rdata->values = qthread_internal_aligned_alloc(num_lines * cacheline, cacheline);
-        assert(rdata->values);
-
-        // Initialize values
-        for (size_t s = 0; s < num_sheps; s++) {
-            const size_t shep_offset = s * sizeof_shep_value_part;
-            for (size_t w = 0; w < num_wps; w++) {
-                const size_t worker_offset = w * rdata->sizeof_value;
-                memcpy((uint8_t *)rdata->values + shep_offset + worker_offset,
-                       initial_value,
-                       sizeof_value);
-            }
-        }
-    }
-    qt_sinc_snzi_t *snzi = sinc->snzi = malloc(sizeof(qt_sinc_snzi_t));
-    assert(snzi);
-
-    assert(sizeof(qt_sinc_cache_count_t) <= cacheline);
-    snzi_counts = qthread_internal_aligned_alloc(num_sheps * cacheline, cacheline);
-    assert(snzi->counts);
-    // memset(sinc->counts, 0, num_sheps * cacheline);
-    // memset(sinc->counts, 0, QTHREAD_SIZEOF_ALIGNED_T * num_sheps);
-
-    // Initialize counts array
-    if (expect > 0) {
-        const size_t num_per_shep = expect / num_sheps;
-        size_t       extras       = expect % num_sheps;
-
-        // Set remaining count
-        if (num_per_shep > 0) {
-            snzi->remaining = num_sheps;
-        } else {
-            snzi->remaining = extras;
-        }
-
-        for (size_t s = 0; s < num_sheps; s++) {
-#if defined(SINCS_PROFILE)
-            snzi->count_spawns[s] = num_per_shep;
-            if (extras > 0) {
-                snzi->count_spawns[s]++;
-            }
-#endif      /* defined(SINCS_PROFILE) */
-            if (extras > 0) {
-                SNZI_ASSIGN(snzi->counts[s].c, num_per_shep + 1);
-                extras--;
-            } else {
-                SNZI_ASSIGN(snzi->counts[s].c, num_per_shep);
-            }
-        }
-        qthread_empty(&sinc->ready);
-    } else {
-        snzi->remaining = 0;
-        qthread_fill(&sinc->ready);
+        memcpy(rdata->result, initial_value, sizeof_value);
     }
-}
-
-qt_sinc_t *qt_sinc_create(const size_t sizeof_value,
-                          const void  *initial_value,
-                          qt_sinc_op_f op,
-                          const size_t expect)
-{
-    qt_sinc_t *sinc = malloc(sizeof(qt_sinc_t));
+    sinc->nodes = qthread_internal_aligned_alloc(num_nodes * NODE_STRIDE(sinc->rdata), cacheline);
+    assert(sinc->nodes);
+    qt_sinc_internal_distribute(sinc, expect);
+} /*}}}*/
+
+qt_sinc_t API_FUNC *qt_sinc_create(const size_t sizeof_value,
+                                   const void  *initial_value,
+                                   qt_sinc_op_f op,
+                                   const size_t expect)
+{   /*{{{*/
+    qt_sinc_t *const restrict sinc = MALLOC(sizeof(qt_sinc_t));
 
     assert(sinc);
     qt_sinc_init(sinc, sizeof_value, initial_value, op, expect);
 
     return sinc;
-}
-
-void qt_sinc_reset(qt_sinc_t   *sinc_,
-                   const size_t will_spawn)
-{
-    qt_internal_sinc_t *const restrict sinc  = (qt_internal_sinc_t *)sinc_;
-    qt_sinc_reduction_t               *rdata = sinc->rdata;
-
-    // Reset values
-    if (NULL != rdata) {
-        const size_t sizeof_shep_value_part = rdata->sizeof_shep_value_part;
-        const size_t sizeof_value           = rdata->sizeof_value;
-        for (size_t s = 0; s < num_sheps; s++) {
-            const size_t shep_offset = s * sizeof_shep_value_part;
-            for (size_t w = 0; w < num_wps; w++) {
-                const size_t worker_offset = w * sizeof_value;
-                memcpy((uint8_t *)rdata->values + shep_offset + worker_offset,
-                       rdata->initial_value,
-                       sizeof_value);
-            }
-        }
-    }
+} /*}}}*/
 
-    // Reset counts
-    const size_t                   num_per_worker = will_spawn / num_sheps;
-    size_t                         extras         = will_spawn % num_sheps;
-    qt_sinc_snzi_t *const restrict snzi           = sinc->snzi;
-
-    if (num_per_worker > 0) {
-        snzi->remaining = num_sheps;
-    } else {
-        snzi->remaining = extras;
-    }
-
-    for (size_t s = 0; s < num_sheps; s++) {
-        if (extras > 0) {
-            extras--;
-            SNZI_ASSIGN(snzi->counts[s].c, num_per_worker + 1);
-        } else {
-            SNZI_ASSIGN(snzi->counts[s].c, num_per_worker);
-        }
-    }
-
-    // Reset ready flag
-    if (will_spawn != 0) {
-        qthread_empty(&sinc->ready);
-    } else {
-        qthread_fill(&sinc->ready);
-    }
-}
-
-void qt_sinc_fini(qt_sinc_t *sinc_)
-{
+void API_FUNC qt_sinc_reset(qt_sinc_t   *sinc_,
+                            const size_t will_spawn)
+{   /*{{{*/
     qt_internal_sinc_t *const restrict sinc = (qt_internal_sinc_t *)sinc_;
 
-#if defined(SINCS_PROFILE)
-    for (size_t s = 0; s < num_sheps; s++) {
-        for (size_t w = 0; w < num_wps; w++) {
-            const size_t shep_offset = s;
-            const size_t offset      = shep_offset + w;
-
-            fprintf(stderr, "CI %lu %lu %lu\n", s, w, (unsigned long)sinc->count_incrs[offset]);
-            fprintf(stderr, "CL %lu %lu %lu\n", s, w, (unsigned long)sinc->count_locals[offset]);
-            fprintf(stderr, "CD %lu %lu %lu\n", s, w, (unsigned long)sinc->count_decrs[offset]);
-            fprintf(stderr, "CR %lu %lu %lu\n", s, w, (unsigned long)sinc->count_remaining[offset]);
-            fprintf(stderr, "CS %lu %lu %lu\n", s, w, (unsigned long)sinc->count_spawns[offset]);
-            fprintf(stderr, "DM %lu %lu %lu\n", s, w, (unsigned long)sinc->dist_max[offset]);
-            fprintf(stderr, "DT %lu %lu %lu\n", s, w, (unsigned long)sinc->dist_ttl[offset]);
-            fprintf(stderr, "DC %lu %lu %lu\n", s, w, (unsigned long)sinc->dist_cnt[offset]);
-            fprintf(stderr, "DA %lu %lu %f\n", s, w,
-                    ((unsigned long)sinc->dist_ttl[offset] * 1.0) /
-                    ((unsigned long)sinc->dist_cnt[offset] * 1.0));
-        }
-    }
+    assert(sinc);
+    qt_sinc_internal_distribute(sinc, will_spawn);
+} /*}}}*/
 
-    free(sinc->count_incrs);
-    free(sinc->count_locals);
-    free(sinc->count_decrs);
-    free(sinc->count_remaining);
-    free(sinc->count_spawns);
-    free(sinc->dist_max);
-    free(sinc->dist_ttl);
-#endif /* defined(SINCS_PROFILE) */
+void API_FUNC qt_sinc_fini(qt_sinc_t *sinc_)
+{   /*{{{*/
+    qt_internal_sinc_t *const restrict sinc = (qt_internal_sinc_t *)sinc_;
 
     assert(sinc);
-    qt_sinc_snzi_t *const restrict snzi = sinc->snzi;
-    assert(snzi);
-    assert(snzi->counts);
-    qthread_internal_aligned_free(snzi->counts, cacheline);
+    assert(sinc->nodes);
+    qthread_internal_aligned_free(sinc->nodes, cacheline);
+    sinc->nodes = NULL;
     if (sinc->rdata) {
-        qt_sinc_reduction_t *rdata = sinc->rdata;
-        assert(rdata->result);
+        qt_sinc_reduction_t *const restrict rdata = sinc->rdata;
         assert(rdata->initial_value);
-        free(rdata->initial_value);
-        assert(rdata->values);
-        qthread_internal_aligned_free(rdata->values, cacheline);
+        FREE(rdata->initial_value, 2 * rdata->sizeof_value);
+        FREE(rdata, sizeof(qt_sinc_reduction_t));
+        sinc->rdata = NULL;
     }
-}
+    qassert(qthread_fill(&sinc->ready), QTHREAD_SUCCESS);
+} /*}}}*/
 
-void qt_sinc_destroy(qt_sinc_t *sinc_)
-{
+void API_FUNC qt_sinc_destroy(qt_sinc_t *sinc_)
+{   /*{{{*/
     qt_sinc_fini(sinc_);
-    free(sinc_);
-}
-
-#define SNZI_HALF 1
-#define SNZI_ONE  2
+    FREE(sinc_, sizeof(qt_sinc_t));
+} /*}}}*/
 
-/* Adds a new participant to the sinc.
+/* Adds new participants to the sinc, counted against the caller's leaf.
  * Pre:  sinc was created
  * Post: aggregate count is positive
  */
-void qt_sinc_expect(qt_sinc_t *sinc_,
-                    size_t     count)
-{
-    assert(sinc_);
+void API_FUNC qt_sinc_expect(qt_sinc_t *sinc_,
+                             size_t     count)
+{   /*{{{*/
     qt_internal_sinc_t *const restrict sinc = (qt_internal_sinc_t *)sinc_;
-    qt_sinc_snzi_t *const restrict     snzi = sinc->snzi;
+
+    assert(sinc);
     if (count > 0) {
-        const size_t shep_id = qthread_shep();
-        aligned_t   *C       = &snzi->counts[shep_id].c;
-        int          succ    = 0;
-        int          undoArr = 0;
-
-        // Increment count
-        do {
-            aligned_t c = *C;
-            if ((c >= SNZI_ONE) && (qthread_cas(C, c, c + count) == c)) {
-                succ = 1;
-            }
-            if ((c == 0) && (qthread_cas(C, 0, SNZI_HALF) == 0)) {
-                succ = 1;
-                c    = SNZI_HALF;
-            }
-            if (c == SNZI_HALF) {
-                qthread_incr(&snzi->remaining, 1);
-                if (qthread_cas(C, SNZI_HALF, count + 1) != SNZI_HALF) {
-                    undoArr--;
-                } else {
-                    succ = 1;
-                }
-            }
-            COMPILER_FENCE;
-        } while (!succ);
-        if (undoArr != 0) {
-            qthread_incr(&snzi->remaining, undoArr);
+        const size_t          leaf = qt_sinc_internal_myleaf();
+        qt_sinc_node_t *const node = NODE(sinc, leaf);
+
+        QTHREAD_FASTLOCK_LOCK(&node->lock);
+        if (node->count == 0) {
+            qt_sinc_internal_arrive(sinc, leaf);
         }
+        node->count += count;
+        QTHREAD_FASTLOCK_UNLOCK(&node->lock);
     }
-}
+} /*}}}*/
 
-void *qt_sinc_tmpdata(qt_sinc_t *sinc_)
-{
-    assert(sinc_);
+/* The caller's own partial value; only safe to use while no other worker can
+ * be submitting against the caller's leaf. */
+void API_FUNC *qt_sinc_tmpdata(qt_sinc_t *sinc_)
+{   /*{{{*/
     qt_internal_sinc_t *const restrict sinc = (qt_internal_sinc_t *)sinc_;
+
+    assert(sinc);
     if (NULL != sinc->rdata) {
-        qt_sinc_reduction_t *const restrict rdata         = sinc->rdata;
-        const size_t                        shep_offset   = qthread_shep() * rdata->sizeof_shep_value_part;
-        const size_t                        worker_offset = qthread_readstate(CURRENT_WORKER) * rdata->sizeof_value;
-        return (uint8_t *)rdata->values + shep_offset + worker_offset;
+        return VALUE(NODE(sinc, qt_sinc_internal_myleaf()));
     } else {
         return NULL;
     }
-}
+} /*}}}*/
 
-static void qt_sinc_internal_collate(qt_sinc_t *sinc_)
-{
-    assert(sinc_);
+void API_FUNC qt_sinc_submit(qt_sinc_t *restrict  sinc_,
+                             const void *restrict value)
+{   /*{{{*/
     qt_internal_sinc_t *const restrict sinc = (qt_internal_sinc_t *)sinc_;
-    if (sinc->rdata) {
-        qt_sinc_reduction_t *const restrict rdata = sinc->rdata;
-        // step 1: collate results
-        const size_t sizeof_value           = rdata->sizeof_value;
-        const size_t sizeof_shep_value_part = rdata->sizeof_shep_value_part;
-
-        memcpy(rdata->result, rdata->initial_value, sizeof_value);
-        for (qthread_shepherd_id_t s = 0; s < num_sheps; ++s) {
-            const size_t shep_offset = s * sizeof_shep_value_part;
-            for (size_t w = 0; w < num_wps; ++w) {
-                rdata->op(rdata->result,
-                          (uint8_t *)rdata->values + shep_offset + (w * sizeof_value));
-            }
-        }
-    }
-    // step 2: release waiters
-    qthread_fill(&sinc->ready);
-}
-
-void qt_sinc_submit(qt_sinc_t *restrict sinc_,
-                    void *restrict      value)
-{
-    assert(sinc_);
-    qt_internal_sinc_t *const restrict sinc    = (qt_internal_sinc_t *)sinc_;
-    qthread_shepherd_id_t              shep_id = qthread_shep();
-
-    if (value) {
-        // Update value
-        qt_sinc_reduction_t *const restrict rdata = sinc->rdata;
-        assert(sinc->rdata);
-        assert((rdata->result && rdata->initial_value) || (!rdata->result && !rdata->initial_value));
-
-        const size_t sizeof_shep_value_part = rdata->sizeof_shep_value_part;
-        const size_t sizeof_value           = rdata->sizeof_value;
-
-        qthread_worker_id_t worker_id = qthread_readstate(CURRENT_WORKER);
-
-        if (NULL != value) {
-            const size_t shep_offset   = shep_id * sizeof_shep_value_part;
-            const size_t worker_offset = worker_id * sizeof_value;
-            void        *values        = (uint8_t *)rdata->values + shep_offset + worker_offset;
-
-            rdata->op(values, value);
-        }
-    }
-
-    qt_sinc_snzi_t *const restrict snzi = sinc->snzi;
-    assert(snzi->counts);
+    const size_t                       mine = qt_sinc_internal_myleaf();
 
+    assert(sinc);
+    assert(value == NULL || sinc->rdata);
     do {
-        aligned_t x = snzi->counts[shep_id].c;
-        aligned_t y;
-        while (snzi->counts[shep_id].c == 0) {
-            shep_id++;
-            shep_id *= (shep_id < num_sheps);
-        }
-        if (x > SNZI_ONE) {
-            y = x - 1;
-        } else if (x == SNZI_ONE) {
-            y = 0;
-        } else {
-            // shep_id has insufficient counts
-            continue;
-        }
-        // printf("depart c=%i (%i)\n", (int)x, (int)(count_offset));
-        assert(x >= SNZI_ONE);  // search for a good shep_id?
-        if (qthread_cas(&snzi->counts[shep_id].c, x, y) == x) {
-            if (x == SNZI_ONE) {
-                x = snzi->remaining;
-                // printf("snzi_depart x = %i (%p)\n", (int)x, snzi);
-                assert(x >= 1);
-                if (qthread_incr(&snzi->remaining, -1) == 1) {
-                    qt_sinc_internal_collate(sinc_);
-                    return;
-                }
-                // printf("            x = %i (%p)\n", (int)x, snzi);
+        const size_t          leaf = qt_sinc_internal_find(sinc, mine);
+        qt_sinc_node_t *const node = NODE(sinc, leaf);
+
+        QTHREAD_FASTLOCK_LOCK(&node->lock);
+        if (node->count > 0) {
+            if (value) {
+                sinc->rdata->op(VALUE(node), value);
             }
-            // qthread_cas(&snzi->remaining, x, x-1);
+            if (--node->count == 0) {
+                qt_sinc_internal_depart(sinc, leaf);
+            }
+            QTHREAD_FASTLOCK_UNLOCK(&node->lock);
             return;
         }
+        QTHREAD_FASTLOCK_UNLOCK(&node->lock);
+        SPINLOCK_BODY();
     } while (1);
-}
+} /*}}}*/
 
-void qt_sinc_wait(qt_sinc_t *restrict sinc_,
-                  void *restrict      target)
-{
-    assert(sinc_);
+void API_FUNC qt_sinc_wait(qt_sinc_t *restrict sinc_,
+                           void *restrict      target)
+{   /*{{{*/
     qt_internal_sinc_t *const restrict sinc = (qt_internal_sinc_t *)sinc_;
+
+    assert(sinc);
     qthread_readFF(NULL, &sinc->ready);
 
-    if (target) {
-        assert(sinc->rdata->sizeof_value > 0);
+    if (target && sinc->rdata) {
         memcpy(target, sinc->rdata->result, sinc->rdata->sizeof_value);
     }
-}
+} /*}}}*/
 
 /* vim:set expandtab: */
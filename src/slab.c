@@ -0,0 +1,99 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* System Headers */
+#include <stdlib.h>                    /* for malloc() and free() */
+#include <qthread/qthread-int.h>       /* for uint32_t */
+
+/* Internal Headers */
+#include "qt_slab.h"
+#include "qt_mpool.h"
+#include "qt_visibility.h"
+#include "qt_debug.h"
+#include "qt_asserts.h"
+#include "qt_subsystems.h"
+#include "qt_expect.h"
+#include "qt_int_log.h"
+
+/* Size classes are powers of two with a half-step in between (16, 32, 48,
+ * 64, 96, 128, ... 3072, 4096), which bounds internal fragmentation at 33%.
+ * Everything is a multiple of 16, since that is what qt_mpool rounds item
+ * sizes up to anyway. */
+#define QT_SLAB_CLASSES 16
+
+static const size_t qt_slab_sizes[QT_SLAB_CLASSES] = {
+    16,  32,  48,  64,  96,  128,  192,  256,
+    384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+
+#ifndef UNPOOLED
+static const char *const qt_slab_names[QT_SLAB_CLASSES] = {
+    "slab 16",  "slab 32",  "slab 48",   "slab 64",   "slab 96",   "slab 128",  "slab 192",  "slab 256",
+    "slab 384", "slab 512", "slab 768",  "slab 1024", "slab 1536", "slab 2048", "slab 3072", "slab 4096"
+};
+
+static qt_mpool qt_slab_pools[QT_SLAB_CLASSES];
+#endif
+
+static QINLINE unsigned int qt_slab_class(size_t size)
+{   /*{{{*/
+    uint32_t b;
+
+    assert(size <= QT_SLAB_MAX);
+    if (size <= 32) {
+        return (size <= 16) ? 0 : 1;
+    }
+    /* size is in (2^b, 2^(b+1)]; pick the lower or upper half of that range */
+    b = QT_INT_LOG((uint32_t)(size - 1));
+    return 2 * (b - 5) + 2 + (size > ((size_t)3 << (b - 1)));
+} /*}}}*/
+
+#ifndef UNPOOLED
+static void qt_slab_subsystem_shutdown(void)
+{   /*{{{*/
+    qthread_debug(CORE_DETAILS, "destroy size-class pools\n");
+    for (unsigned int i = 0; i < QT_SLAB_CLASSES; ++i) {
+        qt_mpool_destroy(qt_slab_pools[i]);
+        qt_slab_pools[i] = NULL;
+    }
+} /*}}}*/
+#endif
+
+void INTERNAL qt_slab_subsystem_init(void)
+{   /*{{{*/
+#ifndef UNPOOLED
+    for (unsigned int i = 0; i < QT_SLAB_CLASSES; ++i) {
+        assert(qt_slab_class(qt_slab_sizes[i]) == i);
+        qt_slab_pools[i] = qt_mpool_create(qt_slab_sizes[i]);
+        assert(qt_slab_pools[i]);
+        qt_mpool_set_name(qt_slab_pools[i], qt_slab_names[i]);
+    }
+    qthread_internal_cleanup_late(qt_slab_subsystem_shutdown);
+#endif
+} /*}}}*/
+
+void INTERNAL *qt_slab_alloc(size_t size)
+{   /*{{{*/
+#ifndef UNPOOLED
+    if (QTHREAD_LIKELY(size <= QT_SLAB_MAX)) {
+        return qt_mpool_alloc(qt_slab_pools[qt_slab_class(size)]);
+    }
+#endif
+    return MALLOC(size);
+} /*}}}*/
+
+void INTERNAL qt_slab_free(void  *ptr,
+                           size_t size)
+{   /*{{{*/
+    assert(ptr);
+#ifndef UNPOOLED
+    if (QTHREAD_LIKELY(size <= QT_SLAB_MAX)) {
+        qt_mpool_free(qt_slab_pools[qt_slab_class(size)], ptr);
+        return;
+    }
+#endif
+    FREE(ptr, size);
+} /*}}}*/
+
+/* vim:set expandtab: */
@@ -65,6 +65,7 @@ void INTERNAL qt_internal_teams_init(void)
     QTHREAD_FASTLOCK_INIT(qlib->team_count_lock);
 #ifndef UNPOOLED
     generic_team_pool = qt_mpool_create(sizeof(qt_team_t));
+    qt_mpool_set_name(generic_team_pool, "teams");
 #endif
     qthread_internal_cleanup(qt_internal_teams_shutdown);
     qthread_internal_cleanup_late(qt_internal_teams_destroy);
@@ -86,6 +86,8 @@ void INTERNAL qt_threadqueue_subsystem_init(void)
 {   /*{{{*/
     generic_threadqueue_pools.queues = qt_mpool_create(sizeof(qt_threadqueue_t));
     generic_threadqueue_pools.nodes  = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t), 8);
+    qt_mpool_set_name(generic_threadqueue_pools.queues, "threadqueues");
+    qt_mpool_set_name(generic_threadqueue_pools.nodes, "threadqueue nodes");
     qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
 } /*}}}*/
 #endif /* if defined(UNPOOLED_QUEUES) || defined(UNPOOLED) */
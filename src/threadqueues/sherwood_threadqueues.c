@@ -205,6 +205,8 @@ void INTERNAL qt_threadqueue_subsystem_init(void)
                                                                qthread_cacheline());
     generic_threadqueue_pools.nodes = qt_mpool_create_aligned(sizeof(qt_threadqueue_node_t),
                                                               qthread_cacheline());
+    qt_mpool_set_name(generic_threadqueue_pools.queues, "threadqueues");
+    qt_mpool_set_name(generic_threadqueue_pools.nodes, "threadqueue nodes");
     steal_chunksize = qt_internal_get_env_num("STEAL_CHUNK", 0, 0);
     qthread_internal_cleanup(qt_threadqueue_subsystem_shutdown);
 } /*}}}*/
@@ -251,8 +253,8 @@ qt_threadqueue_t INTERNAL *qt_threadqueue_new(void)
 } /*}}}*/
 
 #if defined(UNPOOLED_QTHREAD_T) || defined(UNPOOLED)
-# define ALLOC_QTHREAD() MALLOC(sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size)
-# define FREE_QTHREAD(t) FREE(t, sizeof(qthread_t) + qlib->qthread_argcopy_size + qlib->qthread_tasklocal_size)
+# define ALLOC_QTHREAD() MALLOC(sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size)
+# define FREE_QTHREAD(t) FREE(t, sizeof(qthread_t) + sizeof(void *) + qlib->qthread_tasklocal_size)
 #else /* if defined(UNPOOLED_QTHREAD_T) ||./src/threadqueues/nemesis_threadqueues.c defined(UNPOOLED) */
 extern qt_mpool generic_qthread_pool;
 # define ALLOC_QTHREAD() (qthread_t *)qt_mpool_alloc(generic_qthread_pool)
@@ -466,7 +468,6 @@ void INTERNAL qt_threadqueue_enqueue_yielded(qt_threadqueue_t *restrict q,
 
 #define QTHREAD_TASK_IS_AGGREGABLE(f) (0 &&                                                \
                                        (f &QTHREAD_SIMPLE) && !(f &QTHREAD_HAS_ARGCOPY) && \
-                                       !(f &QTHREAD_BIG_STRUCT) &&                         \
                                        !(f &QTHREAD_FUTURE) && !(f &QTHREAD_REAL_MCCOY) && \
                                        !(f &QTHREAD_AGGREGATED))
 // && (f & QTHREAD_AGGREGABLE) \
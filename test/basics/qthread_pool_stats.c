@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include "argparsing.h"
+
+#define NUM_TASKS 1000
+
+static aligned_t null_task(void *arg)
+{
+    return 0;
+}
+
+static int find_pool(const char           *name,
+                     qthread_pool_stats_t *out)
+{
+    size_t                npools = qthread_pool_stats(NULL, 0);
+    qthread_pool_stats_t *stats  = malloc(sizeof(qthread_pool_stats_t) * npools);
+    int                   found  = 0;
+
+    assert(stats);
+    npools = qthread_pool_stats(stats, npools);
+    for (size_t i = 0; i < npools; i++) {
+        if (stats[i].name && !strcmp(stats[i].name, name)) {
+            *out  = stats[i];
+            found = 1;
+            break;
+        }
+    }
+    free(stats);
+    return found;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    qthread_pool_stats_t before, after;
+    aligned_t           *rets;
+    size_t               npools;
+    size_t               i;
+
+    setenv("QT_POOL_PROFILE", "1", 1);
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    npools = qthread_pool_stats(NULL, 0);
+    iprintf("%lu pools\n", (unsigned long)npools);
+    assert(npools > 0);
+    /* asking for fewer than there are is fine */
+    assert(qthread_pool_stats(&before, 1) == 1);
+
+    assert(find_pool("qthread_t", &before));
+    rets = malloc(sizeof(aligned_t) * NUM_TASKS);
+    assert(rets);
+    for (i = 0; i < NUM_TASKS; i++) {
+        qthread_fork(null_task, NULL, rets + i);
+    }
+    for (i = 0; i < NUM_TASKS; i++) {
+        qthread_readFF(NULL, rets + i);
+    }
+    free(rets);
+    assert(find_pool("qthread_t", &after));
+    iprintf("qthread_t: %lu allocs (%lu hits), %lu live, %lu peak, %lu bytes\n",
+            after.allocs, after.cache_hits, after.live, after.peak,
+            (unsigned long)after.reserved);
+    assert(after.allocs >= before.allocs + NUM_TASKS);
+    assert(after.cache_hits <= after.allocs);
+    assert(after.peak >= after.live);
+    assert(after.peak >= 1);
+    assert(after.reserved > 0);
+    assert(after.item_size > 0);
+    assert(after.lock_contended <= after.lock_acquisitions);
+
+    return 0;
+}
+
+/* vim:set expandtab */
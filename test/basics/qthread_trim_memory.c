@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qpool.h>
+#include "argparsing.h"
+
+#define NUM_ITEMS 100000
+
+static aligned_t null_task(void *arg)
+{
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    qpool     *pool;
+    void     **items;
+    aligned_t *rets;
+    size_t     released;
+    size_t     i;
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == 0);
+
+    /* a burst of pool allocations, all freed again */
+    pool  = qpool_create(64);
+    items = malloc(sizeof(void *) * NUM_ITEMS);
+    assert(pool && items);
+    for (i = 0; i < NUM_ITEMS; i++) {
+        items[i] = qpool_alloc(pool);
+        assert(items[i]);
+    }
+    for (i = 0; i < NUM_ITEMS; i++) {
+        qpool_free(pool, items[i]);
+    }
+    released = qthread_trim_memory();
+    iprintf("released %lu bytes after the qpool burst\n", (unsigned long)released);
+    assert(released > 0);
+
+    /* trimming again has nothing left to give back */
+    released = qthread_trim_memory();
+    iprintf("released %lu bytes on the second trim\n", (unsigned long)released);
+
+    /* the pool must still work after being trimmed */
+    for (i = 0; i < NUM_ITEMS; i++) {
+        items[i] = qpool_alloc(pool);
+        assert(items[i]);
+        *(int *)items[i] = (int)i;
+    }
+    for (i = 0; i < NUM_ITEMS; i++) {
+        assert(*(int *)items[i] == (int)i);
+        qpool_free(pool, items[i]);
+    }
+    qpool_destroy(pool);
+
+    /* and so must the runtime's own pools */
+    rets = malloc(sizeof(aligned_t) * 1000);
+    assert(rets);
+    for (i = 0; i < 1000; i++) {
+        qthread_fork(null_task, NULL, rets + i);
+    }
+    for (i = 0; i < 1000; i++) {
+        qthread_readFF(NULL, rets + i);
+    }
+    released = qthread_trim_memory();
+    iprintf("released %lu bytes after the task burst\n", (unsigned long)released);
+    for (i = 0; i < 1000; i++) {
+        qthread_fork(null_task, NULL, rets + i);
+    }
+    for (i = 0; i < 1000; i++) {
+        qthread_readFF(NULL, rets + i);
+    }
+
+    free(rets);
+    free(items);
+    return 0;
+}
+
+/* vim:set expandtab */
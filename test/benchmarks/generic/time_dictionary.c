@@ -0,0 +1,164 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <qthread/qthread.h>
+#include <qthread/qloop.h>
+#include <qthread/qtimer.h>
+#include <qthread/dictionary.h>
+
+#include "argparsing.h"
+
+// Throughput of the dictionary used as a shared lookup table: the table is
+// filled with KEYS keys, and then 1, 2, 4, ... TASKS tasks each do OPS
+// operations on keys drawn uniformly from twice that range (so about half the
+// lookups miss). READ_PCT of the operations are lookups; the rest alternate
+// between puts and deletes, which keeps the size steady. Unless READ_PCT is
+// given, mixes of 50%, 90%, 99% and 100% lookups are run. With BATCH > 1, the
+// lookups are done BATCH at a time with qt_dictionary_get_many().
+//
+// The dictionary implementation is picked at configure time (--with-dict), so
+// to compare them, build once per implementation and run this on each.
+
+static size_t KEYS     = 100000;
+static size_t OPS      = 100000;
+static size_t TASKS    = 0;
+static size_t READ_PCT = 0;
+static size_t BATCH    = 1;
+
+static qt_dictionary *dict;
+static aligned_t      hits;
+
+#define KEY(i) ((void *)(uintptr_t)((i) + 1))
+
+static int int_equals(void *a,
+                      void *b)
+{
+    return a == b;
+}
+
+static int int_hash(void *k)
+{
+    return (int)(uintptr_t)k;
+}
+
+static QINLINE uint64_t next_rand(uint64_t *state)
+{
+    /* xorshift64*, so that each task has its own stream */
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+static void run_ops(const size_t startat,
+                    const size_t stopat,
+                    void        *arg)
+{
+    const size_t read_pct = *(size_t *)arg;
+    void       **keys     = malloc(BATCH * sizeof(void *));
+    void       **vals     = malloc(BATCH * sizeof(void *));
+    uint64_t     state    = 0x9e3779b97f4a7c15ULL * (startat + 1);
+    aligned_t    found    = 0;
+    size_t       writes   = 0;
+
+    assert(keys && vals);
+    for (size_t op = 0; op < OPS;) {
+        const size_t key = next_rand(&state) % (2 * KEYS);
+
+        if (next_rand(&state) % 100 < read_pct) {
+            if (BATCH > 1) {
+                keys[0] = KEY(key);
+                for (size_t j = 1; j < BATCH; j++) {
+                    keys[j] = KEY(next_rand(&state) % (2 * KEYS));
+                }
+                found += qt_dictionary_get_many(dict, keys, vals, BATCH);
+                op    += BATCH;
+                continue;
+            }
+            found += (qt_dictionary_get(dict, KEY(key)) != NULL);
+        } else if (writes++ & 1) {
+            (void)qt_dictionary_delete(dict, KEY(key));
+        } else {
+            (void)qt_dictionary_put(dict, KEY(key), KEY(key));
+        }
+        op++;
+    }
+    qthread_incr(&hits, found);
+    free(keys);
+    free(vals);
+}
+
+static void run_mix(size_t read_pct)
+{
+    qtimer_t timer = qtimer_create();
+
+    for (size_t tasks = 1;; tasks = (tasks * 2 > TASKS) ? TASKS : tasks * 2) {
+        double secs;
+
+        hits = 0;
+        qtimer_start(timer);
+        qt_loop(0, tasks, run_ops, &read_pct);
+        qtimer_stop(timer);
+        secs = qtimer_secs(timer);
+        printf("%3lu%% reads %4lu tasks: %9.3f Mops/s (%.1f%% of lookups hit)\n",
+               (unsigned long)read_pct, (unsigned long)tasks,
+               (tasks * OPS) / secs / 1e6,
+               100.0 * hits / ((tasks * OPS * read_pct / 100.0) + 1));
+        if (tasks == TASKS) { break; }
+    }
+    qtimer_destroy(timer);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    static const size_t mixes[] = { 50, 90, 99, 100 };
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(KEYS, "KEYS");
+    NUMARG(OPS, "OPS");
+    NUMARG(TASKS, "TASKS");
+    NUMARG(READ_PCT, "READ_PCT");
+    NUMARG(BATCH, "BATCH");
+    if (TASKS == 0) { TASKS = qthread_num_workers(); }
+    if (BATCH == 0) { BATCH = 1; }
+
+#ifdef QTHREAD_DICTIONARY_TYPE
+    printf("dictionary: %s\n", QTHREAD_DICTIONARY_TYPE);
+#endif
+    printf("%u shepherds, %u workers, %lu keys, %lu ops per task, batch %lu\n",
+           (unsigned)qthread_num_shepherds(), (unsigned)qthread_num_workers(),
+           (unsigned long)KEYS, (unsigned long)OPS, (unsigned long)BATCH);
+
+    dict = qt_dictionary_create(int_equals, int_hash, NULL);
+    assert(dict);
+    {
+        qtimer_t timer = qtimer_create();
+
+        qtimer_start(timer);
+        for (size_t i = 0; i < KEYS; i++) {
+            (void)qt_dictionary_put(dict, KEY(2 * i), KEY(2 * i));
+        }
+        qtimer_stop(timer);
+        printf("fill: %9.3f Mops/s\n", KEYS / qtimer_secs(timer) / 1e6);
+        qtimer_destroy(timer);
+    }
+
+    if (READ_PCT != 0) {
+        run_mix(READ_PCT);
+    } else {
+        for (size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++) {
+            run_mix(mixes[i]);
+        }
+    }
+
+    qt_dictionary_destroy(dict);
+    return 0;
+}
+
+/* vim:set expandtab: */
@@ -0,0 +1,133 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <qthread/qthread.h>
+#include <qthread/qloop.h>
+#include <qthread/qtimer.h>
+
+#include "argparsing.h"
+
+// Cost of the FEB metadata lookups. Only words that are empty (or have
+// waiters) have an entry in the runtime's internal address hash, so:
+//  - "hit" checks qthread_feb_status() on WORDS empty words,
+//  - "miss" checks it on WORDS full words while the empty ones are still in
+//    the table, and
+//  - "churn" empties and refills words, which is an insert and a remove.
+// Each is run with 1, 2, 4, ... TASKS tasks doing OPS operations apiece.
+//
+// The hash is picked at configure time (--with-hash), so to compare them,
+// build once per implementation and run this on each.
+
+static size_t WORDS = 16384;
+static size_t OPS   = 1000000;
+static size_t TASKS = 0;
+
+static aligned_t *words;
+
+static QINLINE uint64_t next_rand(uint64_t *state)
+{
+    /* xorshift64*, so that each task has its own stream */
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+static void hits(const size_t startat,
+                 const size_t stopat,
+                 void        *arg)
+{
+    uint64_t state = 0x9e3779b97f4a7c15ULL * (startat + 1);
+
+    for (size_t op = 0; op < OPS; op++) {
+        assert(qthread_feb_status(&words[next_rand(&state) % WORDS]) == 0);
+    }
+}
+
+static void misses(const size_t startat,
+                   const size_t stopat,
+                   void        *arg)
+{
+    uint64_t state = 0x9e3779b97f4a7c15ULL * (startat + 1);
+
+    for (size_t op = 0; op < OPS; op++) {
+        assert(qthread_feb_status(&words[WORDS + next_rand(&state) % WORDS]) == 1);
+    }
+}
+
+static void churn(const size_t startat,
+                  const size_t stopat,
+                  void        *arg)
+{
+    const size_t tasks = *(size_t *)arg;
+    const size_t mine  = WORDS / tasks;
+    aligned_t   *base  = &words[WORDS + startat * mine];
+
+    for (size_t op = 0; op < OPS; op += 2) {
+        aligned_t *w = &base[(op / 2) % mine];
+
+        qthread_empty(w);
+        qthread_fill(w);
+    }
+}
+
+static void run(const char *name,
+                qt_loop_f   f)
+{
+    qtimer_t timer = qtimer_create();
+
+    for (size_t tasks = 1;; tasks = (tasks * 2 > TASKS) ? TASKS : tasks * 2) {
+        double secs;
+
+        qtimer_start(timer);
+        qt_loop(0, tasks, f, &tasks);
+        qtimer_stop(timer);
+        secs = qtimer_secs(timer);
+        printf("%-6s %4lu tasks: %9.3f Mops/s (%.1f ns/op/task)\n", name,
+               (unsigned long)tasks, (tasks * OPS) / secs / 1e6,
+               secs * 1e9 / OPS);
+        if (tasks == TASKS) { break; }
+    }
+    qtimer_destroy(timer);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(WORDS, "WORDS");
+    NUMARG(OPS, "OPS");
+    NUMARG(TASKS, "TASKS");
+    if (TASKS == 0) { TASKS = qthread_num_workers(); }
+    if (TASKS > WORDS) { TASKS = WORDS; }
+
+#ifdef QTHREAD_HASH_TYPE
+    printf("hash: %s\n", QTHREAD_HASH_TYPE);
+#endif
+    printf("%u shepherds, %u workers, %lu words, %lu ops per task\n",
+           (unsigned)qthread_num_shepherds(), (unsigned)qthread_num_workers(),
+           (unsigned long)WORDS, (unsigned long)OPS);
+
+    words = calloc(2 * WORDS, sizeof(aligned_t));
+    assert(words);
+    for (size_t i = 0; i < WORDS; i++) {
+        qthread_empty(&words[i]);
+    }
+
+    run("hit", hits);
+    run("miss", misses);
+    run("churn", churn);
+
+    for (size_t i = 0; i < WORDS; i++) {
+        qthread_fill(&words[i]);
+    }
+    free(words);
+    return 0;
+}
+
+/* vim:set expandtab: */
@@ -116,6 +116,28 @@ static void spawn_rows(const size_t start, const size_t stop, void *arg) {
     qt_loop(1, points->M-1, update, &args);
 }
 
+// Update a tile of points at once; x is the column (j), y is the row (i)
+static void update_tile(const size_t xstart, const size_t xstop,
+                        const size_t ystart, const size_t ystop, void *arg)
+{
+    stencil_t *points = ((rows_args_t *)arg)->points;
+    size_t stage = ((rows_args_t *)arg)->stage;
+    size_t prev = prev_stage(stage);
+
+    for (size_t i = ystart; i < ystop; i++) {
+        for (size_t j = xstart; j < xstop; j++) {
+            perform_local_work();
+            aligned_t sum = points->stage[prev][i  ][j-1];
+            sum          += points->stage[prev][i-1][j  ];
+            sum          += points->stage[prev][i  ][j  ];
+            sum          += points->stage[prev][i+1][j  ];
+            sum          += points->stage[prev][i  ][j+1];
+
+            points->stage[stage][i][j] = sum/NUM_NEIGHBORS;
+        }
+    }
+}
+
 int main(int argc, char *argv[])
 {
     int n = 10;
@@ -126,6 +148,8 @@ int main(int argc, char *argv[])
     workload_var = 0;
     int print_final = 0;
     int alltime = 0;
+    int tile = 0;
+    int order = QT_LOOP_HILBERT;
 
     CHECK_VERBOSE();
     NUMARG(n, "N");
@@ -136,6 +160,8 @@ int main(int argc, char *argv[])
     NUMARG(workload_var, "WORKLOAD_VAR");
     NUMARG(print_final, "PRINT_FINAL");
     NUMARG(alltime, "ALL_TIME");
+    NUMARG(tile, "TILE");   // > 0: tiles of TILE x TILE points via qt_loop2d()
+    NUMARG(order, "ORDER"); // qt_loop_order for the tiles
 
     assert (n > 0 && m > 0);
 
@@ -190,7 +216,12 @@ int main(int argc, char *argv[])
     qtimer_start(exec_timer);
     rows_args_t args = {&points, 1};
     for (int t = 1; t <= num_timesteps; t++) {
-        qt_loop(1, points.N-1, spawn_rows, &args);
+        if (tile > 0) {
+            qt_loop2d(1, points.M-1, 1, points.N-1, tile, tile,
+                      (qt_loop_order)order, update_tile, &args);
+        } else {
+            qt_loop(1, points.N-1, spawn_rows, &args);
+        }
         args.stage = next_stage(args.stage);
     }
     qtimer_stop(exec_timer);
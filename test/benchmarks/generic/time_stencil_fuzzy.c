@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <qthread/qthread.h>
+#include <qthread/barrier.h>
+#include <qthread/qtimer.h>
+
+#include "argparsing.h"
+
+#define NUM_NEIGHBORS 5
+#define NUM_STAGES 2
+#define BOUNDARY 42
+
+// The same computation as time_stencil_bsp, but with one long-lived task per
+// band of rows, and a split-phase barrier between timesteps: each band
+// computes its edge rows (the only ones its neighbors read), arrives, computes
+// its interior rows while the barrier completes, and then waits.
+
+static int num_timesteps;
+
+static int workload;
+static int workload_per;
+static int workload_var;
+
+static int fuzzy;
+
+typedef struct stencil {
+    size_t N;
+    size_t M;
+    aligned_t **stage[NUM_STAGES];
+} stencil_t;
+
+typedef struct band_args {
+    stencil_t *points;
+    qt_barrier_t *barrier;
+    size_t first;
+    size_t last;
+} band_args_t;
+
+////////////////////////////////////////////////////////////////////////////////
+static inline void perform_local_work(void)
+{
+    volatile unsigned long work = workload;
+    long rand_per = (long)qtimer_fastrand();
+    long rand_var = (long)qtimer_fastrand();
+
+    rand_per = (rand_per<0) ? (-rand_per)%100 : rand_per%100;
+    if (rand_per < workload_per) {
+        rand_var = (rand_var<0) ? (-rand_var)%100 : rand_var%100;
+        work += (workload * (workload_var * 0.01)) * (rand_var * 0.01);
+    }
+
+    for (int i = 0; i < work; i++) {
+        work = work % 1000000000;
+    }
+    work++;
+}
+
+static inline void print_stage(stencil_t *points, size_t stage)
+{
+    for (int i = 0; i < points->N; i++) {
+        fprintf(stderr, "%02lu", (unsigned long)points->stage[stage][i][0]);
+        for (int j = 1; j < points->M; j++) {
+            fprintf(stderr, "  %02lu", (unsigned long)points->stage[stage][i][j]);
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+static inline size_t prev_stage(size_t stage)
+{
+    return (stage == 0) ? NUM_STAGES-1 : stage - 1;
+}
+
+static inline size_t next_stage(size_t stage)
+{
+    return (stage == NUM_STAGES-1) ? 0 : stage + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void update_row(stencil_t *points, size_t stage, size_t i)
+{
+    size_t prev = prev_stage(stage);
+
+    for (size_t j = 1; j < points->M-1; j++) {
+        perform_local_work();
+        aligned_t sum = points->stage[prev][i  ][j-1];
+        sum          += points->stage[prev][i-1][j  ];
+        sum          += points->stage[prev][i  ][j  ];
+        sum          += points->stage[prev][i+1][j  ];
+        sum          += points->stage[prev][i  ][j+1];
+
+        points->stage[stage][i][j] = sum/NUM_NEIGHBORS;
+    }
+}
+
+static aligned_t band(void *arg_)
+{
+    band_args_t *arg = (band_args_t *)arg_;
+    stencil_t *points = arg->points;
+    size_t stage = 1;
+
+    for (int t = 1; t <= num_timesteps; t++) {
+        aligned_t phase;
+
+        // Neighbors only read the edge rows, so once those are done, nothing
+        // left in this timestep can hold anyone else up
+        update_row(points, stage, arg->first);
+        if (arg->last != arg->first) {
+            update_row(points, stage, arg->last);
+        }
+        if (fuzzy) {
+            phase = qt_barrier_arrive(arg->barrier);
+        }
+        for (size_t i = arg->first + 1; i < arg->last; i++) {
+            update_row(points, stage, i);
+        }
+        if (!fuzzy) {
+            phase = qt_barrier_arrive(arg->barrier);
+        }
+        qt_barrier_wait(arg->barrier, phase);
+        stage = next_stage(stage);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int n = 10;
+    int m = 10;
+    num_timesteps = 10;
+    workload = 0;
+    workload_per = 0;
+    workload_var = 0;
+    fuzzy = 1;
+    int print_final = 0;
+    int alltime = 0;
+    int nbands = 0;
+    int barrier_type = REGION_BARRIER;
+
+    CHECK_VERBOSE();
+    NUMARG(n, "N");
+    NUMARG(m, "M");
+    NUMARG(num_timesteps, "TIMESTEPS");
+    NUMARG(workload, "WORKLOAD");
+    NUMARG(workload_per, "WORKLOAD_PER");
+    NUMARG(workload_var, "WORKLOAD_VAR");
+    NUMARG(print_final, "PRINT_FINAL");
+    NUMARG(alltime, "ALL_TIME");
+    NUMARG(fuzzy, "FUZZY");               // 0: arrive and wait back to back
+    NUMARG(nbands, "BANDS");              // 0: one band per worker
+    NUMARG(barrier_type, "BARRIER_TYPE"); // qt_barrier_btype
+
+    assert (n > 0 && m > 0);
+
+    // Initialize Qthreads
+    assert(qthread_initialize() == 0);
+
+    if (nbands <= 0) { nbands = qthread_num_workers(); }
+    if (nbands > n) { nbands = n; }
+
+    qtimer_t alloc_timer = qtimer_create();
+    qtimer_t init_timer = qtimer_create();
+    qtimer_t exec_timer = qtimer_create();
+
+    // Allocate memory for 3-stage stencil (with boundary padding)
+    qtimer_start(alloc_timer);
+    stencil_t points;
+    points.N = n + 2;
+    points.M = m + 2;
+
+    points.stage[0] = malloc(points.N*sizeof(aligned_t *));
+    assert(NULL != points.stage[0]);
+    points.stage[1] = malloc(points.N*sizeof(aligned_t *));
+    assert(NULL != points.stage[1]);
+
+    for (int i = 0; i < points.N; i++) {
+        points.stage[0][i] = calloc(points.M, sizeof(aligned_t));
+        assert(NULL != points.stage[0][i]);
+        points.stage[1][i] = calloc(points.M, sizeof(aligned_t));
+        assert(NULL != points.stage[1][i]);
+    }
+    qtimer_stop(alloc_timer);
+
+    // Initialize first stage and set boundary conditions
+    qtimer_start(init_timer);
+    for (int i = 1; i < points.N-1; i++) {
+        for (int j = 1; j < points.M-1; j++) {
+            points.stage[0][i][j] = 0;
+        }
+    }
+    for (int i = 0; i < points.N; i++) {
+        points.stage[0][i][0] = BOUNDARY;
+        points.stage[0][i][points.M-1] = BOUNDARY;
+        points.stage[1][i][0] = BOUNDARY;
+        points.stage[1][i][points.M-1] = BOUNDARY;
+    }
+    for (int j = 0; j < points.M; j++) {
+        points.stage[0][0][j] = BOUNDARY;
+        points.stage[0][points.N-1][j] = BOUNDARY;
+        points.stage[1][0][j] = BOUNDARY;
+        points.stage[1][points.N-1][j] = BOUNDARY;
+    }
+    qtimer_stop(init_timer);
+
+    // Split the rows into bands, and start one task per band
+    band_args_t *bands = malloc(nbands * sizeof(band_args_t));
+    aligned_t *rets = malloc(nbands * sizeof(aligned_t));
+    assert(NULL != bands && NULL != rets);
+    qt_barrier_t *barrier = qt_barrier_create(nbands, (qt_barrier_btype)barrier_type);
+    assert(NULL != barrier);
+
+    qtimer_start(exec_timer);
+    for (int b = 0; b < nbands; b++) {
+        bands[b].points = &points;
+        bands[b].barrier = barrier;
+        bands[b].first = 1 + (size_t)n * b / nbands;
+        bands[b].last = (size_t)n * (b + 1) / nbands;
+        qthread_fork_to(band, &bands[b], &rets[b], b % qthread_num_shepherds());
+    }
+    for (int b = 0; b < nbands; b++) {
+        qthread_readFF(NULL, &rets[b]);
+    }
+    qtimer_stop(exec_timer);
+
+    // Print timing info
+    if (alltime) {
+        fprintf(stderr, "Allocation time: %f\n", qtimer_secs(alloc_timer));
+        fprintf(stderr, "Initialization time: %f\n", qtimer_secs(init_timer));
+        fprintf(stderr, "Execution time: %f\n", qtimer_secs(exec_timer));
+    } else {
+        fprintf(stdout, "%f\n", qtimer_secs(exec_timer));
+    }
+
+    // Print stencils
+    if (print_final) {
+        size_t final = (num_timesteps % NUM_STAGES);
+        iprintf("\nStage %lu:\n", prev_stage(final));
+        print_stage(&points, prev_stage(final));
+        iprintf("\nStage %lu:\n", final);
+        print_stage(&points, final);
+    }
+
+    qt_barrier_destroy(barrier);
+    free(bands);
+    free(rets);
+
+    qtimer_destroy(alloc_timer);
+    qtimer_destroy(init_timer);
+    qtimer_destroy(exec_timer);
+
+    // Free allocated memory
+    for (int i = 0; i < points.N; i++) {
+        free(points.stage[0][i]);
+        free(points.stage[1][i]);
+    }
+    free(points.stage[0]);
+    free(points.stage[1]);
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -94,7 +94,7 @@ int HPC_sparsemv(HPC_Sparse_Matrix  *A,
 
     if (tcount > 0) {
         HPC_sparsemv_outerloop loop(A, x, y);
-        qt_loop_balance(0, nrow, loop);
+        qt_loop_affinity_run(row_affinity, loop);
     } else {
         for (int i = 0; i < nrow; i++) {
             double              sum      = 0.0;
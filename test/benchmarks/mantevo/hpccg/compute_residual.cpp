@@ -90,7 +90,7 @@ int compute_residual(const int           n,
 
     if (tcount > 0) {
         cr_loop loop(v1, v2);
-        qt_loop_balance(0, n, loop);
+        qt_loop_affinity_run(row_affinity, loop);
         local_residual = loop.ret;
     } else {
         for (int i = 0; i < n; i++) {
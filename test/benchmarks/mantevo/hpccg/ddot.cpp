@@ -98,11 +98,11 @@ int ddot (const int           n,
     if (tcount > 0) {
         if (y == x) {
             ddot_square loop(x);
-            qt_loop_balance(0, n, loop);
+            qt_loop_affinity_run(row_affinity, loop);
             local_result = loop.ret;
         } else {
             ddot_mult loop(x, y);
-            qt_loop_balance(0, n, loop);
+            qt_loop_affinity_run(row_affinity, loop);
             local_result = loop.ret;
         }
     } else {
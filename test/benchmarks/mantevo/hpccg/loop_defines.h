@@ -6,6 +6,7 @@
 #ifdef USING_QTHREADS
 # include <qthread/qthread.h>
 # include <qthread/qloop.hpp>
+extern qt_loop_affinity_t *row_affinity; // covers 0..local_nrow
 # define LOOP_BEGIN(x, y, b, e) qt_loop_balance((x), (y), [&](size_t b, size_t e) {
 # define LOOP_END() })
 #else
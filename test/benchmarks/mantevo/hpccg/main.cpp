@@ -75,7 +75,9 @@
 #include "HPC_Sparse_Matrix.hpp"
 #ifdef USING_QTHREADS
 # include <qthread/qthread.h>
-int tcount = 0;
+# include <qthread/qloop.h>
+int                 tcount       = 0;
+qt_loop_affinity_t *row_affinity = NULL;
 #endif
 
 #undef DEBUG
@@ -159,6 +161,13 @@ int main(int   argc,
     times[6] = t6;
 #endif
 
+#ifdef USING_QTHREADS
+    // All of the row-parallel kernels run over the same local rows, so they
+    // share one affinity handle: a given block of rows is always handled by
+    // the same shepherd, in every kernel and every iteration.
+    row_affinity = qt_loop_affinity_create(0, A->local_nrow);
+#endif
+
 
     // double t1 = mytimer();   // Initialize it (if needed)
     int    niters    = 0;
@@ -232,6 +241,9 @@ int main(int   argc,
     }
 
     // Finish up
+#ifdef USING_QTHREADS
+    qt_loop_affinity_destroy(row_affinity);
+#endif
 #ifdef USING_MPI
     MPI_Finalize();
 #endif
@@ -106,13 +106,13 @@ int waxpby (const int           n,
     if (tcount > 0) {
         if (alpha == 1.0) {
             waxpby_shortcut loop(y, beta, x, w);
-            qt_loop_balance(0, n, loop);
+            qt_loop_affinity_run(row_affinity, loop);
         } else if (beta == 1.0) {
             waxpby_shortcut loop(x, alpha, y, w);
-            qt_loop_balance(0, n, loop);
+            qt_loop_affinity_run(row_affinity, loop);
         } else {
             waxpby_both loop(x, beta, alpha, y, w);
-            qt_loop_balance(0, n, loop);
+            qt_loop_affinity_run(row_affinity, loop);
         }
     } else {
         if (alpha == 1.0) {
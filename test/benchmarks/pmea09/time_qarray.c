@@ -50,6 +50,19 @@ static void assignall1_loop(const size_t startat, const size_t stopat,
     }
 }
 
+static void sum_loop(const size_t startat, const size_t stopat,
+                     qarray * qa, void *arg, void *ret)
+{
+    const double *ptr = (const double *)qarray_elem_nomigrate(qa, startat);
+    const size_t max = stopat - startat;
+    double sum = 0.0;
+
+    for (size_t i = 0; i < max; i++) {
+        sum += ptr[i];
+    }
+    *(double *)ret = sum;
+}
+
 static void assertall1_loop(const size_t startat, const size_t stopat,
                             qarray * qa, void *arg)
 {
@@ -74,6 +87,65 @@ static void assignoff1(const size_t startat, const size_t stopat, qarray * qa,
     }
 }
 
+/* for the locality test: sum the segments that belong to one shepherd, from
+ * whichever shepherd this runs on */
+typedef struct {
+    qarray               *a;
+    qthread_shepherd_id_t owner;
+    double                sum;
+} sweep_args;
+
+static aligned_t sweep_owned(void *arg_)
+{
+    sweep_args  *arg = (sweep_args *)arg_;
+    qarray      *a   = arg->a;
+    const size_t seg = a->segment_size;
+    double       sum = 0.0;
+
+    for (size_t i = 0; i < a->count; i += seg) {
+        const double *ptr;
+        const size_t  max = (i + seg > a->count) ? a->count - i : seg;
+
+        if (qarray_shepof(a, i) != arg->owner) { continue; }
+        ptr = (const double *)qarray_elem_nomigrate(a, i);
+        for (size_t j = 0; j < max; j++) {
+            sum += ptr[j];
+        }
+    }
+    arg->sum = sum;
+    return 0;
+}
+
+/* every shepherd sweeps the segments of the shepherd offset after it; with an
+ * offset of 0, all of the reads are local */
+static double sweep(qarray  *a,
+                    unsigned offset,
+                    qtimer_t timer)
+{
+    const qthread_shepherd_id_t nsheps = qthread_num_shepherds();
+    sweep_args                 *args   = malloc(nsheps * sizeof(sweep_args));
+    aligned_t                  *rets   = malloc(nsheps * sizeof(aligned_t));
+    double                      acc    = 0.0;
+
+    assert(args && rets);
+    for (size_t j = 0; j < ITERATIONS; j++) {
+        qtimer_start(timer);
+        for (qthread_shepherd_id_t s = 0; s < nsheps; s++) {
+            args[s].a     = a;
+            args[s].owner = (s + offset) % nsheps;
+            qthread_fork_to(sweep_owned, &args[s], &rets[s], s);
+        }
+        for (qthread_shepherd_id_t s = 0; s < nsheps; s++) {
+            qthread_readFF(NULL, &rets[s]);
+        }
+        qtimer_stop(timer);
+        acc += qtimer_secs(timer);
+    }
+    free(args);
+    free(rets);
+    return (a->count * sizeof(double)) / (acc / ITERATIONS);
+}
+
 static void assertoff1(const size_t startat, const size_t stopat, qarray * qa,
                        void *arg)
 {
@@ -105,7 +177,7 @@ int main(int argc, char *argv[])
     unsigned int dt_index;
     unsigned int num_dists =
         sizeof(disttypes) / sizeof(distribution_t) + 1 /* serial */;
-    int enabled_tests = 7;
+    int enabled_tests = 31;
     int enabled_types = (1 << num_dists) - 1;
 
     assert(qthread_initialize() == QTHREAD_SUCCESS);
@@ -298,6 +370,92 @@ int main(int argc, char *argv[])
             printf("%f secs\n", acc / ITERATIONS);
             qarray_destroy(a);
         }
+
+        /* local versus remote bandwidth, and what migrating fixes */
+        if ((enabled_tests & 8) && (qthread_num_shepherds() > 1)) {
+            qarray *a =
+                qarray_create_configured(ELEMENT_COUNT, sizeof(double),
+                                         disttypes[dt_index], 1, 0);
+            const qthread_shepherd_id_t nsheps = qthread_num_shepherds();
+            double                      local, remote;
+
+            assert(a != NULL);
+            qarray_iter_loop(a, 0, ELEMENT_COUNT, assign1_loop, NULL);
+            local  = sweep(a, 0, timer);
+            remote = sweep(a, 1, timer);
+            printf("\tLocal/remote sweeps: %.1f/%.1f MB/s\n",
+                   local / 1e6, remote / 1e6);
+            if (a->dist_type != FIXED_HASH && a->dist_type != FIXED_FIELDS) {
+                /* hand every segment to the next shepherd, which moves its
+                 * pages; the old "remote" sweep is now the local one */
+                qtimer_start(timer);
+                if (a->dist_type == ALL_SAME) {
+                    qarray_set_shepof(a, 0, (qarray_shepof(a, 0) + nsheps - 1) % nsheps);
+                } else {
+                    for (size_t i = 0; i < ELEMENT_COUNT; i += a->segment_size) {
+                        qarray_set_shepof(a, i, (qarray_shepof(a, i) + nsheps - 1) % nsheps);
+                    }
+                }
+                qtimer_stop(timer);
+                printf("\tMigrating: %f secs; after: %.1f MB/s local\n",
+                       qtimer_secs(timer), sweep(a, 0, timer) / 1e6);
+            }
+            qarray_iter_loop(a, 0, ELEMENT_COUNT, assert1_loop, NULL);
+            qarray_destroy(a);
+        }
+        /* the typed kernels, against the same work done by loop callbacks */
+        if (enabled_tests & 16) {
+            qarray *x =
+                qarray_create_configured(ELEMENT_COUNT, sizeof(double),
+                                         disttypes[dt_index], 1, 0);
+            qarray *y =
+                qarray_create_configured(ELEMENT_COUNT, sizeof(double),
+                                         disttypes[dt_index], 1, 0);
+            const double bytes = ELEMENT_COUNT * sizeof(double) * ITERATIONS;
+            double fill_k = 0.0, fill_l = 0.0, sum_k = 0.0, sum_l = 0.0;
+            double axpy = 0.0, dot = 0.0, r;
+
+            assert(x != NULL && y != NULL);
+            qarray_dist_like(x, y);
+            for (size_t j = 0; j < ITERATIONS; j++) {
+                qtimer_start(timer);
+                qarray_iter_loop(x, 0, ELEMENT_COUNT, assign1_loop, NULL);
+                qtimer_stop(timer);
+                fill_l += qtimer_secs(timer);
+                qtimer_start(timer);
+                qarray_double_fill(x, 0, ELEMENT_COUNT, 1.0);
+                qtimer_stop(timer);
+                fill_k += qtimer_secs(timer);
+                qtimer_start(timer);
+                qarray_iter_loopaccum(x, 0, ELEMENT_COUNT, sum_loop, NULL, &r,
+                                      sizeof(double), qt_dbl_add_acc);
+                qtimer_stop(timer);
+                sum_l += qtimer_secs(timer);
+                assert(r == ELEMENT_COUNT);
+                qtimer_start(timer);
+                r = qarray_double_sum(x, 0, ELEMENT_COUNT);
+                qtimer_stop(timer);
+                sum_k += qtimer_secs(timer);
+                assert(r == ELEMENT_COUNT);
+                qarray_double_fill(y, 0, ELEMENT_COUNT, 0.0);
+                qtimer_start(timer);
+                qarray_double_axpy(y, 1.0, x, 0, ELEMENT_COUNT);
+                qtimer_stop(timer);
+                axpy += qtimer_secs(timer);
+                qtimer_start(timer);
+                r = qarray_double_dot(x, y, 0, ELEMENT_COUNT);
+                qtimer_stop(timer);
+                dot += qtimer_secs(timer);
+                assert(r == ELEMENT_COUNT);
+            }
+            printf("\tKernels/loops (MB/s): fill %.1f/%.1f, sum %.1f/%.1f, "
+                   "axpy %.1f, dot %.1f\n",
+                   bytes / fill_k / 1e6, bytes / fill_l / 1e6,
+                   bytes / sum_k / 1e6, bytes / sum_l / 1e6,
+                   3 * bytes / axpy / 1e6, 2 * bytes / dot / 1e6);
+            qarray_destroy(x);
+            qarray_destroy(y);
+        }
     }
 
     return 0;
@@ -7,8 +7,11 @@
 #include <qthread/qtimer.h>
 #include "argparsing.h"
 
-#define ELEMENT_COUNT   10000
-#define THREAD_COUNT    128
+static size_t ELEMENT_COUNT = 10000;
+static size_t THREAD_COUNT  = 128;
+static size_t TASKS         = 0;
+
+#define BATCH 16
 
 static aligned_t queuer(void *arg)
 {
@@ -67,6 +70,88 @@ static void loop_dequeuer(const size_t startat, const size_t stopat,
     }
 }                                      /*}}} */
 
+/* Each task puts ELEMENT_COUNT elements in and takes as many out again (not
+ * necessarily its own), so the queue's shared parts see both ends at once. */
+static void pairs_single(const size_t startat, const size_t stopat,
+                         void *arg)
+{                                      /*{{{ */
+    qdqueue_t *q = (qdqueue_t *)arg;
+    void *me = (void *)(uintptr_t)(startat + 1);
+
+    for (size_t i = 0; i < ELEMENT_COUNT; i++) {
+        qdqueue_enqueue(q, me);
+    }
+    for (size_t i = 0; i < ELEMENT_COUNT; i++) {
+        while (qdqueue_dequeue(q) == NULL) {
+            qthread_yield();
+        }
+    }
+}                                      /*}}} */
+
+static void pairs_batch(const size_t startat, const size_t stopat,
+                        void *arg)
+{                                      /*{{{ */
+    qdqueue_t *q = (qdqueue_t *)arg;
+    void *elems[BATCH];
+
+    for (size_t i = 0; i < BATCH; i++) {
+        elems[i] = (void *)(uintptr_t)(startat + 1);
+    }
+    for (size_t i = 0; i < ELEMENT_COUNT; i += BATCH) {
+        size_t n = (ELEMENT_COUNT - i < BATCH) ? (ELEMENT_COUNT - i) : BATCH;
+
+        qdqueue_enqueue_many(q, elems, n);
+    }
+    for (size_t i = 0; i < ELEMENT_COUNT;) {
+        size_t want = (ELEMENT_COUNT - i < BATCH) ? (ELEMENT_COUNT - i) : BATCH;
+        size_t got  = qdqueue_dequeue_many(q, elems, want);
+
+        if (got == 0) {
+            qthread_yield();
+        }
+        i += got;
+    }
+}                                      /*}}} */
+
+static void pairs_buffered(const size_t startat, const size_t stopat,
+                           void *arg)
+{                                      /*{{{ */
+    qdqueue_t *q = (qdqueue_t *)arg;
+    void *me = (void *)(uintptr_t)(startat + 1);
+
+    for (size_t i = 0; i < ELEMENT_COUNT; i++) {
+        qdqueue_enqueue_buffered(q, me);
+    }
+    for (size_t i = 0; i < ELEMENT_COUNT; i++) {
+        while (qdqueue_dequeue(q) == NULL) {
+            qthread_yield();
+        }
+    }
+}                                      /*}}} */
+
+/* run f with 1, 2, 4, ... TASKS tasks */
+static void scale(const char *name, qt_loop_f f, qdqueue_t *q)
+{                                      /*{{{ */
+    qtimer_t timer = qtimer_create();
+
+    for (size_t tasks = 1;; tasks = (tasks * 2 > TASKS) ? TASKS : tasks * 2) {
+        double secs;
+
+        qtimer_start(timer);
+        qt_loop(0, tasks, f, q);
+        qtimer_stop(timer);
+        secs = qtimer_secs(timer);
+        if (!qdqueue_empty(q)) {
+            fprintf(stderr, "qdqueue not empty after %s test!\n", name);
+            exit(-2);
+        }
+        printf("%-8s %4lu tasks: %9.3f Mops/s\n", name, (unsigned long)tasks,
+               (2.0 * tasks * ELEMENT_COUNT) / secs / 1e6);
+        if (tasks == TASKS) { break; }
+    }
+    qtimer_destroy(timer);
+}                                      /*}}} */
+
 int main(int argc, char *argv[])
 {
     qdqueue_t *q;
@@ -77,6 +162,15 @@ int main(int argc, char *argv[])
     assert(qthread_initialize() == QTHREAD_SUCCESS);
 
     CHECK_VERBOSE();
+    NUMARG(ELEMENT_COUNT, "ELEMENT_COUNT");
+    NUMARG(THREAD_COUNT, "THREAD_COUNT");
+    NUMARG(TASKS, "TASKS");
+    if (TASKS == 0) {
+        TASKS = (qthread_num_workers() > THREAD_COUNT) ? qthread_num_workers() : THREAD_COUNT;
+    }
+    printf("%u shepherds, %u workers, %lu elements per task\n",
+           (unsigned)qthread_num_shepherds(), (unsigned)qthread_num_workers(),
+           (unsigned long)ELEMENT_COUNT);
 
     if ((q = qdqueue_create()) == NULL) {
         fprintf(stderr, "qdqueue_create() failed!\n");
@@ -124,6 +218,10 @@ int main(int argc, char *argv[])
     printf("threaded dq test: %f secs\n", qtimer_secs(timer));
     free(rets);
 
+    scale("single", pairs_single, q);
+    scale("batch", pairs_batch, q);
+    scale("buffered", pairs_buffered, q);
+
     if (qdqueue_destroy(q) != QTHREAD_SUCCESS) {
         fprintf(stderr, "qdqueue_destroy() failed!\n");
         exit(-2);
@@ -13,9 +13,16 @@
 #include <qthread/qtimer.h>
 #include "argparsing.h"
 
+/* Times the linked qlfqueue against the ring-based one, one element at a time
+ * and in batches. time_tbbq runs the same loops (THREAD_COUNT * ELEMENT_COUNT
+ * elements by default) against TBB's concurrent_queue. */
+
 #define ELEMENT_COUNT   10000
 #define THREAD_COUNT    128
 
+static size_t batch     = 64;
+static size_t ring_size = 0;
+
 #ifdef HAVE_CPROPS
 static aligned_t cpqueuer(void *arg)
 {
@@ -138,60 +145,84 @@ static void loop_dequeuer(const size_t startat, const size_t stopat,
     }
 }                                      /*}}} */
 
-int main(int argc, char *argv[])
-{
-    qlfqueue_t *q;
-    size_t i;
-    aligned_t *rets;
-    qtimer_t timer = qtimer_create();
+static void loop_batch_queuer(const size_t startat, const size_t stopat,
+                              void *arg)
+{                                      /*{{{ */
+    qlfqueue_t *q = (qlfqueue_t *)arg;
+    void **elems = malloc(batch * sizeof(void *));
 
-#ifdef HAVE_CPROPS
-    cp_list *cpq;
-#endif
+    assert(elems);
+    for (size_t i = 0; i < batch; i++) {
+        elems[i] = (void *)(uintptr_t)(qthread_id() + 1);
+    }
+    for (size_t i = startat; i < stopat; i += batch) {
+        size_t n = (stopat - i < batch) ? stopat - i : batch;
 
-    assert(qthread_initialize() == QTHREAD_SUCCESS);
+        if (qlfqueue_enqueue_many(q, elems, n) != QTHREAD_SUCCESS) {
+            fprintf(stderr, "qlfqueue_enqueue_many(q, %lu) failed!\n", (unsigned long)n);
+            exit(-2);
+        }
+    }
+    free(elems);
+}                                      /*}}} */
 
-    CHECK_VERBOSE();
+static void loop_batch_dequeuer(const size_t startat, const size_t stopat,
+                                void *arg)
+{                                      /*{{{ */
+    qlfqueue_t *q = (qlfqueue_t *)arg;
+    void **elems = malloc(batch * sizeof(void *));
 
-    if ((q = qlfqueue_create()) == NULL) {
-        fprintf(stderr, "qlfqueue_create() failed!\n");
-        exit(-1);
+    assert(elems);
+    for (size_t i = startat; i < stopat; ) {
+        size_t n = (stopat - i < batch) ? stopat - i : batch;
+        size_t got = qlfqueue_dequeue_many(q, elems, n);
+
+        if (got == 0) {
+            fprintf(stderr, "qlfqueue_dequeue_many(%p) failed!\n", (void *)q);
+            exit(-2);
+        }
+        i += got;
     }
+    free(elems);
+}                                      /*}}} */
+
+static void timed_loop(qtimer_t timer, const char *name, const char *op,
+                       qt_loop_f f, qlfqueue_t *q)
+{                                      /*{{{ */
+    qtimer_start(timer);
+    qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, f, q);
+    qtimer_stop(timer);
+    printf("%s loop balance %s: %g secs (%g nsecs/%s)\n", name, op,
+           qtimer_secs(timer),
+           1e9 * qtimer_secs(timer) / (THREAD_COUNT * ELEMENT_COUNT), op);
+}                                      /*}}} */
+
+static void time_qlfqueue(const char *name, qlfqueue_t *q, aligned_t *rets)
+{                                      /*{{{ */
+    size_t i;
+    qtimer_t timer = qtimer_create();
 
     /* prime the pump */
     qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, loop_queuer, q);
     qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, loop_dequeuer, q);
     if (!qlfqueue_empty(q)) {
-        fprintf(stderr, "qlfqueue not empty after priming!\n");
+        fprintf(stderr, "%s qlfqueue not empty after priming!\n", name);
         exit(-2);
     }
 
-    qtimer_start(timer);
-    qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, loop_queuer, q);
-    qtimer_stop(timer);
-    printf("loop balance enqueue: %g secs (%g nsecs/enqueue)\n", qtimer_secs(timer), 1e9*qtimer_secs(timer)/(THREAD_COUNT*ELEMENT_COUNT));
-    qtimer_start(timer);
-    qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, loop_dequeuer, q);
-    qtimer_stop(timer);
-    printf("loop balance dequeue: %g secs (%g nsecs/dequeue)\n", qtimer_secs(timer), 1e9*qtimer_secs(timer)/(THREAD_COUNT*ELEMENT_COUNT));
+    timed_loop(timer, name, "enqueue", loop_queuer, q);
+    timed_loop(timer, name, "dequeue", loop_dequeuer, q);
     if (!qlfqueue_empty(q)) {
-        fprintf(stderr, "qlfqueue not empty after loop balance test!\n");
+        fprintf(stderr, "%s qlfqueue not empty after loop balance test!\n", name);
+        exit(-2);
+    }
+    timed_loop(timer, name, "batch enqueue", loop_batch_queuer, q);
+    timed_loop(timer, name, "batch dequeue", loop_batch_dequeuer, q);
+    if (!qlfqueue_empty(q)) {
+        fprintf(stderr, "%s qlfqueue not empty after batch test!\n", name);
         exit(-2);
     }
-#ifdef HAVE_CPROPS
-    cpq = cp_list_create();
-    qtimer_start(timer);
-    qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, loop_cpqueuer, cpq);
-    qtimer_stop(timer);
-    printf("loop balance cp enqueue: %f secs\n", qtimer_secs(timer));
-    qtimer_start(timer);
-    qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, loop_cpdequeuer, cpq);
-    qtimer_stop(timer);
-    printf("loop balance cp dequeue: %f secs\n", qtimer_secs(timer));
-#endif
 
-    rets = calloc(THREAD_COUNT, sizeof(aligned_t));
-    assert(rets != NULL);
     qtimer_start(timer);
     for (i = 0; i < THREAD_COUNT; i++) {
         assert(qthread_fork(dequeuer, q, &(rets[i])) == QTHREAD_SUCCESS);
@@ -204,12 +235,61 @@ int main(int argc, char *argv[])
     }
     qtimer_stop(timer);
     if (!qlfqueue_empty(q)) {
-        fprintf(stderr, "qlfqueue not empty after threaded test!\n");
+        fprintf(stderr, "%s qlfqueue not empty after threaded test!\n", name);
+        exit(-2);
+    }
+    printf("%s threaded lf test: %f secs\n", name, qtimer_secs(timer));
+    qtimer_destroy(timer);
+
+    if (qlfqueue_destroy(q) != QTHREAD_SUCCESS) {
+        fprintf(stderr, "qlfqueue_destroy() failed!\n");
         exit(-2);
     }
-    printf("threaded lf test: %f secs\n", qtimer_secs(timer));
+}                                      /*}}} */
+
+int main(int argc, char *argv[])
+{
+    qlfqueue_t *q;
+    aligned_t *rets;
+
+#ifdef HAVE_CPROPS
+    size_t i;
+    qtimer_t timer = qtimer_create();
+    cp_list *cpq;
+#endif
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+
+    CHECK_VERBOSE();
+    NUMARG(batch, "BATCH");
+    NUMARG(ring_size, "RING_SIZE");
+    assert(batch > 0);
+
+    rets = calloc(THREAD_COUNT, sizeof(aligned_t));
+    assert(rets != NULL);
+
+    if ((q = qlfqueue_create()) == NULL) {
+        fprintf(stderr, "qlfqueue_create() failed!\n");
+        exit(-1);
+    }
+    time_qlfqueue("linked", q, rets);
+    if ((q = qlfqueue_create_ring(ring_size)) == NULL) {
+        fprintf(stderr, "qlfqueue_create_ring() failed!\n");
+        exit(-1);
+    }
+    time_qlfqueue("ring", q, rets);
 
 #ifdef HAVE_CPROPS
+    cpq = cp_list_create();
+    qtimer_start(timer);
+    qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, loop_cpqueuer, cpq);
+    qtimer_stop(timer);
+    printf("loop balance cp enqueue: %f secs\n", qtimer_secs(timer));
+    qtimer_start(timer);
+    qt_loop_balance(0, THREAD_COUNT * ELEMENT_COUNT, loop_cpdequeuer, cpq);
+    qtimer_stop(timer);
+    printf("loop balance cp dequeue: %f secs\n", qtimer_secs(timer));
+
     qtimer_start(timer);
     for (i = 0; i < THREAD_COUNT; i++) {
         assert(qthread_fork(cpdequeuer, cpq, &(rets[i])) == QTHREAD_SUCCESS);
@@ -221,16 +301,12 @@ int main(int argc, char *argv[])
         assert(qthread_readFF(NULL, &(rets[i])) == QTHREAD_SUCCESS);
     }
     qtimer_stop(timer);
-    free(rets);
     printf("threaded cp test: %f secs\n", qtimer_secs(timer));
 
     cp_list_destroy(cpq);
+    qtimer_destroy(timer);
 #endif /* ifdef HAVE_CPROPS */
-
-    if (qlfqueue_destroy(q) != QTHREAD_SUCCESS) {
-        fprintf(stderr, "qlfqueue_destroy() failed!\n");
-        exit(-2);
-    }
+    free(rets);
 
     iprintf("success!\n");
 
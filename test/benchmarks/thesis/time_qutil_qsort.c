@@ -14,19 +14,49 @@
 #include <time.h>                      /* for gettimeofday() */
 
 #include <qthread/qutil.h>
+#include <qthread/qloop.h>
 #include <qthread/qtimer.h>
 #include "argparsing.h"
 
 static int dcmp(const void *a, const void *b)
 {
-    return (int)(*(double *)a - *(double *)b);
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
 }
 
 static int acmp(const void *a, const void *b)
 {
-    return (*(aligned_t *)a - *(aligned_t *)b);
+    const aligned_t x = *(const aligned_t *)a, y = *(const aligned_t *)b;
+    return (x > y) - (x < y);
 }
 
+static void libc_dsort(double *a, size_t len) { qsort(a, len, sizeof(double), dcmp); }
+static void libc_asort(aligned_t *a, size_t len) { qsort(a, len, sizeof(aligned_t), acmp); }
+static void sample_dsort(double *a, size_t len) { qutil_samplesort(a, len, sizeof(double), dcmp); }
+static void sample_asort(aligned_t *a, size_t len) { qutil_samplesort(a, len, sizeof(aligned_t), acmp); }
+
+static const struct {
+    const char *name;
+    void      (*sort)(double *, size_t);
+} dsorts[] = {
+    { "libc qsort", libc_dsort },
+    { "qutil_qsort", qutil_qsort },
+    { "qt_qsort", qt_qsort },
+    { "qutil_samplesort", sample_dsort },
+    { "qutil_double_radixsort", qutil_double_radixsort },
+    { "qutil_mergesort", qutil_mergesort }
+};
+
+static const struct {
+    const char *name;
+    void      (*sort)(aligned_t *, size_t);
+} asorts[] = {
+    { "libc qsort", libc_asort },
+    { "qutil_aligned_qsort", qutil_aligned_qsort },
+    { "qutil_samplesort", sample_asort },
+    { "qutil_uint_radixsort", qutil_uint_radixsort }
+};
+
 static const char * human_readable(size_t bytes)
 {
     static char str[50];
@@ -55,9 +85,9 @@ int main(int argc, char *argv[])
     double *d_array, *d_array2;
     size_t len = 1000000;
     qtimer_t timer = qtimer_create();
-    double cumulative_time_qutil = 0.0;
-    double cumulative_time_libc = 0.0;
+    double time_libc = 0.0;
     int using_doubles = 0;
+    int with_mergesort = 0;
     unsigned long iterations = 10;
 
     qthread_initialize();
@@ -67,47 +97,49 @@ int main(int argc, char *argv[])
     NUMARG(len, "TEST_LEN");
     NUMARG(iterations, "TEST_ITERATIONS");
     NUMARG(using_doubles, "TEST_USING_DOUBLES");
+    /* qutil_mergesort's in-place merge is quadratic; only time it on request */
+    NUMARG(with_mergesort, "TEST_MERGESORT");
     printf("using %s\n", using_doubles ? "doubles" : "aligned_ts");
 
     if (using_doubles) {
+        const size_t nsorts = sizeof(dsorts) / sizeof(dsorts[0]) - (with_mergesort ? 0 : 1);
+
         d_array = calloc(len, sizeof(double));
 	printf("array is %s\n", human_readable(len * sizeof(double)));
         assert(d_array);
-        // madvise(d_array,len*sizeof(double), MADV_SEQUENTIAL);
         for (unsigned int i = 0; i < len; i++) {
             d_array[i] = ((double)random()) / ((double)RAND_MAX) + random();
         }
         d_array2 = calloc(len, sizeof(double));
         assert(d_array2);
-        // madvise(d_array2,len*sizeof(double), MADV_RANDOM);
         iprintf("double array generated...\n");
-        for (unsigned int i = 0; i < iterations; i++) {
-            memcpy(d_array2, d_array, len * sizeof(double));
-            qtimer_start(timer);
-            qutil_qsort(d_array2, len);
-            qtimer_stop(timer);
-            cumulative_time_qutil += qtimer_secs(timer);
-            iprintf("\t%u: sorting %lu doubles with qutil took: %f seconds\n",
-                    i, (unsigned long)len, qtimer_secs(timer));
-        }
-        cumulative_time_qutil /= (double)iterations;
-        printf("sorting %lu doubles with qutil took: %f seconds (avg)\n",
-               (unsigned long)len, cumulative_time_qutil);
-        for (unsigned int i = 0; i < iterations; i++) {
-            memcpy(d_array2, d_array, len * sizeof(double));
-            qtimer_start(timer);
-            qsort(d_array2, len, sizeof(double), dcmp);
-            qtimer_stop(timer);
-            cumulative_time_libc += qtimer_secs(timer);
-            iprintf("\t%u: sorting %lu doubles with libc took: %f seconds\n",
-                    i, (unsigned long)len, qtimer_secs(timer));
+        for (size_t s = 0; s < nsorts; s++) {
+            double cumulative = 0.0;
+            for (unsigned int i = 0; i < iterations; i++) {
+                memcpy(d_array2, d_array, len * sizeof(double));
+                qtimer_start(timer);
+                dsorts[s].sort(d_array2, len);
+                qtimer_stop(timer);
+                cumulative += qtimer_secs(timer);
+                iprintf("\t%u: sorting %lu doubles with %s took: %f seconds\n",
+                        i, (unsigned long)len, dsorts[s].name, qtimer_secs(timer));
+            }
+            for (size_t i = 1; i < len; i++) {
+                if (d_array2[i - 1] > d_array2[i]) {
+                    printf("%s: out of order at %lu\n", dsorts[s].name, (unsigned long)i);
+                    abort();
+                }
+            }
+            cumulative /= (double)iterations;
+            if (s == 0) { time_libc = cumulative; }
+            printf("sorting %lu doubles with %-24s took: %f seconds (avg), %0.2fx libc\n",
+                   (unsigned long)len, dsorts[s].name, cumulative, time_libc / cumulative);
         }
-	cumulative_time_libc /= (double)iterations;
-        printf("sorting %lu doubles with libc took: %f seconds\n",
-               (unsigned long)len, cumulative_time_libc);
         free(d_array);
         free(d_array2);
     } else {
+        const size_t nsorts = sizeof(asorts) / sizeof(asorts[0]);
+
         ui_array = calloc(len, sizeof(aligned_t));
 	printf("array is %s\n", human_readable(len * sizeof(aligned_t)));
         for (unsigned int i = 0; i < len; i++) {
@@ -115,34 +147,29 @@ int main(int argc, char *argv[])
         }
         ui_array2 = calloc(len, sizeof(aligned_t));
         iprintf("ui_array generated...\n");
-        for (int i = 0; i < iterations; i++) {
-            memcpy(ui_array2, ui_array, len * sizeof(aligned_t));
-            qtimer_start(timer);
-            qutil_aligned_qsort(ui_array2, len);
-            qtimer_stop(timer);
-            cumulative_time_qutil += qtimer_secs(timer);
-        }
-	cumulative_time_qutil /= (double)iterations;
-        printf("sorting %lu aligned_ts with qutil took: %f seconds\n",
-               (unsigned long)len, cumulative_time_qutil);
-        for (int i = 0; i < iterations; i++) {
-            memcpy(ui_array2, ui_array, len * sizeof(aligned_t));
-            qtimer_start(timer);
-            qsort(ui_array2, len, sizeof(double), acmp);
-            qtimer_stop(timer);
-            cumulative_time_libc += qtimer_secs(timer);
+        for (size_t s = 0; s < nsorts; s++) {
+            double cumulative = 0.0;
+            for (unsigned int i = 0; i < iterations; i++) {
+                memcpy(ui_array2, ui_array, len * sizeof(aligned_t));
+                qtimer_start(timer);
+                asorts[s].sort(ui_array2, len);
+                qtimer_stop(timer);
+                cumulative += qtimer_secs(timer);
+            }
+            for (size_t i = 1; i < len; i++) {
+                if (ui_array2[i - 1] > ui_array2[i]) {
+                    printf("%s: out of order at %lu\n", asorts[s].name, (unsigned long)i);
+                    abort();
+                }
+            }
+            cumulative /= (double)iterations;
+            if (s == 0) { time_libc = cumulative; }
+            printf("sorting %lu aligned_ts with %-24s took: %f seconds (avg), %0.2fx libc\n",
+                   (unsigned long)len, asorts[s].name, cumulative, time_libc / cumulative);
         }
-	cumulative_time_libc /= (double)iterations;
-        printf("sorting %lu aligned_ts with libc took: %f seconds (avg)\n",
-               (unsigned long)len, cumulative_time_libc);
         free(ui_array);
         free(ui_array2);
     }
-    if (cumulative_time_qutil < cumulative_time_libc) {
-	printf("qutil with %lu threads provides a %0.2fx speedup.\n", (unsigned long)qthread_num_shepherds(), cumulative_time_libc/cumulative_time_qutil);
-    } else {
-	printf("qutil with %lu threads provides a %0.2fx slowdown.\n", (unsigned long)qthread_num_shepherds(), cumulative_time_libc/cumulative_time_qutil);
-    }
 
     qtimer_destroy(timer);
 
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/barrier.h>
+#include "argparsing.h"
+
+static size_t        rounds = 100;
+static size_t        participants;
+static aligned_t    *phase;
+static qt_barrier_t *b;
+static int           use_ids;
+
+static void enter(size_t id)
+{
+    if (use_ids) {
+        qt_barrier_enter_id(b, id);
+    } else {
+        qt_barrier_enter(b);
+    }
+}
+
+static aligned_t participant(void *arg)
+{
+    size_t id = (uintptr_t)arg;
+
+    for (size_t r = 1; r <= rounds; r++) {
+        phase[id] = r;
+        enter(id);
+        /* nobody may be missing from, or ahead of, this round */
+        for (size_t i = 0; i < participants; i++) {
+            assert(phase[i] == r);
+        }
+        enter(id);
+    }
+    return 0;
+}
+
+static void run(qt_barrier_btype type,
+                size_t           n)
+{
+    aligned_t *rets = malloc(n * sizeof(aligned_t));
+
+    assert(rets);
+    participants = n;
+    phase        = calloc(n, sizeof(aligned_t));
+    assert(phase);
+    for (size_t i = 1; i < n; i++) {
+        qthread_fork(participant, (void *)(uintptr_t)i, rets + i);
+    }
+    participant((void *)(uintptr_t)0);
+    for (size_t i = 1; i < n; i++) {
+        qthread_readFF(NULL, rets + i);
+    }
+    free(phase);
+    free(rets);
+    iprintf("%s, %lu participants, %s: ok\n",
+            (type == DISSEMINATION_BARRIER) ? "dissemination" : "tournament",
+            (unsigned long)n, use_ids ? "by id" : "by ticket");
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    const qt_barrier_btype types[] = { DISSEMINATION_BARRIER, TOURNAMENT_BARRIER };
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(rounds, "ROUNDS");
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    for (int t = 0; t < 2; t++) {
+        size_t sizes[] = { 1, 2, 3, qthread_num_workers(), 37 };
+
+        b = qt_barrier_create(sizes[0], types[t]);
+        assert(b);
+        for (int s = 0; s < 5; s++) {
+            qt_barrier_resize(b, sizes[s]);
+            for (use_ids = 0; use_ids < 2; use_ids++) {
+                run(types[t], sizes[s]);
+            }
+        }
+        qt_barrier_destroy(b);
+    }
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/barrier.h>
+#include "argparsing.h"
+
+static size_t        rounds = 100;
+static size_t        participants;
+static aligned_t    *phase;
+static qt_barrier_t *b;
+
+static aligned_t participant(void *arg)
+{
+    size_t id = (uintptr_t)arg;
+
+    for (size_t r = 1; r <= rounds; r++) {
+        aligned_t token;
+
+        phase[id] = r;
+        token     = qt_barrier_arrive(b);
+        /* nobody can get more than one round ahead of us, since round r + 1
+         * can't complete until we arrive for it; poll a bit, as if doing
+         * other work, but don't count on the scheduler to run anyone else */
+        for (int i = 0; i < 10 && !qt_barrier_test(b, token); i++) {
+            for (size_t i = 0; i < participants; i++) {
+                assert(phase[i] + 1 >= r && phase[i] <= r + 1);
+            }
+            qthread_yield();
+        }
+        qt_barrier_wait(b, token);
+        for (size_t i = 0; i < participants; i++) {
+            assert(phase[i] >= r);
+        }
+    }
+    return 0;
+}
+
+static aligned_t late(void *arg)
+{
+    qt_barrier_wait(b, qt_barrier_arrive(b));
+    return 0;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    const qt_barrier_btype types[] = { REGION_BARRIER, DISSEMINATION_BARRIER, TOURNAMENT_BARRIER };
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(rounds, "ROUNDS");
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    for (int t = 0; t < 3; t++) {
+        size_t    sizes[] = { 1, 2, 5, qthread_num_workers(), 37 };
+        aligned_t token, ret;
+
+        /* the phase can't complete until the second participant shows up */
+        b     = qt_barrier_create(2, types[t]);
+        token = qt_barrier_arrive(b);
+        assert(!qt_barrier_test(b, token));
+        qthread_fork(late, NULL, &ret);
+        qt_barrier_wait(b, token);
+        assert(qt_barrier_test(b, token));
+        qthread_readFF(NULL, &ret);
+
+        for (int s = 0; s < 5; s++) {
+            aligned_t *rets = malloc(sizes[s] * sizeof(aligned_t));
+
+            assert(rets);
+            participants = sizes[s];
+            phase        = calloc(participants, sizeof(aligned_t));
+            assert(phase);
+            if (types[t] == REGION_BARRIER) {
+                /* not every backend can resize a region barrier */
+                qt_barrier_destroy(b);
+                b = qt_barrier_create(participants, types[t]);
+            } else {
+                qt_barrier_resize(b, participants);
+            }
+            for (size_t i = 1; i < participants; i++) {
+                qthread_fork(participant, (void *)(uintptr_t)i, rets + i);
+            }
+            participant((void *)(uintptr_t)0);
+            for (size_t i = 1; i < participants; i++) {
+                qthread_readFF(NULL, rets + i);
+            }
+            free(phase);
+            free(rets);
+            iprintf("type %i, %lu participants: ok\n", (int)types[t], (unsigned long)participants);
+        }
+        qt_barrier_destroy(b);
+    }
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qloop.hpp>
+
+#include "argparsing.h"
+
+#if __cplusplus >= 201103L
+static const size_t len = 100003;
+
+static void check_for(size_t grain)
+{
+    aligned_t *hits = (aligned_t *)calloc(len, sizeof(aligned_t));
+
+    assert(hits);
+    qthread::parallel_for(0, len, grain, [hits](size_t i) {
+                              qthread_incr(&hits[i], 1);
+                          });
+    for (size_t i = 0; i < len; i++) assert(hits[i] == 1);
+
+    /* a sub-range, shorter than the number of workers */
+    qthread::parallel_for(10, 12, grain, [=](size_t i) {
+                              hits[i]++;
+                          });
+    for (size_t i = 0; i < len; i++) assert(hits[i] == ((i == 10 || i == 11) ? 2 : 1));
+    free(hits);
+    iprintf("parallel_for, grain %lu: ok\n", (unsigned long)grain);
+}
+
+static void check_reduce(size_t grain)
+{
+    unsigned long expect = 0, got, big;
+
+    for (size_t i = 0; i < len; i++) expect += i * 3;
+    got = qthread::parallel_reduce(0, len, grain, 0UL,
+                                   [](size_t i) { return (unsigned long)i * 3; },
+                                   [](unsigned long a, unsigned long b) { return a + b; });
+    assert(got == expect);
+
+    big = qthread::parallel_reduce(0, len, grain, 0UL,
+                                   [](size_t i) { return (unsigned long)((i * 2654435761UL) % 1000003); },
+                                   [](unsigned long a, unsigned long b) { return (a > b) ? a : b; });
+    expect = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned long v = (i * 2654435761UL) % 1000003;
+        if (v > expect) { expect = v; }
+    }
+    assert(big == expect);
+    iprintf("parallel_reduce, grain %lu: ok\n", (unsigned long)grain);
+}
+#endif // if __cplusplus >= 201103L
+
+int main(int    argc,
+         char **argv)
+{
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+#if __cplusplus >= 201103L
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    check_for(0);
+    check_for(1);
+    check_for(1000);
+    check_reduce(0);
+    check_reduce(1);
+    check_reduce(1000);
+
+    assert(qthread::parallel_reduce(7, 7, 0, 42, [](size_t) { return 1; },
+                                    [](int a, int b) { return a + b; }) == 42);
+    qthread::parallel_for(7, 3, [](size_t) { assert(0); });
+
+    return 0;
+#else
+    iprintf("not compiled as C++11\n");
+    return 77;
+#endif // if __cplusplus >= 201103L
+}
+
+/* vim:set expandtab: */
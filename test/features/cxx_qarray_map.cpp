@@ -0,0 +1,70 @@
+#include <assert.h>
+#include <stdio.h>
+#include <qthread/qthread.h>
+#include <qthread/qarray.hpp>
+
+#include "argparsing.h"
+
+struct scale {
+    scale(double _k) : k(_k) {}
+
+    double operator() (double x) const
+    {
+        return k * x;
+    }
+
+    double k;
+};
+
+struct to_index {
+    aligned_t operator() (double x) const
+    {
+        return (aligned_t)(x / 2.0);
+    }
+};
+
+int main(int    argc,
+         char **argv)
+{
+    const size_t elems = 10007;
+    qarray      *a, *b, *u;
+
+    qthread_initialize();
+    CHECK_VERBOSE();
+
+    /* DIST arrays have gaps between segments; b doesn't match a's layout */
+    a = qarray_create_configured(elems, sizeof(double), DIST_STRIPES, 1, 1);
+    b = qarray_create_configured(elems, sizeof(double), FIXED_FIELDS, 1, 2);
+    u = qarray_create_configured(elems, sizeof(aligned_t), FIXED_HASH, 1, 1);
+    assert(a && b && u);
+
+    for (size_t i = 0; i < elems; i++) {
+        *(double *)qarray_elem(a, i) = (double)i;
+    }
+    qarray_map<double>(a, 0, elems, scale(2.0));
+    for (size_t i = 0; i < elems; i++) {
+        assert(*(double *)qarray_elem(a, i) == 2.0 * i);
+    }
+    iprintf("map ok\n");
+
+    qarray_double_fill(b, 0, elems, -1.0);
+    qarray_transform<double, double>(b, a, 1, elems - 1, scale(0.5));
+    for (size_t i = 0; i < elems; i++) {
+        assert(*(double *)qarray_elem(b, i) ==
+               ((i == 0 || i == elems - 1) ? -1.0 : (double)i));
+    }
+    iprintf("transform ok\n");
+
+    qarray_transform<aligned_t, double>(u, a, 0, elems, to_index());
+    for (size_t i = 0; i < elems; i++) {
+        assert(*(aligned_t *)qarray_elem(u, i) == i);
+    }
+    iprintf("typed transform ok\n");
+
+    qarray_destroy(a);
+    qarray_destroy(b);
+    qarray_destroy(u);
+    return 0;
+}
+
+/* vim:set expandtab: */
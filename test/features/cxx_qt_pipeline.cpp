@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string>
+#include <qthread/qthread.h>
+#include <qthread/qloop_pipeline.hpp>
+
+#include "argparsing.h"
+
+static const size_t len = 100000;
+
+struct square {
+    typedef unsigned long result_type;
+    unsigned long operator()(size_t i) const { return (unsigned long)i * i; }
+};
+
+struct odd {
+    bool operator()(unsigned long v) const { return v & 1; }
+};
+
+struct add {
+    unsigned long operator()(unsigned long a,
+                             unsigned long b) const { return a + b; }
+};
+
+struct below {
+    below(double c) : cut(c) {}
+    bool operator()(double v) const { return v < cut; }
+    double cut;
+};
+
+struct scale {
+    typedef double result_type;
+    scale(double f) : factor(f) {}
+    double operator()(double v) const { return v * factor; }
+    double factor;
+};
+
+struct dadd {
+    double operator()(double a,
+                      double b) const { return a + b; }
+};
+
+/* string concatenation: associative, but not commutative */
+struct letter {
+    typedef std::string result_type;
+    std::string operator()(size_t i) const { return std::string(1, (char)('a' + i % 26)); }
+};
+
+struct concat {
+    std::string operator()(const std::string &a,
+                           const std::string &b) const { return a + b; }
+};
+
+struct mark {
+    mark(aligned_t *h) : hits(h) {}
+    void operator()(size_t i) const { qthread_incr(&hits[i], 1); }
+    aligned_t *hits;
+};
+
+int main(int    argc,
+         char **argv)
+{
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    {
+        unsigned long expect = 0, got;
+
+        for (size_t i = 0; i < len; i++) {
+            unsigned long sq = (unsigned long)i * i;
+            if (sq & 1) { expect += sq; }
+        }
+        got = qt_pipeline(0, len).map(square()).filter(odd()).reduce(add(), 0UL);
+        iprintf("map/filter/reduce: %lu (expected %lu)\n", got, expect);
+        assert(got == expect);
+        assert(qt_pipeline(0, len).map(square()).filter(odd()).count() == len / 2);
+    }
+
+    {
+        double *data = (double *)malloc(len * sizeof(double));
+        double  expect = 0.0, got;
+
+        assert(data);
+        for (size_t i = 0; i < len; i++) {
+            data[i] = (double)(i % 1000);
+            if (data[i] < 250.0) { expect += data[i] * 0.5; }
+        }
+        got = qt_pipeline(data, len).filter(below(250.0)).map(scale(0.5)).reduce(dadd(), 0.0);
+        iprintf("array source: %g (expected %g)\n", got, expect);
+        assert(got == expect); /* small integers and halves add up exactly */
+        free(data);
+    }
+
+    {
+        std::string expect, got;
+
+        for (size_t i = 0; i < 1000; i++) expect += (char)('a' + i % 26);
+        got = qt_pipeline(0, 1000).map(letter()).reduce(concat(), std::string());
+        assert(got == expect);
+        iprintf("non-commutative reduce: ok\n");
+    }
+
+    {
+        aligned_t *hits = (aligned_t *)calloc(len, sizeof(aligned_t));
+
+        assert(hits);
+        qt_pipeline(0, len).for_each(mark(hits));
+        for (size_t i = 0; i < len; i++) assert(hits[i] == 1);
+        iprintf("for_each: ok\n");
+        free(hits);
+    }
+
+    assert(qt_pipeline(5, 5).map(square()).reduce(add(), 42UL) == 42);
+    assert(qt_pipeline(0, len).map(square()).filter(below(-1.0)).count() == 0);
+
+    return 0;
+}
+
+/* vim:set expandtab: */
@@ -0,0 +1,134 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qarray.h>
+#include "argparsing.h"
+
+static size_t ELEMS = 10007;
+
+static const distribution_t dists[] = {
+    FIXED_HASH, FIXED_FIELDS, ALL_LOCAL, DIST_STRIPES, DIST_FIELDS, DIST_RAND,
+    DIST_LEAST
+};
+static const char *dist_names[] = {
+    "FIXED_HASH", "FIXED_FIELDS", "ALL_LOCAL", "DIST_STRIPES", "DIST_FIELDS",
+    "DIST_RAND", "DIST_LEAST"
+};
+
+#define DBL(a, i)  (*(double *)qarray_elem_nomigrate((a), (i)))
+#define UINT(a, i) (*(aligned_t *)qarray_elem_nomigrate((a), (i)))
+#define INT(a, i)  (*(saligned_t *)qarray_elem_nomigrate((a), (i)))
+
+static void test_doubles(distribution_t d)
+{
+    /* b is laid out like a; c has bigger segments, so the runs that pair it
+     * with a are cut at both arrays' segment boundaries */
+    qarray *a = qarray_create_configured(ELEMS, sizeof(double), d, 1, 1);
+    qarray *b = qarray_create_configured(ELEMS, sizeof(double), d, 1, 1);
+    qarray *c = qarray_create_configured(ELEMS, sizeof(double), FIXED_HASH, 0, 3);
+    double  expect;
+
+    assert(a && b && c);
+
+    qarray_double_fill(a, 0, ELEMS, 1.5);
+    qarray_double_fill(a, 13, ELEMS - 7, 2.0);
+    for (size_t i = 0; i < ELEMS; i++) {
+        assert(DBL(a, i) == ((i < 13 || i >= ELEMS - 7) ? 1.5 : 2.0));
+    }
+    iprintf("\tfill ok\n");
+
+    for (size_t i = 0; i < ELEMS; i++) {
+        DBL(a, i) = (double)i;
+    }
+    qarray_copy(b, a, 0, ELEMS);
+    qarray_copy(c, a, 0, ELEMS);
+    for (size_t i = 0; i < ELEMS; i++) {
+        assert(DBL(b, i) == (double)i);
+        assert(DBL(c, i) == (double)i);
+    }
+    iprintf("\tcopy ok\n");
+
+    qarray_double_axpy(b, 2.0, a, 0, ELEMS);
+    qarray_double_axpy(c, -1.0, a, 1, ELEMS - 1);
+    for (size_t i = 0; i < ELEMS; i++) {
+        assert(DBL(b, i) == 3.0 * i);
+        assert(DBL(c, i) == ((i == 0 || i == ELEMS - 1) ? (double)i : 0.0));
+    }
+    iprintf("\taxpy ok\n");
+
+    qarray_double_fill(c, 0, ELEMS, 1.0);
+    expect = (double)ELEMS * (ELEMS - 1) / 2;
+    assert(qarray_double_dot(a, c, 0, ELEMS) == expect);
+    assert(qarray_double_dot(c, a, 0, ELEMS) == expect);
+    assert(qarray_double_dot(a, a, 5, 6) == 25.0);
+    assert(qarray_double_sum(a, 0, ELEMS) == expect);
+    assert(qarray_double_sum(a, 10, 20) == 145.0);
+    assert(qarray_double_sum(a, 7, 7) == 0.0);
+    iprintf("\tdot/sum ok\n");
+
+    DBL(a, ELEMS / 3) = -1.0;
+    assert(qarray_double_min(a, 0, ELEMS) == -1.0);
+    assert(qarray_double_min(a, 1, ELEMS / 3) == 1.0);
+    assert(qarray_double_max(a, 0, ELEMS) == (double)(ELEMS - 1));
+    assert(qarray_double_max(a, 0, ELEMS - 1) == (double)(ELEMS - 2));
+    iprintf("\tmin/max ok\n");
+
+    qarray_destroy(a);
+    qarray_destroy(b);
+    qarray_destroy(c);
+}
+
+static void test_ints(distribution_t d)
+{
+    qarray    *u = qarray_create_configured(ELEMS, sizeof(aligned_t), d, 1, 1);
+    qarray    *s = qarray_create_configured(ELEMS, sizeof(saligned_t), d, 1, 1);
+    aligned_t  usum = 0;
+    saligned_t ssum = 0;
+
+    assert(u && s);
+    qarray_uint_fill(u, 0, ELEMS, 3);
+    qarray_int_fill(s, 0, ELEMS, -3);
+    assert(qarray_uint_sum(u, 0, ELEMS) == 3 * ELEMS);
+    assert(qarray_int_sum(s, 0, ELEMS) == -3 * (saligned_t)ELEMS);
+    for (size_t i = 0; i < ELEMS; i++) {
+        UINT(u, i) = (aligned_t)((i * 7919) % ELEMS);
+        INT(s, i)  = (saligned_t)i - (saligned_t)(ELEMS / 2);
+        usum      += UINT(u, i);
+        ssum      += INT(s, i);
+    }
+    assert(qarray_uint_sum(u, 0, ELEMS) == usum);
+    assert(qarray_uint_max(u, 0, ELEMS) == ELEMS - 1);
+    assert(qarray_uint_min(u, 0, ELEMS) == 0);
+    assert(qarray_int_sum(s, 0, ELEMS) == ssum);
+    assert(qarray_int_max(s, 0, ELEMS) == (saligned_t)(ELEMS - 1 - ELEMS / 2));
+    assert(qarray_int_min(s, 0, ELEMS) == -(saligned_t)(ELEMS / 2));
+    assert(qarray_int_min(s, ELEMS / 2, ELEMS) == 0);
+    iprintf("\tuint/int ok\n");
+
+    qarray_destroy(u);
+    qarray_destroy(s);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(ELEMS, "ELEMS");
+    assert(ELEMS > 20);
+    iprintf("%i shepherds, %lu elements\n", (int)qthread_num_shepherds(),
+            (unsigned long)ELEMS);
+
+    for (size_t d = 0; d < sizeof(dists) / sizeof(dists[0]); d++) {
+        iprintf("%s:\n", dist_names[d]);
+        test_doubles(dists[d]);
+        test_ints(dists[d]);
+    }
+    return 0;
+}
+
+/* vim:set expandtab: */
@@ -7,6 +7,7 @@
 
 static unsigned int ELEMENT_COUNT = 1000;
 static unsigned int THREAD_COUNT = 128;
+static int          buffered     = 0;
 
 static aligned_t queuer(void *arg)
 {
@@ -14,8 +15,10 @@ static aligned_t queuer(void *arg)
     size_t i;
 
     for (i = 0; i < ELEMENT_COUNT; i++) {
-        if (qdqueue_enqueue(q, (void *)((intptr_t)qthread_id() + 1)) !=
-            QTHREAD_SUCCESS) {
+        void *elem = (void *)((intptr_t)qthread_id() + 1);
+
+        if ((buffered ? qdqueue_enqueue_buffered(q, elem) :
+             qdqueue_enqueue(q, elem)) != QTHREAD_SUCCESS) {
             fprintf(stderr, "qdqueue_enqueue(q, %p) failed!\n",
                     (void *)((intptr_t)qthread_id() + 1));
             exit(-2);
@@ -29,6 +32,20 @@ static aligned_t dequeuer(void *arg)
     qdqueue_t *q = (qdqueue_t *)arg;
     size_t i;
 
+    if (buffered) {
+        void *elems[4];
+
+        for (i = 0; i < ELEMENT_COUNT;) {
+            size_t want = ELEMENT_COUNT - i;
+            size_t got  = qdqueue_dequeue_many(q, elems, (want < 4) ? want : 4);
+
+            if (got == 0) {
+                qthread_yield();
+            }
+            i += got;
+        }
+        return 0;
+    }
     for (i = 0; i < ELEMENT_COUNT; i++) {
         while (qdqueue_dequeue(q) == NULL) {
             qthread_yield();
@@ -95,6 +112,66 @@ int main(int argc,
     }
     iprintf("ordering test succeeded\n");
 
+    {
+        void **elems = malloc(ELEMENT_COUNT * sizeof(void *));
+        size_t got;
+
+        assert(elems);
+        for (i = 0; i < ELEMENT_COUNT; i++) {
+            elems[i] = (void *)(intptr_t)(i + 1);
+        }
+        if (qdqueue_enqueue_many(q, elems, ELEMENT_COUNT) != QTHREAD_SUCCESS) {
+            fprintf(stderr, "qdqueue_enqueue_many() failed!\n");
+            exit(-1);
+        }
+        for (i = 0; i < ELEMENT_COUNT; i += got) {
+            void *out[7];
+
+            got = qdqueue_dequeue_many(q, out, 7);
+            if (got == 0 || got > ELEMENT_COUNT - i) {
+                fprintf(stderr, "qdqueue_dequeue_many() returned %i at %i!\n",
+                        (int)got, (int)i);
+                exit(-1);
+            }
+            for (size_t j = 0; j < got; j++) {
+                if (out[j] != (void *)(intptr_t)(i + j + 1)) {
+                    fprintf(stderr, "qdqueue_dequeue_many() failed, didn't equal %i!\n",
+                            (int)(i + j));
+                    exit(-1);
+                }
+            }
+        }
+        free(elems);
+    }
+    if (!qdqueue_empty(q)) {
+        fprintf(stderr, "qdqueue not empty after batch test!\n");
+        exit(-1);
+    }
+    iprintf("batch test succeeded\n");
+
+    for (i = 0; i < ELEMENT_COUNT; i++) {
+        if (qdqueue_enqueue_buffered(q, (void *)(intptr_t)(i + 1)) != 0) {
+            fprintf(stderr, "qdqueue_enqueue_buffered(q,%i) failed!\n", (int)i);
+            exit(-1);
+        }
+    }
+    if (qdqueue_empty(q)) {
+        fprintf(stderr, "qdqueue empty after buffered enqueue!\n");
+        exit(-1);
+    }
+    for (i = 0; i < ELEMENT_COUNT; i++) {
+        if (qdqueue_dequeue(q) != (void *)(intptr_t)(i + 1)) {
+            fprintf(stderr, "qdqueue_dequeue() of buffered elements failed, didn't equal %i!\n",
+                    (int)i);
+            exit(-1);
+        }
+    }
+    if (!qdqueue_empty(q)) {
+        fprintf(stderr, "qdqueue not empty after buffered test!\n");
+        exit(-1);
+    }
+    iprintf("buffered ordering test succeeded\n");
+
     aligned_t ret;
     assert(qthread_fork_new_team(spawn_dequeuers, q, &ret) == QTHREAD_SUCCESS);
     iprintf("dequeuers forked\n");
@@ -108,6 +185,21 @@ int main(int argc,
     }
     iprintf("threaded test succeeded\n");
 
+    /* again, with the queuers holding elements back and the dequeuers taking
+     * several at a time; nothing may be stranded in a buffer */
+    buffered = 1;
+    assert(qthread_fork_new_team(spawn_dequeuers, q, &ret) == QTHREAD_SUCCESS);
+    for (i = 0; i < THREAD_COUNT; i++) {
+        assert(qthread_fork_to(queuer, q, NULL, i%qthread_num_shepherds()) == QTHREAD_SUCCESS);
+    }
+    assert(qthread_readFF(NULL, &ret) == QTHREAD_SUCCESS);
+    qdqueue_flush(q);
+    if (!qdqueue_empty(q)) {
+        fprintf(stderr, "qdqueue not empty after buffered threaded test!\n");
+        exit(-2);
+    }
+    iprintf("buffered threaded test succeeded\n");
+
     if (qdqueue_destroy(q) != QTHREAD_SUCCESS) {
         fprintf(stderr, "qdqueue_destroy() failed!\n");
         exit(-2);
@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <qthread/qthread.h>
+#include <qthread/qlfqueue.h>
+#include "argparsing.h"
+
+static size_t elementcount = 2000;
+static size_t threadcount  = 16;
+static size_t batch        = 7;
+
+/* values are (producer << 32 | sequence), both counting from 1 */
+#define VAL(p, s) ((void *)(uintptr_t)(((uint64_t)(p) << 32) | (s)))
+#define PRODUCER(v) ((size_t)((uint64_t)(uintptr_t)(v) >> 32))
+#define SEQUENCE(v) ((size_t)((uint64_t)(uintptr_t)(v) & 0xffffffff))
+
+static qlfqueue_t *q;
+static aligned_t   total_seen;
+
+static aligned_t producer(void *arg)
+{
+    size_t      me   = (uintptr_t)arg;
+    void      **vals = malloc(batch * sizeof(void *));
+    size_t      i    = 0;
+
+    assert(vals);
+    while (i < elementcount) {
+        /* alternate single and batched enqueues */
+        if ((i / batch) & 1) {
+            size_t n = 0;
+
+            while (n < batch && i < elementcount) {
+                vals[n++] = VAL(me, ++i);
+            }
+            assert(qlfqueue_enqueue_many(q, vals, n) == QTHREAD_SUCCESS);
+        } else {
+            i++;
+            assert(qlfqueue_enqueue(q, VAL(me, i)) == QTHREAD_SUCCESS);
+        }
+    }
+    free(vals);
+    return 0;
+}
+
+static aligned_t consumer(void *arg)
+{
+    size_t     *last = calloc(threadcount + 1, sizeof(size_t));
+    void      **vals = malloc(batch * sizeof(void *));
+    size_t      got  = 0;
+
+    assert(last && vals);
+    while (got < elementcount) {
+        size_t n;
+
+        if (got & 1) {
+            size_t want = elementcount - got;
+
+            n = qlfqueue_dequeue_many(q, vals, (want < batch) ? want : batch);
+        } else {
+            n = ((vals[0] = qlfqueue_dequeue(q)) != NULL);
+        }
+        if (n == 0) {
+            qthread_yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; i++) {
+            /* each producer's elements come out in the order they went in */
+            assert(SEQUENCE(vals[i]) > last[PRODUCER(vals[i])]);
+            last[PRODUCER(vals[i])] = SEQUENCE(vals[i]);
+        }
+        got += n;
+    }
+    qthread_incr(&total_seen, got);
+    free(last);
+    free(vals);
+    return 0;
+}
+
+static void ordering(void)
+{
+    void **vals = malloc(elementcount * sizeof(void *));
+    size_t i, n;
+
+    assert(vals);
+    for (i = 0; i < elementcount; i++) {
+        assert(qlfqueue_enqueue(q, VAL(1, i + 1)) == QTHREAD_SUCCESS);
+    }
+    for (i = 0; i < elementcount; i++) {
+        assert(qlfqueue_dequeue(q) == VAL(1, i + 1));
+    }
+    assert(qlfqueue_empty(q));
+    assert(qlfqueue_dequeue(q) == NULL);
+
+    /* batches of different sizes in and out */
+    for (i = 0; i < elementcount; i++) {
+        vals[i] = VAL(2, i + 1);
+    }
+    for (i = 0; i < elementcount; i += n) {
+        n = (i % 13) + 1;
+        if (n > elementcount - i) { n = elementcount - i; }
+        assert(qlfqueue_enqueue_many(q, vals + i, n) == QTHREAD_SUCCESS);
+    }
+    for (i = 0; i < elementcount; i += n) {
+        n = qlfqueue_dequeue_many(q, vals, (i % 11) + 1);
+        assert(n > 0);
+        for (size_t j = 0; j < n; j++) {
+            assert(vals[j] == VAL(2, i + j + 1));
+        }
+    }
+    assert(i == elementcount);
+    assert(qlfqueue_dequeue_many(q, vals, 5) == 0);
+    assert(qlfqueue_empty(q));
+    free(vals);
+}
+
+static void threaded(void)
+{
+    aligned_t *rets = malloc(threadcount * sizeof(aligned_t));
+
+    assert(rets);
+    total_seen = 0;
+    for (size_t i = 0; i < threadcount; i++) {
+        assert(qthread_fork(consumer, NULL, rets + i) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < threadcount; i++) {
+        assert(qthread_fork(producer, (void *)(uintptr_t)(i + 1), NULL) == QTHREAD_SUCCESS);
+    }
+    for (size_t i = 0; i < threadcount; i++) {
+        qthread_readFF(NULL, rets + i);
+    }
+    assert(total_seen == threadcount * elementcount);
+    assert(qlfqueue_empty(q));
+    free(rets);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    /* the smallest rings fill up and get replaced constantly */
+    const size_t ring_sizes[] = { 0, 1, 64 };
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(threadcount, "THREAD_COUNT");
+    NUMARG(elementcount, "ELEMENT_COUNT");
+    NUMARG(batch, "BATCH");
+    assert(batch > 0);
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    for (int r = -1; r < 3; r++) {
+        q = (r < 0) ? qlfqueue_create() : qlfqueue_create_ring(ring_sizes[r]);
+        assert(q);
+        ordering();
+        iprintf("%s %lu: ordering ok\n", (r < 0) ? "linked" : "ring",
+                (r < 0) ? 0UL : (unsigned long)ring_sizes[r]);
+        threaded();
+        iprintf("%s %lu: threaded ok\n", (r < 0) ? "linked" : "ring",
+                (r < 0) ? 0UL : (unsigned long)ring_sizes[r]);
+        assert(qlfqueue_destroy(q) == QTHREAD_SUCCESS);
+    }
+
+    return 0;
+}
+
+/* vim:set expandtab */
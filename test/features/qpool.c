@@ -10,6 +10,53 @@ static unsigned int THREAD_COUNT = 128;
 
 qpool *qp = NULL;
 
+static aligned_t constructed = 0;
+static aligned_t destructed  = 0;
+
+typedef struct {
+    aligned_t magic;
+    aligned_t uses;
+} node_t;
+
+static void node_ctor(void *obj,
+                      void *arg)
+{
+    node_t *n = (node_t *)obj;
+
+    assert(arg == &constructed);
+    n->magic = 0xfeedface;
+    n->uses  = 0;
+    qthread_incr(&constructed, 1);
+}
+
+static void node_dtor(void *obj,
+                      void *arg)
+{
+    node_t *n = (node_t *)obj;
+
+    assert(arg == &constructed);
+    assert(n->magic == 0xfeedface);
+    qthread_incr(&destructed, 1);
+}
+
+static aligned_t bulk_allocator(void *arg)
+{
+    void  *block[64];
+    qpool *p = (qpool *)arg;
+
+    for (int round = 0; round < 4; round++) {
+        size_t got = qpool_alloc_bulk(p, block, 64);
+        assert(got == 64);
+        for (size_t i = 0; i < got; i++) {
+            node_t *n = (node_t *)block[i];
+            assert(n->magic == 0xfeedface);
+            n->uses++;
+        }
+        qpool_free_bulk(p, block, got);
+    }
+    return 0;
+}
+
 static aligned_t allocator(void *arg)
 {
     aligned_t *block[5];
@@ -87,6 +134,50 @@ int main(int argc,
 
     qpool_destroy(qp);
 
+    /* bulk interfaces, with constructed objects */
+    if ((qp = qpool_create_with_hooks(sizeof(node_t), 0, node_ctor, node_dtor, &constructed)) == NULL) {
+        fprintf(stderr, "qpool_create_with_hooks() failed!\n");
+        exit(-1);
+    }
+    allthat = (aligned_t **)malloc(sizeof(aligned_t *) * ELEMENT_COUNT);
+    assert(allthat != NULL);
+    i = qpool_alloc_bulk(qp, (void **)allthat, ELEMENT_COUNT);
+    assert(i == ELEMENT_COUNT);
+    iprintf("bulk allocated %lu, constructed %lu\n", (unsigned long)i, (unsigned long)constructed);
+    assert(constructed == ELEMENT_COUNT);
+    for (i = 0; i < ELEMENT_COUNT; i++) {
+        node_t *n = (node_t *)allthat[i];
+        assert(n->magic == 0xfeedface);
+        assert(n->uses == 0);
+        n->uses = i + 1;
+    }
+    qpool_free_bulk(qp, (void *const *)allthat, ELEMENT_COUNT);
+    /* everything comes back out of the pool, already constructed */
+    i = qpool_alloc_bulk(qp, (void **)allthat, ELEMENT_COUNT);
+    assert(i == ELEMENT_COUNT);
+    assert(constructed == ELEMENT_COUNT);
+    for (i = 0; i < ELEMENT_COUNT; i++) {
+        node_t *n = (node_t *)allthat[i];
+        assert(n->magic == 0xfeedface);
+        assert(n->uses != 0);
+    }
+    qpool_free_bulk(qp, (void *const *)allthat, ELEMENT_COUNT);
+    free(allthat);
+
+    rets = (aligned_t *)malloc(sizeof(aligned_t) * THREAD_COUNT);
+    assert(rets != NULL);
+    for (i = 0; i < THREAD_COUNT; i++) {
+        assert(qthread_fork(bulk_allocator, qp, &(rets[i])) == QTHREAD_SUCCESS);
+    }
+    for (i = 0; i < THREAD_COUNT; i++) {
+        assert(qthread_readFF(NULL, &(rets[i])) == QTHREAD_SUCCESS);
+    }
+    free(rets);
+
+    qpool_destroy(qp);
+    iprintf("constructed %lu, destructed %lu\n", (unsigned long)constructed, (unsigned long)destructed);
+    assert(constructed == destructed);
+
     iprintf("success!\n");
     return 0;
 }
@@ -36,6 +36,73 @@ static aligned_t dequeuer(void *arg)
     return 0;
 }
 
+static aligned_t blocking_queuer(void *arg)
+{
+    qswsrqueue_t *q = (qswsrqueue_t *)arg;
+    size_t        i;
+
+    for (i = 0; i < elementcount; i++) {
+        assert(qswsrqueue_enqueue_blocking(q, (void *)(intptr_t)(i + 1)) == QTHREAD_SUCCESS);
+    }
+    return 0;
+}
+
+static aligned_t blocking_dequeuer(void *arg)
+{
+    qswsrqueue_t *q = (qswsrqueue_t *)arg;
+    size_t        i;
+
+    for (i = 0; i < elementcount; i++) {
+        if (qswsrqueue_dequeue_blocking(q) != (void *)(intptr_t)(i + 1)) {
+            fprintf(stderr, "qswsrqueue_dequeue_blocking() out of order at %i!\n", (int)i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return 0;
+}
+
+static aligned_t batch_queuer(void *arg)
+{
+    qswsrqueue_t *q = (qswsrqueue_t *)arg;
+    void         *batch[7];
+    size_t        i = 0;
+
+    while (i < elementcount) {
+        size_t n = (elementcount - i < 7) ? (elementcount - i) : 7;
+        size_t j, sent;
+
+        for (j = 0; j < n; j++) batch[j] = (void *)(intptr_t)(i + j + 1);
+        sent = qswsrqueue_enqueue_many(q, batch, n);
+        if (sent == 0) {
+            qthread_yield();
+        }
+        i += sent;
+    }
+    return 0;
+}
+
+static aligned_t batch_dequeuer(void *arg)
+{
+    qswsrqueue_t *q = (qswsrqueue_t *)arg;
+    void         *batch[5];
+    size_t        i = 0;
+
+    while (i < elementcount) {
+        size_t j, got = qswsrqueue_dequeue_many(q, batch, 5);
+
+        if (got == 0) {
+            qthread_yield();
+        }
+        for (j = 0; j < got; j++, i++) {
+            if (batch[j] != (void *)(intptr_t)(i + 1)) {
+                fprintf(stderr, "qswsrqueue_dequeue_many() out of order at %i!\n", (int)i);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    return 0;
+}
+
 int main(int   argc,
          char *argv[])
 {
@@ -96,6 +163,70 @@ int main(int   argc,
     }
     iprintf("threaded test succeeded\n");
 
+    /* capacity is a power of two, and every slot is usable */
+    for (i = 0; i < 128; i++) {
+        assert(qswsrqueue_enqueue(q, (void *)(intptr_t)(i + 1)) == QTHREAD_SUCCESS);
+    }
+    assert(qswsrqueue_enqueue(q, (void *)(intptr_t)1) == QTHREAD_OPFAIL);
+    for (i = 0; i < 128; i++) {
+        assert(qswsrqueue_dequeue(q) == (void *)(intptr_t)(i + 1));
+    }
+    assert(qswsrqueue_dequeue(q) == NULL);
+    assert(qswsrqueue_empty(q));
+    iprintf("capacity test succeeded\n");
+
+    /* batches that wrap around the end of the ring, and partial batches */
+    {
+        void  *in[100], *out[100];
+        size_t j, next_in = 0, next_out = 0;
+
+        for (i = 0; i < 50; i++) {
+            size_t n = (i % 9) + 1, got;
+
+            for (j = 0; j < n; j++) in[j] = (void *)(intptr_t)(next_in + j + 1);
+            assert(qswsrqueue_enqueue_many(q, in, n) == n);
+            next_in += n;
+            got      = qswsrqueue_dequeue_many(q, out, (i % 7) + 1);
+            for (j = 0; j < got; j++) assert(out[j] == (void *)(intptr_t)(++next_out));
+        }
+        for (j = 0; j < 100; j++) in[j] = (void *)(intptr_t)(next_in + j + 1);
+        j        = qswsrqueue_enqueue_many(q, in, 100);
+        assert(j == 128 - (next_in - next_out));
+        next_in += j;
+        assert(qswsrqueue_enqueue_many(q, in, 1) == 0);
+        while (next_out < next_in) {
+            size_t got = qswsrqueue_dequeue_many(q, out, 100);
+
+            assert(got > 0);
+            for (j = 0; j < got; j++) assert(out[j] == (void *)(intptr_t)(++next_out));
+        }
+        assert(qswsrqueue_dequeue_many(q, out, 100) == 0);
+        assert(qswsrqueue_empty(q));
+    }
+    iprintf("batch test succeeded\n");
+
+    if (qswsrqueue_destroy(q) != QTHREAD_SUCCESS) {
+        fprintf(stderr, "qswsrqueue_destroy() failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* a tiny ring, so both sides have to suspend */
+    if ((q = qswsrqueue_create(2)) == NULL) {
+        fprintf(stderr, "qswsrqueue_create() failed!\n");
+        exit(EXIT_FAILURE);
+    }
+    assert(qthread_fork(blocking_dequeuer, q, &ret) == QTHREAD_SUCCESS);
+    assert(qthread_fork(blocking_queuer, q, NULL) == QTHREAD_SUCCESS);
+    qthread_readFF(NULL, &ret);
+    assert(qswsrqueue_empty(q));
+    iprintf("blocking test succeeded\n");
+
+    assert(qthread_fork(batch_dequeuer, q, &ret) == QTHREAD_SUCCESS);
+    assert(qthread_fork(batch_queuer, q, NULL) == QTHREAD_SUCCESS);
+    qthread_readFF(NULL, &ret);
+    assert(qswsrqueue_empty(q));
+    iprintf("threaded batch test succeeded\n");
+
     if (qswsrqueue_destroy(q) != QTHREAD_SUCCESS) {
         fprintf(stderr, "qswsrqueue_destroy() failed!\n");
         exit(EXIT_FAILURE);
@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "argparsing.h"
+
+#include <qthread/qthread.h>
+#include <qthread/dictionary.h>
+
+static size_t         len     = 20000;
+static size_t         per     = 2000;
+static qt_dictionary *dict    = NULL;
+static void         **keys    = NULL;
+static void         **vals    = NULL;
+
+#define KEY(i) ((void *)(uintptr_t)((i) + 1))
+#define VAL(i) ((void *)(uintptr_t)((i) + 2))
+
+static int int_equals(void *a,
+                      void *b)
+{
+    return a == b;
+}
+
+static int int_hash(void *k)
+{
+    return (int)(uintptr_t)k;
+}
+
+static size_t count_entries(void)
+{
+    qt_dictionary_iterator *it = qt_dictionary_iterator_create(dict);
+    size_t                  n  = 0;
+
+    while (qt_dictionary_iterator_next(it) != NULL) {
+        n++;
+    }
+    qt_dictionary_iterator_destroy(it);
+    return n;
+}
+
+/* each task owns a range of keys beyond the shared ones; it churns through
+ * its own while reading the shared ones, which nobody changes */
+static aligned_t worker(void *arg)
+{
+    const size_t id    = (size_t)(uintptr_t)arg;
+    const size_t first = len + id * per;
+
+    for (size_t i = first; i < first + per; i++) {
+        assert(qt_dictionary_put(dict, KEY(i), VAL(i)) != NULL);
+        assert(qt_dictionary_get(dict, KEY(i)) == VAL(i));
+        assert(qt_dictionary_get(dict, KEY((i * 7) % len)) == VAL((i * 7) % len));
+    }
+    for (size_t i = first; i < first + per; i += 2) {
+        assert(qt_dictionary_delete(dict, KEY(i)) == VAL(i));
+    }
+    for (size_t i = first; i < first + per; i++) {
+        void *v = qt_dictionary_get(dict, KEY(i));
+
+        assert(v == (((i - first) & 1) ? VAL(i) : NULL));
+    }
+    return 0;
+}
+
+int main(int    argc,
+         char **argv)
+{
+    size_t     ntasks, found;
+    aligned_t *rets;
+
+    CHECK_VERBOSE();
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    NUMARG(len, "TEST_LEN");
+    NUMARG(per, "TEST_PER_TASK");
+    ntasks = qthread_num_workers() * 2;
+    iprintf("%i threads, %i tasks\n", qthread_num_workers(), (int)ntasks);
+
+    dict = qt_dictionary_create(int_equals, int_hash, NULL);
+    assert(dict);
+    keys = malloc(len * sizeof(void *));
+    vals = malloc(len * sizeof(void *));
+    assert(keys && vals);
+    for (size_t i = 0; i < len; i++) {
+        keys[i] = KEY(i);
+        vals[i] = VAL(i);
+    }
+
+    assert(qt_dictionary_put_many(dict, keys, vals, len) == len);
+    for (size_t i = 0; i < len; i++) vals[i] = NULL;
+    found = qt_dictionary_get_many(dict, keys, vals, len);
+    iprintf("get_many found %lu of %lu\n", (unsigned long)found, (unsigned long)len);
+    assert(found == len);
+    for (size_t i = 0; i < len; i++) {
+        assert(vals[i] == VAL(i));
+    }
+    assert(count_entries() == len);
+    iprintf("bulk put/get: ok\n");
+
+    /* keys that aren't there */
+    for (size_t i = 0; i < len; i++) keys[i] = KEY(i + len * 100);
+    assert(qt_dictionary_get_many(dict, keys, vals, len) == 0);
+    for (size_t i = 0; i < len; i++) {
+        assert(vals[i] == NULL);
+    }
+    for (size_t i = 0; i < len; i++) keys[i] = KEY(i);
+    iprintf("bulk misses: ok\n");
+
+    rets = malloc(ntasks * sizeof(aligned_t));
+    assert(rets);
+    for (size_t t = 0; t < ntasks; t++) {
+        assert(qthread_fork(worker, (void *)(uintptr_t)t, &rets[t]) == QTHREAD_SUCCESS);
+    }
+    for (size_t t = 0; t < ntasks; t++) {
+        qthread_readFF(NULL, &rets[t]);
+    }
+    assert(count_entries() == len + ntasks * (per / 2));
+    assert(qt_dictionary_get_many(dict, keys, vals, len) == len);
+    iprintf("concurrent put/get/delete: ok\n");
+
+    for (size_t i = 0; i < len; i++) {
+        assert(qt_dictionary_delete(dict, KEY(i)) == VAL(i));
+    }
+    for (size_t i = len + 1; i < len + ntasks * per; i += 2) {
+        assert(qt_dictionary_delete(dict, KEY(i)) == VAL(i));
+    }
+    assert(count_entries() == 0);
+    assert(qt_dictionary_get_many(dict, keys, vals, len) == 0);
+    iprintf("delete all: ok\n");
+
+    qt_dictionary_destroy(dict);
+    free(rets);
+    free(keys);
+    free(vals);
+
+    return 0;
+}
+
+/* vim:set expandtab: */
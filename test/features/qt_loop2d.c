@@ -0,0 +1,157 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qloop.h>
+#include "argparsing.h"
+
+static size_t     nx = 1000, ny = 333, nz = 30;
+static aligned_t *hits  = NULL;
+static aligned_t  calls = 0;
+static size_t    *seq   = NULL;        /* tile corner of each call, in order */
+
+static const char *order_names[] = { "row-major", "morton", "hilbert", "recursive" };
+
+static void mark2d(const size_t xstart,
+                   const size_t xstop,
+                   const size_t ystart,
+                   const size_t ystop,
+                   void        *arg)
+{
+    const aligned_t n = qthread_incr(&calls, 1);
+
+    if (seq) {
+        seq[2 * n]     = xstart;
+        seq[2 * n + 1] = ystart;
+    }
+    for (size_t y = ystart; y < ystop; y++) {
+        for (size_t x = xstart; x < xstop; x++) {
+            qthread_incr(&hits[y * nx + x], 1);
+        }
+    }
+}
+
+static void mark3d(const size_t xstart,
+                   const size_t xstop,
+                   const size_t ystart,
+                   const size_t ystop,
+                   const size_t zstart,
+                   const size_t zstop,
+                   void        *arg)
+{
+    const aligned_t n = qthread_incr(&calls, 1);
+
+    if (seq) {
+        seq[3 * n]     = xstart;
+        seq[3 * n + 1] = ystart;
+        seq[3 * n + 2] = zstart;
+    }
+    for (size_t z = zstart; z < zstop; z++) {
+        for (size_t y = ystart; y < ystop; y++) {
+            for (size_t x = xstart; x < xstop; x++) {
+                qthread_incr(&hits[(z * ny + y) * nx + x], 1);
+            }
+        }
+    }
+}
+
+static void check(const char *name,
+                  size_t      count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (hits[i] != 1) {
+            iprintf("%s: point %lu ran %lu times\n", name, (unsigned long)i, (unsigned long)hits[i]);
+        }
+        assert(hits[i] == 1);
+        hits[i] = 0;
+    }
+    iprintf("%s: ok (%lu tiles)\n", name, (unsigned long)calls);
+    calls = 0;
+}
+
+/* consecutive tiles of a Hilbert curve over a power-of-two grid are always
+ * face neighbors; this only holds up if a single worker runs them in order */
+static void check_adjacent(const size_t dims,
+                           const size_t count)
+{
+    for (size_t i = 1; i < count; i++) {
+        size_t dist = 0;
+
+        for (size_t d = 0; d < dims; d++) {
+            const size_t a = seq[dims * (i - 1) + d], b = seq[dims * i + d];
+
+            dist += (a > b) ? (a - b) : (b - a);
+        }
+        assert(dist == 1);
+    }
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(nx, "NX");
+    NUMARG(ny, "NY");
+    NUMARG(nz, "NZ");
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    hits = calloc(nx * ny * ((nz > 16) ? nz : 16), sizeof(aligned_t));
+    assert(hits);
+
+    for (int o = QT_LOOP_ROW_MAJOR; o <= QT_LOOP_RECURSIVE; o++) {
+        char name[64];
+
+        qt_loop2d(0, nx, 0, ny, 17, 9, (qt_loop_order)o, mark2d, NULL);
+        snprintf(name, sizeof(name), "2d %s", order_names[o]);
+        check(name, nx * ny);
+
+        qt_loop2d(0, nx, 0, ny, 0, 0, (qt_loop_order)o, mark2d, NULL);
+        snprintf(name, sizeof(name), "2d %s, default tiles", order_names[o]);
+        check(name, nx * ny);
+    }
+
+    {
+        const size_t bx = nx, by = ny;
+
+        nx = ny = 8;
+        for (int o = QT_LOOP_ROW_MAJOR; o <= QT_LOOP_RECURSIVE; o++) {
+            char name[64];
+
+            qt_loop3d(0, nx, 0, ny, 0, nz, 3, 2, 5, (qt_loop_order)o, mark3d, NULL);
+            snprintf(name, sizeof(name), "3d %s", order_names[o]);
+            check(name, nx * ny * nz);
+        }
+
+        if (qthread_num_workers() == 1) {
+            seq = malloc(3 * 16 * 16 * 16 * sizeof(size_t));
+            assert(seq);
+            nx  = ny = 16;
+            qt_loop2d(0, nx, 0, ny, 1, 1, QT_LOOP_HILBERT, mark2d, NULL);
+            check_adjacent(2, nx * ny);
+            check("2d hilbert adjacency", nx * ny);
+            nz = nx = ny = 8;
+            qt_loop3d(0, nx, 0, ny, 0, nz, 1, 1, 1, QT_LOOP_HILBERT, mark3d, NULL);
+            check_adjacent(3, nx * ny * nz);
+            check("3d hilbert adjacency", nx * ny * nz);
+            free(seq);
+            seq = NULL;
+        }
+        nx = bx;
+        ny = by;
+    }
+
+    /* empty ranges */
+    qt_loop2d(5, 5, 0, ny, 0, 0, QT_LOOP_HILBERT, mark2d, NULL);
+    qt_loop3d(0, nx, 3, 3, 0, 1, 0, 0, 0, QT_LOOP_RECURSIVE, mark3d, NULL);
+    assert(calls == 0);
+
+    free(hits);
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,137 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qloop.h>
+#include "argparsing.h"
+
+static aligned_t              numincrs = 4096;
+static aligned_t             *hits     = NULL;
+static qthread_shepherd_id_t *where    = NULL;
+static aligned_t              total    = 0;
+
+static void mark(const size_t startat,
+                 const size_t stopat,
+                 void        *arg_)
+{
+    for (size_t i = startat; i < stopat; i++) {
+        qthread_incr(&hits[i], 1);
+        where[i] = qthread_shep();
+    }
+    qthread_incr(&total, stopat - startat);
+}
+
+static void check(const char *name,
+                  size_t      start,
+                  size_t      stop)
+{
+    assert(total == stop - start);
+    for (size_t i = 0; i < numincrs; i++) {
+        if (hits[i] != ((i >= start && i < stop) ? 1 : 0)) {
+            iprintf("%s: iteration %lu ran %lu times\n", name, (unsigned long)i, (unsigned long)hits[i]);
+        }
+        assert(hits[i] == ((i >= start && i < stop) ? 1 : 0));
+        hits[i] = 0;
+    }
+    total = 0;
+    iprintf("%s: ok\n", name);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    qt_loop_affinity_t *h;
+    size_t              moved = 0;
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(numincrs, "NUM_INCRS");
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    hits  = calloc(numincrs, sizeof(aligned_t));
+    where = calloc(numincrs, sizeof(qthread_shepherd_id_t));
+    assert(hits && where);
+
+    h = qt_loop_affinity_create(0, numincrs);
+    assert(h);
+    for (size_t i = 0; i < numincrs; i++) {
+        assert(qt_loop_affinity_shepof(h, i) == NO_SHEPHERD);
+    }
+    qt_loop_affinity_run(h, mark, NULL);
+    check("first run", 0, numincrs);
+    for (size_t i = 0; i < numincrs; i++) {
+        assert(qt_loop_affinity_shepof(h, i) == where[i]);
+    }
+    assert(qt_loop_affinity_shepof(h, numincrs) == NO_SHEPHERD);
+    for (int rep = 0; rep < 10; rep++) {
+        qthread_shepherd_id_t *prev = malloc(numincrs * sizeof(qthread_shepherd_id_t));
+
+        assert(prev);
+        for (size_t i = 0; i < numincrs; i++) prev[i] = where[i];
+        qt_loop_affinity_run(h, mark, NULL);
+        check("replay", 0, numincrs);
+        /* stealing may move a chunk, so this is only reported */
+        for (size_t i = 0; i < numincrs; i++) moved += (prev[i] != where[i]);
+        free(prev);
+    }
+    iprintf("%lu iterations changed shepherds across replays\n", (unsigned long)moved);
+
+    qt_loop_affinity_reset(h);
+    qt_loop_affinity_run(h, mark, NULL);
+    check("after reset", 0, numincrs);
+
+    /* what is recorded is where the chunks ran, not where they were first
+     * queued: with every other shepherd disabled, everything runs on
+     * shepherd 0, even the chunks queued round-robin elsewhere */
+    if (qthread_num_shepherds() > 1) {
+        const qthread_shepherd_id_t nsheps = qthread_num_shepherds();
+
+        qt_loop_affinity_reset(h);
+        for (qthread_shepherd_id_t s = 1; s < nsheps; s++) {
+            assert(qthread_disable_shepherd(s) == QTHREAD_SUCCESS);
+        }
+        qt_loop_affinity_run(h, mark, NULL);
+        check("disabled shepherds", 0, numincrs);
+        for (qthread_shepherd_id_t s = 1; s < nsheps; s++) {
+            qthread_enable_shepherd(s);
+        }
+        for (size_t i = 0; i < numincrs; i++) {
+            assert(where[i] == 0);
+            assert(qt_loop_affinity_shepof(h, i) == 0);
+        }
+        /* replays queue everything on shepherd 0 now, but others may steal */
+        qt_loop_affinity_run(h, mark, NULL);
+        check("replay after disabling", 0, numincrs);
+        for (size_t i = 0; i < numincrs; i++) {
+            assert(qt_loop_affinity_shepof(h, i) == 0);
+        }
+        iprintf("recorded placement follows execution\n");
+    }
+    qt_loop_affinity_destroy(h);
+
+    h = qt_loop_affinity_create(7, 10);
+    qt_loop_affinity_run(h, mark, NULL);
+    check("tiny range", 7, 10);
+    assert(qt_loop_affinity_shepof(h, 6) == NO_SHEPHERD);
+    for (size_t i = 7; i < 10; i++) {
+        assert(qt_loop_affinity_shepof(h, i) == where[i]);
+    }
+    qt_loop_affinity_run(h, mark, NULL);
+    check("tiny range replay", 7, 10);
+    qt_loop_affinity_destroy(h);
+
+    h = qt_loop_affinity_create(5, 5);
+    qt_loop_affinity_run(h, mark, NULL);
+    assert(total == 0);
+    qt_loop_affinity_destroy(h);
+
+    free(hits);
+    free(where);
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,86 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qloop.h>
+#include "argparsing.h"
+
+static aligned_t  numincrs = 4096;
+static aligned_t *hits     = NULL;
+static aligned_t  total    = 0;
+
+static void mark(const size_t startat,
+                 const size_t stopat,
+                 void        *arg_)
+{
+    for (size_t i = startat; i < stopat; i++) {
+        qthread_incr(&hits[i], 1);
+    }
+    qthread_incr(&total, stopat - startat);
+}
+
+/* the last iterations are much more expensive than the first ones, so
+ * whoever ends up with the tail of the range has to give some of it away */
+static void skewed(const size_t startat,
+                   const size_t stopat,
+                   void        *arg_)
+{
+    for (size_t i = startat; i < stopat; i++) {
+        size_t spin = (i * 16) / numincrs;
+        for (size_t j = 0; j < spin; j++) {
+            qthread_yield();
+        }
+        qthread_incr(&hits[i], 1);
+    }
+    qthread_incr(&total, stopat - startat);
+}
+
+static void check(const char *name)
+{
+    if (total != numincrs) {
+        iprintf("%s: total == %lu, not %lu\n", name, (unsigned long)total, (unsigned long)numincrs);
+    }
+    assert(total == numincrs);
+    for (size_t i = 0; i < numincrs; i++) {
+        if (hits[i] != 1) {
+            iprintf("%s: iteration %lu ran %lu times\n", name, (unsigned long)i, (unsigned long)hits[i]);
+        }
+        assert(hits[i] == 1);
+        hits[i] = 0;
+    }
+    total = 0;
+    iprintf("%s: ok\n", name);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(numincrs, "NUM_INCRS");
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    hits = calloc(numincrs, sizeof(aligned_t));
+    assert(hits);
+
+    qt_loop_balance_lazy(0, numincrs, mark, NULL);
+    check("uniform");
+
+    qt_loop_balance_lazy_grain(0, numincrs, 1, skewed, NULL);
+    check("skewed, grain 1");
+
+    qt_loop_balance_lazy_grain(0, numincrs, numincrs, mark, NULL);
+    check("single grain");
+
+    qt_loop_balance_lazy(5, 5, mark, NULL);
+    assert(total == 0);
+
+    free(hits);
+
+    return 0;
+}
+
+/* vim:set expandtab */
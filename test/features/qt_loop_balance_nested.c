@@ -0,0 +1,120 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <qthread/qloop.h>
+#include "argparsing.h"
+
+static aligned_t  rows  = 64;
+static aligned_t  cols  = 512;
+static aligned_t *hits  = NULL;
+static aligned_t  total = 0;
+
+static void mark(const size_t startat,
+                 const size_t stopat,
+                 void        *arg_)
+{
+    const size_t row = *(size_t *)arg_;
+
+    for (size_t i = startat; i < stopat; i++) {
+        qthread_incr(&hits[row * cols + i], 1);
+    }
+    qthread_incr(&total, stopat - startat);
+}
+
+static void row_nested(const size_t startat,
+                       const size_t stopat,
+                       void        *arg_)
+{
+    for (size_t r = startat; r < stopat; r++) {
+        size_t row = r;
+
+        qt_loop_balance_nested(0, cols, mark, &row);
+    }
+}
+
+/* a third level: each row is split in two halves, each of which is a loop */
+static void mark_half(const size_t startat,
+                      const size_t stopat,
+                      void        *arg_)
+{
+    const size_t row  = *(size_t *)arg_;
+    const size_t half = cols / 2;
+
+    for (size_t h = startat; h < stopat; h++) {
+        size_t row_ = row;
+
+        qt_loop_balance_nested(h * half, (h + 1) * half + ((h == 1) ? cols % 2 : 0), mark, &row_);
+    }
+}
+
+static void row_deep(const size_t startat,
+                     const size_t stopat,
+                     void        *arg_)
+{
+    for (size_t r = startat; r < stopat; r++) {
+        size_t row = r;
+
+        qt_loop_balance_nested(0, 2, mark_half, &row);
+    }
+}
+
+static void check(const char *name)
+{
+    const size_t numincrs = rows * cols;
+
+    if (total != numincrs) {
+        iprintf("%s: total == %lu, not %lu\n", name, (unsigned long)total, (unsigned long)numincrs);
+    }
+    assert(total == numincrs);
+    for (size_t i = 0; i < numincrs; i++) {
+        if (hits[i] != 1) {
+            iprintf("%s: iteration %lu ran %lu times\n", name, (unsigned long)i, (unsigned long)hits[i]);
+        }
+        assert(hits[i] == 1);
+        hits[i] = 0;
+    }
+    total = 0;
+    iprintf("%s: ok\n", name);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    size_t row = 0;
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(rows, "ROWS");
+    NUMARG(cols, "COLS");
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    hits = calloc(rows * cols, sizeof(aligned_t));
+    assert(hits);
+
+    qt_loop_balance_nested(0, rows, row_nested, NULL);
+    check("nested in nested");
+
+    qt_loop_balance(0, rows, row_nested, NULL);
+    check("nested in qt_loop_balance");
+
+    qt_loop_balance_nested(0, rows, row_deep, NULL);
+    check("three levels");
+
+    for (row = 0; row < rows; row++) {
+        qt_loop_balance_nested(0, cols, mark, &row);
+    }
+    check("not nested");
+
+    qt_loop_balance_nested(5, 5, mark, &row);
+    assert(total == 0);
+
+    free(hits);
+
+    return 0;
+}
+
+/* vim:set expandtab */
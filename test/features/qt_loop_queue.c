@@ -135,6 +135,16 @@ int main(int argc,
         iprintf("\tsum was %lu\n", (unsigned long)uitmp);
         assert(uitmp == uisum);
 
+        uitmp = 0;
+        loophandle = qt_loop_queue_create(ADAPTIVE, 0, BIGLEN, 1, sum, &uitmp);
+        qtimer_start(t);
+        qt_loop_queue_run(loophandle);
+        qtimer_stop(t);
+        iprintf("summing-parallel ADAPTIVE %u uints took %g seconds\n", BIGLEN,
+                qtimer_secs(t));
+        iprintf("\tsum was %lu\n", (unsigned long)uitmp);
+        assert(uitmp == uisum);
+
         free(uia);
         qtimer_destroy(t);
     }
@@ -0,0 +1,172 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <qthread/qloop.h>
+#include "argparsing.h"
+
+static size_t len = 100000;
+
+static void add(void *restrict       a,
+                const void *restrict b)
+{
+    *(unsigned long *)a += *(const unsigned long *)b;
+}
+
+/* 2x2 matrix multiplication mod 2^32: associative, but not commutative, so
+ * any prefix combined in the wrong order shows up */
+typedef struct {
+    uint32_t m[4];
+} mat_t;
+
+static void matmul(void *restrict       a_,
+                   const void *restrict b_)
+{
+    mat_t       *a = a_;
+    const mat_t *b = b_;
+    mat_t        r;
+
+    r.m[0] = a->m[0] * b->m[0] + a->m[1] * b->m[2];
+    r.m[1] = a->m[0] * b->m[1] + a->m[1] * b->m[3];
+    r.m[2] = a->m[2] * b->m[0] + a->m[3] * b->m[2];
+    r.m[3] = a->m[2] * b->m[1] + a->m[3] * b->m[3];
+    *a     = r;
+}
+
+static int is_odd(const void *elem,
+                  void       *arg)
+{
+    return (*(const unsigned long *)elem) & 1;
+}
+
+static int below(const void *elem,
+                 void       *arg)
+{
+    return (*(const unsigned long *)elem) < *(unsigned long *)arg;
+}
+
+static void fill(unsigned long *a)
+{
+    for (size_t i = 0; i < len; i++) {
+        a[i] = (i * 2654435761UL) % 1000;
+    }
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    unsigned long *in, *out;
+    unsigned long  zero = 0, sum, cut;
+    mat_t         *min, *mout, mid, mrun;
+    size_t         n;
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(len, "TEST_LEN");
+    iprintf("%i shepherds\n", qthread_num_shepherds());
+    iprintf("%i threads\n", qthread_num_workers());
+
+    in  = malloc(len * sizeof(unsigned long));
+    out = malloc(len * sizeof(unsigned long));
+    assert(in && out);
+    fill(in);
+
+    qt_loop_scan(in, out, len, sizeof(unsigned long), add, NULL, QT_SCAN_INCLUSIVE);
+    sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += in[i];
+        assert(out[i] == sum);
+    }
+    iprintf("inclusive: ok\n");
+
+    qt_loop_scan(in, out, len, sizeof(unsigned long), add, &zero, QT_SCAN_EXCLUSIVE);
+    sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        assert(out[i] == sum);
+        sum += in[i];
+    }
+    iprintf("exclusive: ok\n");
+
+    /* in place */
+    memcpy(out, in, len * sizeof(unsigned long));
+    qt_loop_scan(out, out, len, sizeof(unsigned long), add, &zero, QT_SCAN_EXCLUSIVE);
+    sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        assert(out[i] == sum);
+        sum += in[i];
+    }
+    memcpy(out, in, len * sizeof(unsigned long));
+    qt_loop_scan(out, out, len, sizeof(unsigned long), add, NULL, QT_SCAN_INCLUSIVE);
+    sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += in[i];
+        assert(out[i] == sum);
+    }
+    iprintf("in place: ok\n");
+
+    min  = malloc(len * sizeof(mat_t));
+    mout = malloc(len * sizeof(mat_t));
+    assert(min && mout);
+    for (size_t i = 0; i < len; i++) {
+        min[i].m[0] = 1;
+        min[i].m[1] = i + 1;
+        min[i].m[2] = i % 3;
+        min[i].m[3] = 1;
+    }
+    mid.m[0] = mid.m[3] = 1;
+    mid.m[1] = mid.m[2] = 0;
+    qt_loop_scan(min, mout, len, sizeof(mat_t), matmul, &mid, QT_SCAN_EXCLUSIVE);
+    mrun = mid;
+    for (size_t i = 0; i < len; i++) {
+        assert(memcmp(&mout[i], &mrun, sizeof(mat_t)) == 0);
+        matmul(&mrun, &min[i]);
+    }
+    qt_loop_scan(min, mout, len, sizeof(mat_t), matmul, NULL, QT_SCAN_INCLUSIVE);
+    assert(memcmp(&mout[len - 1], &mrun, sizeof(mat_t)) == 0);
+    iprintf("non-commutative: ok\n");
+    free(min);
+    free(mout);
+
+    n = qt_compact(in, out, len, sizeof(unsigned long), is_odd, NULL);
+    for (size_t i = 0, j = 0; i < len; i++) {
+        if (in[i] & 1) {
+            assert(j < n);
+            assert(out[j] == in[i]);
+            j++;
+        }
+        if (i == len - 1) { assert(j == n); }
+    }
+    iprintf("compact: kept %lu, ok\n", (unsigned long)n);
+
+    /* stable partition: each side keeps the original order */
+    memcpy(out, in, len * sizeof(unsigned long));
+    cut = 300;
+    n   = qt_partition(out, len, sizeof(unsigned long), below, &cut);
+    {
+        size_t lo = 0, hi = n;
+
+        for (size_t i = 0; i < len; i++) {
+            if (in[i] < cut) {
+                assert(out[lo++] == in[i]);
+            } else {
+                assert(out[hi++] == in[i]);
+            }
+        }
+        assert(lo == n && hi == len);
+    }
+    iprintf("partition: %lu below %lu, ok\n", (unsigned long)n, cut);
+
+    assert(qt_compact(in, out, 0, sizeof(unsigned long), is_odd, NULL) == 0);
+    assert(qt_partition(out, 0, sizeof(unsigned long), is_odd, NULL) == 0);
+    qt_loop_scan(in, out, 0, sizeof(unsigned long), add, NULL, QT_SCAN_INCLUSIVE);
+
+    free(in);
+    free(out);
+
+    return 0;
+}
+
+/* vim:set expandtab */
@@ -0,0 +1,127 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include <qthread/qthread.h>
+#include <qthread/qutil.h>
+#include "argparsing.h"
+
+/*
+ * This checks the qutil reductions against plain loops, for lengths around
+ * the vector widths and the task chunk size, with values (negative integers,
+ * unsigned integers above 2^63, extremes at either end) that the random
+ * positive numbers in the qutil test never produce.
+ */
+
+static size_t maxlen = 30000;
+
+#define CHECK(_fn_, _arr_, _len_, _expect_) do {                     \
+        if (_fn_(_arr_, _len_, 0) != (_expect_)) {                  \
+            fprintf(stderr, #_fn_ " wrong for length %lu\n",        \
+                    (unsigned long)(_len_));                        \
+            abort();                                                \
+        }                                                           \
+} while (0)
+
+static void check_length(double     *d,
+                         aligned_t  *u,
+                         saligned_t *s,
+                         size_t      len)
+{
+    double     dsum = 0.0, dmax = d[0], dmin = d[0];
+    aligned_t  usum = 0, umult = 1, umax = u[0], umin = u[0];
+    saligned_t ssum = 0, smult = 1, smax = s[0], smin = s[0];
+
+    for (size_t i = 0; i < len; i++) {
+        dsum  += d[i];
+        if (dmax < d[i]) { dmax = d[i]; }
+        if (dmin > d[i]) { dmin = d[i]; }
+        usum  += u[i];
+        umult *= u[i];
+        if (umax < u[i]) { umax = u[i]; }
+        if (umin > u[i]) { umin = u[i]; }
+        ssum  += s[i];
+        smult *= s[i];
+        if (smax < s[i]) { smax = s[i]; }
+        if (smin > s[i]) { smin = s[i]; }
+    }
+    /* the doubles are small integers, so the sum is exact in any order */
+    CHECK(qutil_double_sum, d, len, dsum);
+    CHECK(qutil_double_max, d, len, dmax);
+    CHECK(qutil_double_min, d, len, dmin);
+    CHECK(qutil_uint_sum, u, len, usum);
+    CHECK(qutil_uint_mult, u, len, umult);
+    CHECK(qutil_uint_max, u, len, umax);
+    CHECK(qutil_uint_min, u, len, umin);
+    CHECK(qutil_int_sum, s, len, ssum);
+    CHECK(qutil_int_mult, s, len, smult);
+    CHECK(qutil_int_max, s, len, smax);
+    CHECK(qutil_int_min, s, len, smin);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    double     *d, *p;
+    aligned_t  *u;
+    saligned_t *s;
+    size_t      len;
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(maxlen, "MAXLEN");
+    assert(maxlen >= 64);
+
+    d = malloc(maxlen * sizeof(double));
+    p = malloc(maxlen * sizeof(double));
+    u = malloc(maxlen * sizeof(aligned_t));
+    s = malloc(maxlen * sizeof(saligned_t));
+    assert(d && p && u && s);
+
+    srandom(0x5eed);
+    for (size_t i = 0; i < maxlen; i++) {
+        d[i] = (double)(random() % 2001) - 1000.0;
+        u[i] = ((aligned_t)random() << (sizeof(aligned_t) * 4)) ^ (aligned_t)random();
+        s[i] = (saligned_t)(random() % 2001) - 1000;
+        /* products of these stay exact */
+        p[i] = (random() & 1) ? 2.0 : 0.5;
+    }
+    /* put the extremes at the very ends, where the vector tails are */
+    u[maxlen - 1] = (aligned_t)-1;
+    u[maxlen - 2] = 0;
+    s[maxlen - 1] = -5000;
+    d[maxlen - 1] = 5000.0;
+
+    for (len = 1; len <= 64; len++) {
+        check_length(d + maxlen - len, u + maxlen - len, s + maxlen - len, len);
+    }
+    for (len = 9990; len <= 10010; len += 5) {
+        if (len <= maxlen) {
+            check_length(d + maxlen - len, u + maxlen - len, s + maxlen - len, len);
+        }
+    }
+    check_length(d, u, s, maxlen);
+    iprintf("sum/max/min correct for all types\n");
+
+    for (len = 1; len <= maxlen; len = len * 3 + 1) {
+        double expect = 1.0;
+
+        for (size_t i = 0; i < len; i++) {
+            expect *= p[i];
+        }
+        CHECK(qutil_double_mult, p, len, expect);
+    }
+    iprintf("qutil_double_mult correct\n");
+
+    free(d);
+    free(p);
+    free(u);
+    free(s);
+
+    return 0;
+}
+
+/* vim:set expandtab */
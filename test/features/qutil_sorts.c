@@ -0,0 +1,160 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"                   /* for _GNU_SOURCE */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>                      /* for HUGE_VAL */
+#include <assert.h>
+
+#include <qthread/qutil.h>
+#include "argparsing.h"
+
+/*
+ * This checks qutil_samplesort() and the qutil radix sorts against libc's
+ * qsort(), including element sizes other than a word, heavily duplicated
+ * keys, negative numbers and arrays too short to be split up.
+ */
+
+struct rec {
+    uint32_t key;
+    uint32_t idx;
+    uint32_t pad;
+};
+
+static int rcmp(const void *a,
+                const void *b)
+{
+    const uint32_t x = ((const struct rec *)a)->key;
+    const uint32_t y = ((const struct rec *)b)->key;
+
+    return (x > y) - (x < y);
+}
+
+static int dcmp(const void *a,
+                const void *b)
+{
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int ucmp(const void *a,
+                const void *b)
+{
+    const aligned_t x = *(const aligned_t *)a;
+    const aligned_t y = *(const aligned_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int icmp(const void *a,
+                const void *b)
+{
+    const saligned_t x = *(const saligned_t *)a;
+    const saligned_t y = *(const saligned_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void check_recs(size_t   len,
+                       uint32_t keyrange)
+{
+    struct rec *r    = malloc(len * sizeof(struct rec));
+    char       *seen = calloc(len, 1);
+
+    assert(r && seen);
+    for (size_t i = 0; i < len; i++) {
+        r[i].key = random() % keyrange;
+        r[i].idx = i;
+        r[i].pad = r[i].key ^ 0xdeadbeef;
+    }
+    qutil_samplesort(r, len, sizeof(struct rec), rcmp);
+    for (size_t i = 0; i < len; i++) {
+        assert(i == 0 || r[i - 1].key <= r[i].key);
+        assert(r[i].pad == (r[i].key ^ 0xdeadbeef));
+        assert(r[i].idx < len && !seen[r[i].idx]);
+        seen[r[i].idx] = 1;
+    }
+    free(seen);
+    free(r);
+}
+
+#define CHECK_AGAINST_QSORT(_type_, _array_, _len_, _sortcall_, _cmp_) do { \
+        _type_ *ref = malloc((_len_) * sizeof(_type_));                     \
+        assert(ref);                                                        \
+        memcpy(ref, _array_, (_len_) * sizeof(_type_));                     \
+        qsort(ref, _len_, sizeof(_type_), _cmp_);                           \
+        _sortcall_;                                                         \
+        assert(memcmp(ref, _array_, (_len_) * sizeof(_type_)) == 0);        \
+        free(ref);                                                          \
+} while (0)
+
+int main(int   argc,
+         char *argv[])
+{
+    size_t      len = 200000, lens[3];
+    aligned_t  *u;
+    saligned_t *s;
+    double     *d;
+
+    assert(qthread_initialize() == QTHREAD_SUCCESS);
+    CHECK_VERBOSE();
+    NUMARG(len, "TEST_LEN");
+    assert(len >= 1000);
+    lens[0] = 1000;
+    lens[1] = len / 3 + 1;
+    lens[2] = len;
+
+    u = malloc(len * sizeof(aligned_t));
+    s = malloc(len * sizeof(saligned_t));
+    d = malloc(len * sizeof(double));
+    assert(u && s && d);
+
+    for (int l = 0; l < 3; l++) {
+        const size_t n = lens[l];
+
+        check_recs(n, 0xffffffff);
+        check_recs(n, 3);
+
+        for (size_t i = 0; i < n; i++) {
+            d[i] = (random() - RAND_MAX / 2) / 7.0;
+        }
+        d[0] = HUGE_VAL;
+        d[1] = -HUGE_VAL;
+        d[2] = 0.0;
+        CHECK_AGAINST_QSORT(double, d, n, qutil_samplesort(d, n, sizeof(double), dcmp), dcmp);
+        /* sorted input */
+        CHECK_AGAINST_QSORT(double, d, n, qutil_samplesort(d, n, sizeof(double), dcmp), dcmp);
+        iprintf("samplesort of %lu elements ok\n", (unsigned long)n);
+
+        for (size_t i = 0; i < n; i++) {
+            u[i] = ((aligned_t)random() << (sizeof(aligned_t) * 4)) ^ (aligned_t)random();
+            s[i] = (saligned_t)random() - RAND_MAX / 2;
+            d[i] = (random() - RAND_MAX / 2) / 7.0;
+        }
+        u[0] = (aligned_t)-1;
+        s[0] = (saligned_t)((aligned_t)1 << (sizeof(saligned_t) * 8 - 1));
+        d[0] = -HUGE_VAL;
+        d[1] = HUGE_VAL;
+        CHECK_AGAINST_QSORT(aligned_t, u, n, qutil_uint_radixsort(u, n), ucmp);
+        CHECK_AGAINST_QSORT(saligned_t, s, n, qutil_int_radixsort(s, n), icmp);
+        CHECK_AGAINST_QSORT(double, d, n, qutil_double_radixsort(d, n), dcmp);
+        /* small values skip most passes */
+        for (size_t i = 0; i < n; i++) {
+            u[i] = random() % 1000;
+        }
+        CHECK_AGAINST_QSORT(aligned_t, u, n, qutil_uint_radixsort(u, n), ucmp);
+        iprintf("radix sorts of %lu elements ok\n", (unsigned long)n);
+    }
+
+    free(u);
+    free(s);
+    free(d);
+
+    return 0;
+}
+
+/* vim:set expandtab */